@@ -0,0 +1,364 @@
+/**
+ * Round trip test of the tuiod packet capture (tuio/tuiod/capture.h).
+ *
+ * Synthetic TUIO bundles from three senders (up to 20 moving contacts, the
+ * odd malformed packet) are recorded raw and delta coded, then read back
+ * and compared byte for byte. The same files are read again with their
+ * index cut off, as after a crash, and through capture_seek.
+ *
+ * Usage:
+ *    ./capture_test [-n packets] [file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "capture.h"
+
+#define DEFAULT_PACKETS 20000
+#define DEFAULT_FILE "/tmp/capture_test.cap"
+#define SOURCES 3
+
+struct packet {
+   unsigned int len;
+   unsigned int source;
+   unsigned char data[CAPTURE_MAX_PACKET];
+};
+
+static struct packet *packets;
+static struct capture_reader reader;
+
+
+/*
+ * OSC building
+ */
+static unsigned char *put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+   return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s)
+{
+   unsigned int len = (strlen(s) / 4 + 1) * 4;
+
+   memset(p, 0, len);
+   memcpy(p, s, strlen(s));
+   return p + len;
+}
+
+static unsigned char *put_float(unsigned char *p, float f)
+{
+   union { float f; unsigned int i; } v;
+
+   v.f = f;
+   return put_be32(p, v.i);
+}
+
+/* Message element of a bundle: size, then the message */
+static unsigned char *begin_element(unsigned char *p, unsigned char **size)
+{
+   *size = p;
+   return p + 4;
+}
+
+static void end_element(unsigned char *size, unsigned char *end)
+{
+   put_be32(size, end - size - 4);
+}
+
+/*
+ * One 2Dcur frame of n contacts moving on circles, positions on the pixels
+ * of a 640x480 tracker camera like reacTIVision's
+ */
+static unsigned int build_frame(unsigned char *buf, int source, int frame,
+      int n)
+{
+   unsigned char *p = buf, *size;
+   char types[32];
+   float a;
+   int i;
+
+   p = put_string(p, "#bundle");
+   p = put_be32(p, 0);
+   p = put_be32(p, 1);
+
+   strcpy(types, ",s");
+   for (i = 0; i < n; i++)
+      strcat(types, "i");
+   p = begin_element(p, &size);
+   p = put_string(p, "/tuio/2Dcur");
+   p = put_string(p, types);
+   p = put_string(p, "alive");
+   for (i = 0; i < n; i++)
+      p = put_be32(p, source * 1000 + i);
+   end_element(size, p);
+
+   for (i = 0; i < n; i++) {
+      a = (frame + i * 17) * 0.01f;
+      p = begin_element(p, &size);
+      p = put_string(p, "/tuio/2Dcur");
+      p = put_string(p, ",sifffff");
+      p = put_string(p, "set");
+      p = put_be32(p, source * 1000 + i);
+      p = put_float(p, (int) (320 + 190 * cosf(a)) / 640.0f);
+      p = put_float(p, (int) (240 + 140 * sinf(a)) / 480.0f);
+      p = put_float(p, -0.18f * sinf(a));
+      p = put_float(p, 0.18f * cosf(a));
+      p = put_float(p, 0.0f);
+      end_element(size, p);
+   }
+
+   p = begin_element(p, &size);
+   p = put_string(p, "/tuio/2Dcur");
+   p = put_string(p, ",si");
+   p = put_string(p, "fseq");
+   p = put_be32(p, frame);
+   end_element(size, p);
+
+   return p - buf;
+}
+
+static void build(long count)
+{
+   struct packet *pk;
+   long k;
+   int i;
+
+   for (k = 0; k < count; k++) {
+      pk = &packets[k];
+      pk->source = k % SOURCES;
+      pk->len = build_frame(pk->data, pk->source, (int) (k / SOURCES),
+            1 + (int) (k / 50 % 20));
+
+      /* Now and then a bundle with a truncated element, a bare message and
+       * random bytes: they must come back as they went in */
+      if (k % 997 == 500) {
+         pk->len -= 6;
+      } else if (k % 997 == 501) {
+         pk->len = put_string(pk->data, "/ping") - pk->data;
+      } else if (k % 997 == 502) {
+         pk->len = 61;
+         for (i = 0; i < 61; i++)
+            pk->data[i] = (unsigned char) (k * 31 + i * 7);
+      }
+   }
+}
+
+static void record(const char *file, long count, int flags)
+{
+   struct sockaddr_in from[SOURCES];
+   struct timespec wait = { 0, 100000 };
+   struct capture *c;
+   unsigned long long written, dropped;
+   long k;
+   int s;
+
+   for (s = 0; s < SOURCES; s++) {
+      memset(&from[s], 0, sizeof(from[s]));
+      from[s].sin_family = AF_INET;
+      from[s].sin_port = htons(3333 + s);
+      from[s].sin_addr.s_addr = htonl(0x0a000001 + s);
+   }
+
+   if ((c = capture_open(file, flags)) == NULL) {
+      printf("ERROR: Could not create '%s'\n", file);
+      exit(1);
+   }
+
+   /* A full ring drops, so give the writer time rather than lose packets */
+   for (k = 0; k < count; k++)
+      while (capture_packet(c, (struct sockaddr *) &from[packets[k].source],
+               packets[k].data, packets[k].len))
+         nanosleep(&wait, NULL);
+   capture_close(c, &written, &dropped);
+
+   if (written != (unsigned long long) count)
+      printf("FAIL recorded %llu of %ld packets\n", written, count);
+}
+
+/*
+ * Reads the capture from 'first' on and compares it with the packets.
+ * Returns the number of mismatches.
+ */
+static int verify(const char *name, const char *file, long first, long count,
+      unsigned long long seek_ns, int expect_index)
+{
+   struct capture_reader *r = &reader;
+   struct capture_packet p;
+   long k = first, read = 0, bytes = 0, stored = 0;
+   unsigned long long last_ns = 0;
+   int ret, bad = 0;
+
+   if (capture_reader_open(r, file)) {
+      printf("FAIL %s: could not open\n", name);
+      return 1;
+   }
+   if (r->indexed != expect_index) {
+      printf("FAIL %s: index %s\n", name, r->indexed ? "found" : "missing");
+      bad++;
+   }
+
+   if (seek_ns) {
+      capture_seek(r, seek_ns);
+      /* The block found starts at or before the time sought */
+      k = -1;
+   }
+
+   while ((ret = capture_next(r, &p)) > 0) {
+      if (k < 0) {
+         /* Find where in the stream the seek landed */
+         for (k = 0; k < count; k++)
+            if (packets[k].len == p.len &&
+                  !memcmp(packets[k].data, p.data, p.len))
+               break;
+         if (p.time_ns > seek_ns) {
+            printf("FAIL %s: seek landed after the time sought\n", name);
+            bad++;
+         }
+      }
+      if (k >= count || p.len != packets[k].len ||
+            memcmp(p.data, packets[k].data, p.len) ||
+            p.source != packets[k].source ||
+            p.from->port != 3333 + packets[k].source ||
+            p.time_ns < last_ns) {
+         if (bad++ < 5)
+            printf("FAIL %s: packet %ld differs\n", name, k);
+      }
+      last_ns = p.time_ns;
+      bytes += p.len;
+      stored += p.stored;
+      read++;
+      k++;
+   }
+   if (ret < 0) {
+      printf("FAIL %s: corrupt record after packet %ld\n", name, k);
+      bad++;
+   }
+   if (k != count) {
+      printf("FAIL %s: read %ld of %ld packets\n", name, k - first,
+            count - first);
+      bad++;
+   }
+   if (!bad)
+      printf("PASS %s: %ld packets, %ld bytes stored as %ld (%.0f%%), "
+            "%u blocks\n", name, read, bytes, stored,
+            100.0 * stored / (bytes ? bytes : 1), r->blocks);
+
+   capture_reader_close(r);
+   return bad;
+}
+
+/* Cuts the index and trailer off, or the last block short as well */
+static void truncate_capture(const char *file, int tear)
+{
+   struct capture_reader *r = &reader;
+   unsigned long long size;
+
+   capture_reader_open(r, file);
+   size = r->block[r->blocks - 1].offset;
+   if (!tear) {
+      fseeko(r->fp, 0, SEEK_END);
+      size = ftello(r->fp) - CAPTURE_INDEX_HEADER -
+         CAPTURE_INDEX_ENTRY * r->blocks - CAPTURE_TRAILER;
+   } else {
+      size += 100;
+   }
+   capture_reader_close(r);
+   if (truncate(file, size)) {
+      printf("ERROR: Could not truncate '%s'\n", file);
+      exit(1);
+   }
+}
+
+/* Packets before the last block, for the torn capture */
+static long packets_before_last_block(const char *file)
+{
+   struct capture_reader *r = &reader;
+   struct capture_packet p;
+   long n = 0;
+
+   capture_reader_open(r, file);
+   r->blocks--;
+   while (capture_next(r, &p) > 0)
+      n++;
+   r->blocks++;
+   capture_reader_close(r);
+   return n;
+}
+
+/* Time of the packet at about 'fraction' of the capture */
+static unsigned long long time_at(const char *file, double fraction)
+{
+   struct capture_reader *r = &reader;
+   struct capture_packet p;
+   unsigned long long t = 0;
+
+   capture_reader_open(r, file);
+   t = r->block[(unsigned int) (r->blocks * fraction)].first_ns;
+   while (capture_next(r, &p) > 0 && p.time_ns < t)
+      ;
+   t = p.time_ns + 1;
+   capture_reader_close(r);
+   return t;
+}
+
+int main(int argc, char** argv)
+{
+   const char *file = DEFAULT_FILE;
+   long count = DEFAULT_PACKETS, last;
+   int opt, failed = 0, pass;
+
+   while ((opt = getopt(argc, argv, "n:")) != -1) {
+      if (opt != 'n') {
+         printf("usage: %s [-n packets] [file]\n", argv[0]);
+         exit(1);
+      }
+      count = atol(optarg);
+   }
+   if (optind < argc)
+      file = argv[optind];
+   if (count < 1000) {
+      printf("usage: %s [-n packets] [file]\n", argv[0]);
+      exit(1);
+   }
+
+   packets = malloc(count * sizeof(*packets));
+   build(count);
+
+   for (pass = 0; pass < 2; pass++) {
+      const char *mode = pass ? "delta" : "raw";
+      char name[64];
+
+      record(file, count, pass ? CAPTURE_DELTA : 0);
+      snprintf(name, sizeof(name), "%s", mode);
+      failed += verify(name, file, 0, count, 0, 1);
+
+      snprintf(name, sizeof(name), "%s seek", mode);
+      failed += verify(name, file, 0, count, time_at(file, 0.6), 1);
+
+      truncate_capture(file, 0);
+      snprintf(name, sizeof(name), "%s without index", mode);
+      failed += verify(name, file, 0, count, 0, 0);
+
+      last = packets_before_last_block(file);
+      truncate_capture(file, 1);
+      snprintf(name, sizeof(name), "%s torn", mode);
+      failed += verify(name, file, 0, last, 0, 0);
+   }
+
+   if (optind >= argc)
+      unlink(file);
+   free(packets);
+   printf("%d failed\n", failed);
+   return failed != 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * Golden vector test and throughput benchmark for the touchmouse coordinate
+ * parser (tuio/touchmouse/coord.h).
+ *
+ *    ./coord_test vectors.txt   check every vector, exit 1 on any mismatch
+ *    ./coord_test -b [iters]    compare parse_coord against the old strsep
+ *                               parser on a typical "set" message
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coord.h"
+
+#define LINE_LEN 256
+#define BENCH_ITERS 5000000
+#define BENCH_MSG "set 4 0.482812 0.412500 0.000000 0.000000 -7.122507\n"
+
+
+int run_vectors(const char *file)
+{
+   FILE *fp;
+   char line[LINE_LEN], input[LINE_LEN];
+   const char *p;
+   unsigned long res;
+   long expected, got;
+   int lineno = 0, count = 0, failed = 0;
+
+   if ((fp = fopen(file, "r")) == NULL) {
+      printf("ERROR: Could not open vectors '%s'\n", file);
+      return 1;
+   }
+
+   while (fgets(line, sizeof(line), fp)) {
+      lineno++;
+      if (line[0] == '#' || line[0] == '\n')
+         continue;
+
+      if (sscanf(line, "%s %lu %ld", input, &res, &expected) != 3) {
+         printf("%s:%d: malformed vector\n", file, lineno);
+         failed++;
+         continue;
+      }
+
+      p = input;
+      got = parse_coord(&p, res);
+      count++;
+
+      if (got != expected || *p != '\0') {
+         printf("%s:%d: FAIL \"%s\" res %lu: expected %ld got %ld (stopped at '%s')\n",
+               file, lineno, input, res, expected, got, p);
+         failed++;
+      }
+   }
+   fclose(fp);
+
+   printf("%d vectors, %d failed\n", count, failed);
+   return failed != 0;
+}
+
+/* The parser update_state used before coord.h, kept for comparison */
+static void parse_strsep(char *message, long *id, long *x, long *y)
+{
+   char **copy, *token;
+
+   message += strlen("set") + 1;
+   copy = &message;
+
+   token = strsep(copy, " ");
+   *id = strtoul(token, NULL, 10);
+
+   token = strsep(copy, ".");
+   token = strsep(copy, " ");
+   *x = strtoul(token, NULL, 10);
+
+   token = strsep(copy, ".");
+   token = strsep(copy, " ");
+   *y = strtoul(token, NULL, 10);
+}
+
+static void parse_fixed(char *message, long *id, long *x, long *y)
+{
+   const char *args = message + strlen("set") + 1;
+
+   *id = strtoul(args, (char **) &args, 10);
+   while (*args == ' ')
+      args++;
+   *x = parse_coord(&args, 1000000);
+   *y = parse_coord(&args, 1000000);
+}
+
+static double elapsed_ns(struct timespec *a, struct timespec *b)
+{
+   return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void bench(const char *name, long iters,
+      void (*parse)(char *, long *, long *, long *))
+{
+   char msg[LINE_LEN];
+   struct timespec start, end;
+   long i, id, x, y, sum = 0;
+   double ns;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (i = 0; i < iters; i++) {
+      /* strsep modifies the message, copy it fresh every time */
+      memcpy(msg, BENCH_MSG, sizeof(BENCH_MSG));
+      parse(msg, &id, &x, &y);
+      sum += id + x + y;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   ns = elapsed_ns(&start, &end);
+   printf("%-8s %8.1f ns/msg %10.0f msg/s  (x=%ld y=%ld, check %ld)\n",
+         name, ns / iters, iters / (ns / 1e9), x, y, sum);
+}
+
+int main(int argc, char** argv)
+{
+   long iters = BENCH_ITERS;
+
+   if (argc >= 2 && !strcmp(argv[1], "-b")) {
+      if (argc >= 3)
+         iters = atol(argv[2]);
+      bench("strsep", iters, parse_strsep);
+      bench("fixed", iters, parse_fixed);
+      return 0;
+   }
+
+   if (argc != 2) {
+      printf("usage: %s vectors_file | -b [iterations]\n", argv[0]);
+      return 1;
+   }
+
+   return run_vectors(argv[1]);
+}
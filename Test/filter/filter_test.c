@@ -0,0 +1,357 @@
+/**
+ * Test of tuiod's profile filter (tuio/tuiod/filter.h).
+ *
+ * Sample datagrams, TUIO bundles of several profiles, lone messages and
+ * short or malformed packets, go through filter_packet and through the
+ * classic BPF program of filter_program, run here as a socket filter runs
+ * it (after the UDP header, a load past the end drops the datagram), for
+ * each of a few subscriptions. Both are compared to the expected results,
+ * and the kernel filter must keep whatever filter_packet keeps, but for
+ * bundles mixing profiles. Last the program is attached to a loopback UDP
+ * socket, and the datagrams that arrive must be the ones it keeps.
+ *
+ * Usage:
+ *    ./filter_test [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "filter.h"
+
+#define UDP_HEADER 8
+#define MAX_PACKET 256
+#define SETS 3
+
+#define CUR "/tuio/2Dcur"
+#define OBJ "/tuio/2Dobj"
+
+static const char *sets[SETS] = { FILTER_DEFAULT, CUR "," OBJ,
+   "/tuio/25Dcur" };
+
+struct sample {
+   const char *name;
+   unsigned int (*build)(unsigned char *buf);
+   int mixed;                      /* The kernel only sees the first */
+   int user[SETS];                 /* Kept by filter_packet, per set */
+   int kernel[SETS];               /* And by the BPF program */
+};
+
+static unsigned char *put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+   return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s)
+{
+   unsigned int len = (strlen(s) / 4 + 1) * 4;
+
+   memset(p, 0, len);
+   memcpy(p, s, strlen(s));
+   return p + len;
+}
+
+/* A "<path> fseq 1" message */
+static unsigned char *put_message(unsigned char *p, const char *path)
+{
+   p = put_string(p, path);
+   p = put_string(p, ",si");
+   p = put_string(p, "fseq");
+   return put_be32(p, 1);
+}
+
+/* A bundle of a message per path */
+static unsigned int put_bundle(unsigned char *buf, const char **paths, int n)
+{
+   unsigned char *p = buf, *size;
+   int i;
+
+   p = put_string(p, "#bundle");
+   p = put_be32(p, 0);
+   p = put_be32(p, 1);
+   for (i = 0; i < n; i++) {
+      size = p;
+      p = put_message(p + 4, paths[i]);
+      put_be32(size, p - size - 4);
+   }
+   return p - buf;
+}
+
+static unsigned int cur_bundle(unsigned char *buf)
+{
+   const char *paths[] = { CUR, CUR, CUR };
+   return put_bundle(buf, paths, 3);
+}
+
+static unsigned int obj_bundle(unsigned char *buf)
+{
+   const char *paths[] = { OBJ, OBJ };
+   return put_bundle(buf, paths, 2);
+}
+
+static unsigned int blb_bundle(unsigned char *buf)
+{
+   const char *paths[] = { "/tuio/2Dblb" };
+   return put_bundle(buf, paths, 1);
+}
+
+/* A path of whole words, its NULs a word of their own */
+static unsigned int cur25_bundle(unsigned char *buf)
+{
+   const char *paths[] = { "/tuio/25Dcur" };
+   return put_bundle(buf, paths, 1);
+}
+
+static unsigned int prefix_bundle(unsigned char *buf)
+{
+   const char *paths[] = { CUR "x" };
+   return put_bundle(buf, paths, 1);
+}
+
+static unsigned int mixed_bundle(unsigned char *buf)
+{
+   const char *paths[] = { OBJ, CUR };
+   return put_bundle(buf, paths, 2);
+}
+
+static unsigned int cur_message(unsigned char *buf)
+{
+   return put_message(buf, CUR) - buf;
+}
+
+static unsigned int obj_message(unsigned char *buf)
+{
+   return put_message(buf, OBJ) - buf;
+}
+
+static unsigned int empty(unsigned char *buf)
+{
+   return 0;
+}
+
+static unsigned int short_packet(unsigned char *buf)
+{
+   memcpy(buf, "abc", 3);
+   return 3;
+}
+
+static unsigned int bundle_header(unsigned char *buf)
+{
+   return put_bundle(buf, NULL, 0);
+}
+
+/* A 2Dcur message its element size says runs past the end */
+static unsigned int bad_size(unsigned char *buf)
+{
+   unsigned int len = cur_bundle(buf);
+
+   put_be32(buf + 16, 1000);
+   return len;
+}
+
+/* Cut in the middle of the first path */
+static unsigned int cut_path(unsigned char *buf)
+{
+   cur_bundle(buf);
+   return 28;
+}
+
+static const struct sample samples[] = {
+   { "2Dcur bundle", cur_bundle, 0, { 1, 1, 0 }, { 1, 1, 0 } },
+   { "2Dobj bundle", obj_bundle, 0, { 0, 1, 0 }, { 0, 1, 0 } },
+   { "2Dblb bundle", blb_bundle, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+   { "25Dcur bundle", cur25_bundle, 0, { 0, 0, 1 }, { 0, 0, 1 } },
+   { "2Dcurx bundle", prefix_bundle, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+   { "mixed bundle", mixed_bundle, 1, { 1, 1, 0 }, { 0, 1, 0 } },
+   { "2Dcur message", cur_message, 0, { 1, 1, 0 }, { 1, 1, 1 } },
+   { "2Dobj message", obj_message, 0, { 0, 1, 0 }, { 1, 1, 1 } },
+   { "empty", empty, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+   { "3 bytes", short_packet, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+   { "bundle header", bundle_header, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+   { "bad size", bad_size, 0, { 0, 0, 0 }, { 1, 1, 0 } },
+   { "cut path", cut_path, 0, { 0, 0, 0 }, { 0, 0, 0 } },
+};
+#define SAMPLES (sizeof(samples) / sizeof(samples[0]))
+
+/*
+ * Runs a program on a datagram as the kernel runs a UDP socket filter:
+ * on the packet from the UDP header. Returns whether it is kept.
+ */
+static int run_program(const struct sock_filter *insn, int n,
+      const unsigned char *data, unsigned int len)
+{
+   unsigned char packet[UDP_HEADER + MAX_PACKET];
+   unsigned int a = 0, k, pc;
+
+   memset(packet, 0, UDP_HEADER);
+   memcpy(packet + UDP_HEADER, data, len);
+   len += UDP_HEADER;
+
+   for (pc = 0; pc < (unsigned int) n; pc++) {
+      k = insn[pc].k;
+      switch (insn[pc].code) {
+         case BPF_LD | BPF_W | BPF_ABS:
+            if (k + 4 > len)
+               return 0;
+            a = (unsigned int) packet[k] << 24 | packet[k + 1] << 16 |
+               packet[k + 2] << 8 | packet[k + 3];
+            break;
+         case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += a == k ? insn[pc].jt : insn[pc].jf;
+            break;
+         case BPF_RET | BPF_K:
+            return k != 0;
+         default:
+            printf("FAIL instruction %u: unknown code 0x%x\n", pc,
+                  insn[pc].code);
+            return -1;
+      }
+   }
+   printf("FAIL program runs past its end\n");
+   return -1;
+}
+
+static int check_samples(int set, const struct sock_filter *insn, int n,
+      int verbose)
+{
+   const struct sample *s;
+   unsigned char buf[MAX_PACKET];
+   unsigned int i, len;
+   int user, kernel, failed = 0;
+
+   for (i = 0; i < SAMPLES; i++) {
+      s = &samples[i];
+      len = s->build(buf);
+      user = filter_packet(buf, len);
+      kernel = run_program(insn, n, buf, len);
+
+      if (user != s->user[set] || kernel != s->kernel[set]) {
+         printf("FAIL %s, -p %s: filter_packet %d, program %d, expected "
+               "%d and %d\n", s->name, sets[set], user, kernel,
+               s->user[set], s->kernel[set]);
+         failed++;
+      } else if (user && !kernel && !s->mixed) {
+         printf("FAIL %s, -p %s: dropped in the kernel, kept by "
+               "filter_packet\n", s->name, sets[set]);
+         failed++;
+      } else if (verbose) {
+         printf("ok   %s, -p %s: %s\n", s->name, sets[set],
+               kernel ? (user ? "kept" : "kept by the kernel only") :
+               (user ? "kept by filter_packet only" : "dropped"));
+      }
+   }
+   return failed;
+}
+
+/*
+ * Sends every sample, each followed by a marker that always passes, to a
+ * loopback socket with the filter attached: a sample is kept if it
+ * arrives before its marker. Returns failures, -1 if it could not run.
+ */
+static int check_kernel(int set, const struct sock_filter *insn, int n)
+{
+   static const unsigned char marker[] = "/end\0\0\0\0,\0\0";
+   unsigned char buf[MAX_PACKET], got[MAX_PACKET];
+   struct sockaddr_in addr;
+   socklen_t addr_len = sizeof(addr);
+   struct timeval tv = { 1, 0 };
+   unsigned int i, len;
+   int rx, tx, kept, failed = 0;
+   ssize_t r;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if ((rx = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ||
+         (tx = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ||
+         bind(rx, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+         getsockname(rx, (struct sockaddr *) &addr, &addr_len) < 0 ||
+         connect(tx, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+         setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+      perror("loopback socket");
+      return -1;
+   }
+   if (filter_attach(rx) < 0) {
+      printf("FAIL -p %s: the kernel refused the program\n", sets[set]);
+      close(rx);
+      close(tx);
+      return 1;
+   }
+
+   for (i = 0; i < SAMPLES; i++) {
+      len = samples[i].build(buf);
+      if (send(tx, buf, len, 0) < 0 ||
+            send(tx, marker, sizeof(marker) - 1, 0) < 0) {
+         perror("send");
+         failed++;
+         break;
+      }
+      if ((r = recv(rx, got, sizeof(got), 0)) < 0) {
+         perror("recv");
+         failed++;
+         break;
+      }
+      kept = r != sizeof(marker) - 1 || memcmp(got, marker, r);
+      if (kept && recv(rx, got, sizeof(got), 0) < 0) {
+         perror("recv");
+         failed++;
+         break;
+      }
+      if (kept != run_program(insn, n, buf, len)) {
+         printf("FAIL %s, -p %s: the kernel %s it\n", samples[i].name,
+               sets[set], kept ? "kept" : "dropped");
+         failed++;
+      }
+   }
+   close(rx);
+   close(tx);
+   return failed;
+}
+
+int main(int argc, char** argv)
+{
+   int verbose = argc > 1 && !strcmp(argv[1], "-v");
+   struct sock_filter insn[FILTER_MAX_INSNS];
+   int set, n, ret, failed = 0, kernel = 1;
+   unsigned char buf[MAX_PACKET];
+   unsigned int i;
+
+   for (set = 0; set < SETS; set++) {
+      if (filter_set(sets[set]) < 0 || (n = filter_program(insn)) < 0) {
+         printf("FAIL -p %s: no program\n", sets[set]);
+         failed++;
+         continue;
+      }
+      failed += check_samples(set, insn, n, verbose);
+      if (kernel && (ret = check_kernel(set, insn, n)) < 0)
+         kernel = 0;
+      else if (kernel)
+         failed += ret;
+   }
+
+   /* "*" keeps everything, with no program to attach */
+   filter_set("*");
+   for (i = 0; i < SAMPLES; i++)
+      if (!filter_packet(buf, samples[i].build(buf))) {
+         printf("FAIL %s, -p '*': dropped\n", samples[i].name);
+         failed++;
+      }
+   if (filter_program(insn) != -1) {
+      printf("FAIL -p '*': a program\n");
+      failed++;
+   }
+
+   printf("%u samples, %d subscriptions%s, %d failed\n", (unsigned) SAMPLES,
+         SETS, kernel ? " (and in the kernel)" : "", failed);
+   return failed != 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * Test of the tuiod frame ordering (tuio/tuiod/fseq.h).
+ *
+ * Each case sends a sequence of fseq bundles, from its own sender, at
+ * given times and compares the frames passed on, in order and with the
+ * frames lost before them, to the expected ones. Frames held for
+ * reordering are taken out at the time of the next arrival, and at the
+ * end; in a burst only at the end, as when tuiod drains its socket.
+ *
+ * Last the senders fill every place, and a new one must be turned away
+ * until one of them has been silent for FSEQ_EXPIRE_NS, then take its place
+ * with its order starting afresh.
+ *
+ * Usage:
+ *    ./fseq_test [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "fseq.h"
+
+#define MAX_SENT 24
+#define START_NS 1000000000ULL
+
+struct sent {
+   int obj;                        /* /tuio/2Dobj instead of 2Dcur */
+   long fseq;
+   unsigned int ms;                /* Arrival */
+};
+
+struct test {
+   const char *name;
+   unsigned int budget_ms;
+   struct sent sent[MAX_SENT];
+   int count;
+   const char *expect;             /* fseq(lost) ... */
+   int burst;                      /* No fseq_next between arrivals */
+};
+
+static const struct test tests[] = {
+   { "in order", 0, { {0, 1, 0}, {0, 2, 16}, {0, 3, 33} }, 3, "1 2 3" },
+   { "duplicate", 0, { {0, 1, 0}, {0, 2, 16}, {0, 2, 17}, {0, 3, 33} }, 4,
+      "1 2 3" },
+   { "stale", 0, { {0, 1, 0}, {0, 3, 16}, {0, 2, 17}, {0, 4, 33} }, 4,
+      "1 3(1) 4" },
+   { "reordered", 20, { {0, 1, 0}, {0, 3, 16}, {0, 2, 17}, {0, 4, 33} }, 4,
+      "1 2 3 4" },
+   { "duplicate held", 20, { {0, 1, 0}, {0, 3, 16}, {0, 3, 17},
+      {0, 2, 18} }, 4, "1 2 3" },
+   { "budget spent", 20, { {0, 1, 0}, {0, 3, 16}, {0, 4, 33},
+      {0, 5, 50} }, 4, "1 3(1) 4 5" },
+   { "window full", 1000, { {0, 1, 0}, {0, 3, 1}, {0, 4, 2}, {0, 5, 3},
+      {0, 6, 4}, {0, 7, 5}, {0, 8, 6}, {0, 9, 7}, {0, 10, 8}, {0, 11, 9} },
+      10, "1 3(1) 4 5 6 7 8 9 10 11" },
+   { "burst", 1000, { {0, 1, 0}, {0, 3, 1}, {0, 4, 1}, {0, 5, 1}, {0, 6, 1},
+      {0, 7, 1}, {0, 8, 1}, {0, 9, 1}, {0, 10, 1}, {0, 11, 1}, {0, 12, 1},
+      {0, 13, 1}, {0, 14, 1}, {0, 15, 1}, {0, 16, 1}, {0, 17, 1}, {0, 18, 1},
+      {0, 19, 1}, {0, 20, 1} }, 19,
+      "1 3(1) 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20", 1 },
+   { "burst, oldest late", 1000, { {0, 1, 0}, {0, 4, 1}, {0, 5, 1},
+      {0, 6, 1}, {0, 7, 1}, {0, 8, 1}, {0, 9, 1}, {0, 10, 1}, {0, 11, 1},
+      {0, 12, 1}, {0, 3, 1}, {0, 2, 1}, {0, 13, 1} }, 13,
+      "1 3(1) 4 5 6 7 8 9 10 11 12 13", 1 },
+   { "restart", 0, { {0, 500, 0}, {0, 501, 16}, {0, 1, 33}, {0, 2, 50} }, 4,
+      "500 501 1 2" },
+   { "idle restart", 0, { {0, 100, 0}, {0, 90, 16}, {0, 90, 1500} }, 3,
+      "100 90" },
+   { "redundant", 0, { {0, 1, 0}, {0, -1, 16}, {0, -1, 17}, {0, 2, 33} }, 4,
+      "1 -1 -1 2" },
+   { "profiles", 0, { {0, 1, 0}, {1, 1, 1}, {0, 2, 16}, {1, 2, 17},
+      {1, 1, 18} }, 5, "1 o1 2 o2" },
+};
+
+static unsigned char *put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+   return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s)
+{
+   unsigned int len = (strlen(s) / 4 + 1) * 4;
+
+   memset(p, 0, len);
+   memcpy(p, s, strlen(s));
+   return p + len;
+}
+
+/* A bundle of just the fseq message, which ends it */
+static unsigned int build_frame(unsigned char *buf, int obj, long fseq)
+{
+   unsigned char *p = buf, *size;
+
+   p = put_string(p, "#bundle");
+   p = put_be32(p, 0);
+   p = put_be32(p, 1);
+   size = p;
+   p += 4;
+   p = put_string(p, obj ? "/tuio/2Dobj" : "/tuio/2Dcur");
+   p = put_string(p, ",si");
+   p = put_string(p, "fseq");
+   p = put_be32(p, fseq);
+   put_be32(size, p - size - 4);
+   return p - buf;
+}
+
+static void print_frame(char *out, const struct fseq_frame *f)
+{
+   const unsigned char *p = f->data + f->len - 4;
+   int fseq = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+
+   const char *sep = *out ? " " : "";
+
+   out += strlen(out);
+   out += sprintf(out, "%s%s%d", sep,
+         f->profile && strstr(f->profile, "2Dobj") ? "o" : "", fseq);
+   if (f->lost)
+      sprintf(out, "(%ld)", f->lost);
+}
+
+static struct sockaddr *sender(struct sockaddr_in *from, int port)
+{
+   memset(from, 0, sizeof(*from));
+   from->sin_family = AF_INET;
+   from->sin_port = htons(port);
+   from->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   return (struct sockaddr *) from;
+}
+
+static int run(const struct test *t, int port, int verbose)
+{
+   unsigned char buf[256];
+   char out[512] = "";
+   struct sockaddr_in from;
+   struct fseq_source *s;
+   struct fseq_frame f;
+   unsigned long long now = START_NS;
+   unsigned int len;
+   int i;
+
+   fseq_init(t->budget_ms * 1000000ULL);
+   s = fseq_source(sender(&from, port), sizeof(from), START_NS);
+
+   for (i = 0; i < t->count; i++) {
+      now = START_NS + t->sent[i].ms * 1000000ULL;
+      while (!t->burst && fseq_next(now, &f))
+         print_frame(out, &f);
+      len = build_frame(buf, t->sent[i].obj, t->sent[i].fseq);
+      if (fseq_packet(s, buf, len, now, &f) == FSEQ_PASS)
+         print_frame(out, &f);
+      while (!t->burst && fseq_next(now, &f))
+         print_frame(out, &f);
+   }
+   now += t->budget_ms * 1000000ULL;
+   while (fseq_next(now, &f))
+      print_frame(out, &f);
+
+   if (strcmp(out, t->expect)) {
+      printf("FAIL %s: got \"%s\", expected \"%s\"\n", t->name, out,
+            t->expect);
+      return 1;
+   }
+   if (verbose)
+      printf("ok   %s: %s\n", t->name, out);
+   return 0;
+}
+
+/* The senders of the cases are silent from START_NS on */
+static int check_expiry(int verbose)
+{
+   unsigned long long expire = START_NS + FSEQ_EXPIRE_NS;
+   unsigned char buf[256];
+   char out[512] = "";
+   struct sockaddr_in from;
+   struct fseq_source *kept, *s;
+   struct fseq_frame f;
+   unsigned int len;
+   int i;
+
+   fseq_init(0);
+   for (i = 0; i <= FSEQ_MAX_SOURCES; i++)
+      if (!fseq_source(sender(&from, 41000 + i), sizeof(from), START_NS))
+         break;
+   if (i > FSEQ_MAX_SOURCES) {
+      printf("FAIL expiry: more than %d senders ordered\n", FSEQ_MAX_SOURCES);
+      return 1;
+   }
+   if (fseq_source(sender(&from, 42000), sizeof(from), expire - 1)) {
+      printf("FAIL expiry: a sender took the place of one heard from "
+            "recently\n");
+      return 1;
+   }
+
+   /* Heard from again, its place stays */
+   kept = fseq_source(sender(&from, 40000), sizeof(from), START_NS + 1000);
+   s = fseq_source(sender(&from, 42000), sizeof(from), expire);
+   if (!s || s == kept) {
+      printf("FAIL expiry: the new sender %s\n", !s ? "was turned away" :
+            "took the place of one heard from recently");
+      return 1;
+   }
+   if (fseq_source(sender(&from, 40000), sizeof(from), expire) != kept) {
+      printf("FAIL expiry: a sender heard from recently lost its place\n");
+      return 1;
+   }
+
+   /* Its order is its own, not that of the sender before */
+   len = build_frame(buf, 0, 1);
+   if (fseq_packet(s, buf, len, expire, &f) == FSEQ_PASS)
+      print_frame(out, &f);
+   if (strcmp(out, "1")) {
+      printf("FAIL expiry: got \"%s\" from the new sender, expected "
+            "\"1\"\n", out);
+      return 1;
+   }
+   if (verbose)
+      printf("ok   expiry: a place freed after %llu s\n",
+            FSEQ_EXPIRE_NS / 1000000000);
+   return 0;
+}
+
+int main(int argc, char** argv)
+{
+   int verbose = argc > 1 && !strcmp(argv[1], "-v");
+   int count = sizeof(tests) / sizeof(tests[0]);
+   struct fseq_stats stats;
+   int i, failed = 0;
+
+   for (i = 0; i < count; i++)
+      failed += run(&tests[i], 40000 + i, verbose);
+   failed += check_expiry(verbose);
+
+   fseq_get_stats(&stats);
+   printf("%d tests, %d failed; %lu duplicates, %lu stale, %lu lost, "
+         "%lu held\n", count, failed, stats.duplicates, stats.stale,
+         stats.lost, stats.held);
+   return failed != 0;
+}
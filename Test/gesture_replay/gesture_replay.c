@@ -0,0 +1,93 @@
+/**
+ * Replays a TUIO trace through the two contact gesture recognizer
+ * (tuio/touchmouse/gesture.h) and prints the recognized gestures.
+ *
+ * The first two contacts down form the pair, like touchmouse's states 1
+ * and 4. Every mode change is printed with its frame, and every gesture
+ * ends with the motion reported in each mode:
+ *
+ *    frame 7: PINCH
+ *    gesture 1: frames 30 scroll 0,0 pinch 292000 rotate 0
+ *
+ * Pinch and scroll are in 1/1000000 of the screen, rotate in degrees.
+ *
+ * Usage:
+ *    ./gesture_replay traces/pinch_out.trace
+ */
+
+#include "trace.h"
+#include "gesture.h"
+
+#define RES 1000000
+
+static const char *mode_name[] = { "NONE", "SCROLL", "PINCH", "ROTATE" };
+
+
+int main(int argc, char** argv)
+{
+   FILE *fp;
+   struct trace_frame frame;
+   struct trace_blob *a, *b;
+   struct gesture_state g = { 0 };
+   struct gesture_out out;
+   unsigned long id_a = 0, id_b = 0;
+   long frames = 0, pair_frames = 0, gestures = 0;
+   long pan_x = 0, pan_y = 0, scale = 0, rotate = 0;
+   int paired = 0;
+
+   if (argc != 2) {
+      printf("usage: %s trace_file\n", argv[0]);
+      exit(1);
+   }
+
+   if ((fp = fopen(argv[1], "r")) == NULL) {
+      printf("ERROR: Could not open trace '%s'\n", argv[1]);
+      exit(1);
+   }
+
+   while (trace_next(fp, &frame, RES)) {
+      frames++;
+
+      if (paired) {
+         a = trace_find(&frame, id_a);
+         b = trace_find(&frame, id_b);
+
+         if (a && b) {
+            pair_frames++;
+            gesture_update(&g, a->x, a->y, b->x, b->y, &out);
+            if (out.changed)
+               printf("frame %ld: %s\n", frames, mode_name[out.mode]);
+            pan_x += out.pan_x;
+            pan_y += out.pan_y;
+            scale += out.scale;
+            rotate += out.rotate;
+            continue;
+         }
+
+         printf("gesture %ld: frames %ld scroll %ld,%ld pinch %ld rotate %ld\n",
+               ++gestures, pair_frames, pan_x, pan_y, scale,
+               rotate * 360 / GESTURE_TURN);
+         paired = 0;
+      }
+
+      /* Pair the first two contacts once both are down */
+      if (frame.count >= 2) {
+         id_a = frame.blob[0].id;
+         id_b = frame.blob[1].id;
+         gesture_begin(&g, RES, frame.blob[0].x, frame.blob[0].y,
+               frame.blob[1].x, frame.blob[1].y);
+         pan_x = pan_y = scale = rotate = 0;
+         pair_frames = 0;
+         paired = 1;
+      }
+   }
+   fclose(fp);
+
+   if (paired)
+      printf("gesture %ld: frames %ld scroll %ld,%ld pinch %ld rotate %ld\n",
+            ++gestures, pair_frames, pan_x, pan_y, scale,
+            rotate * 360 / GESTURE_TURN);
+
+   printf("%ld frames, %ld gestures\n", frames, gestures);
+   return 0;
+}
@@ -0,0 +1,228 @@
+/**
+ * Replay benchmark for touchmouse's motion prediction
+ * (tuio/touchmouse/predict.h).
+ *
+ * Every contact of a trace is predicted h ms ahead at every frame and
+ * compared with where the trace actually has it h ms later (linearly
+ * interpolated between frames). The error without prediction (the position
+ * simply lagging by h) is printed next to it, and so is the error of the
+ * prediction from the velocity alone, without its a h^2 / 2 term. Errors
+ * are in 1/1000000 of the screen.
+ *
+ * Frames use their "# time <us>" stamps, or the -r rate when the trace has
+ * none. With -f the contacts are run through the jitter filter first, as in
+ * the module.
+ *
+ * Usage:
+ *    ./predict_bench [-f] [-r hz] trace_file...
+ */
+
+#include <math.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "filter.h"
+#include "predict.h"
+
+#define RES 1000000
+#define DEFAULT_HZ 60
+
+static const long horizons_ms[] = { 8, 16, 33 };
+#define HORIZONS (sizeof(horizons_ms) / sizeof(horizons_ms[0]))
+
+struct errors {
+   long count;
+   long cap;
+   double *err;
+};
+
+static struct trace_frame *frames;
+static long nframes;
+
+
+static void load(const char *file, long hz, int filtered)
+{
+   FILE *fp;
+   struct filter_state filter;
+   struct filter_params fparams = { 1000, 20000, 1000, RES / 2000 };
+   struct trace_frame *f;
+   long cap = 0;
+   unsigned int i;
+
+   if ((fp = fopen(file, "r")) == NULL) {
+      printf("ERROR: Could not open trace '%s'\n", file);
+      exit(1);
+   }
+
+   filter_init(&filter, RES);
+   nframes = 0;
+   while (1) {
+      if (nframes == cap) {
+         cap = cap ? cap * 2 : 1024;
+         frames = realloc(frames, cap * sizeof(*frames));
+      }
+      f = &frames[nframes];
+      if (!trace_next(fp, f, RES))
+         break;
+      if (f->time_us < 0)
+         f->time_us = nframes * 1000000LL / hz;
+
+      if (filtered) {
+         filter_begin(&filter);
+         for (i = 0; i < f->count; i++)
+            filter_contact(&filter, &fparams, f->blob[i].id,
+                  (unsigned long *) &f->blob[i].x,
+                  (unsigned long *) &f->blob[i].y, f->time_us);
+         filter_end(&filter);
+      }
+      nframes++;
+   }
+   fclose(fp);
+}
+
+/*
+ * Position of 'id' at time t, interpolated from frame k onwards.
+ * Returns 0 if the contact is gone by then.
+ */
+static int actual(unsigned long id, long k, long long t, double *x, double *y)
+{
+   struct trace_blob *a, *b;
+   double w;
+
+   for (; k + 1 < nframes; k++) {
+      if (!(a = trace_find(&frames[k], id)))
+         return 0;
+      if (frames[k + 1].time_us < t)
+         continue;
+      if (!(b = trace_find(&frames[k + 1], id)))
+         return 0;
+
+      w = (double) (t - frames[k].time_us)
+        / (frames[k + 1].time_us - frames[k].time_us);
+      *x = a->x + (b->x - a->x) * w;
+      *y = a->y + (b->y - a->y) * w;
+      return 1;
+   }
+   return 0;
+}
+
+static void add(struct errors *e, double v)
+{
+   if (e->count == e->cap) {
+      e->cap = e->cap ? e->cap * 2 : 1024;
+      e->err = realloc(e->err, e->cap * sizeof(double));
+   }
+   e->err[e->count++] = v;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+   return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, struct errors *e)
+{
+   double sum = 0;
+   long i;
+
+   if (!e->count) {
+      printf("  %-9s no samples\n", name);
+      return;
+   }
+   qsort(e->err, e->count, sizeof(double), cmp_double);
+   for (i = 0; i < e->count; i++)
+      sum += e->err[i];
+   printf("  %-9s mean %7.0f  p50 %7.0f  p95 %7.0f  max %7.0f\n", name,
+         sum / e->count, e->err[e->count / 2], e->err[e->count * 95 / 100],
+         e->err[e->count - 1]);
+}
+
+/* Predicts b h_ms ahead of frame k into px, py */
+static void predict(struct predict_state *s, struct predict_params *params,
+      long k, struct trace_blob *b, long h_ms, unsigned long *px,
+      unsigned long *py)
+{
+   *px = b->x;
+   *py = b->y;
+   predict_contact(s, params, b->id, px, py, frames[k].time_us,
+         frames[k].time_us + h_ms * 1000);
+}
+
+static void bench(long h_ms)
+{
+   struct predict_state vel, acc;
+   struct predict_params vparams = { RES / 10000 * 16, RES / 20, 0 };
+   struct predict_params aparams = { RES / 10000 * 16, RES / 20, 1 };
+   struct errors base = { 0 }, verr = { 0 }, aerr = { 0 };
+   unsigned long vx, vy, px, py;
+   struct trace_blob *b;
+   double ax, ay;
+   long k;
+   unsigned int i;
+
+   predict_init(&vel);
+   predict_init(&acc);
+   for (k = 0; k < nframes; k++) {
+      predict_begin(&vel);
+      predict_begin(&acc);
+      for (i = 0; i < frames[k].count; i++) {
+         b = &frames[k].blob[i];
+         predict(&vel, &vparams, k, b, h_ms, &vx, &vy);
+         predict(&acc, &aparams, k, b, h_ms, &px, &py);
+
+         if (!actual(b->id, k, frames[k].time_us + h_ms * 1000, &ax, &ay))
+            continue;
+         add(&base, hypot(b->x - ax, b->y - ay));
+         add(&verr, hypot(vx - ax, vy - ay));
+         add(&aerr, hypot(px - ax, py - ay));
+      }
+      predict_end(&vel);
+      predict_end(&acc);
+   }
+
+   printf("look-ahead %ld ms, %ld samples\n", h_ms, base.count);
+   report("lagging", &base);
+   report("velocity", &verr);
+   report("predicted", &aerr);
+   free(base.err);
+   free(verr.err);
+   free(aerr.err);
+}
+
+int main(int argc, char** argv)
+{
+   long hz = DEFAULT_HZ;
+   int opt, filtered = 0;
+   unsigned int h;
+
+   while ((opt = getopt(argc, argv, "fr:")) != -1) {
+      switch (opt) {
+         case 'f':
+            filtered = 1;
+            break;
+         case 'r':
+            hz = atol(optarg);
+            break;
+         default:
+            printf("usage: %s [-f] [-r hz] trace_file...\n", argv[0]);
+            exit(1);
+      }
+   }
+
+   if (optind >= argc || hz <= 0) {
+      printf("usage: %s [-f] [-r hz] trace_file...\n", argv[0]);
+      exit(1);
+   }
+
+   for (; optind < argc; optind++) {
+      load(argv[optind], hz, filtered);
+      printf("== %s (%ld frames%s)\n", argv[optind], nframes,
+            filtered ? ", filtered" : "");
+      for (h = 0; h < HORIZONS; h++)
+         bench(horizons_ms[h]);
+   }
+
+   free(frames);
+   return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * Reader for TUIO traces in the text format tuiod writes to /dev/tuio:
+ *
+ *    /tuio/2Dcur alive 1 2
+ *    /tuio/2Dcur set 1 0.400000 0.500000 0.000000 0.000000 0.000000
+ *    /tuio/2Dcur set 2 0.500000 0.500000 0.000000 0.000000 0.000000
+ *    /tuio/2Dcur fseq 12
+ *
+ * Output of Test/tsdev_poll can be used as is; its "[len]" prefix is
+ * skipped. Lines starting with '#' and other profiles are ignored, except
+ * for "# time <us>" which timestamps the frame it appears in.
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coord.h"
+
+#define TRACE_LINE_LEN 256
+#define TRACE_MAX_BLOBS 20
+#define TRACE_PROFILE "/tuio/2Dcur "
+
+struct trace_blob {
+   unsigned long id;
+   long x;
+   long y;
+};
+
+struct trace_frame {
+   long fseq;
+   long long time_us;   /* -1 when the trace has no timestamps */
+   unsigned int count;
+   struct trace_blob blob[TRACE_MAX_BLOBS];
+};
+
+/*
+ * Reads the next complete frame (up to and including its fseq).
+ * Returns 1 on a frame, 0 at the end of the trace.
+ */
+static int trace_next(FILE *fp, struct trace_frame *frame, unsigned long res)
+{
+   char line[TRACE_LINE_LEN];
+   const char *p;
+   struct trace_blob *blob;
+
+   frame->count = 0;
+   frame->time_us = -1;
+
+   while (fgets(line, sizeof(line), fp)) {
+      p = line;
+      if (!strncmp(p, "# time ", 7)) {
+         frame->time_us = strtoll(p + 7, NULL, 10);
+         continue;
+      }
+      if (*p == '[')
+         p = strchr(p, ']') ? strchr(p, ']') + 1 : p;
+      if (strncmp(p, TRACE_PROFILE, strlen(TRACE_PROFILE)))
+         continue;
+      p += strlen(TRACE_PROFILE);
+
+      if (!strncmp(p, "fseq ", 5)) {
+         frame->fseq = strtol(p + 5, NULL, 10);
+         return 1;
+      }
+
+      if (strncmp(p, "set ", 4) || frame->count >= TRACE_MAX_BLOBS)
+         continue;
+
+      blob = &frame->blob[frame->count++];
+      blob->id = strtoul(p + 4, (char **) &p, 10);
+      while (*p == ' ')
+         p++;
+      blob->x = parse_coord(&p, res);
+      blob->y = parse_coord(&p, res);
+   }
+   return 0;
+}
+
+static struct trace_blob *trace_find(struct trace_frame *frame,
+      unsigned long id)
+{
+   unsigned int i;
+
+   for (i = 0; i < frame->count; i++)
+      if (frame->blob[i].id == id)
+         return &frame->blob[i];
+   return NULL;
+}
+
+#endif
@@ -0,0 +1,764 @@
+/**
+ * End to end touch latency: from the UDP send of a TUIO frame to the evdev
+ * event touchmouse reports for it, through tuiod, /dev/tuio and the
+ * touchmouse module, or through tuiod -u and uinput.
+ *
+ * A probe contact is put down and moved one step to the right every frame,
+ * so the ABS_X of each event tells which frame caused it. The event times
+ * are the kernel's (EVIOCSCLOCKID, CLOCK_MONOTONIC) and the device is
+ * grabbed, so the desktop cursor stays put. Latency is split in stages:
+ *
+ *    net    send to tuiod receiving the packet. Only with -C, the capture
+ *           tuiod records with -r (see tuio/tuiod/capture.h): its receive
+ *           times are matched up after the run.
+ *    stack  tuiod receiving to the evdev event: liblo, /dev/tuio and
+ *           touchmouse, or the built in touchcore and uinput. With -C.
+ *    total  send to the evdev event
+ *    read   the evdev event to this program reading it
+ *
+ * Every combination of the load lists is run in turn, -d seconds each
+ * after -w seconds of warm up:
+ *    -c  contacts besides the probe, moving on circles. touchmouse turns a
+ *        second 2Dcur contact into a gesture, so these are sent as 2Dobj
+ *        objects: tuiod and /dev/tuio carry them like contacts and
+ *        touchmouse reads every message, but only tracks the probe. tuiod
+ *        passes only 2Dcur on by default, start it with
+ *        -p /tuio/2Dcur,/tuio/2Dobj for them to load it.
+ *    -r  frame rates, Hz
+ *    -b  busy processes spinning on the CPU meanwhile
+ * For example 0, 10 and 50 contacts at 60 and 200 Hz, idle and with four
+ * busy processes:
+ *
+ *    ./latency_bench -c 0,10,50 -r 60,200 -b 0,4 -o latency.csv 3333
+ *
+ * Percentiles of each stage are printed per combination; -o also writes
+ * them as CSV, one line per combination and stage, for tracking runs.
+ *
+ * The events must show the positions as sent: run touchmouse without
+ * filter or prediction and with the identity calibration. Sender, tuiod
+ * and the device share a host, and so a clock.
+ *
+ * Usage:
+ *    ./latency_bench [-h host] [-e device] [-c contacts,...] [-r hz,...]
+ *                    [-b busy,...] [-d seconds] [-w seconds] [-C capture]
+ *                    [-o results.csv] port
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/input.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "capture.h"
+
+#define MAX_LIST 16                /* Values per load list */
+#define MAX_CONTACTS 256           /* Load objects; their alive list fits */
+#define MAX_BUSY 256
+#define MAX_PACKET 4096            /* Larger packets are not captured */
+#define LOAD_CHUNK 30              /* Objects per load bundle */
+#define DEFAULT_DEVICE_NAME "touchmouse"
+#define DEFAULT_RES 1000000        /* TOUCHMOUSE_COORD_RES */
+#define PROBE_X 0.2                /* Probe positions: PROBE_X + k * STEP */
+#define PROBE_Y 0.5
+#define PROBE_STEP 0.001
+#define PROBE_PERIOD 600           /* Steps before it starts over */
+#define START_NS 100000000LL       /* From setting up to the first frame */
+#define DRAIN_NS 300000000LL       /* Wait for late events after the lift */
+#define CAPTURE_WAIT 1500000       /* us for tuiod to write its capture */
+
+#define STAGE_NET 0
+#define STAGE_STACK 1
+#define STAGE_TOTAL 2
+#define STAGE_READ 3
+#define STAGES 4
+
+static const char *stage_name[STAGES] = { "net", "stack", "total", "read" };
+
+/* One probe frame. Times are CLOCK_MONOTONIC ns, 0 until known */
+struct frame {
+   long long send_ns;
+   long long recv_ns;              /* tuiod, from the capture */
+   long long event_ns;
+   long long read_ns;
+   int measured;                   /* Not warm up */
+};
+
+struct config {
+   int contacts, rate, busy;
+   unsigned long first, end;       /* Its frames */
+   unsigned long unmatched;        /* Events that were no probe frame */
+};
+
+static struct frame *frames;
+static unsigned long frame_count, frame_size;
+static struct config configs[MAX_LIST * MAX_LIST * MAX_LIST];
+static int config_count;
+
+static int ev_fd = -1;
+static long long ev_offset;        /* Event clock minus CLOCK_MONOTONIC */
+static long res = DEFAULT_RES;
+
+static unsigned char packet[MAX_PACKET];
+
+
+/*
+ * Clocks
+ */
+static long long clock_ns(clockid_t id)
+{
+   struct timespec ts;
+
+   clock_gettime(id, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long long now_ns(void)
+{
+   return clock_ns(CLOCK_MONOTONIC);
+}
+
+static struct timespec to_timespec(long long ns)
+{
+   struct timespec ts;
+
+   ts.tv_sec = ns / 1000000000;
+   ts.tv_nsec = ns % 1000000000;
+   return ts;
+}
+
+
+/*
+ * OSC building
+ */
+static unsigned char *put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+   return p + 4;
+}
+
+static unsigned int get_be32(const unsigned char *p)
+{
+   return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s)
+{
+   unsigned int len = (strlen(s) / 4 + 1) * 4;
+
+   memset(p, 0, len);
+   memcpy(p, s, strlen(s));
+   return p + len;
+}
+
+static unsigned char *put_float(unsigned char *p, float f)
+{
+   union { float f; unsigned int i; } v;
+
+   v.f = f;
+   return put_be32(p, v.i);
+}
+
+/* Bundle header; elements are a size, then the message */
+static unsigned char *begin_bundle(unsigned char *p)
+{
+   p = put_string(p, "#bundle");
+   p = put_be32(p, 0);
+   return put_be32(p, 1);
+}
+
+static unsigned char *begin_element(unsigned char *p, unsigned char **size)
+{
+   *size = p;
+   return p + 4;
+}
+
+static void end_element(unsigned char *size, unsigned char *end)
+{
+   put_be32(size, end - size - 4);
+}
+
+static unsigned char *put_alive(unsigned char *p, const char *profile,
+      unsigned int first, int n)
+{
+   unsigned char *size;
+   char types[MAX_CONTACTS + 4];
+   int i;
+
+   strcpy(types, ",s");
+   for (i = 0; i < n; i++)
+      types[2 + i] = 'i';
+   types[2 + n] = '\0';
+
+   p = begin_element(p, &size);
+   p = put_string(p, profile);
+   p = put_string(p, types);
+   p = put_string(p, "alive");
+   for (i = 0; i < n; i++)
+      p = put_be32(p, first + i);
+   end_element(size, p);
+   return p;
+}
+
+static unsigned char *put_fseq(unsigned char *p, const char *profile,
+      unsigned int seq)
+{
+   unsigned char *size;
+
+   p = begin_element(p, &size);
+   p = put_string(p, profile);
+   p = put_string(p, ",si");
+   p = put_string(p, "fseq");
+   p = put_be32(p, seq);
+   end_element(size, p);
+   return p;
+}
+
+/*
+ * The probe frame: the probe down at its step for frame 'seq', or lifted.
+ * The fseq is the frame number, which is how the capture is matched up.
+ */
+static unsigned int build_probe(unsigned int seq, unsigned int id, int down)
+{
+   unsigned char *p = begin_bundle(packet), *size;
+
+   p = put_alive(p, "/tuio/2Dcur", id, down);
+   if (down) {
+      p = begin_element(p, &size);
+      p = put_string(p, "/tuio/2Dcur");
+      p = put_string(p, ",sifffff");
+      p = put_string(p, "set");
+      p = put_be32(p, id);
+      p = put_float(p, PROBE_X + (seq % PROBE_PERIOD) * PROBE_STEP);
+      p = put_float(p, PROBE_Y);
+      p = put_float(p, PROBE_STEP * 60);
+      p = put_float(p, 0);
+      p = put_float(p, 0);
+      end_element(size, p);
+   }
+   p = put_fseq(p, "/tuio/2Dcur", seq);
+   return p - packet;
+}
+
+/* Objects 'first' to first + n - 1 of the 'total' of the load */
+static unsigned int build_load(unsigned int seq, int first, int n, int total)
+{
+   unsigned char *p = begin_bundle(packet), *size;
+   float a;
+   int i;
+
+   p = put_alive(p, "/tuio/2Dobj", 1, total);
+   for (i = first; i < first + n; i++) {
+      a = (seq + i * 17) * 0.02f;
+      p = begin_element(p, &size);
+      p = put_string(p, "/tuio/2Dobj");
+      p = put_string(p, ",siiffffffff");
+      p = put_string(p, "set");
+      p = put_be32(p, 1 + i);
+      p = put_be32(p, i % 100);
+      p = put_float(p, 0.5f + 0.3f * cosf(a));
+      p = put_float(p, 0.5f + 0.3f * sinf(a));
+      p = put_float(p, a);
+      p = put_float(p, -0.3f * sinf(a));
+      p = put_float(p, 0.3f * cosf(a));
+      p = put_float(p, 0.2f);
+      p = put_float(p, 0);
+      p = put_float(p, 0);
+      end_element(size, p);
+   }
+   p = put_fseq(p, "/tuio/2Dobj", seq);
+   return p - packet;
+}
+
+/* The fseq of a probe bundle, or -1 */
+static long probe_fseq(const unsigned char *p, unsigned int len)
+{
+   static const char fseq[24] = "/tuio/2Dcur\0,si\0fseq\0\0\0";
+   unsigned int pos = 16, size;
+
+   if (len < 16 || memcmp(p, "#bundle", 8))
+      return -1;
+   while (pos + 4 <= len) {
+      size = get_be32(p + pos);
+      pos += 4;
+      if (size > len - pos)
+         return -1;
+      if (size == 28 && !memcmp(p + pos, fseq, sizeof(fseq)))
+         return get_be32(p + pos + 24);
+      pos += size;
+   }
+   return -1;
+}
+
+
+/*
+ * Events
+ */
+static int open_device(const char *path)
+{
+   char name[256];
+   char node[64];
+   int fd, i;
+
+   if (path)
+      return open(path, O_RDONLY | O_NONBLOCK);
+
+   for (i = 0; i < 64; i++) {
+      snprintf(node, sizeof(node), "/dev/input/event%d", i);
+      if ((fd = open(node, O_RDONLY | O_NONBLOCK)) < 0)
+         continue;
+      memset(name, 0, sizeof(name));
+      if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) >= 0 &&
+            !strcmp(name, DEFAULT_DEVICE_NAME)) {
+         printf("Reading %s (%s)\n", node, name);
+         return fd;
+      }
+      close(fd);
+   }
+   errno = ENODEV;
+   return -1;
+}
+
+static void setup_device(void)
+{
+   struct input_absinfo abs;
+   int clock = CLOCK_MONOTONIC;
+
+   /* Event times on our clock, else convert from CLOCK_REALTIME */
+   if (ioctl(ev_fd, EVIOCSCLOCKID, &clock) < 0) {
+      printf("Warning: no EVIOCSCLOCKID, converting event times\n");
+      ev_offset = clock_ns(CLOCK_REALTIME) - now_ns();
+   }
+   if (ioctl(ev_fd, EVIOCGABS(ABS_X), &abs) >= 0 && abs.maximum > 0)
+      res = abs.maximum + 1;
+   else
+      printf("Warning: no ABS_X range, assuming %ld\n", res);
+   if (ioctl(ev_fd, EVIOCGRAB, 1) < 0)
+      printf("Warning: could not grab the device, the cursor will move\n");
+}
+
+/* Finds the frame an ABS_X event is for, by the probe step it shows */
+static void match_event(struct input_event *ev, long long read_ns, int config)
+{
+   double step = PROBE_STEP * res;
+   long k, f, last;
+
+   k = lround((ev->value - PROBE_X * res) / step);
+   last = (long) frame_count - 1;
+   if (k < 0 || k >= PROBE_PERIOD || last < 0 ||
+         fabs(ev->value - (PROBE_X * res + k * step)) > step / 4) {
+      configs[config].unmatched++;
+      return;
+   }
+
+   /* The latest frame sent at that step */
+   f = last - ((last % PROBE_PERIOD) - k + PROBE_PERIOD) % PROBE_PERIOD;
+   if (f < 0 || frames[f].event_ns) {
+      configs[config].unmatched++;
+      return;
+   }
+   frames[f].event_ns = (long long) ev->time.tv_sec * 1000000000 +
+      ev->time.tv_usec * 1000 - ev_offset;
+   frames[f].read_ns = read_ns;
+}
+
+/* Reads events as they come until the deadline */
+static void read_events_until(long long deadline, int config)
+{
+   struct input_event ev[64];
+   struct pollfd pfd;
+   struct timespec ts;
+   long long now, read_ns;
+   ssize_t len;
+   int i;
+
+   pfd.fd = ev_fd;
+   pfd.events = POLLIN;
+   while ((now = now_ns()) < deadline) {
+      ts = to_timespec(deadline - now);
+      if (ppoll(&pfd, 1, &ts, NULL) <= 0)
+         continue;
+
+      while ((len = read(ev_fd, ev, sizeof(ev))) > 0) {
+         read_ns = now_ns();
+         for (i = 0; i < (int) (len / sizeof(ev[0])); i++)
+            if (ev[i].type == EV_ABS && ev[i].code == ABS_X)
+               match_event(&ev[i], read_ns, config);
+      }
+   }
+}
+
+
+/*
+ * Load
+ */
+static void start_busy(pid_t *pid, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      if ((pid[i] = fork()) == 0) {
+         for (;;)
+            ;
+      }
+   }
+}
+
+static void stop_busy(pid_t *pid, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      if (pid[i] > 0) {
+         kill(pid[i], SIGKILL);
+         waitpid(pid[i], NULL, 0);
+      }
+   }
+}
+
+static struct frame *add_frame(void)
+{
+   if (frame_count == frame_size) {
+      frame_size = 2 * frame_size + 1024;
+      if ((frames = realloc(frames, frame_size * sizeof(*frames))) == NULL) {
+         printf("ERROR: Out of memory\n");
+         exit(1);
+      }
+   }
+   memset(&frames[frame_count], 0, sizeof(*frames));
+   return &frames[frame_count++];
+}
+
+static void run(int fd, int n, double duration, double warm_up)
+{
+   struct config *cf = &configs[n];
+   static pid_t busy[MAX_BUSY];
+   unsigned long k, total;
+   unsigned int len, id = n + 1;
+   long long start, deadline;
+   struct frame *fr;
+   int i;
+
+   start_busy(busy, cf->busy);
+
+   total = (unsigned long) ((warm_up + duration) * cf->rate);
+   cf->first = frame_count;
+   start = now_ns() + START_NS;
+   for (k = 0; k < total; k++) {
+      deadline = start + (long long) (k * 1e9 / cf->rate);
+      read_events_until(deadline, n);
+
+      for (i = 0; i < cf->contacts; i += LOAD_CHUNK) {
+         len = build_load(frame_count, i, cf->contacts - i < LOAD_CHUNK ?
+               cf->contacts - i : LOAD_CHUNK, cf->contacts);
+         send(fd, packet, len, 0);
+      }
+
+      len = build_probe(frame_count, id, 1);
+      fr = add_frame();
+      fr->measured = k >= (unsigned long) (warm_up * cf->rate);
+      fr->send_ns = now_ns();
+      send(fd, packet, len, 0);
+   }
+   cf->end = frame_count;
+
+   /* Lift the probe and the load, then collect the stragglers */
+   len = build_probe(frame_count, id, 0);
+   send(fd, packet, len, 0);
+   if (cf->contacts) {
+      len = build_load(frame_count, 0, 0, 0);
+      send(fd, packet, len, 0);
+   }
+   read_events_until(now_ns() + DRAIN_NS, n);
+
+   stop_busy(busy, cf->busy);
+}
+
+
+/*
+ * Capture: tuiod's receive times of the probe frames
+ */
+static void read_capture(const char *file, unsigned short port)
+{
+   static struct capture_reader r;
+   struct capture_packet p;
+   unsigned long matched = 0;
+   long seq;
+
+   if (capture_reader_open(&r, file)) {
+      printf("ERROR: Could not read capture '%s'\n", file);
+      return;
+   }
+   while (capture_next(&r, &p) > 0) {
+      if (p.from->port != port)
+         continue;
+      seq = probe_fseq(p.data, p.len);
+      if (seq < 0 || seq >= (long) frame_count)
+         continue;
+      /* An older run from the same port is over before this one sent */
+      if ((long long) p.time_ns < frames[seq].send_ns)
+         continue;
+      frames[seq].recv_ns = p.time_ns;
+      matched++;
+   }
+   capture_reader_close(&r);
+   printf("Matched %lu of %lu frames in the capture\n", matched, frame_count);
+}
+
+
+/*
+ * Results
+ */
+static int compare_ll(const void *a, const void *b)
+{
+   long long x = *(const long long *) a, y = *(const long long *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+static double percentile(const long long *v, unsigned long n, double fraction)
+{
+   unsigned long i = (unsigned long) ceil(n * fraction);
+
+   return v[i ? i - 1 : 0] / 1e3;
+}
+
+static void report(FILE *csv)
+{
+   static const double fraction[] = { 0.5, 0.9, 0.99, 0.999 };
+   unsigned long n[STAGES], f, measured, lost;
+   long long *v[STAGES], d[STAGES];
+   double sum;
+   struct config *cf;
+   struct frame *fr;
+   int c, s, i;
+
+   for (s = 0; s < STAGES; s++)
+      v[s] = malloc((frame_count + 1) * sizeof(long long));
+
+   if (csv)
+      fprintf(csv, "contacts,rate,busy,stage,frames,lost,unmatched,mean_us,"
+            "p50_us,p90_us,p99_us,p999_us,max_us\n");
+
+   for (c = 0; c < config_count; c++) {
+      cf = &configs[c];
+      memset(n, 0, sizeof(n));
+      measured = lost = 0;
+      for (f = cf->first; f < cf->end; f++) {
+         fr = &frames[f];
+         if (!fr->measured)
+            continue;
+         measured++;
+         if (!fr->event_ns) {
+            lost++;
+            continue;
+         }
+         d[STAGE_NET] = fr->recv_ns - fr->send_ns;
+         d[STAGE_STACK] = fr->event_ns - fr->recv_ns;
+         d[STAGE_TOTAL] = fr->event_ns - fr->send_ns;
+         d[STAGE_READ] = fr->read_ns - fr->event_ns;
+         for (s = 0; s < STAGES; s++)
+            if (fr->recv_ns || (s != STAGE_NET && s != STAGE_STACK))
+               v[s][n[s]++] = d[s];
+      }
+
+      printf("\n%d contacts, %d Hz, %d busy: %lu frames, %lu lost, "
+            "%lu unmatched events\n", cf->contacts, cf->rate, cf->busy,
+            measured, lost, cf->unmatched);
+      printf("   stage       mean      p50      p90      p99    p99.9      "
+            "max (us)\n");
+      for (s = 0; s < STAGES; s++) {
+         if (!n[s])
+            continue;
+         qsort(v[s], n[s], sizeof(long long), compare_ll);
+         sum = 0;
+         for (f = 0; f < n[s]; f++)
+            sum += v[s][f];
+
+         printf("   %-6s %9.1f", stage_name[s], sum / n[s] / 1e3);
+         for (i = 0; i < 4; i++)
+            printf(" %8.1f", percentile(v[s], n[s], fraction[i]));
+         printf(" %8.1f\n", v[s][n[s] - 1] / 1e3);
+
+         if (csv) {
+            fprintf(csv, "%d,%d,%d,%s,%lu,%lu,%lu,%.1f", cf->contacts,
+                  cf->rate, cf->busy, stage_name[s], measured, lost,
+                  cf->unmatched, sum / n[s] / 1e3);
+            for (i = 0; i < 4; i++)
+               fprintf(csv, ",%.1f", percentile(v[s], n[s], fraction[i]));
+            fprintf(csv, ",%.1f\n", v[s][n[s] - 1] / 1e3);
+         }
+      }
+   }
+
+   for (s = 0; s < STAGES; s++)
+      free(v[s]);
+}
+
+
+/*
+ * Setup
+ */
+static int parse_list(const char *arg, int *v, int min, int max)
+{
+   char *end;
+   int n = 0;
+
+   do {
+      if (n == MAX_LIST)
+         return -1;
+      v[n] = strtol(arg, &end, 10);
+      if (end == arg || v[n] < min || v[n] > max)
+         return -1;
+      n++;
+      arg = end + 1;
+   } while (*end == ',');
+   return *end ? -1 : n;
+}
+
+static int open_socket(const char *host, const char *port,
+      unsigned short *local_port)
+{
+   struct addrinfo hints, *ai;
+   struct sockaddr_storage local;
+   socklen_t local_len = sizeof(local);
+   int fd;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_DGRAM;
+   if (getaddrinfo(host, port, &hints, &ai)) {
+      printf("ERROR: Unknown host '%s'\n", host);
+      return -1;
+   }
+   if ((fd = socket(ai->ai_family, SOCK_DGRAM, 0)) < 0 ||
+         connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+      printf("ERROR: Could not open socket: %s\n", strerror(errno));
+      freeaddrinfo(ai);
+      return -1;
+   }
+   freeaddrinfo(ai);
+
+   /* The port tuiod sees us send from, to find our packets in its capture */
+   getsockname(fd, (struct sockaddr *) &local, &local_len);
+   if (local.ss_family == AF_INET6)
+      *local_port = ntohs(((struct sockaddr_in6 *) &local)->sin6_port);
+   else
+      *local_port = ntohs(((struct sockaddr_in *) &local)->sin_port);
+   return fd;
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-h host] [-e device] [-c contacts,...] [-r hz,...]\n"
+         "          [-b busy,...] [-d seconds] [-w seconds] [-C capture]\n"
+         "          [-o results.csv] port\n", name);
+   exit(1);
+}
+
+int main(int argc, char** argv)
+{
+   const char *host = "127.0.0.1", *device = NULL, *cap_file = NULL;
+   const char *csv_file = NULL;
+   int contacts[MAX_LIST] = { 0 }, rates[MAX_LIST] = { 60 };
+   int busy[MAX_LIST] = { 0 };
+   int nc = 1, nr = 1, nb = 1, opt, fd, c, r, b;
+   double duration = 5, warm_up = 1;
+   unsigned short local_port;
+   FILE *csv = NULL;
+
+   while ((opt = getopt(argc, argv, "h:e:c:r:b:d:w:C:o:")) != -1) {
+      switch (opt) {
+         case 'h':
+            host = optarg;
+            break;
+         case 'e':
+            device = optarg;
+            break;
+         case 'c':
+            nc = parse_list(optarg, contacts, 0, MAX_CONTACTS);
+            break;
+         case 'r':
+            nr = parse_list(optarg, rates, 1, 10000);
+            break;
+         case 'b':
+            nb = parse_list(optarg, busy, 0, MAX_BUSY);
+            break;
+         case 'd':
+            duration = atof(optarg);
+            break;
+         case 'w':
+            warm_up = atof(optarg);
+            break;
+         case 'C':
+            cap_file = optarg;
+            break;
+         case 'o':
+            csv_file = optarg;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (argc - optind != 1 || nc < 1 || nr < 1 || nb < 1 || duration <= 0 ||
+         warm_up < 0)
+      usage(argv[0]);
+
+   if ((ev_fd = open_device(device)) < 0) {
+      printf("ERROR: Could not open the %s device: %s\n",
+            device ? device : DEFAULT_DEVICE_NAME, strerror(errno));
+      exit(1);
+   }
+   setup_device();
+   if ((fd = open_socket(host, argv[optind], &local_port)) < 0)
+      exit(1);
+   if (csv_file && (csv = fopen(csv_file, "w")) == NULL) {
+      printf("ERROR: Could not create '%s'\n", csv_file);
+      exit(1);
+   }
+
+   for (b = 0; b < nb; b++) {
+      for (r = 0; r < nr; r++) {
+         for (c = 0; c < nc; c++) {
+            configs[config_count].contacts = contacts[c];
+            configs[config_count].rate = rates[r];
+            configs[config_count].busy = busy[b];
+            printf("Running %d contacts, %d Hz, %d busy\n", contacts[c],
+                  rates[r], busy[b]);
+            fflush(stdout);
+            run(fd, config_count++, duration, warm_up);
+         }
+      }
+   }
+
+   if (cap_file) {
+      /* tuiod writes what it has after a second without a full block */
+      usleep(CAPTURE_WAIT);
+      read_capture(cap_file, local_port);
+   }
+   report(csv);
+
+   if (csv)
+      fclose(csv);
+   ioctl(ev_fd, EVIOCGRAB, 0);
+   close(ev_fd);
+   close(fd);
+   free(frames);
+   return 0;
+}
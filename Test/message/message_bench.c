@@ -0,0 +1,112 @@
+/**
+ * Benchmark of tuiod's message formatting (tuio/tuiod/message.h) against
+ * the sprintf loop it replaced (reference.h).
+ *
+ * The messages are the ones TUIO trackers send every frame: a 2Dcur set,
+ * an alive of 20 contacts and an fseq. Prints ns per message for both and
+ * the speedup.
+ *
+ * Usage:
+ *    ./message_bench [-n messages]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reference.h"
+
+#define DEFAULT_MESSAGES 2000000
+#define PATH "/tuio/2Dcur"
+
+typedef int (*write_fn)(char *buf, int buf_len, const char *path,
+      const char *types, lo_arg **argv, int argc);
+
+static volatile long sink;
+
+
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void build_set(struct args *a)
+{
+   add_string(a, "set");
+   add_int(a, 4);
+   add_float(a, 0.482812f);
+   add_float(a, 0.4125f);
+   add_float(a, 0.013f);
+   add_float(a, -0.21f);
+   add_float(a, -7.122507f);
+}
+
+static void build_alive(struct args *a)
+{
+   int i;
+
+   add_string(a, "alive");
+   for (i = 0; i < 20; i++)
+      add_int(a, 1000 + i);
+}
+
+static void build_fseq(struct args *a)
+{
+   add_string(a, "fseq");
+   add_int(a, 123456);
+}
+
+/* ns per message of fn */
+static double run(write_fn fn, const struct args *a, long n)
+{
+   char buf[1024];
+   long long start;
+   long i;
+
+   start = now_ns();
+   for (i = 0; i < n; i++)
+      sink += fn(buf, sizeof(buf) - 2, PATH, a->types,
+            (lo_arg **) a->argv, a->argc);
+   return (double) (now_ns() - start) / n;
+}
+
+int main(int argc, char **argv)
+{
+   static const struct {
+      const char *name;
+      void (*build)(struct args *a);
+   } messages[] = {
+      { "set", build_set },
+      { "alive 20", build_alive },
+      { "fseq", build_fseq },
+   };
+   struct args a;
+   long n = DEFAULT_MESSAGES;
+   double ref, fast;
+   unsigned int i;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "n:")) != -1) {
+      if (opt != 'n') {
+         fprintf(stderr, "usage: %s [-n messages]\n", argv[0]);
+         return 2;
+      }
+      n = atol(optarg);
+   }
+
+   printf("%-10s %12s %12s %8s\n", "message", "sprintf ns", "write_msg ns",
+         "speedup");
+   for (i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+      memset(&a, 0, sizeof(a));
+      messages[i].build(&a);
+      run(write_msg, &a, n / 10);      /* Warm up */
+      ref = run(ref_write_msg, &a, n);
+      fast = run(write_msg, &a, n);
+      printf("%-10s %12.1f %12.1f %7.1fx\n", messages[i].name, ref, fast,
+            ref / fast);
+   }
+   return 0;
+}
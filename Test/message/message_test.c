@@ -0,0 +1,270 @@
+/**
+ * Test of tuiod's message formatting (tuio/tuiod/message.h).
+ *
+ * Golden lines for every OSC type, and for strings and paths a sender
+ * could split an argument or forge a line with, escaped to stay one word
+ * each. Then the bounds: each golden message
+ * written into every buffer too short for it must fail without a byte
+ * written past the end. Last, floats against printf's "%f": the values
+ * TUIO sends (coordinates and velocities), the ties of the sixth decimal,
+ * and random bit patterns.
+ *
+ * Usage:
+ *    ./message_test [-v] [-n random_floats]
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "reference.h"
+
+#define PATH "/tuio/2Dcur"
+#define GUARD 16
+#define DEFAULT_RANDOM 2000000
+
+struct golden {
+   const char *name;
+   void (*build)(struct args *a);
+   const char *expect;
+   const char *path;                 /* PATH if NULL */
+};
+
+static void build_set(struct args *a)
+{
+   add_string(a, "set");
+   add_int(a, 4);
+   add_float(a, 0.482812f);
+   add_float(a, 0.4125f);
+   add_float(a, 0.0f);
+   add_float(a, 0.0f);
+   add_float(a, -7.122507f);
+}
+
+static void build_alive(struct args *a)
+{
+   add_string(a, "alive");
+   add_int(a, 0);
+   add_int(a, -1);
+   add_int(a, 2147483647);
+   add_int(a, -2147483647 - 1);
+}
+
+static void build_floats(struct args *a)
+{
+   add_float(a, -0.0f);
+   add_float(a, -1e-9f);
+   add_float(a, 1.5f);
+   add_float(a, 0.0000005f);         /* Just below the tie */
+   add_float(a, 0.0000015f);         /* Just above it */
+   add_float(a, 1e10f);
+   add_float(a, 3.4e38f);            /* Beyond the scaled range */
+   add_float(a, INFINITY);
+   add_float(a, -INFINITY);
+}
+
+static void build_wide(struct args *a)
+{
+   add_arg(a, 'h')->h = -(1LL << 40);
+   add_arg(a, 'h')->h = INT64_MIN;
+   add_arg(a, 'd')->d = 1.0 / 3;
+   strcpy(&add_arg(a, 'S')->S, "symbol");
+   add_arg(a, 'c')->c = 'q';
+}
+
+static void build_data(struct args *a)
+{
+   static const unsigned char midi[4] = { 0x00, 0x90, 0x3c, 0x40 };
+   uint32_t size = 3;
+   uint64_t tt;
+   lo_arg *arg;
+
+   memcpy(add_arg(a, 'm')->m, midi, 4);
+
+   /* As liblo 0.26 leaves them: one 64 bit number, seconds high */
+   tt = (uint64_t) (2208988800U + 1760000000U) << 32 | 0x40000000;
+   memcpy(add_arg(a, 't'), &tt, sizeof(tt));
+   tt = 1;
+   memcpy(add_arg(a, 't'), &tt, sizeof(tt));
+
+   /* Size in host order, then the bytes */
+   arg = add_arg(a, 'b');
+   memcpy(arg, &size, sizeof(size));
+   memcpy((char *) arg + sizeof(size), "\x0a\x1b\xff", size);
+   size = 0;
+   memcpy(add_arg(a, 'b'), &size, sizeof(size));
+}
+
+static void build_flags(struct args *a)
+{
+   add_arg(a, 'T');
+   add_arg(a, 'F');
+   add_arg(a, 'N');
+   add_arg(a, 'I');
+   add_arg(a, 'x');                  /* Unknown, a placeholder */
+   add_int(a, 7);
+}
+
+/* Spaces, quotes and backslashes would split or mark the words */
+static void build_words(struct args *a)
+{
+   add_string(a, "set x");
+   add_string(a, "a\tb");
+   add_string(a, "");
+   add_string(a, "q\"\\");
+   add_string(a, "caf\xc3\xa9");       /* UTF-8 passes */
+   add_arg(a, 'c')->c = ' ';
+   strcpy(&add_arg(a, 'S')->S, "\x7f");
+}
+
+/* Whole lines of touch data, smuggled in a string */
+static void build_forged(struct args *a)
+{
+   add_string(a, "alive\n/tuio/2Dcur set 9 0.5 0.5 0 0 0\r\n"
+         "/tuio/2Dcur fseq 7");
+   add_arg(a, 'c')->c = '\n';
+}
+
+static const struct golden goldens[] = {
+   { "set", build_set,
+      PATH " set 4 0.482812 0.412500 0.000000 0.000000 -7.122507" },
+   { "alive", build_alive,
+      PATH " alive 0 -1 2147483647 -2147483648" },
+   { "floats", build_floats,
+      PATH " -0.000000 -0.000000 1.500000 0.000000 0.000002 "
+      "10000000000.000000 339999995214436424907732413799364296704.000000 "
+      "inf -inf" },
+   { "wide", build_wide,
+      PATH " -1099511627776 -9223372036854775808 0.333333 symbol q" },
+   { "data", build_data,
+      PATH " 0x00903c40 1760000000.250000000 immediate 0x0a1bff 0x" },
+   { "flags", build_flags,
+      PATH " true false nil inf ? 7" },
+   { "words", build_words,
+      PATH " set\\x20x a\\x09b \"\" q\\x22\\x5c caf\xc3\xa9 \\x20 \\x7f" },
+   { "forged", build_forged,
+      PATH " alive\\x0a/tuio/2Dcur\\x20set\\x209\\x200.5\\x200.5\\x200"
+      "\\x200\\x200\\x0d\\x0a/tuio/2Dcur\\x20fseq\\x207 \\x0a" },
+   { "forged path", build_alive,
+      "/tuio/2Dcur\\x0aset\\x209 alive 0 -1 2147483647 -2147483648",
+      "/tuio/2Dcur\nset 9" },
+};
+#define GOLDENS (sizeof(goldens) / sizeof(goldens[0]))
+
+
+/* The golden line, then every shorter buffer */
+static int run_golden(const struct golden *g, int verbose)
+{
+   const char *path = g->path ? g->path : PATH;
+   struct args a;
+   char buf[1024 + GUARD];
+   int len, n, i, failed = 0;
+
+   memset(&a, 0, sizeof(a));
+   g->build(&a);
+   len = write_msg(buf, 1024, path, a.types, a.argv, a.argc);
+   if (len < 0 || strcmp(buf, g->expect) || len != (int) strlen(buf) ||
+         strchr(buf, '\n')) {
+      printf("FAIL %s\n   got:    %s\n   expect: %s\n", g->name,
+            len < 0 ? "(overflow)" : buf, g->expect);
+      return 1;
+   }
+
+   for (n = 0; n < len; n++) {
+      memset(buf, '#', sizeof(buf));
+      if (write_msg(buf, n, path, a.types, a.argv, a.argc) != -1) {
+         printf("FAIL %s: fits %d bytes, needs %d\n", g->name, n, len);
+         failed = 1;
+      }
+      for (i = n + 1; i < (int) sizeof(buf); i++) {
+         if (buf[i] != '#') {
+            printf("FAIL %s: %d byte buffer written at %d\n", g->name, n, i);
+            failed = 1;
+            break;
+         }
+      }
+   }
+   if (!failed && verbose)
+      printf("PASS %s: %s\n", g->name, g->expect);
+   return failed;
+}
+
+/* One float against "%f"; returns 1 if they differ */
+static int check_float(float f)
+{
+   struct args a;
+   char got[128], expect[128];
+
+   memset(&a, 0, sizeof(a));
+   add_float(&a, f);
+   snprintf(expect, sizeof(expect), "x %f", f);
+   if (write_msg(got, sizeof(got) - 1, "x", a.types, a.argv, a.argc) < 0 ||
+         strcmp(got, expect)) {
+      printf("FAIL float %a: got \"%s\", expect \"%s\"\n", f, got, expect);
+      return 1;
+   }
+   return 0;
+}
+
+static int run_floats(long count, int verbose)
+{
+   union { float f; uint32_t u; } v;
+   long i, checked = 0;
+   int failed = 0;
+
+   /* Coordinates, every step of 2^-20 */
+   for (i = -(1 << 20); i <= (1 << 21) && failed < 10; i++, checked++)
+      failed += check_float(i / (float) (1 << 20));
+
+   /* Halves of the last decimal, and the floats next to them */
+   for (i = 0; i < 2000000 && failed < 10; i++) {
+      v.f = (i + 0.5f) / 1e6f;
+      failed += check_float(v.f);
+      v.u++;
+      failed += check_float(v.f);
+      v.u -= 2;
+      failed += check_float(v.f);
+      checked += 3;
+   }
+
+   /* Anything, NaN included */
+   srandom(1);
+   for (i = 0; i < count && failed < 10; i++, checked++) {
+      v.u = (uint32_t) random() << 1 ^ (uint32_t) random();
+      failed += check_float(v.f);
+   }
+
+   if (verbose || failed)
+      printf("%s floats: %ld checked against %%f\n", failed ? "FAIL" : "PASS",
+            checked);
+   return failed;
+}
+
+int main(int argc, char **argv)
+{
+   long count = DEFAULT_RANDOM;
+   int verbose = 0, failed = 0, opt;
+   unsigned int i;
+
+   while ((opt = getopt(argc, argv, "vn:")) != -1) {
+      switch (opt) {
+         case 'v':
+            verbose = 1;
+            break;
+         case 'n':
+            count = atol(optarg);
+            break;
+         default:
+            fprintf(stderr, "usage: %s [-v] [-n random_floats]\n", argv[0]);
+            return 2;
+      }
+   }
+
+   for (i = 0; i < GOLDENS; i++)
+      failed += run_golden(&goldens[i], verbose);
+   failed += run_floats(count, verbose) > 0;
+
+   printf("%u golden lines and floats, %d failed\n", (unsigned) GOLDENS,
+         failed);
+   return failed ? 1 : 0;
+}
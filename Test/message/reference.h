@@ -0,0 +1,83 @@
+/**
+ * The arguments of an OSC message as liblo hands them to a handler, and
+ * write_msg as tuiod had it before the bounded writer, with sprintf: the
+ * reference the test checks against and the benchmark races.
+ */
+#ifndef __REFERENCE_H__
+#define __REFERENCE_H__
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <lo/lo.h>
+
+#include "message.h"
+
+#define MAX_ARGS 32
+
+struct args {
+   char types[MAX_ARGS + 1];
+   lo_arg *argv[MAX_ARGS];
+   int argc;
+   union { lo_arg a; char s[64]; } store[MAX_ARGS];
+};
+
+static inline lo_arg *add_arg(struct args *a, char type)
+{
+   lo_arg *arg = &a->store[a->argc].a;
+
+   memset(&a->store[a->argc], 0, sizeof(a->store[0]));
+   a->argv[a->argc] = arg;
+   a->types[a->argc++] = type;
+   a->types[a->argc] = '\0';
+   return arg;
+}
+
+static inline void add_int(struct args *a, int32_t v)
+{
+   add_arg(a, 'i')->i = v;
+}
+
+static inline void add_float(struct args *a, float v)
+{
+   add_arg(a, 'f')->f = v;
+}
+
+static inline void add_string(struct args *a, const char *s)
+{
+   strcpy(&add_arg(a, 's')->s, s);
+}
+
+/* The sprintf loop, for the types it had */
+static inline int ref_write_msg(char *lbuf, int buf_len, const char *path,
+      const char *types, lo_arg **argv, int argc)
+{
+   char *buf_start = lbuf;
+   int i;
+
+   lbuf += sprintf(lbuf, "%s", path);
+   for(i = 0; i < argc; i++) {
+      if(lbuf - buf_start > buf_len)
+         return -1;
+      switch(types[i]) {
+         case 'i':
+            lbuf += sprintf(lbuf, " %d", argv[i]->i);
+            break;
+         case 'h':
+            lbuf += sprintf(lbuf, " %" PRId64, argv[i]->h);
+            break;
+         case 'f':
+            lbuf += sprintf(lbuf, " %f", argv[i]->f);
+            break;
+         case 'd':
+            lbuf += sprintf(lbuf, " %lf", argv[i]->d);
+            break;
+         case 's':
+            lbuf += sprintf(lbuf, " %s", &(argv[i]->s));
+            break;
+      }
+   }
+   return lbuf - buf_start;
+}
+
+#endif
@@ -0,0 +1,572 @@
+/**
+ * Microbenchmarks of the hot functions on the touch path, for catching
+ * regressions commit by commit:
+ *
+ *    write_msg        tuiod formatting a received OSC message as text
+ *                     (tuio/tuiod/message.c)
+ *    update_state     touchcore parsing one message into the frame
+ *    compare_state    touchcore diffing two frames of 1 to 256 contacts
+ *    handle_state     touchcore turning a frame diff into events, over a
+ *                     cycle of touch, hover, drag and two finger scroll
+ *    dispatch         a whole frame of 1 to 256 contacts, message by
+ *                     message through touchcore_dispatch
+ *    ring             the /dev/tuio message ring (tuio/tuiodriver/ring.h)
+ *
+ * touchcore.c is built into this program, so its static functions can be
+ * timed on their own, with MAX_ALIVE_BLOBS raised to 256 (see the
+ * Makefile).
+ *
+ * Each benchmark is warmed up, its iterations sized so that one
+ * repetition takes about -t ms, and then repeated -r times. Printed per
+ * benchmark are ns per operation (min, median, mean and the standard
+ * deviation across repetitions), CPU cycles per operation (median; from
+ * perf, or the time stamp counter where perf is not allowed) and heap
+ * allocations per operation, counted as tuiod's RT_COUNT build counts them
+ * (tuio/tuiod/rt.h). The process is pinned to one CPU (-c, by
+ * default the one it starts on). -o also writes the results as CSV.
+ *
+ * Usage:
+ *    ./microbench [-c cpu] [-t ms] [-r repetitions] [-w ms] [-f filter]
+ *                 [-o results.csv]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* The core itself, for its static functions */
+#include "touchcore.c"
+#include "harness.h"
+
+#include "message.h"
+#include "ring.h"
+#include "rt.h"
+
+#define MAX_REPS 1000
+#define MAX_BENCHES 64
+#define FRAME_US 16667
+#define CYCLE_FRAMES 64            /* Frames of the handle_state cycle */
+#define MSG_LEN 96
+
+struct bench {
+   char name[48];
+   void (*setup) (int n);
+   void (*run) (long iters);
+   int n;                          /* Contacts, or 0 */
+};
+
+struct result {
+   long iters;
+   double ns[MAX_REPS];            /* Per operation */
+   double cycles[MAX_REPS];
+   unsigned long allocs;
+};
+
+static struct bench benches[MAX_BENCHES];
+static int bench_count;
+
+static int perf_fd = -1;
+static const char *cycle_source = "none";
+static volatile long sink;         /* Keeps results from being optimized out */
+
+
+/*
+ * Clocks
+ */
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void cycles_open(void)
+{
+   struct perf_event_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = PERF_COUNT_HW_CPU_CYCLES;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+   if (perf_fd >= 0) {
+      cycle_source = "perf cpu-cycles";
+      ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+      return;
+   }
+#if defined(__x86_64__) || defined(__i386__)
+   cycle_source = "time stamp counter";
+#endif
+}
+
+static unsigned long long cycles(void)
+{
+   unsigned long long v = 0;
+
+   if (perf_fd >= 0) {
+      if (read(perf_fd, &v, sizeof(v)) != sizeof(v))
+         v = 0;
+      return v;
+   }
+#if defined(__x86_64__) || defined(__i386__)
+   v = __rdtsc();
+#endif
+   return v;
+}
+
+
+/*
+ * write_msg
+ */
+static char out[1024];
+static lo_arg *args[32];
+static char types[32];
+static int argc;
+static union { lo_arg a; char s[16]; } arg_store[32];
+
+static void clear_args(void)
+{
+   int i;
+
+   memset(arg_store, 0, sizeof(arg_store));
+   for (i = 0; i < 32; i++)
+      args[i] = &arg_store[i].a;
+}
+
+/* "set", session id, x, y, X, Y, m */
+static void setup_write_set(int n)
+{
+   static const float set[] = { 0.482812f, 0.4125f, 0.0f, 0.0f, -7.122507f };
+   int i;
+
+   clear_args();
+   strcpy(types, "sifffff");
+   strcpy(arg_store[0].s, "set");
+   arg_store[1].a.i = 4;
+   for (i = 0; i < 5; i++)
+      arg_store[2 + i].a.f = set[i];
+   argc = strlen(types);
+}
+
+/* "alive" and n session ids */
+static void setup_write_alive(int n)
+{
+   int i;
+
+   clear_args();
+   types[0] = 's';
+   strcpy(arg_store[0].s, "alive");
+   for (i = 1; i <= n && i < 31; i++) {
+      types[i] = 'i';
+      arg_store[i].a.i = 100 + i;
+   }
+   types[i] = '\0';
+   argc = strlen(types);
+}
+
+static void setup_write_fseq(int n)
+{
+   clear_args();
+   strcpy(types, "si");
+   strcpy(arg_store[0].s, "fseq");
+   arg_store[1].a.i = 123456;
+   argc = strlen(types);
+}
+
+static void run_write_msg(long iters)
+{
+   long k;
+
+   for (k = 0; k < iters; k++)
+      sink += write_msg(out, sizeof(out) - 2, "/tuio/2Dcur", types, args, argc);
+}
+
+
+/*
+ * touchcore
+ */
+static struct harness h;
+static struct screen_state frame_a, frame_b;
+static struct screen_state cycle[CYCLE_FRAMES];
+static char frame_msgs[MAX_ALIVE_BLOBS + 2][MSG_LEN];
+static int frame_contacts;
+
+/* Copies the contacts of a frame, not all MAX_ALIVE_BLOBS */
+static void copy_frame(struct screen_state *to, const struct screen_state *from)
+{
+   to->count = from->count;
+   memcpy(to->alive, from->alive, from->count * sizeof(from->alive[0]));
+}
+
+static void fill_frame(struct screen_state *s, int n, int shift, int moved)
+{
+   int i;
+
+   s->count = n;
+   for (i = 0; i < n; i++) {
+      s->alive[i].id = i + 1 + shift;
+      s->alive[i].x = 100000 + i * 3000 + moved * 1300;
+      s->alive[i].y = 150000 + i * 2000 + moved * 900;
+   }
+}
+
+static void setup_update_state(int n)
+{
+   harness_init(&h, NULL, 0);
+}
+
+static void run_update_state(long iters)
+{
+   static const char msg[] = "set 4 0.482812 0.412500 0.000000 0.000000 "
+      "-7.122507";
+   long k;
+
+   for (k = 0; k < iters; k++) {
+      h.core.cur_state.count = 0;
+      sink += update_state(&h.core, &h.core.cur_state, msg);
+   }
+}
+
+/* n contacts, all moved but one lifted and one new */
+static void setup_compare_state(int n)
+{
+   fill_frame(&frame_a, n, 0, 0);
+   fill_frame(&frame_b, n, 0, 1);
+   frame_b.alive[n - 1].id = n + 1000;
+}
+
+static void run_compare_state(long iters)
+{
+   struct state_diff diff;
+   long k;
+
+   for (k = 0; k < iters; k++) {
+      diff.new_count = diff.dead_count = diff.move_count = 0;
+      sink += compare_state(&diff, &frame_a, &frame_b);
+   }
+}
+
+/*
+ * A loop of frames that takes the state machine through touch down,
+ * hover, lift, touch and hold into a drag, and a two finger scroll
+ */
+static void setup_handle_state(int n)
+{
+   int f, t;
+
+   for (f = 0; f < CYCLE_FRAMES; f++) {
+      t = f % 32;
+      if (f < 12) {
+         fill_frame(&cycle[f], 1, 0, t);            /* Hover */
+      } else if (f < 16) {
+         fill_frame(&cycle[f], 0, 0, 0);            /* Lift */
+      } else if (f < 40) {
+         fill_frame(&cycle[f], 1, 1, f < 32 ? 0 : t); /* Hold, drag */
+      } else if (f < 44) {
+         fill_frame(&cycle[f], 0, 0, 0);
+      } else if (f < 60) {
+         fill_frame(&cycle[f], 2, 2, f < 46 ? 0 : t); /* Scroll */
+         cycle[f].alive[1].x = cycle[f].alive[0].x + 200000;
+      } else {
+         fill_frame(&cycle[f], 0, 0, 0);
+      }
+   }
+   harness_init(&h, NULL, 0);
+}
+
+static void run_handle_state(long iters)
+{
+   long k;
+   int f;
+
+   for (k = 0; k < iters; k++) {
+      f = k % CYCLE_FRAMES;
+      h.now_us += FRAME_US;
+      copy_frame(&h.core.pre_state, &cycle[f ? f - 1 : CYCLE_FRAMES - 1]);
+      copy_frame(&h.core.cur_state, &cycle[f]);
+      handle_state(&h.core);
+   }
+   sink += h.count;
+}
+
+static void setup_dispatch(int n)
+{
+   int i, len;
+
+   len = sprintf(frame_msgs[0], "/tuio/2Dcur alive");
+   for (i = 0; i < n && len < MSG_LEN - 8; i++)
+      len += sprintf(frame_msgs[0] + len, " %d", i + 1);
+   for (i = 0; i < n; i++)
+      sprintf(frame_msgs[i + 1], "/tuio/2Dcur set %d 0.%06d 0.%06d "
+            "0.000000 0.000000 0.000000", i + 1, 100000 + i * 3000,
+            150000 + i * 2000);
+   sprintf(frame_msgs[n + 1], "/tuio/2Dcur fseq 1");
+   frame_contacts = n;
+   harness_init(&h, NULL, 0);
+}
+
+static void run_dispatch(long iters)
+{
+   long k;
+   int i;
+
+   for (k = 0; k < iters; k++) {
+      h.now_us += FRAME_US;
+      for (i = 0; i < frame_contacts + 2; i++)
+         touchcore_dispatch(&h.core, frame_msgs[i]);
+   }
+   sink += h.count;
+}
+
+
+/*
+ * The /dev/tuio ring
+ */
+static struct tuio_ring ring;
+static struct buf_ring_ent ring_ent[BUF_COUNT];
+static const char ring_msg[] =
+   "/tuio/2Dcur set 4 0.482812 0.412500 0.000000 0.000000 -7.122507\n";
+static char ring_out[BUF_LEN];
+
+static void setup_ring(int n)
+{
+   ring_init(&ring, ring_ent, BUF_COUNT);
+}
+
+/* A message in and out, as a reader keeping up sees it */
+static void run_ring(long iters)
+{
+   struct buf_ring_ent *e;
+   long k;
+
+   for (k = 0; k < iters; k++) {
+      e = ring_write_slot(&ring);
+      memcpy(e->buf, ring_msg, sizeof(ring_msg));
+      ring_write_done(&ring, sizeof(ring_msg));
+
+      e = ring_read_slot(&ring);
+      memcpy(ring_out, e->buf, e->len);
+      sink += e->len;
+      ring_read_done(&ring);
+   }
+}
+
+/* Writes with no reader: every one overwrites the oldest message */
+static void run_ring_full(long iters)
+{
+   struct buf_ring_ent *e;
+   long k;
+
+   for (k = 0; k < iters; k++) {
+      e = ring_write_slot(&ring);
+      memcpy(e->buf, ring_msg, sizeof(ring_msg));
+      ring_write_done(&ring, sizeof(ring_msg));
+   }
+   sink += ring.read->len;
+}
+
+
+/*
+ * Runner
+ */
+static void add(const char *name, int n, void (*setup) (int),
+      void (*run) (long))
+{
+   struct bench *b = &benches[bench_count++];
+
+   if (n)
+      snprintf(b->name, sizeof(b->name), "%s %d", name, n);
+   else
+      snprintf(b->name, sizeof(b->name), "%s", name);
+   b->n = n;
+   b->setup = setup;
+   b->run = run;
+}
+
+static void add_all(void)
+{
+   int n;
+
+   add("write_msg set", 0, setup_write_set, run_write_msg);
+   add("write_msg alive", 20, setup_write_alive, run_write_msg);
+   add("write_msg fseq", 0, setup_write_fseq, run_write_msg);
+   add("update_state set", 0, setup_update_state, run_update_state);
+   for (n = 1; n <= MAX_ALIVE_BLOBS; n *= 2)
+      add("compare_state", n, setup_compare_state, run_compare_state);
+   add("handle_state cycle", 0, setup_handle_state, run_handle_state);
+   for (n = 1; n <= MAX_ALIVE_BLOBS; n *= 4)
+      add("dispatch frame", n, setup_dispatch, run_dispatch);
+   add("ring write+read", 0, setup_ring, run_ring);
+   add("ring write full", 0, setup_ring, run_ring_full);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+static double median(double *v, int n)
+{
+   qsort(v, n, sizeof(double), compare_double);
+   return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static void measure(struct bench *b, struct result *r, int reps,
+      long long rep_ns, long long warm_ns)
+{
+   long long start, t;
+   unsigned long long c;
+   unsigned long a;
+   long iters = 1;
+   int i;
+
+   b->setup(b->n);
+
+   /* Warm up, doubling the iterations until a run takes rep_ns */
+   start = now_ns();
+   for (;;) {
+      t = now_ns();
+      b->run(iters);
+      t = now_ns() - t;
+      if (t >= rep_ns && now_ns() - start >= warm_ns)
+         break;
+      if (t < rep_ns)
+         iters *= 2;
+   }
+
+   a = rt_allocations;
+   for (i = 0; i < reps; i++) {
+      c = cycles();
+      t = now_ns();
+      b->run(iters);
+      t = now_ns() - t;
+      c = cycles() - c;
+      r->ns[i] = (double) t / iters;
+      r->cycles[i] = (double) c / iters;
+   }
+   r->allocs = rt_allocations - a;
+   r->iters = iters;
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-c cpu] [-t ms] [-r repetitions] [-w ms] [-f filter] "
+         "[-o results.csv]\n", name);
+   exit(1);
+}
+
+int main(int argc_, char** argv)
+{
+   static struct result r;
+   const char *filter = NULL, *csv_file = NULL;
+   double rep_ms = 10, warm_ms = 100, sum, var, mean, min, med, cyc;
+   int cpu = -1, reps = 15, opt, i, k;
+   struct bench *b;
+   cpu_set_t set;
+   FILE *csv = NULL;
+
+   while ((opt = getopt(argc_, argv, "c:t:r:w:f:o:")) != -1) {
+      switch (opt) {
+         case 'c':
+            cpu = atoi(optarg);
+            break;
+         case 't':
+            rep_ms = atof(optarg);
+            break;
+         case 'r':
+            reps = atoi(optarg);
+            break;
+         case 'w':
+            warm_ms = atof(optarg);
+            break;
+         case 'f':
+            filter = optarg;
+            break;
+         case 'o':
+            csv_file = optarg;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (optind != argc_ || rep_ms <= 0 || warm_ms < 0 || reps < 2 ||
+         reps > MAX_REPS)
+      usage(argv[0]);
+
+   if (cpu < 0)
+      cpu = sched_getcpu();
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   if (sched_setaffinity(0, sizeof(set), &set))
+      printf("Warning: could not pin to CPU %d: %s\n", cpu, strerror(errno));
+   if (csv_file && (csv = fopen(csv_file, "w")) == NULL) {
+      printf("ERROR: Could not create '%s'\n", csv_file);
+      exit(1);
+   }
+   cycles_open();
+   rt_count();
+
+   printf("CPU %d, %d repetitions of %.0f ms, cycles from %s\n", cpu, reps,
+         rep_ms, cycle_source);
+   printf("%-22s %9s %9s %9s %7s %9s %9s\n", "benchmark", "min ns",
+         "median", "mean", "stddev", "cycles", "allocs");
+   if (csv)
+      fprintf(csv, "benchmark,iters,reps,min_ns,median_ns,mean_ns,stddev_ns,"
+            "cycles,allocs\n");
+   fflush(stdout);
+
+   add_all();
+   for (i = 0; i < bench_count; i++) {
+      if (filter && !strstr(benches[i].name, filter))
+         continue;
+
+      b = &benches[i];
+      measure(b, &r, reps, (long long) (rep_ms * 1e6),
+            (long long) (warm_ms * 1e6));
+
+      sum = 0;
+      min = r.ns[0];
+      for (k = 0; k < reps; k++) {
+         sum += r.ns[k];
+         if (r.ns[k] < min)
+            min = r.ns[k];
+      }
+      mean = sum / reps;
+      var = 0;
+      for (k = 0; k < reps; k++)
+         var += (r.ns[k] - mean) * (r.ns[k] - mean);
+      var = sqrt(var / (reps - 1));
+      med = median(r.ns, reps);
+      cyc = median(r.cycles, reps);
+
+      printf("%-22s %9.1f %9.1f %9.1f %6.1f%% %9.1f %9.3f\n", b->name, min,
+            med, mean, 100 * var / mean, cyc,
+            (double) r.allocs / r.iters / reps);
+      fflush(stdout);
+      if (csv)
+         fprintf(csv, "%s,%ld,%d,%.2f,%.2f,%.2f,%.2f,%.1f,%.4f\n", b->name,
+               r.iters, reps, min, med, mean, var, cyc,
+               (double) r.allocs / r.iters / reps);
+   }
+
+   if (csv)
+      fclose(csv);
+   return 0;
+}
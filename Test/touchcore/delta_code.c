@@ -0,0 +1,117 @@
+/**
+ * Delta codes a trace as tuiod -d does (tuio/tuiod/delta.h), to replay
+ * both forms through touchcore_replay and compare what they report.
+ *
+ * Every /tuio/2Dcur line of the trace goes through tuiod's delta_message
+ * as the message it was made from, one sender; what it lets through and
+ * the lines it adds are written out, with the "# time" and other lines
+ * unchanged. -l drops the "gone" lines of the frame with that fseq, as
+ * when the /dev/tuio ring overwrote them: touchcore keeps the contacts
+ * until the next whole frame.
+ *
+ * Usage:
+ *    ./delta_code [-l fseq] trace > delta_trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "delta.h"
+
+#define LINE_LEN 512
+#define MAX_ARGS 64
+#define PROFILE "/tuio/2Dcur "
+
+static char frame[64 * LINE_LEN];  /* Lines of the frame, until its fseq */
+static int frame_len;
+
+
+static void keep(const char *line)
+{
+   int len = strlen(line);
+
+   if (frame_len + len < (int) sizeof(frame)) {
+      memcpy(frame + frame_len, line, len + 1);
+      frame_len += len;
+   }
+}
+
+/* Writes the frame out, without its gone lines if it is lost */
+static void flush(int lost)
+{
+   char *line, *end;
+
+   for (line = frame; line < frame + frame_len; line = end) {
+      end = strchr(line, '\n') ? strchr(line, '\n') + 1 : frame + frame_len;
+      if (!lost || strncmp(line, PROFILE "gone ", 17))
+         fwrite(line, 1, end - line, stdout);
+   }
+   frame_len = 0;
+}
+
+/* Splits "alive 1 2" or "set 1 0.5 ..." into arguments as liblo would */
+static int parse(char *msg, char *types, lo_arg *args, lo_arg **argv)
+{
+   char *word, *end;
+   int argc = 0;
+
+   for (word = strtok(msg, " \n"); word && argc < MAX_ARGS;
+         word = strtok(NULL, " \n"), argc++) {
+      argv[argc] = &args[argc];
+      if (!argc) {
+         types[argc] = 's';
+         argv[argc] = (lo_arg *) word;
+      } else if (strchr(word, '.')) {
+         types[argc] = 'f';
+         args[argc].f = strtof(word, &end);
+      } else {
+         types[argc] = 'i';
+         args[argc].i = strtol(word, &end, 10);
+      }
+   }
+   types[argc] = '\0';
+   return argc;
+}
+
+int main(int argc, char** argv)
+{
+   char line[LINE_LEN], msg[LINE_LEN], types[MAX_ARGS + 1];
+   lo_arg args[MAX_ARGS], *arg[MAX_ARGS];
+   long lose_fseq = -1;
+   FILE *fp;
+   int opt, n;
+
+   while ((opt = getopt(argc, argv, "l:")) != -1) {
+      if (opt != 'l') {
+         printf("usage: %s [-l fseq] trace\n", argv[0]);
+         exit(1);
+      }
+      lose_fseq = atol(optarg);
+   }
+   if (argc - optind != 1 || (fp = fopen(argv[optind], "r")) == NULL) {
+      printf("usage: %s [-l fseq] trace\n", argv[0]);
+      exit(1);
+   }
+
+   delta_init(keep);
+   while (fgets(line, sizeof(line), fp)) {
+      if (strncmp(line, PROFILE, strlen(PROFILE))) {
+         keep(line);
+         continue;
+      }
+
+      strcpy(msg, line + strlen(PROFILE));
+      n = parse(msg, types, args, arg);
+      if (delta_message(0, "/tuio/2Dcur", types, arg, n) == DELTA_PASS)
+         keep(line);
+
+      /* The fseq ends the frame, and tells which one it was */
+      if (!strncmp(line, PROFILE "fseq ", 17))
+         flush(atol(line + 17) == lose_fseq);
+   }
+   flush(0);
+   fclose(fp);
+   return 0;
+}
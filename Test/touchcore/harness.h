@@ -0,0 +1,177 @@
+/**
+ * Runs tuio/touchmouse/touchcore.h on a virtual clock.
+ *
+ * The harness plays the part of the module: it supplies the clock, records
+ * every reported event with the time it was reported, and runs the
+ * momentum scroll timer in virtual time between frames. Nothing depends on
+ * the wall clock, so a run is repeatable to the event.
+ */
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "touchcore.h"
+
+#define HARNESS_RES 1000000
+#define HARNESS_TICK_US 16667     /* 60 Hz momentum scroll */
+#define HARNESS_MAX_EVENTS 65536
+
+struct harness_event {
+   unsigned long long time_us;
+   unsigned int type;
+   unsigned int code;
+   int value;
+};
+
+struct harness {
+   struct touchcore core;
+   struct touchcore_params params;
+   unsigned long long now_us;
+   unsigned long long next_tick_us;   /* 0 while the timer is idle */
+   int record;                        /* Keep the events, or only count */
+   long count;
+   struct harness_event event[HARNESS_MAX_EVENTS];
+};
+
+static inline unsigned long long harness_now_us(void *ctx)
+{
+   return ((struct harness *) ctx)->now_us;
+}
+
+static inline void harness_event(void *ctx, unsigned int type,
+      unsigned int code, int value)
+{
+   struct harness *h = ctx;
+   struct harness_event *e;
+
+   if (h->record && h->count < HARNESS_MAX_EVENTS) {
+      e = &h->event[h->count];
+      e->time_us = h->now_us;
+      e->type = type;
+      e->code = code;
+      e->value = value;
+   }
+   h->count++;
+}
+
+static inline void harness_timer_start(void *ctx)
+{
+   struct harness *h = ctx;
+
+   h->next_tick_us = h->now_us + HARNESS_TICK_US;
+}
+
+static const struct touchcore_ops harness_ops = {
+   harness_now_us,
+   harness_event,
+   harness_timer_start,
+   NULL,
+   NULL,
+   NULL,
+};
+
+/*
+ * Sets up a harness with the module defaults. The caller may change
+ * h->params afterwards; 'single' only before harness_init.
+ */
+static inline void harness_init(struct harness *h,
+      struct touchcore_params *params, int record)
+{
+   struct touchcore_params defaults = TOUCHCORE_PARAMS_DEFAULT;
+
+   h->params = params ? *params : defaults;
+   h->params.hires = 1;
+   h->now_us = 0;
+   h->next_tick_us = 0;
+   h->record = record;
+   h->count = 0;
+   touchcore_init(&h->core, &harness_ops, h, &h->params, HARNESS_RES,
+         HARNESS_TICK_US);
+}
+
+/*
+ * Advances the virtual clock to t, running any timer ticks due on the way
+ */
+static inline void harness_advance(struct harness *h, unsigned long long t)
+{
+   while (h->next_tick_us && h->next_tick_us <= t) {
+      h->now_us = h->next_tick_us;
+      if (touchcore_tick(&h->core))
+         h->next_tick_us += HARNESS_TICK_US;
+      else
+         h->next_tick_us = 0;
+   }
+   if (t > h->now_us)
+      h->now_us = t;
+}
+
+/*
+ * Sends one message to the core at the current virtual time
+ */
+static inline void harness_message(struct harness *h, const char *msg)
+{
+   touchcore_dispatch(&h->core, msg);
+}
+
+/*
+ * Sends a complete frame of 'count' contacts at time t, positions given
+ * in 1/1000000 of the screen
+ */
+static inline void harness_frame(struct harness *h, unsigned long long t,
+      long fseq, int count, const unsigned long *id, const long *x, const long *y)
+{
+   char msg[128];
+   int i, len;
+
+   harness_advance(h, t);
+
+   len = sprintf(msg, "/tuio/2Dcur alive");
+   for (i = 0; i < count && len < 100; i++)
+      len += sprintf(msg + len, " %lu", id[i]);
+   harness_message(h, msg);
+
+   for (i = 0; i < count; i++) {
+      sprintf(msg, "/tuio/2Dcur set %lu %ld.%06ld %ld.%06ld 0.000000 0.000000 "
+            "0.000000", id[i], x[i] / 1000000, x[i] % 1000000,
+            y[i] / 1000000, y[i] % 1000000);
+      harness_message(h, msg);
+   }
+
+   sprintf(msg, "/tuio/2Dcur fseq %ld", fseq);
+   harness_message(h, msg);
+}
+
+/* Names of the events touchcore reports */
+static inline const char *harness_code_name(unsigned int type,
+      unsigned int code)
+{
+   switch (type) {
+      case TC_EV_SYN:
+         return "SYN";
+      case TC_EV_ABS:
+         return code == TC_ABS_X ? "ABS_X" : "ABS_Y";
+      case TC_EV_KEY:
+         switch (code) {
+            case TC_BTN_LEFT: return "BTN_LEFT";
+            case TC_BTN_RIGHT: return "BTN_RIGHT";
+            case TC_BTN_TOUCH: return "BTN_TOUCH";
+            case TC_KEY_LEFTCTRL: return "KEY_LEFTCTRL";
+         }
+         break;
+      case TC_EV_REL:
+         switch (code) {
+            case TC_REL_WHEEL: return "REL_WHEEL";
+            case TC_REL_HWHEEL: return "REL_HWHEEL";
+            case TC_REL_DIAL: return "REL_DIAL";
+            case TC_REL_WHEEL_HI_RES: return "REL_WHEEL_HI_RES";
+            case TC_REL_HWHEEL_HI_RES: return "REL_HWHEEL_HI_RES";
+         }
+         break;
+   }
+   return "UNKNOWN";
+}
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Benchmark of the touchmouse state machine (tuio/touchmouse/touchcore.h).
+ *
+ * Frames of 1 to 20 moving contacts are built as /dev/tuio text messages
+ * up front and then fed to the core on a virtual 60 Hz clock, so only
+ * parsing, calibration, filtering, prediction and the state diff are
+ * timed. Prints ns per frame and per message for each contact count.
+ *
+ * Usage:
+ *    ./touchcore_bench [-n frames] [-c] [-p]
+ *       -c also applies an affine calibration, -p enables prediction
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#define DEFAULT_FRAMES 200000
+#define FRAME_US 16667
+#define LOOP_FRAMES 600            /* Frames built, then replayed in a loop */
+#define MSG_LEN 96
+
+static const int contact_counts[] = { 1, 2, 5, 10, 20 };
+#define COUNTS (sizeof(contact_counts) / sizeof(contact_counts[0]))
+
+static struct harness h;
+static char msgs[LOOP_FRAMES][MAX_ALIVE_BLOBS + 2][MSG_LEN];
+
+
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Builds LOOP_FRAMES frames of n contacts, each walking its own diagonal
+ */
+static void build(int n)
+{
+   long x, y;
+   int f, i, len;
+
+   for (f = 0; f < LOOP_FRAMES; f++) {
+      len = sprintf(msgs[f][0], "/tuio/2Dcur alive");
+      for (i = 0; i < n; i++)
+         len += sprintf(msgs[f][0] + len, " %d", i + 1);
+
+      for (i = 0; i < n; i++) {
+         x = (100000 + i * 37000 + f * 1300) % 1000000;
+         y = (150000 + i * 41000 + f * 900) % 1000000;
+         sprintf(msgs[f][i + 1], "/tuio/2Dcur set %d 0.%06ld 0.%06ld "
+               "0.000000 0.000000 0.000000", i + 1, x, y);
+      }
+      sprintf(msgs[f][n + 1], "/tuio/2Dcur fseq %d", f + 1);
+   }
+}
+
+int main(int argc, char** argv)
+{
+   struct touchcore_params params = TOUCHCORE_PARAMS_DEFAULT;
+   static const int skew[CALIB_ENTRIES] = {
+      64880, 650, 330, -520, 65210, -260, 0, 0, 65536
+   };
+   long frames = DEFAULT_FRAMES, k;
+   long long start, ns;
+   int opt, n, i, f;
+   unsigned int c;
+
+   while ((opt = getopt(argc, argv, "n:cp")) != -1) {
+      switch (opt) {
+         case 'n':
+            frames = atol(optarg);
+            break;
+         case 'c':
+            memcpy(params.calib, skew, sizeof(skew));
+            params.calib_count = CALIB_ENTRIES;
+            break;
+         case 'p':
+            params.predict_enable = 1;
+            break;
+         default:
+            printf("usage: %s [-n frames] [-c] [-p]\n", argv[0]);
+            exit(1);
+      }
+   }
+   if (frames <= 0) {
+      printf("usage: %s [-n frames] [-c] [-p]\n", argv[0]);
+      exit(1);
+   }
+
+   printf("%ld frames%s%s\n", frames, params.calib_count ? ", calibrated" : "",
+         params.predict_enable ? ", predicted" : "");
+
+   for (c = 0; c < COUNTS; c++) {
+      n = contact_counts[c];
+      build(n);
+      harness_init(&h, &params, 0);
+
+      /* Warm up on one pass of the loop */
+      for (f = 0; f < LOOP_FRAMES; f++) {
+         h.now_us += FRAME_US;
+         for (i = 0; i < n + 2; i++)
+            harness_message(&h, msgs[f][i]);
+      }
+
+      start = now_ns();
+      for (k = 0; k < frames; k++) {
+         f = k % LOOP_FRAMES;
+         h.now_us += FRAME_US;
+         for (i = 0; i < n + 2; i++)
+            harness_message(&h, msgs[f][i]);
+      }
+      ns = now_ns() - start;
+
+      printf("  %2d contacts: %8.1f ns/frame %6.1f ns/msg (%ld events)\n", n,
+            (double) ns / frames, (double) ns / frames / (n + 2), h.count);
+   }
+   return 0;
+}
@@ -0,0 +1,372 @@
+/**
+ * Replays recorded TUIO traces through the touchmouse state machine
+ * (tuio/touchmouse/touchcore.h) on a virtual clock and writes, or checks,
+ * the input events it reports.
+ *
+ * Traces are in the /dev/tuio text format read by Test/gesture_replay
+ * (see ../gesture_replay/trace.h): "# time <us>" lines give the time of
+ * the messages that follow, traces without them are played at 60 Hz.
+ * After the last message the clock runs on for 10 s so momentum scrolling
+ * can coast out. Every event is written as its virtual time, name and
+ * value:
+ *
+ *    267390 BTN_LEFT 1
+ *    267390 SYN 0
+ *
+ * With -g each trace is compared with the golden trace of the same name
+ * (circle.trace against dir/circle.events), -u writes the goldens instead.
+ * -n replays every trace n times, checking each run, and reports the
+ * sessions per second. -a lets ABS_X and ABS_Y values differ from the
+ * golden by that many units, for the delta coded traces of delta_code,
+ * which leave out moves below tuiod's threshold.
+ *
+ * Usage:
+ *    ./touchcore_replay [options] trace
+ *    ./touchcore_replay [options] -g dir [-u] [-n count] [-a units] trace...
+ *       -D us  drag delay, -M us  move delay
+ *       -p     enable prediction, -F  disable the jitter filter
+ *       -s     one finger (single) mode
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#define FRAME_US 16667             /* Frame period of untimed traces */
+#define DRAIN_US 10000000          /* Clock run after the last message */
+#define MAX_LINES 65536
+#define EVENT_LEN 40               /* Longest written event line */
+#define PATH_LEN 512
+
+struct replay_line {
+   long long time_us;              /* -1 on message lines */
+   const char *msg;
+};
+
+struct replay_trace {
+   const char *name;
+   char *text;                     /* The file, split into lines in place */
+   int timed;
+   long lines;
+   struct replay_line line[MAX_LINES];
+};
+
+static struct harness h;
+static struct replay_trace trace;
+static char output[HARNESS_MAX_EVENTS * EVENT_LEN];
+
+
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Reads a whole file into a NUL terminated buffer, NULL on failure
+ */
+static char *read_file(const char *path, long *size)
+{
+   FILE *fp;
+   char *buf;
+   long len;
+
+   if ((fp = fopen(path, "rb")) == NULL)
+      return NULL;
+   fseek(fp, 0, SEEK_END);
+   len = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+
+   if (len < 0 || (buf = malloc(len + 1)) == NULL ||
+         (long) fread(buf, 1, len, fp) != len) {
+      fclose(fp);
+      return NULL;
+   }
+   fclose(fp);
+   buf[len] = '\0';
+   if (size)
+      *size = len;
+   return buf;
+}
+
+/*
+ * Loads a trace and splits it into timestamps and messages, so replays
+ * do no parsing beyond what the core does itself
+ */
+static int load(struct replay_trace *t, const char *path)
+{
+   struct replay_line *l;
+   char *p, *end;
+
+   if ((t->text = read_file(path, NULL)) == NULL)
+      return -1;
+   t->name = path;
+   t->timed = 0;
+   t->lines = 0;
+
+   for (p = t->text; *p; p = end) {
+      if ((end = strchr(p, '\n')) != NULL)
+         *end++ = '\0';
+      else
+         end = p + strlen(p);
+
+      if (t->lines >= MAX_LINES)
+         return -1;
+      l = &t->line[t->lines];
+
+      if (!strncmp(p, "# time ", 7)) {
+         l->time_us = strtoll(p + 7, NULL, 10);
+         l->msg = NULL;
+         t->timed = 1;
+         t->lines++;
+         continue;
+      }
+      if (*p == '[' && strchr(p, ']'))
+         p = strchr(p, ']') + 1;
+      if (*p != '/')
+         continue;
+      l->time_us = -1;
+      l->msg = p;
+      t->lines++;
+   }
+   return 0;
+}
+
+/*
+ * Plays the trace through a fresh core
+ */
+static void replay(struct replay_trace *t, struct touchcore_params *params)
+{
+   struct replay_line *l;
+   unsigned long long untimed = 0;
+   long i;
+
+   harness_init(&h, params, 1);
+
+   for (i = 0; i < t->lines; i++) {
+      l = &t->line[i];
+      if (!l->msg) {
+         harness_advance(&h, l->time_us);
+         continue;
+      }
+      harness_message(&h, l->msg);
+      if (!t->timed && !strncmp(l->msg, "/tuio/2Dcur fseq", 16)) {
+         untimed += FRAME_US;
+         harness_advance(&h, untimed);
+      }
+   }
+   harness_advance(&h, h.now_us + DRAIN_US);
+}
+
+/*
+ * Writes the reported events as text, returns the length or -1 if the
+ * harness ran out of room
+ */
+static long render(char *buf)
+{
+   struct harness_event *e;
+   long i, len = 0;
+
+   if (h.count > HARNESS_MAX_EVENTS)
+      return -1;
+   for (i = 0; i < h.count; i++) {
+      e = &h.event[i];
+      len += sprintf(buf + len, "%llu %s %d\n", e->time_us,
+            harness_code_name(e->type, e->code), e->value);
+   }
+   return len;
+}
+
+/*
+ * Compares the output with the golden, the ABS values within tolerance.
+ * Returns 0 if they match.
+ */
+static int compare(const char *golden, long golden_len, const char *out,
+      long len, long tolerance)
+{
+   unsigned long long gt, ot;
+   char gname[EVENT_LEN], oname[EVENT_LEN];
+   long gv, ov;
+   int gn, on;
+
+   if (!tolerance)
+      return len != golden_len || memcmp(out, golden, len);
+   while (*golden && *out) {
+      if (sscanf(golden, "%llu %39s %ld%n", &gt, gname, &gv, &gn) != 3 ||
+            sscanf(out, "%llu %39s %ld%n", &ot, oname, &ov, &on) != 3 ||
+            gt != ot || strcmp(gname, oname) || (gv != ov &&
+               (strncmp(gname, "ABS_", 4) || labs(gv - ov) > tolerance)))
+         return 1;
+      golden += gn + 1;
+      out += on + 1;
+   }
+   return *golden || *out;
+}
+
+/*
+ * Prints the first line where the output differs from the golden
+ */
+static void report_diff(const char *golden, const char *out)
+{
+   const char *g = golden, *o = out;
+   long line = 1;
+
+   while (*g && *g == *o) {
+      if (*g == '\n')
+         line++;
+      g++;
+      o++;
+   }
+   while (g > golden && g[-1] != '\n') {
+      g--;
+      o--;
+   }
+   printf("   line %ld\n   expected: %.*s\n   got:      %.*s\n", line,
+         (int) strcspn(g, "\n"), *g ? g : "(end)",
+         (int) strcspn(o, "\n"), *o ? o : "(end)");
+}
+
+/*
+ * Golden trace path for a trace: dir/<name without .trace>.events
+ */
+static void golden_path(char *path, const char *dir, const char *trace_path)
+{
+   const char *base = strrchr(trace_path, '/') ? strrchr(trace_path, '/') + 1
+      : trace_path;
+   int len = strlen(base);
+
+   if (len > 6 && !strcmp(base + len - 6, ".trace"))
+      len -= 6;
+   snprintf(path, PATH_LEN, "%s/%.*s.events", dir, len, base);
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-D us] [-M us] [-p] [-F] [-s] trace\n", name);
+   printf("       %s [-D us] [-M us] [-p] [-F] [-s] -g dir [-u] [-n count] "
+         "[-a units] trace...\n", name);
+   exit(1);
+}
+
+int main(int argc, char** argv)
+{
+   struct touchcore_params params = TOUCHCORE_PARAMS_DEFAULT;
+   char path[PATH_LEN];
+   const char *dir = NULL;
+   char *golden;
+   long count = 1, k, len, golden_len, sessions = 0, tolerance = 0;
+   long long start, ns = 0;
+   int opt, update = 0, failed = 0, i;
+   FILE *fp;
+
+   while ((opt = getopt(argc, argv, "D:M:pFsg:un:a:")) != -1) {
+      switch (opt) {
+         case 'D':
+            params.drag_delay_us = atoi(optarg);
+            break;
+         case 'M':
+            params.move_delay_us = atoi(optarg);
+            break;
+         case 'p':
+            params.predict_enable = 1;
+            break;
+         case 'F':
+            params.filter_enable = 0;
+            break;
+         case 's':
+            params.single = 1;
+            break;
+         case 'g':
+            dir = optarg;
+            break;
+         case 'u':
+            update = 1;
+            break;
+         case 'n':
+            count = atol(optarg);
+            break;
+         case 'a':
+            tolerance = atol(optarg);
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (optind >= argc || count <= 0 || (!dir && (update ||
+         argc - optind != 1)))
+      usage(argv[0]);
+
+   for (i = optind; i < argc; i++) {
+      if (load(&trace, argv[i])) {
+         printf("ERROR: Could not load trace '%s'\n", argv[i]);
+         exit(1);
+      }
+
+      replay(&trace, &params);
+      if ((len = render(output)) < 0) {
+         printf("ERROR: More than %d events in '%s'\n", HARNESS_MAX_EVENTS,
+               argv[i]);
+         exit(1);
+      }
+
+      if (!dir) {
+         fwrite(output, 1, len, stdout);
+         free(trace.text);
+         break;
+      }
+
+      golden_path(path, dir, argv[i]);
+      if (update) {
+         if ((fp = fopen(path, "w")) == NULL ||
+               fwrite(output, 1, len, fp) != (size_t) len) {
+            printf("ERROR: Could not write '%s'\n", path);
+            exit(1);
+         }
+         fclose(fp);
+         printf("WROTE %s (%ld events)\n", path, h.count);
+         free(trace.text);
+         continue;
+      }
+
+      if ((golden = read_file(path, &golden_len)) == NULL) {
+         printf("FAIL %s\n   no golden trace '%s'\n", argv[i], path);
+         failed++;
+         free(trace.text);
+         continue;
+      }
+
+      /* Every run is checked, so the rate is that of a regression run */
+      start = now_ns();
+      for (k = 0; k < count; k++) {
+         replay(&trace, &params);
+         len = render(output);
+         if (len < 0 || compare(golden, golden_len, output, len, tolerance))
+            break;
+      }
+      ns += now_ns() - start;
+      sessions += k;
+
+      if (k < count) {
+         output[len < 0 ? 0 : len] = '\0';
+         printf("FAIL %s\n", argv[i]);
+         report_diff(golden, output);
+         failed++;
+      } else {
+         printf("PASS %s (%ld events)\n", argv[i], h.count);
+      }
+      free(golden);
+      free(trace.text);
+   }
+
+   if (dir && !update) {
+      printf("%d traces, %d failed", argc - optind, failed);
+      if (ns > 0)
+         printf(", %ld sessions in %.3f s, %.0f sessions/s", sessions,
+               ns / 1e9, sessions / (ns / 1e9));
+      printf("\n");
+   }
+   return failed != 0;
+}
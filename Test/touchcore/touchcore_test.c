@@ -0,0 +1,326 @@
+/**
+ * Deterministic tests of the touchmouse state machine
+ * (tuio/touchmouse/touchcore.h), run on a virtual clock.
+ *
+ * Each scenario plays a scripted touch sequence at 60 Hz and checks a
+ * summary of what was reported: every button/key event with the frame it
+ * came in, then the direction of the wheel, hwheel and dial motion and
+ * whether the scroll coasted on after the last frame:
+ *
+ *    BTN_LEFT=1@5 BTN_LEFT=0@5 | wheel 0 hwheel 0 dial 0 coast 0
+ *
+ * Last the momentum of a fling must be reported to its last step: the
+ * hi-res motion while coasting is compared to what a copy of the scroll
+ * state gives when ticked on its own.
+ *
+ * Usage:
+ *    ./touchcore_test [-v]
+ */
+
+#include <unistd.h>
+
+#include "harness.h"
+
+#define FRAME_US 16667
+#define SUMMARY_LEN 512
+
+typedef int (*script_fn)(int f, unsigned long *id, long *x, long *y);
+
+struct scenario {
+   const char *name;
+   int single;
+   script_fn script;
+   const char *expect;
+};
+
+static struct harness h;
+
+
+/* Held for 4 frames (67 ms) and lifted */
+static int tap(int f, unsigned long *id, long *x, long *y)
+{
+   if (f >= 6)
+      return -1;
+   if (f < 1 || f > 4)
+      return 0;
+   id[0] = 1; x[0] = 500000; y[0] = 500000;
+   return 1;
+}
+
+/* Held still for half a second, past the drag delay */
+static int hold(int f, unsigned long *id, long *x, long *y)
+{
+   if (f >= 34)
+      return -1;
+   if (f < 1 || f > 31)
+      return 0;
+   id[0] = 1; x[0] = 300000; y[0] = 400000;
+   return 1;
+}
+
+/* Held, then dragged to the right while pressed */
+static int hold_drag(int f, unsigned long *id, long *x, long *y)
+{
+   if (f >= 50)
+      return -1;
+   if (f < 1 || f > 47)
+      return 0;
+   id[0] = 1; y[0] = 400000;
+   x[0] = 300000 + (f > 20 ? (f - 20) * 10000 : 0);
+   return 1;
+}
+
+/* Moved straight away: the cursor hovers, nothing is clicked */
+static int hover(int f, unsigned long *id, long *x, long *y)
+{
+   if (f >= 30)
+      return -1;
+   if (f < 1 || f > 27)
+      return 0;
+   id[0] = 1; x[0] = 200000 + f * 10000; y[0] = 500000;
+   return 1;
+}
+
+/* Two fingers down and up together */
+static int two_finger_tap(int f, unsigned long *id, long *x, long *y)
+{
+   if (f >= 8)
+      return -1;
+   if (f < 1 || f > 5)
+      return 0;
+   id[0] = 1; x[0] = 450000; y[0] = 500000;
+   if (f < 2)
+      return 1;
+   id[1] = 2; x[1] = 550000; y[1] = 500000;
+   return 2;
+}
+
+/* Two fingers dragged down together, then lifted while still. The content
+ * follows the fingers: wheel up */
+static int scroll_down(int f, unsigned long *id, long *x, long *y)
+{
+   long d = f > 4 && f <= 24 ? (f - 4) * 8000 : (f > 24 ? 160000 : 0);
+
+   if (f >= 40)
+      return -1;
+   if (f < 1 || f > 36)
+      return 0;
+   id[0] = 1; x[0] = 450000; y[0] = 300000 + d;
+   if (f < 2)
+      return 1;
+   id[1] = 2; x[1] = 550000; y[1] = 300000 + d;
+   return 2;
+}
+
+/* Two fingers flung to the right and lifted while moving */
+static int fling(int f, unsigned long *id, long *x, long *y)
+{
+   long d = f > 4 ? (f - 4) * 30000 : 0;
+
+   if (f >= 16)
+      return -1;
+   if (f < 1 || f > 13)
+      return 0;
+   id[0] = 1; x[0] = 200000 + d; y[0] = 450000;
+   if (f < 2)
+      return 1;
+   id[1] = 2; x[1] = 200000 + d; y[1] = 550000;
+   return 2;
+}
+
+/* Two fingers spread apart */
+static int pinch_out(int f, unsigned long *id, long *x, long *y)
+{
+   long d = f > 4 ? (f - 4) * 8000 : 0;
+
+   if (f >= 34)
+      return -1;
+   if (f < 1 || f > 31)
+      return 0;
+   id[0] = 1; x[0] = 450000 - d; y[0] = 500000;
+   if (f < 2)
+      return 1;
+   id[1] = 2; x[1] = 550000 + d; y[1] = 500000;
+   return 2;
+}
+
+/* Two fingers turned a quarter counter clockwise (as seen on the screen)
+ * around their centre */
+static int rotate(int f, unsigned long *id, long *x, long *y)
+{
+   /* Quarter turn in steps of ~3 degrees, radius 0.1 */
+   static const long c[] = { 100000, 99863, 99452, 98769, 97815, 96593,
+      95106, 93358, 91355, 89101, 86603, 83867, 80902, 77715, 74314, 70711,
+      66913, 62932, 58779, 54464, 50000, 45399, 40674, 35837, 30902, 25882,
+      20791, 15643, 10453, 5234, 0 };
+   int k = f > 4 ? (f - 4 > 30 ? 30 : f - 4) : 0;
+
+   if (f >= 44)
+      return -1;
+   if (f < 1 || f > 40)
+      return 0;
+   id[0] = 1; x[0] = 500000 - c[k]; y[0] = 500000 + c[30 - k];
+   if (f < 2)
+      return 1;
+   id[1] = 2; x[1] = 500000 + c[k]; y[1] = 500000 - c[30 - k];
+   return 2;
+}
+
+static const struct scenario scenarios[] = {
+   { "tap", 0, tap,
+     "BTN_LEFT=1@5 BTN_LEFT=0@5 | wheel 0 hwheel 0 dial 0 coast 0" },
+   { "hold", 0, hold,
+     "BTN_LEFT=1@16 BTN_LEFT=0@32 | wheel 0 hwheel 0 dial 0 coast 0" },
+   { "hold_drag", 0, hold_drag,
+     "BTN_LEFT=1@16 BTN_LEFT=0@48 | wheel 0 hwheel 0 dial 0 coast 0" },
+   { "hover", 0, hover,
+     "| wheel 0 hwheel 0 dial 0 coast 0" },
+   { "two_finger_tap", 0, two_finger_tap,
+     "BTN_RIGHT=1@6 BTN_RIGHT=0@6 | wheel 0 hwheel 0 dial 0 coast 0" },
+   { "scroll_down", 0, scroll_down,
+     "| wheel + hwheel 0 dial 0 coast 0" },
+   { "fling", 0, fling,
+     "| wheel 0 hwheel - dial 0 coast 1" },
+   { "pinch_out", 0, pinch_out,
+     "KEY_LEFTCTRL=1@8 KEY_LEFTCTRL=0@32 | wheel + hwheel 0 dial 0 coast 0" },
+   { "rotate", 0, rotate,
+     "| wheel 0 hwheel 0 dial + coast 0" },
+   { "single_tap", 1, tap,
+     "BTN_TOUCH=1@5 BTN_TOUCH=0@5 | wheel 0 hwheel 0 dial 0 coast 0" },
+   { "single_drag", 1, hover,
+     "BTN_TOUCH=1@2 BTN_TOUCH=0@28 | wheel 0 hwheel 0 dial 0 coast 0" },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+
+static char sign(long v)
+{
+   return v > 0 ? '+' : (v < 0 ? '-' : '0');
+}
+
+/*
+ * Plays a scenario and summarizes what was reported
+ */
+static void run(const struct scenario *s, char *summary, int verbose)
+{
+   struct touchcore_params params = TOUCHCORE_PARAMS_DEFAULT;
+   unsigned long id[MAX_ALIVE_BLOBS];
+   long x[MAX_ALIVE_BLOBS], y[MAX_ALIVE_BLOBS];
+   long wheel = 0, hwheel = 0, dial = 0, frame;
+   unsigned long long end_us;
+   struct harness_event *e;
+   int f, n, len = 0, coast = 0;
+   long i;
+
+   params.single = s->single;
+   harness_init(&h, &params, 1);
+
+   for (f = 0; (n = s->script(f, id, x, y)) >= 0; f++)
+      harness_frame(&h, (unsigned long long) f * FRAME_US, f + 1, n, id, x, y);
+   end_us = h.now_us;
+
+   /* Let any momentum run out */
+   harness_advance(&h, end_us + 10000000);
+
+   for (i = 0; i < h.count; i++) {
+      e = &h.event[i];
+      frame = (long) (e->time_us / FRAME_US);
+      if (verbose && e->type != TC_EV_SYN)
+         printf("   %8llu %-17s %d\n", e->time_us,
+               harness_code_name(e->type, e->code), e->value);
+
+      if (e->type == TC_EV_KEY)
+         len += sprintf(summary + len, "%s=%d@%ld ",
+               harness_code_name(e->type, e->code), e->value, frame);
+      if (e->type != TC_EV_REL)
+         continue;
+      if (e->code == TC_REL_WHEEL)
+         wheel += e->value;
+      else if (e->code == TC_REL_HWHEEL)
+         hwheel += e->value;
+      else if (e->code == TC_REL_DIAL)
+         dial += e->value;
+      if (e->time_us > end_us)
+         coast = 1;
+   }
+
+   sprintf(summary + len, "| wheel %c hwheel %c dial %c coast %d",
+         sign(wheel), sign(hwheel), sign(dial), coast);
+}
+
+/*
+ * Flings and compares the hi-res motion reported after the last frame with
+ * that of a copy of the scroll state ticked out. Returns 0 if they match.
+ */
+static int check_coast(int verbose)
+{
+   struct scroll_state s;
+   struct scroll_out out;
+   unsigned long id[MAX_ALIVE_BLOBS];
+   long x[MAX_ALIVE_BLOBS], y[MAX_ALIVE_BLOBS];
+   long expect = 0, got = 0, i;
+   unsigned long long end_us;
+   int f, n, more;
+
+   harness_init(&h, NULL, 1);
+   for (f = 0; (n = fling(f, id, x, y)) >= 0; f++)
+      harness_frame(&h, (unsigned long long) f * FRAME_US, f + 1, n, id, x, y);
+   end_us = h.now_us;
+
+   s = h.core.scroll;
+   do {
+      memset(&out, 0, sizeof(out));
+      more = scroll_tick(&s, &out);
+      expect += out.hwheel_hi;
+   } while (more);
+
+   harness_advance(&h, end_us + 10000000);
+   for (i = 0; i < h.count; i++)
+      if (h.event[i].time_us > end_us && h.event[i].type == TC_EV_REL &&
+            h.event[i].code == TC_REL_HWHEEL_HI_RES)
+         got += h.event[i].value;
+
+   if (got != expect || !expect) {
+      printf("FAIL coast\n   expected: %ld hi-res units\n   got:      %ld\n",
+            expect, got);
+      return 1;
+   }
+   if (verbose)
+      printf("coast: %ld hi-res units\n", got);
+   printf("PASS coast\n");
+   return 0;
+}
+
+int main(int argc, char** argv)
+{
+   char summary[SUMMARY_LEN];
+   int opt, verbose = 0, failed = 0;
+   unsigned int i;
+
+   while ((opt = getopt(argc, argv, "v")) != -1) {
+      if (opt != 'v') {
+         printf("usage: %s [-v]\n", argv[0]);
+         exit(1);
+      }
+      verbose = 1;
+   }
+
+   for (i = 0; i < SCENARIOS; i++) {
+      if (verbose)
+         printf("%s\n", scenarios[i].name);
+      run(&scenarios[i], summary, verbose);
+
+      if (strcmp(summary, scenarios[i].expect)) {
+         printf("FAIL %s\n   expected: %s\n   got:      %s\n",
+               scenarios[i].name, scenarios[i].expect, summary);
+         failed++;
+      } else {
+         printf("PASS %s\n", scenarios[i].name);
+      }
+   }
+
+   failed += check_coast(verbose);
+
+   printf("%u scenarios, %d failed\n", (unsigned int) SCENARIOS + 1, failed);
+   return failed != 0;
+}
@@ -0,0 +1,772 @@
+/**
+ * Headless TUIO 1.1 synthesizer, a scriptable stand in for the Java
+ * TUIO_Simulator in load tests.
+ *
+ * A scenario file describes what happens on the surface; every frame
+ * tuiosynth sends a /tuio/2Dcur bundle (source, alive, set per contact,
+ * fseq) and, when objects are on the surface, a /tuio/2Dobj bundle. The
+ * velocities and accelerations in the set messages follow from the motion.
+ * Frames go out on absolute CLOCK_MONOTONIC deadlines at the scenario rate
+ * (or -r), or flat out with -m; at the end the achieved frame rate and the
+ * send lateness are printed.
+ *
+ * With -t nothing is sent: the messages are written to stdout in the
+ * /dev/tuio text format with "# time" lines, ready for
+ * Test/touchcore/touchcore_replay.
+ *
+ * Scenario lines, times in seconds, positions in 0..1, angles in degrees:
+ *
+ *    rate 60                             frames per second
+ *    duration 5                          default: until the last contact
+ *    source tuiosynth                    name in the source messages
+ *    seed 1                              for the walkers
+ *    tap    t x y [hold]                 one touch, held 0.08 s by default
+ *    drag   t dur x0 y0 x1 y1            a straight stroke
+ *    path   t dur x0 y0 x1 y1 ...        a stroke through up to 32 points
+ *    pinch  t dur cx cy d0 d1 [angle]    two fingers from d0 to d1 apart
+ *    rotate t dur cx cy d a0 a1          two fingers d apart, turning
+ *    walk   t dur n [speed]              n random walkers, screens/s
+ *    object t dur class x0 y0 a0 x1 y1 a1  a fiducial moved and turned
+ *
+ * Usage:
+ *    ./tuiosynth [-h host] [-r fps | -m] [-d seconds] [-l loops] scenario port
+ *    ./tuiosynth -t [-r fps] [-d seconds] [-l loops] scenario
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define LINE_LEN 1024
+#define MAX_ITEMS 256
+#define MAX_POINTS 32
+#define MAX_CONTACTS 4096          /* Per item */
+#define MAX_PACKET 65507           /* Largest UDP payload */
+#define MAX_ARGS 16
+#define LATE_BUCKETS 100000        /* 1 us lateness histogram, to 100 ms */
+#define TAP_HOLD 0.08
+#define WALK_SPEED 0.3
+
+enum kind { TAP, DRAG, PATH, PINCH, ROTATE, WALK, OBJECT };
+
+static const char *kind_name[] = {
+   "tap", "drag", "path", "pinch", "rotate", "walk", "object"
+};
+
+/* Where a contact was last frame, for its velocity and acceleration */
+struct motion {
+   double x, y, a;
+   double speed, spin;
+   int valid;
+};
+
+struct item {
+   enum kind kind;
+   double start, dur;
+   int n;                          /* Contacts */
+   int class_id;
+   double pt[MAX_POINTS][2];
+   int points;
+   double cx, cy, d0, d1, a0, a1;
+   double speed;
+
+   unsigned int id;                /* First session id, 0 while inactive */
+   long frames;                    /* Frames it has been on the surface */
+   struct motion *motion;
+   double *walk;                   /* x, y, heading per walker */
+};
+
+struct contact {
+   unsigned int id;
+   int class_id;
+   double x, y, a;                 /* a in radians */
+   double vx, vy, va, m, r;
+};
+
+/* One OSC message, for both the OSC and the text output */
+struct message {
+   const char *profile;
+   char types[MAX_CONTACTS + 4];
+   const char *s;                  /* The command: source, alive, set, fseq */
+   const char *name;               /* String argument of source */
+   int i[MAX_ARGS];
+   float f[MAX_ARGS];
+   const unsigned int *ids;        /* alive: the session ids */
+};
+
+static struct item items[MAX_ITEMS];
+static int item_count;
+static double rate = 60, duration = -1;
+static char source[256] = "tuiosynth";
+static unsigned int seed = 1;
+static unsigned int next_id = 1;
+
+static struct contact cursors[MAX_CONTACTS], objects[MAX_CONTACTS];
+static unsigned int cursor_ids[MAX_CONTACTS], object_ids[MAX_CONTACTS];
+static int cursor_count, object_count;
+
+static int text;
+static unsigned char packet[MAX_PACKET];
+static unsigned long late_hist[LATE_BUCKETS + 1];
+
+
+/*
+ * Scenario
+ */
+static void parse_error(const char *file, int line, const char *what)
+{
+   printf("ERROR: %s line %d: %s\n", file, line, what);
+   exit(1);
+}
+
+static void parse(const char *file)
+{
+   char line[LINE_LEN], *word, *end;
+   double v[2 * MAX_POINTS + 2];
+   struct item *it;
+   int lineno = 0, n, k;
+   FILE *fp;
+
+   if ((fp = fopen(file, "r")) == NULL) {
+      printf("ERROR: Could not open scenario '%s'\n", file);
+      exit(1);
+   }
+
+   while (fgets(line, sizeof(line), fp)) {
+      lineno++;
+      if ((end = strchr(line, '#')) != NULL)
+         *end = '\0';
+      if ((word = strtok(line, " \t\r\n")) == NULL)
+         continue;
+
+      if (!strcmp(word, "source")) {
+         if ((end = strtok(NULL, " \t\r\n")) == NULL)
+            parse_error(file, lineno, "source needs a name");
+         snprintf(source, sizeof(source), "%s", end);
+         continue;
+      }
+
+      /* Everything else is numbers */
+      for (n = 0; (end = strtok(NULL, " \t\r\n")) != NULL; n++) {
+         if (n == (int) (sizeof(v) / sizeof(v[0])))
+            parse_error(file, lineno, "too many numbers");
+         v[n] = strtod(end, &end);
+         if (*end)
+            parse_error(file, lineno, "not a number");
+      }
+
+      if (!strcmp(word, "rate") && n == 1 && v[0] > 0) {
+         rate = v[0];
+         continue;
+      }
+      if (!strcmp(word, "duration") && n == 1 && v[0] > 0) {
+         duration = v[0];
+         continue;
+      }
+      if (!strcmp(word, "seed") && n == 1) {
+         seed = (unsigned int) v[0];
+         continue;
+      }
+
+      if (item_count == MAX_ITEMS)
+         parse_error(file, lineno, "too many items");
+      it = &items[item_count];
+      memset(it, 0, sizeof(*it));
+      for (k = 0; k <= OBJECT && strcmp(word, kind_name[k]); k++)
+         ;
+      if (k > OBJECT)
+         parse_error(file, lineno, "unknown keyword");
+      it->kind = k;
+      it->start = v[0];
+      it->n = 1;
+
+      switch (it->kind) {
+         case TAP:
+            if (n != 3 && n != 4)
+               parse_error(file, lineno, "tap t x y [hold]");
+            it->dur = n == 4 ? v[3] : TAP_HOLD;
+            it->pt[0][0] = v[1];
+            it->pt[0][1] = v[2];
+            it->points = 1;
+            break;
+         case DRAG:
+         case PATH:
+            if ((it->kind == DRAG && n != 6) || n < 6 || n % 2)
+               parse_error(file, lineno, it->kind == DRAG ?
+                     "drag t dur x0 y0 x1 y1" : "path t dur x0 y0 x1 y1 ...");
+            it->dur = v[1];
+            for (k = 2; k < n; k += 2, it->points++) {
+               it->pt[it->points][0] = v[k];
+               it->pt[it->points][1] = v[k + 1];
+            }
+            break;
+         case PINCH:
+            if (n != 6 && n != 7)
+               parse_error(file, lineno, "pinch t dur cx cy d0 d1 [angle]");
+            it->n = 2;
+            it->dur = v[1];
+            it->cx = v[2];
+            it->cy = v[3];
+            it->d0 = v[4];
+            it->d1 = v[5];
+            it->a0 = it->a1 = n == 7 ? v[6] : 0;
+            break;
+         case ROTATE:
+            if (n != 7)
+               parse_error(file, lineno, "rotate t dur cx cy d a0 a1");
+            it->n = 2;
+            it->dur = v[1];
+            it->cx = v[2];
+            it->cy = v[3];
+            it->d0 = it->d1 = v[4];
+            it->a0 = v[5];
+            it->a1 = v[6];
+            break;
+         case WALK:
+            if ((n != 3 && n != 4) || v[2] < 1 || v[2] > MAX_CONTACTS)
+               parse_error(file, lineno, "walk t dur n [speed]");
+            it->dur = v[1];
+            it->n = (int) v[2];
+            it->speed = n == 4 ? v[3] : WALK_SPEED;
+            it->walk = calloc(3 * it->n, sizeof(double));
+            break;
+         case OBJECT:
+            if (n != 9)
+               parse_error(file, lineno,
+                     "object t dur class x0 y0 a0 x1 y1 a1");
+            it->dur = v[1];
+            it->class_id = (int) v[2];
+            it->pt[0][0] = v[3];
+            it->pt[0][1] = v[4];
+            it->a0 = v[5];
+            it->pt[1][0] = v[6];
+            it->pt[1][1] = v[7];
+            it->a1 = v[8];
+            it->points = 2;
+            break;
+      }
+      if (it->dur <= 0)
+         parse_error(file, lineno, "duration must be positive");
+      it->motion = calloc(it->n, sizeof(*it->motion));
+      item_count++;
+   }
+   fclose(fp);
+
+   /* Until the last contact lifts, and one more frame to show it */
+   if (duration < 0)
+      for (k = 0, duration = 0; k < item_count; k++)
+         if (items[k].start + items[k].dur > duration)
+            duration = items[k].start + items[k].dur + 1 / rate;
+}
+
+
+/*
+ * Motion
+ */
+static double random_unit(void)
+{
+   /* xorshift32, the same walk for the same seed */
+   seed ^= seed << 13;
+   seed ^= seed >> 17;
+   seed ^= seed << 5;
+   return (seed & 0xffffff) / (double) 0x1000000;
+}
+
+/* Point at fraction u of the way along a polyline */
+static void along(const struct item *it, double u, double *x, double *y)
+{
+   double len = 0, seg, want;
+   int k;
+
+   for (k = 1; k < it->points; k++)
+      len += hypot(it->pt[k][0] - it->pt[k - 1][0],
+            it->pt[k][1] - it->pt[k - 1][1]);
+
+   want = u * len;
+   for (k = 1; k < it->points; k++) {
+      seg = hypot(it->pt[k][0] - it->pt[k - 1][0],
+            it->pt[k][1] - it->pt[k - 1][1]);
+      if (want <= seg && seg > 0) {
+         *x = it->pt[k - 1][0] + (it->pt[k][0] - it->pt[k - 1][0]) * want / seg;
+         *y = it->pt[k - 1][1] + (it->pt[k][1] - it->pt[k - 1][1]) * want / seg;
+         return;
+      }
+      want -= seg;
+   }
+   *x = it->pt[it->points - 1][0];
+   *y = it->pt[it->points - 1][1];
+}
+
+static void walk_step(struct item *it, int k, double dt, double *x, double *y)
+{
+   double *w = it->walk + 3 * k;
+
+   w[2] += (random_unit() - 0.5) * 4 * dt * M_PI;
+   w[0] += cos(w[2]) * it->speed * dt;
+   w[1] += sin(w[2]) * it->speed * dt;
+
+   /* Bounce off the edges */
+   if (w[0] < 0 || w[0] > 1) {
+      w[0] = w[0] < 0 ? -w[0] : 2 - w[0];
+      w[2] = M_PI - w[2];
+   }
+   if (w[1] < 0 || w[1] > 1) {
+      w[1] = w[1] < 0 ? -w[1] : 2 - w[1];
+      w[2] = -w[2];
+   }
+   *x = w[0];
+   *y = w[1];
+}
+
+/* Position of contact k of an item at u (0..1) through it */
+static void place(struct item *it, int k, double u, double dt, double *x,
+      double *y, double *a)
+{
+   double d, ang;
+
+   *a = 0;
+   switch (it->kind) {
+      case TAP:
+         *x = it->pt[0][0];
+         *y = it->pt[0][1];
+         break;
+      case DRAG:
+      case PATH:
+         along(it, u, x, y);
+         break;
+      case PINCH:
+      case ROTATE:
+         d = (it->d0 + (it->d1 - it->d0) * u) / 2;
+         ang = (it->a0 + (it->a1 - it->a0) * u) * M_PI / 180 + k * M_PI;
+         /* Counter clockwise on the screen, where y points down */
+         *x = it->cx + d * cos(ang);
+         *y = it->cy - d * sin(ang);
+         break;
+      case WALK:
+         walk_step(it, k, dt, x, y);
+         break;
+      case OBJECT:
+         *x = it->pt[0][0] + (it->pt[1][0] - it->pt[0][0]) * u;
+         *y = it->pt[0][1] + (it->pt[1][1] - it->pt[0][1]) * u;
+         d = it->a0 + (it->a1 - it->a0) * u;
+         d = fmod(d, 360);
+         *a = (d < 0 ? d + 360 : d) * M_PI / 180;
+         break;
+   }
+}
+
+/*
+ * Collects the contacts on the surface at time t (into the loop)
+ */
+static void frame_contacts(double t, double dt)
+{
+   struct contact *c;
+   struct motion *m;
+   struct item *it;
+   double u, speed, spin, turn;
+   int i, k;
+
+   cursor_count = object_count = 0;
+   for (i = 0; i < item_count; i++) {
+      it = &items[i];
+      if (t < it->start || t >= it->start + it->dur) {
+         it->id = 0;
+         continue;
+      }
+
+      /* New on the surface: fresh session ids and no motion yet */
+      if (!it->id) {
+         it->frames = 0;
+         it->id = next_id;
+         next_id += it->n;
+         memset(it->motion, 0, it->n * sizeof(*it->motion));
+         for (k = 0; k < it->n && it->kind == WALK; k++) {
+            it->walk[3 * k] = random_unit();
+            it->walk[3 * k + 1] = random_unit();
+            it->walk[3 * k + 2] = random_unit() * 2 * M_PI;
+         }
+      }
+      u = (t - it->start) / it->dur;
+      /* ... and only start to move once both are down */
+      if ((it->kind == PINCH || it->kind == ROTATE) && it->dur > dt)
+         u = it->frames ? (t - it->start - dt) / (it->dur - dt) : 0;
+
+      for (k = 0; k < it->n; k++) {
+         /* Two fingers land a frame apart, as they do on a real table */
+         if (k == 1 && !it->frames && (it->kind == PINCH ||
+                  it->kind == ROTATE))
+            continue;
+         if (it->kind == OBJECT) {
+            if (object_count == MAX_CONTACTS)
+               break;
+            c = &objects[object_count];
+            object_ids[object_count++] = it->id + k;
+         } else {
+            if (cursor_count == MAX_CONTACTS)
+               break;
+            c = &cursors[cursor_count];
+            cursor_ids[cursor_count++] = it->id + k;
+         }
+         c->id = it->id + k;
+         c->class_id = it->class_id;
+         place(it, k, u, dt, &c->x, &c->y, &c->a);
+
+         /* Velocity in screens/s, acceleration in screens/s^2 */
+         m = &it->motion[k];
+         c->vx = c->vy = c->va = c->m = c->r = 0;
+         if (m->valid) {
+            c->vx = (c->x - m->x) / dt;
+            c->vy = (c->y - m->y) / dt;
+            speed = hypot(c->vx, c->vy);
+            c->m = (speed - m->speed) / dt;
+            turn = c->a - m->a;
+            turn -= 2 * M_PI * floor(turn / (2 * M_PI) + 0.5);
+            /* Rotation in turns/s, as the spec has it */
+            spin = turn / (2 * M_PI) / dt;
+            c->va = spin;
+            c->r = (spin - m->spin) / dt;
+            m->speed = speed;
+            m->spin = spin;
+         }
+         m->x = c->x;
+         m->y = c->y;
+         m->a = c->a;
+         m->valid = 1;
+      }
+      it->frames++;
+   }
+}
+
+
+/*
+ * Output: OSC bundles over UDP, or /dev/tuio text
+ */
+struct out {
+   int fd;
+   unsigned long packets;
+   unsigned long bytes;
+   unsigned long errors;
+   long long time_us;
+};
+
+static unsigned char *put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+   return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s)
+{
+   size_t len = strlen(s);
+
+   memcpy(p, s, len);
+   memset(p + len, 0, 4 - len % 4);
+   return p + len + 4 - len % 4;
+}
+
+/* Bytes the message takes in a bundle, element size included */
+static size_t osc_size(const struct message *m)
+{
+   size_t n = strlen(m->types);
+
+   if (m->name)
+      return 4 + (strlen(m->profile) / 4 + 1) * 4 + 4 +
+         (strlen(m->s) / 4 + 1) * 4 + (strlen(m->name) / 4 + 1) * 4;
+   return 4 + (strlen(m->profile) / 4 + 1) * 4 + (n / 4 + 1) * 4 +
+      (strlen(m->s) / 4 + 1) * 4 + 4 * (n - 2);
+}
+
+static unsigned char *put_message(unsigned char *p, const struct message *m)
+{
+   unsigned char *size = p;
+   union { float f; unsigned int i; } v;
+   int k, fi = 0, ii = 0, n = strlen(m->types);
+
+   p = put_string(p + 4, m->profile);
+   p = put_string(p, m->types);
+   p = put_string(p, m->s);
+   for (k = 2; k < n; k++) {
+      if (m->types[k] == 's') {
+         p = put_string(p, m->name);
+      } else if (m->types[k] == 'f') {
+         v.f = m->f[fi++];
+         p = put_be32(p, v.i);
+      } else {
+         p = put_be32(p, m->ids ? m->ids[ii++] : (unsigned int) m->i[ii++]);
+      }
+   }
+   put_be32(size, p - size - 4);
+   return p;
+}
+
+/* The message as tuiod writes it to /dev/tuio */
+static void print_message(const struct message *m)
+{
+   int k, fi = 0, ii = 0, n = strlen(m->types);
+
+   printf("%s %s", m->profile, m->s);
+   for (k = 2; k < n; k++) {
+      if (m->types[k] == 's')
+         printf(" %s", m->name);
+      else if (m->types[k] == 'f')
+         printf(" %f", m->f[fi++]);
+      else
+         printf(" %d", m->ids ? (int) m->ids[ii++] : m->i[ii++]);
+   }
+   printf("\n");
+}
+
+static void flush(struct out *o, unsigned char *end)
+{
+   if (send(o->fd, packet, end - packet, 0) < 0)
+      o->errors++;
+   o->packets++;
+   o->bytes += end - packet;
+}
+
+/* Adds a message to the packet being built, sending it first if full */
+static unsigned char *add(struct out *o, unsigned char *p,
+      const struct message *m)
+{
+   if (text) {
+      print_message(m);
+      return p;
+   }
+   if (p - packet + osc_size(m) > MAX_PACKET && p - packet > 16) {
+      flush(o, p);
+      p = put_string(packet, "#bundle");
+      p = put_be32(p, 0);
+      p = put_be32(p, 1);
+   }
+   return put_message(p, m);
+}
+
+/*
+ * Sends one profile's bundle: source, alive, a set per contact, fseq.
+ * Bundles too big for a datagram are split between the set messages: only
+ * the first has source and alive, only the last fseq.
+ */
+static void send_profile(struct out *o, const char *profile, int obj,
+      const struct contact *c, const unsigned int *ids, int count, int fseq)
+{
+   struct message m;
+   unsigned char *p = packet;
+   int k;
+
+   if (!text) {
+      p = put_string(p, "#bundle");
+      p = put_be32(p, 0);            /* Timetag 1: immediately */
+      p = put_be32(p, 1);
+   }
+
+   memset(&m, 0, sizeof(m));
+   m.profile = profile;
+   strcpy(m.types, ",ss");
+   m.s = "source";
+   m.name = source;
+   p = add(o, p, &m);
+   m.name = NULL;
+
+   memset(m.types + 2, 'i', count);
+   m.types[2 + count] = '\0';
+   m.s = "alive";
+   m.ids = ids;
+   p = add(o, p, &m);
+   m.ids = NULL;
+
+   for (k = 0; k < count; k++, c++) {
+      m.s = "set";
+      m.i[0] = c->id;
+      if (obj) {
+         strcpy(m.types, ",siiffffffff");
+         m.i[1] = c->class_id;
+         m.f[0] = c->x;
+         m.f[1] = c->y;
+         m.f[2] = c->a;
+         m.f[3] = c->vx;
+         m.f[4] = c->vy;
+         m.f[5] = c->va;
+         m.f[6] = c->m;
+         m.f[7] = c->r;
+      } else {
+         strcpy(m.types, ",sifffff");
+         m.f[0] = c->x;
+         m.f[1] = c->y;
+         m.f[2] = c->vx;
+         m.f[3] = c->vy;
+         m.f[4] = c->m;
+      }
+      p = add(o, p, &m);
+   }
+
+   strcpy(m.types, ",si");
+   m.s = "fseq";
+   m.i[0] = fseq;
+   p = add(o, p, &m);
+
+   if (!text)
+      flush(o, p);
+}
+
+static int open_socket(const char *host, const char *port)
+{
+   struct addrinfo hints, *ai;
+   int fd;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_DGRAM;
+   if (getaddrinfo(host, port, &hints, &ai)) {
+      printf("ERROR: Unknown host '%s'\n", host);
+      return -1;
+   }
+   if ((fd = socket(ai->ai_family, SOCK_DGRAM, 0)) < 0 ||
+         connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+      printf("ERROR: Could not open socket: %s\n", strerror(errno));
+      fd = -1;
+   }
+   freeaddrinfo(ai);
+   return fd;
+}
+
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Lateness at the given fraction of the frames, in us */
+static double percentile(unsigned long frames, double fraction)
+{
+   unsigned long seen = 0, want = (unsigned long) ceil(frames * fraction);
+   unsigned int i;
+
+   for (i = 0; i <= LATE_BUCKETS; i++)
+      if ((seen += late_hist[i]) >= want && want)
+         return i;
+   return LATE_BUCKETS;
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-h host] [-r fps | -m] [-d seconds] [-l loops] "
+         "scenario port\n", name);
+   printf("       %s -t [-r fps] [-d seconds] [-l loops] scenario\n", name);
+   exit(1);
+}
+
+int main(int argc, char** argv)
+{
+   const char *host = "127.0.0.1";
+   struct out o;
+   struct timespec ts;
+   double fps = 0, secs = 0, elapsed;
+   long long start, deadline = 0, late, late_max = 0;
+   double late_sum = 0;
+   long frame, frames;
+   int opt, flat_out = 0, loops = 1, loop;
+
+   while ((opt = getopt(argc, argv, "h:r:md:l:t")) != -1) {
+      switch (opt) {
+         case 'h':
+            host = optarg;
+            break;
+         case 'r':
+            fps = atof(optarg);
+            break;
+         case 'm':
+            flat_out = 1;
+            break;
+         case 'd':
+            secs = atof(optarg);
+            break;
+         case 'l':
+            loops = atoi(optarg);
+            break;
+         case 't':
+            text = 1;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (argc - optind != (text ? 1 : 2) || loops < 1 || fps < 0 || secs < 0 ||
+         (text && flat_out))
+      usage(argv[0]);
+
+   parse(argv[optind]);
+   if (fps > 0)
+      rate = fps;
+   if (secs > 0)
+      duration = secs;
+   frames = (long) ceil(duration * rate);
+
+   memset(&o, 0, sizeof(o));
+   if (!text && (o.fd = open_socket(host, argv[optind + 1])) < 0)
+      exit(1);
+
+   start = now_ns();
+   for (loop = 0; loop < loops; loop++) {
+      for (frame = 0; frame < frames; frame++) {
+         frame_contacts(frame / rate, 1 / rate);
+
+         if (text) {
+            printf("# time %lld\n", (long long)
+                  (((double) loop * frames + frame) * 1e6 / rate));
+         } else if (!flat_out) {
+            deadline = start + (long long)
+               (((double) loop * frames + frame) * 1e9 / rate);
+            ts.tv_sec = deadline / 1000000000;
+            ts.tv_nsec = deadline % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+                  == EINTR)
+               ;
+         }
+
+         send_profile(&o, "/tuio/2Dcur", 0, cursors, cursor_ids,
+               cursor_count, (int) (loop * frames + frame + 1));
+         if (object_count)
+            send_profile(&o, "/tuio/2Dobj", 1, objects, object_ids,
+                  object_count, (int) (loop * frames + frame + 1));
+
+         if (!text && !flat_out) {
+            late = now_ns() - deadline;
+            late = late > 0 ? late : 0;
+            late_sum += late;
+            if (late > late_max)
+               late_max = late;
+            late /= 1000;
+            late_hist[late < LATE_BUCKETS ? late : LATE_BUCKETS]++;
+         }
+      }
+   }
+   elapsed = (now_ns() - start) / 1e9;
+   if (text)
+      return 0;
+
+   frames *= loops;
+   printf("%ld frames, %lu packets (%lu bytes) in %.3f s: %.0f frames/s",
+         frames, o.packets, o.bytes, elapsed, frames / elapsed);
+   if (!flat_out)
+      printf(", target %.0f", rate);
+   printf("\n");
+   if (o.errors)
+      printf("%lu send errors\n", o.errors);
+   if (!flat_out && frames)
+      printf("late mean %.1f p50 %.0f p99 %.0f p99.9 %.0f max %.1f us\n",
+            late_sum / frames / 1e3, percentile(frames, 0.5),
+            percentile(frames, 0.99), percentile(frames, 0.999),
+            late_max / 1e3);
+   return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef __CALIB_H__
+#define __CALIB_H__
+
+/*
+ * Projector/camera calibration as a 3x3 homography in fixed point.
+ *
+ * The matrix maps normalized tracker coordinates to normalized screen
+ * coordinates:
+ *
+ *    [X Y W] = M [x y 1],   screen = (X/W, Y/W)
+ *
+ * Entries are Q16 (65536 is 1.0), row major, as written by tuio/tuiocal.
+ * An affine matrix (last row 0 0 65536) needs no divide at all; a
+ * projective one costs one 32 bit divide per point for 1/W.
+ *
+ * Points are in coordinate units (see coord.h).
+ */
+
+#define CALIB_ONE 65536
+#define CALIB_ENTRIES 9
+
+struct calib {
+   long res;                  /* Coordinate units per screen */
+   long m[CALIB_ENTRIES];     /* Q16, row major */
+   long tx, ty;               /* Translation in coordinate units */
+   int identity;              /* Nothing to do */
+   int affine;                /* Last row is 0 0 1 */
+};
+
+/*
+ * Loads matrix m for a screen of 'res' units. An all zero matrix means no
+ * calibration.
+ */
+static inline void calib_set(struct calib *c, long res, const int *m)
+{
+   static const int ident[CALIB_ENTRIES] = {
+      CALIB_ONE, 0, 0,  0, CALIB_ONE, 0,  0, 0, CALIB_ONE
+   };
+   int i, zero = 1;
+
+   for (i = 0; i < CALIB_ENTRIES; i++)
+      zero &= !m[i];
+   if (zero)
+      m = ident;
+
+   c->res = res;
+   c->identity = 1;
+   for (i = 0; i < CALIB_ENTRIES; i++) {
+      c->m[i] = m[i];
+      c->identity &= m[i] == ident[i];
+   }
+   c->affine = !m[6] && !m[7] && m[8] == CALIB_ONE;
+   c->tx = (long) (((long long) m[2] * res) >> 16);
+   c->ty = (long) (((long long) m[5] * res) >> 16);
+}
+
+/*
+ * Maps one point with an affine matrix
+ */
+static inline void calib_affine(const struct calib *c, long *x, long *y)
+{
+   long long px = *x, py = *y;
+
+   *x = (long) ((c->m[0] * px + c->m[1] * py) >> 16) + c->tx;
+   *y = (long) ((c->m[3] * px + c->m[4] * py) >> 16) + c->ty;
+}
+
+/*
+ * Maps one point with a projective matrix. Returns 0 if the point maps to
+ * infinity (W <= 0) and is left unchanged.
+ */
+static inline int calib_project(const struct calib *c, long *x, long *y)
+{
+   long shift = c->res >> 8 ? c->res >> 8 : 1;
+   long w, ax = *x, ay = *y;
+   unsigned long rw;
+
+   /* W in Q16, the perspective terms use coordinates reduced to 8 bits
+    * of fraction so the products stay in 32 bits */
+   w = c->m[8] + (c->m[6] * (ax >> 8) + c->m[7] * (ay >> 8)) / shift;
+   if (w <= 0)
+      return 0;
+   rw = 0xFFFFFFFFUL / (unsigned long) w;   /* 1/W in Q16 */
+
+   calib_affine(c, &ax, &ay);
+   *x = (long) (((long long) ax * (long long) rw) >> 16);
+   *y = (long) (((long long) ay * (long long) rw) >> 16);
+   return 1;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __COORD_H__
+#define __COORD_H__
+
+/*
+ * Fixed-point parsing of the decimal coordinates written by tuiod.
+ *
+ * tuiod prints TUIO floats with "%f", ex: "0.482812". A coordinate is parsed
+ * as "[-]int[.frac]" into a signed value with 'res' units per 1.0, rounded
+ * to the nearest unit. Only the first COORD_FRAC_DIGITS fraction digits are
+ * significant; any further digits are skipped.
+ *
+ * Nothing here depends on kernel headers so the parser can be exercised from
+ * user space (see Test/coord_test).
+ */
+
+#define COORD_FRAC_DIGITS 9
+#define COORD_FRAC_ONE 1000000000UL   /* 10^COORD_FRAC_DIGITS */
+#define COORD_RES_MAX (1UL << 20)      /* Largest supported resolution */
+#define COORD_INT_MAX 1024             /* Integer parts are saturated here */
+
+/* Scales a fraction of n digits up to COORD_FRAC_DIGITS digits */
+static const unsigned long coord_pad[COORD_FRAC_DIGITS + 1] = {
+   1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+   10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+/*
+ * Returns n / 10^9 for n < 2^61 without a 64 bit divide (not available in
+ * 32 bit kernels). Multiplies by ceil(2^92 / 10^9) keeping the high 64 bits,
+ * built from 32x32 products.
+ */
+static inline unsigned long long coord_div_frac(unsigned long long n)
+{
+   const unsigned long long m = 0x44B82FA09B5A52CCULL;
+   unsigned long long n0 = n & 0xFFFFFFFFULL, n1 = n >> 32;
+   unsigned long long m0 = m & 0xFFFFFFFFULL, m1 = m >> 32;
+   unsigned long long p01 = n0 * m1, p10 = n1 * m0;
+   unsigned long long mid;
+
+   mid = ((n0 * m0) >> 32) + (p01 & 0xFFFFFFFFULL) + (p10 & 0xFFFFFFFFULL);
+   return (n1 * m1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32)) >> 28;
+}
+
+/*
+ * Parses the coordinate at *str in units of 1/res and advances *str past the
+ * number and any following spaces. res must not exceed COORD_RES_MAX.
+ */
+static inline long parse_coord(const char **str, unsigned long res)
+{
+   const unsigned char *p = (const unsigned char *) *str;
+   unsigned long ip = 0, fp = 0, d;
+   unsigned int n = 0;
+   long v;
+   int neg;
+
+   neg = (*p == '-');
+   p += neg | (*p == '+');
+
+   while ((d = *p - '0') < 10) {
+      ip = ip * 10 + d;
+      p++;
+   }
+   ip = ip < COORD_INT_MAX ? ip : COORD_INT_MAX;
+
+   if (*p == '.') {
+      p++;
+      while (n < COORD_FRAC_DIGITS && (d = *p - '0') < 10) {
+         fp = fp * 10 + d;
+         p++;
+         n++;
+      }
+      /* Digits beyond the supported precision are dropped */
+      while (*p - '0' < 10U)
+         p++;
+   }
+   fp *= coord_pad[n];
+
+   v = ip * res
+     + coord_div_frac((unsigned long long) fp * res + COORD_FRAC_ONE / 2);
+
+   while (*p == ' ')
+      p++;
+   *str = (const char *) p;
+
+   return neg ? -v : v;
+}
+
+/*
+ * Clamps a parsed coordinate into the reportable range [0, res-1]
+ */
+static inline unsigned long clamp_coord(long v, unsigned long res)
+{
+   if (v < 0)
+      return 0;
+   return (unsigned long) v < res ? (unsigned long) v : res - 1;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+/*
+ * Per contact adaptive low pass filter (One Euro filter) in fixed point.
+ *
+ * Each axis is smoothed by an exponential filter whose cutoff rises with
+ * the contact's speed:
+ *
+ *    cutoff = min_cutoff + beta * |speed|
+ *
+ * so a resting finger is filtered hard (camera jitter disappears) while a
+ * fast one passes with little lag. The speed is itself low passed at
+ * d_cutoff. On top of that the reported position only follows the filtered
+ * one once they differ by more than 'deadband' units, so a finger at rest
+ * reports exactly the same position every frame and never shows up as a
+ * moved blob.
+ *
+ * Cutoffs are in mHz, speeds in 1/1000 screen per second, positions in
+ * coordinate units (see coord.h). A frame takes four 32 bit divides an
+ * axis, for the speed and the two smoothing factors.
+ */
+
+#define FILTER_MAX_CONTACTS 20
+#define FILTER_MIN_DT_US 1000       /* Frame intervals are clamped to */
+#define FILTER_MAX_DT_US 100000     /* 1..100 ms */
+#define FILTER_MAX_SPEED 65535      /* 65 screens per second */
+
+struct filter_params {
+   long min_cutoff;  /* Cutoff at rest, mHz */
+   long beta;        /* Cutoff added per screen/s of speed, mHz */
+   long d_cutoff;    /* Cutoff of the speed estimate, mHz */
+   long deadband;    /* Output hysteresis, coordinate units */
+};
+
+struct filter_axis {
+   long x;           /* Filtered position, Q8 */
+   long dx;          /* Filtered speed, 1/1000 screen per second */
+   long out;         /* Last reported position */
+};
+
+struct filter_contact {
+   unsigned long id;
+   unsigned long long last_us;
+   int seen;         /* Present in the current frame */
+   struct filter_axis axis[2];
+};
+
+struct filter_state {
+   long res;         /* Coordinate units per screen */
+   unsigned int count;
+   struct filter_contact contact[FILTER_MAX_CONTACTS];
+};
+
+static inline void filter_init(struct filter_state *f, long res)
+{
+   f->res = res;
+   f->count = 0;
+}
+
+/*
+ * Smoothing factor (Q16) of a first order low pass at 'cutoff' mHz sampled
+ * every dt_us: alpha = r / (r + 1), r = 2 pi cutoff dt.
+ */
+static inline long filter_alpha(long cutoff, long dt_us)
+{
+   /* 2 pi 10^-9 in Q16 is 4.118e-4 ~ 27 / 2^16 */
+   unsigned long r = (unsigned long) (((long long) cutoff * dt_us * 27) >> 16);
+
+   if (r > (1UL << 23))
+      r = 1UL << 23;
+   return (long) ((r << 8) / ((r + 65536) >> 8));
+}
+
+static inline long filter_abs(long v)
+{
+   return v < 0 ? -v : v;
+}
+
+/*
+ * Runs one axis sample 'raw' through the filter and returns the position
+ * to report
+ */
+static inline long filter_axis(struct filter_axis *a, struct filter_params *p,
+      long res, long raw, long dt_us)
+{
+   long speed, cutoff, unit = res >= 1000 ? res / 1000 : 1;
+
+   /* Speed against the previous estimate, in 1/1000 screen/s */
+   speed = (raw - (a->x >> 8)) * (1000000 / dt_us) / unit;
+   speed = speed > FILTER_MAX_SPEED ? FILTER_MAX_SPEED
+         : (speed < -FILTER_MAX_SPEED ? -FILTER_MAX_SPEED : speed);
+   a->dx += (long) (((long long) filter_alpha(p->d_cutoff, dt_us)
+                     * (speed - a->dx)) >> 16);
+
+   /* beta * |dx| / 1000, the divide done as * 1049 >> 20 */
+   cutoff = p->min_cutoff
+          + (long) (((long long) p->beta * filter_abs(a->dx) * 1049) >> 20);
+   a->x += (long) (((long long) filter_alpha(cutoff, dt_us)
+                    * ((raw << 8) - a->x)) >> 16);
+
+   if (filter_abs((a->x >> 8) - a->out) > p->deadband)
+      a->out = (a->x + 128) >> 8;
+   return a->out;
+}
+
+/*
+ * Marks every contact as unseen before the contacts of a frame are filtered
+ */
+static inline void filter_begin(struct filter_state *f)
+{
+   unsigned int i;
+
+   for (i = 0; i < f->count; i++)
+      f->contact[i].seen = 0;
+}
+
+/*
+ * Filters the position of contact 'id' in place. New contacts start at
+ * their raw position.
+ */
+static inline void filter_contact(struct filter_state *f,
+      struct filter_params *p, unsigned long id, unsigned long *x,
+      unsigned long *y, unsigned long long now)
+{
+   struct filter_contact *c = 0;
+   unsigned int i;
+   long dt;
+
+   for (i = 0; i < f->count; i++) {
+      if (f->contact[i].id == id) {
+         c = &f->contact[i];
+         break;
+      }
+   }
+
+   if (!c) {
+      if (f->count >= FILTER_MAX_CONTACTS)
+         return;
+      c = &f->contact[f->count++];
+      c->id = id;
+      c->last_us = now;
+      c->seen = 1;
+      c->axis[0].x = (long) *x << 8;
+      c->axis[1].x = (long) *y << 8;
+      c->axis[0].out = *x;
+      c->axis[1].out = *y;
+      c->axis[0].dx = c->axis[1].dx = 0;
+      return;
+   }
+
+   dt = now - c->last_us < FILTER_MAX_DT_US ? (long) (now - c->last_us)
+                                            : FILTER_MAX_DT_US;
+   dt = dt < FILTER_MIN_DT_US ? FILTER_MIN_DT_US : dt;
+   c->last_us = now;
+   c->seen = 1;
+
+   *x = filter_axis(&c->axis[0], p, f->res, *x, dt);
+   *y = filter_axis(&c->axis[1], p, f->res, *y, dt);
+}
+
+/*
+ * Forgets the contacts that were not in the frame
+ */
+static inline void filter_end(struct filter_state *f)
+{
+   unsigned int i = 0;
+
+   while (i < f->count) {
+      if (f->contact[i].seen)
+         i++;
+      else
+         f->contact[i] = f->contact[--f->count];
+   }
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef __GESTURE_H__
+#define __GESTURE_H__
+
+/*
+ * Incremental two contact gesture recognizer.
+ *
+ * gesture_begin records the geometry of a pair of contacts; every frame in
+ * which either of them moved, gesture_update derives the new distance,
+ * angle and centroid in O(1) and accumulates the deltas since the start.
+ * A mode is chosen once one of pan (scroll), pinch or rotate passes its
+ * enter threshold. After that the accumulators leak (GESTURE_LEAK) so they
+ * only reflect recent motion, and switching away from the locked mode needs
+ * the competing motion to pass GESTURE_SWITCH times its enter threshold and
+ * to outweigh the locked mode. A slightly wobbly pinch stays a pinch.
+ *
+ * Distances are in coordinate units (see coord.h), angles in 1/65536 of a
+ * turn. The distance is an integer square root and the angle a polynomial
+ * of one 32 bit ratio, with no floating point.
+ */
+
+#define GESTURE_NONE 0
+#define GESTURE_SCROLL 1
+#define GESTURE_PINCH 2
+#define GESTURE_ROTATE 3
+
+#define GESTURE_TURN 65536          /* Angle units per full turn */
+#define GESTURE_PAN_DIV 50          /* Scroll enters at res/50 of pan */
+#define GESTURE_PINCH_DIV 25        /* Pinch enters at res/25 of spread */
+#define GESTURE_ROT_ENTER 2731      /* Rotate enters at 15 degrees */
+#define GESTURE_SWITCH 2            /* Leaving a mode takes 2x the motion */
+#define GESTURE_LEAK 3              /* Locked accumulators lose 1/8 a frame */
+
+struct gesture_out {
+   int mode;         /* Locked mode, GESTURE_NONE while undecided */
+   int changed;      /* Non zero when the mode was entered this frame */
+   long pan_x;       /* Centroid motion this frame (scroll) */
+   long pan_y;
+   long scale;       /* Change of contact distance this frame (pinch) */
+   long rotate;      /* Change of angle this frame (rotate) */
+};
+
+struct gesture_state {
+   long res;                  /* Coordinate units per screen */
+   int mode;
+   long cx, cy;               /* Current centroid */
+   long dist;                 /* Current contact distance */
+   long angle;                /* Current angle of b around a */
+   long pan_x, pan_y;         /* Accumulated motion, leaky once locked */
+   long scale;
+   long rotate;
+};
+
+/*
+ * Integer square root of a 64 bit value, shifts and adds only
+ */
+static inline unsigned long gesture_isqrt(unsigned long long v)
+{
+   unsigned long long res = 0, bit = 1ULL << 62;
+
+   while (bit > v)
+      bit >>= 2;
+   while (bit) {
+      if (v >= res + bit) {
+         v -= res + bit;
+         res = (res >> 1) + bit;
+      } else {
+         res >>= 1;
+      }
+      bit >>= 2;
+   }
+   return (unsigned long) res;
+}
+
+/*
+ * atan2 in 1/65536 turn, [0, GESTURE_TURN). Octant reduction followed by
+ * atan(z) ~ z*pi/4 + 0.273*z*(1-z), within 0.25 degrees.
+ */
+static inline long gesture_atan2(long y, long x)
+{
+   unsigned long ax = x < 0 ? -x : x, ay = y < 0 ? -y : y;
+   unsigned long lo, hi;
+   long z, a;
+
+   if (!ax && !ay)
+      return 0;
+
+   hi = ax > ay ? ax : ay;
+   lo = ax > ay ? ay : ax;
+   /* Keep (lo << 15) within 32 bits */
+   while (hi >= (1UL << 16)) {
+      hi >>= 1;
+      lo >>= 1;
+   }
+   z = (long) ((lo << 15) / hi);    /* Q15, 0..1 */
+   a = ((z * 8192) >> 15) + (long) ((2848LL * z * (32768 - z)) >> 30);
+
+   if (ay > ax)
+      a = GESTURE_TURN / 4 - a;
+   if (x < 0)
+      a = GESTURE_TURN / 2 - a;
+   if (y < 0)
+      a = GESTURE_TURN - a;
+   return a & (GESTURE_TURN - 1);
+}
+
+static inline long gesture_abs(long v)
+{
+   return v < 0 ? -v : v;
+}
+
+static inline void gesture_measure(struct gesture_state *g, long ax, long ay,
+      long bx, long by)
+{
+   long dx = bx - ax, dy = by - ay;
+
+   g->cx = (ax + bx) / 2;
+   g->cy = (ay + by) / 2;
+   g->dist = gesture_isqrt((unsigned long long) ((long long) dx * dx
+                                               + (long long) dy * dy));
+   g->angle = gesture_atan2(dy, dx);
+}
+
+/*
+ * Starts recognizing the pair of contacts a and b
+ */
+static inline void gesture_begin(struct gesture_state *g, long res,
+      long ax, long ay, long bx, long by)
+{
+   g->res = res;
+   g->mode = GESTURE_NONE;
+   g->pan_x = g->pan_y = g->scale = g->rotate = 0;
+   gesture_measure(g, ax, ay, bx, by);
+}
+
+/*
+ * How far past its enter threshold each mode's accumulated motion is,
+ * in 1/256 of the threshold
+ */
+static inline long gesture_weight(struct gesture_state *g, int mode)
+{
+   long pan;
+
+   switch (mode) {
+      case GESTURE_SCROLL:
+         pan = gesture_abs(g->pan_x) > gesture_abs(g->pan_y)
+             ? gesture_abs(g->pan_x) : gesture_abs(g->pan_y);
+         return (pan << 8) / (g->res / GESTURE_PAN_DIV + 1);
+      case GESTURE_PINCH:
+         return (gesture_abs(g->scale) << 8) / (g->res / GESTURE_PINCH_DIV + 1);
+      case GESTURE_ROTATE:
+         return (gesture_abs(g->rotate) << 8) / GESTURE_ROT_ENTER;
+   }
+   return 0;
+}
+
+/*
+ * Feeds the new positions of the pair. Fills 'out' with the locked mode and
+ * this frame's deltas; only the delta of the locked mode is non zero.
+ */
+static inline void gesture_update(struct gesture_state *g, long ax, long ay,
+      long bx, long by, struct gesture_out *out)
+{
+   long px = g->cx, py = g->cy, pd = g->dist, pa = g->angle;
+   long w, best = GESTURE_NONE, best_w = 0, need;
+   int m;
+
+   gesture_measure(g, ax, ay, bx, by);
+
+   out->pan_x = g->cx - px;
+   out->pan_y = g->cy - py;
+   out->scale = g->dist - pd;
+   /* Wrap into (-half turn, half turn] */
+   out->rotate = ((g->angle - pa + GESTURE_TURN / 2) & (GESTURE_TURN - 1))
+               - GESTURE_TURN / 2;
+
+   if (g->mode != GESTURE_NONE) {
+      g->pan_x -= g->pan_x >> GESTURE_LEAK;
+      g->pan_y -= g->pan_y >> GESTURE_LEAK;
+      g->scale -= g->scale >> GESTURE_LEAK;
+      g->rotate -= g->rotate >> GESTURE_LEAK;
+   }
+   g->pan_x += out->pan_x;
+   g->pan_y += out->pan_y;
+   g->scale += out->scale;
+   g->rotate += out->rotate;
+
+   /* Undecided modes need 1x their threshold, leaving a lock needs more */
+   need = g->mode == GESTURE_NONE ? 256 : 256 * GESTURE_SWITCH;
+   for (m = GESTURE_SCROLL; m <= GESTURE_ROTATE; m++) {
+      w = gesture_weight(g, m);
+      if (m != g->mode && w >= need && w > best_w) {
+         best = m;
+         best_w = w;
+      }
+   }
+
+   out->changed = 0;
+   if (best != GESTURE_NONE
+         && (g->mode == GESTURE_NONE || best_w > gesture_weight(g, g->mode))) {
+      g->mode = best;
+      g->pan_x = g->pan_y = g->scale = g->rotate = 0;
+      out->changed = 1;
+   }
+
+   out->mode = g->mode;
+   if (g->mode != GESTURE_SCROLL)
+      out->pan_x = out->pan_y = 0;
+   if (g->mode != GESTURE_PINCH)
+      out->scale = 0;
+   if (g->mode != GESTURE_ROTATE)
+      out->rotate = 0;
+}
+
+#endif
@@ -0,0 +1,371 @@
+#include <asm/uaccess.h>
+#include <asm-generic/fcntl.h>
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/time.h>
+
+#include "touchcore.h"
+
+#define DRIVER_NAME "touchmouse"
+#define DRIVER_DESC "TUIO Mouse Adapter"
+#define DRIVER_VER "0.1"
+
+MODULE_AUTHOR ("Ian Stewart, Pavan Trikutam, Henry Phan");
+MODULE_DESCRIPTION (DRIVER_DESC);
+MODULE_LICENSE ("GPL");
+MODULE_VERSION (DRIVER_VER);
+
+
+#define TOUCHMOUSE_TUIO_SOURCE "/dev/tuio"
+#define TOUCHMOUSE_COORD_RES 1000000 /* Units per 1.0 of TUIO coordinate */
+#define TOUCHMOUSE_SCROLL_HZ 60      /* Momentum scroll events per second */
+#define TOUCHMOUSE_X_MIN 0
+#define TOUCHMOUSE_Y_MIN 0
+#define MESSAGE_MAX_LENGTH 96
+
+//#define _VERBOSE
+
+
+static struct input_dev *touchmouse;
+
+static struct task_struct *thread;
+static struct pid *thread_pid;
+static wait_queue_head_t waitq;
+static DECLARE_COMPLETION (on_exit);
+
+static struct file *tuio;
+
+static struct touchcore core;
+
+static unsigned int coord_res = TOUCHMOUSE_COORD_RES;
+module_param (coord_res, uint, 0444);
+MODULE_PARM_DESC (coord_res, "Reported ABS units per 1.0 of TUIO coordinate");
+
+static unsigned int scroll_hz = TOUCHMOUSE_SCROLL_HZ;
+module_param (scroll_hz, uint, 0444);
+MODULE_PARM_DESC (scroll_hz, "Momentum scroll rate, normally the display refresh rate");
+
+static struct hrtimer scroll_timer;
+/* Guards core's scroll against scroll_timer, and params.calib against
+ * calib_store */
+static DEFINE_SPINLOCK (scroll_lock);
+
+/* All of these but single can be changed at runtime through sysfs */
+static struct touchcore_params params = TOUCHCORE_PARAMS_DEFAULT;
+
+module_param_named (single, params.single, bool, 0444);
+MODULE_PARM_DESC (single, "One finger touchscreen: tap clicks, moving drags");
+
+module_param_named (drag_delay_us, params.drag_delay_us, int, 0644);
+MODULE_PARM_DESC (drag_delay_us, "Hold time before a still touch presses (us)");
+
+module_param_named (move_delay_us, params.move_delay_us, int, 0644);
+MODULE_PARM_DESC (move_delay_us, "Motion ignored after touch down (us)");
+
+/*
+ * Calibration matrix, Q16 row major as printed by tuiocal. Parsed aside
+ * and stored whole under scroll_lock, for no frame to see half of it.
+ */
+static int calib_store (const char *val, struct kernel_param *kp)
+{
+   int m[CALIB_ENTRIES], count = 0;
+   unsigned long flags;
+   char *end;
+
+   while (*val && *val != '\n') {
+      if (count == CALIB_ENTRIES)
+         return -EINVAL;
+      m[count++] = simple_strtol (val, &end, 0);
+      if (end == val || (*end && *end != ',' && *end != '\n'))
+         return -EINVAL;
+      val = *end == ',' ? end + 1 : end;
+   }
+
+   spin_lock_irqsave (&scroll_lock, flags);
+   memcpy (params.calib, m, count * sizeof(m[0]));
+   params.calib_count = count;
+   spin_unlock_irqrestore (&scroll_lock, flags);
+   return 0;
+}
+
+static int calib_show (char *buffer, struct kernel_param *kp)
+{
+   int m[CALIB_ENTRIES], count, i, len = 0;
+   unsigned long flags;
+
+   spin_lock_irqsave (&scroll_lock, flags);
+   count = params.calib_count;
+   memcpy (m, params.calib, sizeof(m));
+   spin_unlock_irqrestore (&scroll_lock, flags);
+
+   for (i = 0; i < count; i++)
+      len += sprintf (buffer + len, i ? ",%d" : "%d", m[i]);
+   return len;
+}
+
+module_param_call (calib, calib_store, calib_show, NULL, 0644);
+MODULE_PARM_DESC (calib, "3x3 Q16 tracker to screen homography, 0 for none");
+
+module_param_named (filter_enable, params.filter_enable, bool, 0644);
+MODULE_PARM_DESC (filter_enable, "Filter contact jitter");
+
+module_param_named (filter_mincutoff, params.filter_mincutoff, int, 0644);
+MODULE_PARM_DESC (filter_mincutoff, "Filter cutoff at rest (mHz)");
+
+module_param_named (filter_beta, params.filter_beta, int, 0644);
+MODULE_PARM_DESC (filter_beta, "Filter cutoff added per screen/s of speed (mHz)");
+
+module_param_named (filter_dcutoff, params.filter_dcutoff, int, 0644);
+MODULE_PARM_DESC (filter_dcutoff, "Cutoff of the filter speed estimate (mHz)");
+
+module_param_named (filter_deadband, params.filter_deadband, int, 0644);
+MODULE_PARM_DESC (filter_deadband, "Motion ignored at rest (1/1000000 screen)");
+
+module_param_named (predict_enable, params.predict_enable, bool, 0644);
+MODULE_PARM_DESC (predict_enable, "Extrapolate reported positions ahead in time");
+
+module_param_named (predict_ms, params.predict_ms, int, 0644);
+MODULE_PARM_DESC (predict_ms, "Prediction look-ahead (ms)");
+
+module_param_named (predict_minspeed, params.predict_minspeed, int, 0644);
+MODULE_PARM_DESC (predict_minspeed, "No prediction below this speed (1/1000 screen/s)");
+
+module_param_named (predict_maxoffset, params.predict_maxoffset, int, 0644);
+MODULE_PARM_DESC (predict_maxoffset, "Largest prediction offset (1/1000000 screen)");
+
+
+/**
+ * Current time in micro seconds
+ */
+static unsigned long long touchmouse_now_us (void *ctx)
+{
+   struct timeval now;
+
+   do_gettimeofday(&now);
+   return (unsigned long long) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void touchmouse_event (void *ctx, unsigned int type, unsigned int code,
+      int value)
+{
+   input_event (touchmouse, type, code, value);
+}
+
+static void touchmouse_timer_start (void *ctx)
+{
+   hrtimer_start (&scroll_timer, ktime_set (0, NSEC_PER_SEC / scroll_hz),
+         HRTIMER_MODE_REL);
+}
+
+static void touchmouse_lock (void *ctx, unsigned long *flags)
+{
+   spin_lock_irqsave (&scroll_lock, *flags);
+}
+
+static void touchmouse_unlock (void *ctx, unsigned long flags)
+{
+   spin_unlock_irqrestore (&scroll_lock, flags);
+}
+
+static void touchmouse_log (void *ctx, const char *msg)
+{
+   printk (KERN_DEBUG "%s: %s\n", DRIVER_NAME, msg);
+}
+
+static const struct touchcore_ops touchmouse_ops = {
+   .now_us = touchmouse_now_us,
+   .event = touchmouse_event,
+   .timer_start = touchmouse_timer_start,
+   .lock = touchmouse_lock,
+   .unlock = touchmouse_unlock,
+   .log = touchmouse_log,
+};
+
+/**
+ * Emits momentum scrolling at display cadence until it decays
+ */
+static enum hrtimer_restart scroll_timer_fn (struct hrtimer *timer)
+{
+   if (!touchcore_tick (&core))
+      return HRTIMER_NORESTART;
+
+   hrtimer_forward_now (timer, ktime_set (0, NSEC_PER_SEC / scroll_hz));
+   return HRTIMER_RESTART;
+}
+
+static int
+touchmouse_thread (void *data)
+{
+  //unsigned long timeout;
+  int error;
+  char buffer[MESSAGE_MAX_LENGTH];
+  ssize_t bytes_read;
+  mm_segment_t old_fs;
+
+  daemonize ("touchmouse");
+  allow_signal (SIGTERM);
+  thread_pid = task_pid (current);
+
+  tuio = filp_open (TOUCHMOUSE_TUIO_SOURCE, O_RDONLY, 0);
+  if (IS_ERR(tuio))
+    {
+      printk (KERN_ERR "%s: unable to open %s\n", DRIVER_NAME, TOUCHMOUSE_TUIO_SOURCE);
+      error = -(PTR_ERR (tuio));
+      goto error_thread;
+    }
+
+  tuio->f_pos = 0;
+
+  while (1)
+    {
+      old_fs = get_fs ();
+      set_fs (KERNEL_DS);
+      bytes_read = tuio->f_op->read (tuio, buffer, sizeof (buffer) - 1, &tuio->f_pos);
+      set_fs (old_fs);
+
+      if (bytes_read <= 0) {
+         printk(KERN_ERR "%s: read error! Goodbye\n", DRIVER_NAME);
+         break;
+      }
+
+      buffer[bytes_read] = '\0';
+#ifdef _VERBOSE
+      printk (KERN_NOTICE "%s: %s", DRIVER_NAME, buffer);
+#endif
+      touchcore_dispatch (&core, buffer);
+
+      /* Timeout no longer needed; read will block. -istewart */
+      //timeout = HZ;
+      //timeout = wait_event_interruptible_timeout (waitq, (timeout == 0), timeout);
+      //if (timeout == -ERESTARTSYS)
+      //  break;
+    }
+
+  error = 0;
+  fput (tuio);
+error_thread:
+  thread_pid = NULL;
+  complete_and_exit (&on_exit, error);
+}
+
+static int __init
+touchmouse_init (void)
+{
+  const struct touchcore_cap *caps;
+  int error = -ENOMEM;
+  int i, count;
+
+  if (!scroll_hz || scroll_hz > 1000)
+    {
+      printk (KERN_ERR "%s: scroll_hz must be in 1..1000\n", DRIVER_NAME);
+      return -EINVAL;
+    }
+
+#ifdef REL_WHEEL_HI_RES
+  params.hires = 1;
+#endif
+  if (touchcore_init (&core, &touchmouse_ops, NULL, &params, coord_res,
+                      1000000 / scroll_hz))
+    {
+      printk (KERN_ERR "%s: coord_res must be in 1..%lu\n", DRIVER_NAME,
+              COORD_RES_MAX);
+      return -EINVAL;
+    }
+
+  hrtimer_init (&scroll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  scroll_timer.function = scroll_timer_fn;
+
+  touchmouse = input_allocate_device ();
+  if (!touchmouse)
+    goto error_touchmouse;
+
+  touchmouse->name       = "touchmouse";
+  touchmouse->phys       = "A/Fake/Path";
+  touchmouse->id.bustype = BUS_HOST;
+  touchmouse->id.vendor  = 0x0001;
+  touchmouse->id.product = 0x0001;
+  touchmouse->id.version = 0x0100;
+
+  touchmouse->absmin[ABS_X]  = TOUCHMOUSE_X_MIN;
+  touchmouse->absmax[ABS_X]  = coord_res - 1;
+  touchmouse->absfuzz[ABS_X] = 0;
+  touchmouse->absflat[ABS_X] = 0;
+
+  touchmouse->absmin[ABS_Y]  = TOUCHMOUSE_Y_MIN;
+  touchmouse->absmax[ABS_Y]  = coord_res - 1;
+  touchmouse->absfuzz[ABS_Y] = 0;
+  touchmouse->absflat[ABS_Y] = 0;
+
+  /* Everything the core may report */
+  count = touchcore_caps (&core, &caps);
+  for (i = 0; i < count; i++)
+    {
+      set_bit (caps[i].type, touchmouse->evbit);
+      if (caps[i].type == EV_KEY)
+        set_bit (caps[i].code, touchmouse->keybit);
+      else if (caps[i].type == EV_REL)
+        set_bit (caps[i].code, touchmouse->relbit);
+      else if (caps[i].type == EV_ABS)
+        set_bit (caps[i].code, touchmouse->absbit);
+    }
+
+  error = input_register_device (touchmouse);
+  if (error)
+    {
+      printk (KERN_ERR "%s: unable to register device\n", DRIVER_NAME);
+      goto free_touchmouse;
+    }
+
+  init_waitqueue_head (&waitq);
+
+  thread = kthread_run (touchmouse_thread, NULL, "touchmouse");
+  if (IS_ERR (thread))
+    {
+      printk (KERN_ERR "%s: unable to spawn poller thread\n", DRIVER_NAME);
+      error = -EIO;
+      goto unregister_touchmouse;
+    }
+
+  printk (KERN_NOTICE "%s: loaded\n", DRIVER_NAME);
+  return 0;
+
+unregister_touchmouse:
+  input_unregister_device (touchmouse);
+  goto error_touchmouse;
+
+free_touchmouse:
+  input_free_device (touchmouse);
+
+error_touchmouse:
+  return error;
+}
+
+static void __exit
+touchmouse_exit (void)
+{
+  if (thread_pid)
+    {
+      kill_pid (thread_pid, SIGTERM, 1);
+      wait_for_completion (&on_exit);
+    }
+
+  hrtimer_cancel (&scroll_timer);
+
+  input_unregister_device (touchmouse);
+  printk (KERN_NOTICE "%s: unloaded\n", DRIVER_NAME);
+}
+
+module_init (touchmouse_init);
+module_exit (touchmouse_exit);
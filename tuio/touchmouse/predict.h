@@ -0,0 +1,192 @@
+#ifndef __PREDICT_H__
+#define __PREDICT_H__
+
+/*
+ * Per contact motion prediction to hide pipeline latency.
+ *
+ * Velocity and acceleration of each contact are estimated from the frame
+ * timestamps and the position is extrapolated from the frame time to a
+ * target time (frame time plus a look-ahead):
+ *
+ *    x' = x + v h + a h^2 / 2
+ *
+ * Prediction switches itself off for a contact that is slow (below
+ * 'min_speed') or that just reversed direction, and only comes back after
+ * PREDICT_WARMUP frames of steady motion. The extrapolated offset is capped
+ * at 'max_offset' and never points against the direction of motion.
+ *
+ * Velocities are in coordinate units per ms (Q4), accelerations in units
+ * per ms per second (Q4). Estimating takes two 32 bit divides an axis,
+ * extrapolating one.
+ */
+
+#define PREDICT_MAX_CONTACTS 20
+#define PREDICT_MIN_DT_US 1000
+#define PREDICT_MAX_DT_US 100000    /* Longer gaps restart the estimate */
+#define PREDICT_MAX_STEP (1L << 17) /* Per frame motion is clamped to this */
+#define PREDICT_MAX_DV (1L << 17)   /* And the velocity change, units/ms (Q4) */
+#define PREDICT_WARMUP 2            /* Steady frames before predicting */
+
+struct predict_params {
+   long min_speed;   /* Slower contacts are not predicted, units/ms (Q4) */
+   long max_offset;  /* Largest extrapolation, coordinate units */
+   int accel;        /* Adds the a h^2 / 2 term, else velocity only */
+};
+
+struct predict_axis {
+   long x;           /* Last measured position */
+   long v;           /* Velocity, units/ms (Q4) */
+   long a;           /* Acceleration, units/ms per s (Q4) */
+};
+
+struct predict_contact {
+   unsigned long id;
+   unsigned long long last_us;
+   int seen;
+   int steady;       /* Frames of motion without a reversal */
+   struct predict_axis axis[2];
+};
+
+struct predict_state {
+   unsigned int count;
+   struct predict_contact contact[PREDICT_MAX_CONTACTS];
+};
+
+static inline void predict_init(struct predict_state *p)
+{
+   p->count = 0;
+}
+
+static inline long predict_abs(long v)
+{
+   return v < 0 ? -v : v;
+}
+
+static inline long predict_clamp(long v, long max)
+{
+   return v > max ? max : (v < -max ? -max : v);
+}
+
+/*
+ * Updates one axis with a new measurement taken dt_us after the previous
+ * one. Returns the new velocity.
+ */
+static inline long predict_measure(struct predict_axis *a, long x, long dt_us)
+{
+   long v;
+
+   v = predict_clamp(x - a->x, PREDICT_MAX_STEP) * 16000 / dt_us;
+   /* dv * 1000000 / dt_us, as 15625 * 64 to stay within 32 bits */
+   a->a = predict_clamp(v - a->v, PREDICT_MAX_DV) * 15625 / dt_us * 64;
+   a->v = v;
+   a->x = x;
+   return v;
+}
+
+/*
+ * Extrapolated offset of one axis h_us into the future
+ */
+static inline long predict_offset(struct predict_axis *a,
+      struct predict_params *p, long h_us)
+{
+   long h = h_us / 1000, d;
+
+   /* v h / 16 + a h^2 / 32000, the divide done as * 131 >> 22 */
+   d = (a->v * h) >> 4;
+   if (p->accel)
+      d += (long) (((long long) a->a * h * h * 131) >> 22);
+
+   /* Never extrapolate backwards or too far */
+   if ((d ^ a->v) < 0)
+      d = 0;
+   return predict_clamp(d, p->max_offset);
+}
+
+static inline void predict_begin(struct predict_state *p)
+{
+   unsigned int i;
+
+   for (i = 0; i < p->count; i++)
+      p->contact[i].seen = 0;
+}
+
+/*
+ * Feeds the position of contact 'id' measured at frame_us and replaces it
+ * with the prediction for target_us. The prediction is kept non negative;
+ * the caller clamps the upper end.
+ */
+static inline void predict_contact(struct predict_state *p,
+      struct predict_params *params, unsigned long id, unsigned long *x,
+      unsigned long *y, unsigned long long frame_us,
+      unsigned long long target_us)
+{
+   struct predict_contact *c = 0;
+   long pvx, pvy, vx, vy, dt, h, speed;
+   unsigned int i;
+
+   for (i = 0; i < p->count; i++) {
+      if (p->contact[i].id == id) {
+         c = &p->contact[i];
+         break;
+      }
+   }
+
+   if (!c || frame_us - c->last_us >= PREDICT_MAX_DT_US) {
+      if (!c) {
+         if (p->count >= PREDICT_MAX_CONTACTS)
+            return;
+         c = &p->contact[p->count++];
+      }
+      c->id = id;
+      c->last_us = frame_us;
+      c->seen = 1;
+      c->steady = 0;
+      c->axis[0].x = *x;
+      c->axis[1].x = *y;
+      c->axis[0].v = c->axis[1].v = c->axis[0].a = c->axis[1].a = 0;
+      return;
+   }
+
+   dt = (long) (frame_us - c->last_us);
+   dt = dt < PREDICT_MIN_DT_US ? PREDICT_MIN_DT_US : dt;
+   c->last_us = frame_us;
+   c->seen = 1;
+
+   pvx = c->axis[0].v;
+   pvy = c->axis[1].v;
+   vx = predict_measure(&c->axis[0], *x, dt);
+   vy = predict_measure(&c->axis[1], *y, dt);
+
+   /* Off while slow or right after the direction reversed */
+   speed = predict_abs(vx) > predict_abs(vy) ? predict_abs(vx)
+                                             : predict_abs(vy);
+   if (speed < params->min_speed
+         || (long long) vx * pvx + (long long) vy * pvy < 0) {
+      c->steady = 0;
+      return;
+   }
+   if (c->steady < PREDICT_WARMUP) {
+      c->steady++;
+      return;
+   }
+
+   h = target_us > frame_us ? (long) (target_us - frame_us) : 0;
+   vx = (long) *x + predict_offset(&c->axis[0], params, h);
+   vy = (long) *y + predict_offset(&c->axis[1], params, h);
+   *x = vx < 0 ? 0 : vx;
+   *y = vy < 0 ? 0 : vy;
+}
+
+static inline void predict_end(struct predict_state *p)
+{
+   unsigned int i = 0;
+
+   while (i < p->count) {
+      if (p->contact[i].seen)
+         i++;
+      else
+         p->contact[i] = p->contact[--p->count];
+   }
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef __SCROLL_H__
+#define __SCROLL_H__
+
+/*
+ * Two finger scroll engine with kinetic momentum.
+ *
+ * While two contacts are down their centroid is fed to scroll_update, which
+ * converts the motion into hi-res wheel units (120 per detent) and tracks a
+ * smoothed velocity. On release scroll_release hands over to momentum and
+ * scroll_tick is called from a timer at display cadence, emitting the
+ * decaying velocity until it falls below SCROLL_MIN_VEL.
+ *
+ * Events are rate limited: during contact at most one event per
+ * SCROLL_MIN_INTERVAL_US, each clamped to SCROLL_MAX_HIRES. Motion that is
+ * held back is accumulated up to SCROLL_MAX_PENDING, two such events, and
+ * anything beyond that is discarded, so a fast flick never leaves the
+ * page scrolling on behind the fingers.
+ *
+ * Like coord.h this has no kernel dependencies; 64 bit values are only
+ * multiplied and shifted, never divided.
+ */
+
+#define SCROLL_HIRES_DETENT 120     /* Hi-res units per wheel detent */
+#define SCROLL_DETENTS 20           /* Detents per full screen of motion */
+#define SCROLL_MIN_INTERVAL_US 8000 /* Minimum time between scroll events */
+#define SCROLL_MAX_HIRES 960        /* Largest single event (8 detents) */
+#define SCROLL_MAX_PENDING 1920     /* Held back at most (2 events) */
+#define SCROLL_MAX_DT_US 100000     /* Longer gaps reset the velocity */
+#define SCROLL_DECAY_Q8 243         /* Momentum kept per tick (0.95) */
+#define SCROLL_MAX_VEL 10240        /* Velocity cap, 40 units/ms (Q8) */
+#define SCROLL_MIN_FLING 512        /* Momentum needs 2 units/ms (Q8) */
+#define SCROLL_MIN_VEL 32           /* Momentum stops below 1/8 unit/ms (Q8) */
+
+struct scroll_out {
+   int wheel;        /* REL_WHEEL detents */
+   int hwheel;       /* REL_HWHEEL detents */
+   int wheel_hi;     /* REL_WHEEL_HI_RES units */
+   int hwheel_hi;    /* REL_HWHEEL_HI_RES units */
+};
+
+struct scroll_state {
+   long res;                     /* Coordinate units per screen */
+   long cx, cy;                  /* Last centroid */
+   unsigned long long last_us;   /* Time of the last centroid */
+   unsigned long long last_scroll; /* Time of the last emitted event */
+   long acc_x, acc_y;            /* Hi-res units not emitted yet, clamped */
+   long rem_x, rem_y;            /* Hi-res units short of a full detent */
+   long vx, vy;                  /* Velocity, hi-res units per ms (Q8) */
+   long tick_q16;                /* Timer period in ms (Q16, /1000) */
+   int momentum;                 /* Non zero while coasting */
+};
+
+static inline long scroll_abs(long v)
+{
+   return v < 0 ? -v : v;
+}
+
+static inline long scroll_clamp(long v, long max)
+{
+   return v > max ? max : (v < -max ? -max : v);
+}
+
+/*
+ * Resets the engine for a screen of 'res' units and a momentum timer
+ * running every tick_us microseconds.
+ */
+static inline void scroll_init(struct scroll_state *s, long res, long tick_us)
+{
+   __builtin_memset(s, 0, sizeof(*s));
+   s->res = res;
+   /* tick_us * 2^16 / 256000: ms per tick scaled to cancel the Q8 */
+   s->tick_q16 = (tick_us << 8) / 1000;
+}
+
+/*
+ * Records the centroid where the pair of contacts started scrolling
+ */
+static inline void scroll_begin(struct scroll_state *s, long cx, long cy,
+      unsigned long long now)
+{
+   s->cx = cx;
+   s->cy = cy;
+   s->last_us = s->last_scroll = now;
+   s->acc_x = s->acc_y = s->rem_x = s->rem_y = 0;
+   s->vx = s->vy = 0;
+   s->momentum = 0;
+}
+
+/*
+ * Moves the pending hi-res units into 'out', keeping the remainder of
+ * partial detents. Returns non zero if there is anything to report.
+ */
+static inline int scroll_flush(struct scroll_state *s, struct scroll_out *out)
+{
+   long x = scroll_clamp(s->acc_x, SCROLL_MAX_HIRES);
+   long y = scroll_clamp(s->acc_y, SCROLL_MAX_HIRES);
+
+   s->acc_x -= x;
+   s->acc_y -= y;
+
+   /* Content follows the fingers: down is wheel up, right is hwheel left */
+   out->wheel_hi = y;
+   out->hwheel_hi = -x;
+
+   s->rem_x += x;
+   s->rem_y += y;
+   out->wheel = s->rem_y / SCROLL_HIRES_DETENT;
+   out->hwheel = -(s->rem_x / SCROLL_HIRES_DETENT);
+   s->rem_x -= -out->hwheel * SCROLL_HIRES_DETENT;
+   s->rem_y -= out->wheel * SCROLL_HIRES_DETENT;
+
+   return x || y;
+}
+
+/*
+ * Feeds a new centroid while both contacts are down.
+ * Returns non zero and fills 'out' when an event is due.
+ */
+static inline int scroll_update(struct scroll_state *s, long cx, long cy,
+      unsigned long long now, struct scroll_out *out)
+{
+   long dx, dy, dt, half = s->res / 2;
+   long units = SCROLL_DETENTS * SCROLL_HIRES_DETENT;
+
+   /* Clamped to half a screen per frame so the products fit in 32 bits */
+   dx = scroll_clamp(cx - s->cx, half) * units / s->res;
+   dy = scroll_clamp(cy - s->cy, half) * units / s->res;
+
+   /* Only consume the coordinate distance that produced whole units */
+   s->cx += dx * s->res / units;
+   s->cy += dy * s->res / units;
+
+   /* Held back motion past SCROLL_MAX_PENDING is dropped */
+   s->acc_x = scroll_clamp(s->acc_x + dx, SCROLL_MAX_PENDING);
+   s->acc_y = scroll_clamp(s->acc_y + dy, SCROLL_MAX_PENDING);
+
+   /* Exponential average of the instantaneous velocity */
+   if (now - s->last_us >= SCROLL_MAX_DT_US) {
+      s->vx = s->vy = 0;
+   } else if (now > s->last_us) {
+      dt = (long) (now - s->last_us);
+      s->vx = scroll_clamp((3 * s->vx + dx * 256000 / dt) / 4, SCROLL_MAX_VEL);
+      s->vy = scroll_clamp((3 * s->vy + dy * 256000 / dt) / 4, SCROLL_MAX_VEL);
+   }
+   s->last_us = now;
+
+   if (now - s->last_scroll < SCROLL_MIN_INTERVAL_US)
+      return 0;
+
+   s->last_scroll = now;
+   return scroll_flush(s, out);
+}
+
+/*
+ * Contacts lifted. Returns non zero if momentum should be driven by
+ * scroll_tick; any held back motion is flushed into 'out' first.
+ */
+static inline int scroll_release(struct scroll_state *s,
+      unsigned long long now, struct scroll_out *out)
+{
+   /* A pause before lifting means the user stopped on purpose */
+   if (now - s->last_us >= SCROLL_MAX_DT_US)
+      s->vx = s->vy = 0;
+
+   scroll_flush(s, out);
+   s->momentum = scroll_abs(s->vx) >= SCROLL_MIN_FLING
+              || scroll_abs(s->vy) >= SCROLL_MIN_FLING;
+   return s->momentum;
+}
+
+/*
+ * One momentum timer tick. Fills 'out' (possibly with zeros) and returns
+ * non zero while the timer should keep running.
+ */
+static inline int scroll_tick(struct scroll_state *s, struct scroll_out *out)
+{
+   if (!s->momentum)
+      return 0;
+
+   s->acc_x = scroll_clamp(s->acc_x
+            + (long) (((long long) s->vx * s->tick_q16) >> 16),
+            SCROLL_MAX_PENDING);
+   s->acc_y = scroll_clamp(s->acc_y
+            + (long) (((long long) s->vy * s->tick_q16) >> 16),
+            SCROLL_MAX_PENDING);
+   scroll_flush(s, out);
+
+   s->vx = s->vx * SCROLL_DECAY_Q8 / 256;
+   s->vy = s->vy * SCROLL_DECAY_Q8 / 256;
+
+   s->momentum = scroll_abs(s->vx) >= SCROLL_MIN_VEL
+              || scroll_abs(s->vy) >= SCROLL_MIN_VEL;
+   return s->momentum;
+}
+
+/*
+ * Cancels any momentum, ex: on a new touch
+ */
+static inline void scroll_stop(struct scroll_state *s)
+{
+   s->momentum = 0;
+   s->acc_x = s->acc_y = 0;
+   s->vx = s->vy = 0;
+}
+
+#endif
@@ -4,8 +4,10 @@
 
 #define MOVE_DELAY_US 1000 // 1ms
 #define DRAG_DELAY_US 250000 // 250 ms
-#define JITTER_THRESHOLD 0
+#define JITTER_THRESHOLD 0 /* Jitter is filtered per contact, see filter.h */
+#ifndef MAX_ALIVE_BLOBS /* Test/microbench builds the core with more */
 #define MAX_ALIVE_BLOBS 20
+#endif
 
 /**
  * Current state of a blob
@@ -46,7 +48,4 @@ struct state_diff {
 };
 
 
-static int compare_state(struct state_diff *diff, struct screen_state *s1,
-      struct screen_state *s2);
-
 #endif
@@ -0,0 +1,1000 @@
+/*
+ * TUIO to mouse state machine, see touchcore.h
+ */
+#include "touchcore.h"
+
+#define MESSAGE_PROFILE "/tuio/2Dcur"
+#define MESSAGE_ALIVE "alive"
+#define MESSAGE_SET  "set"
+#define MESSAGE_FSEQ "fseq"
+#define MESSAGE_LOST "lost"
+#define MESSAGE_DELTA "delta"
+#define MESSAGE_GONE "gone"
+#define MESSAGE_SOURCE "source"
+#define MESSAGE_TIME "time"
+#define MESSAGE_TYPE_OFFSET 12
+
+//#define _DEBUG
+
+#ifdef _DEBUG
+#define debug(c, msg) do { if ((c)->ops->log) (c)->ops->log((c)->ctx, msg); } while (0)
+#else
+#define debug(c, msg) do { } while (0)
+#endif
+
+static const struct touchcore_cap caps_mouse[] = {
+   { TC_EV_ABS, TC_ABS_X },
+   { TC_EV_ABS, TC_ABS_Y },
+   { TC_EV_KEY, TC_BTN_LEFT },
+   { TC_EV_KEY, TC_BTN_RIGHT },
+   { TC_EV_KEY, TC_KEY_LEFTCTRL },
+   { TC_EV_REL, TC_REL_WHEEL },
+   { TC_EV_REL, TC_REL_HWHEEL },
+   { TC_EV_REL, TC_REL_DIAL },
+   { TC_EV_REL, TC_REL_WHEEL_HI_RES },
+   { TC_EV_REL, TC_REL_HWHEEL_HI_RES },
+};
+#define CAPS_MOUSE_LORES 8    /* Entries without the hi-res wheels */
+
+static const struct touchcore_cap caps_single[] = {
+   { TC_EV_ABS, TC_ABS_X },
+   { TC_EV_ABS, TC_ABS_Y },
+   { TC_EV_KEY, TC_BTN_TOUCH },
+};
+
+
+/* Freestanding stand-ins for the few libc helpers needed */
+static inline long tc_abs (long v)
+{
+   return v < 0 ? -v : v;
+}
+
+static inline int tc_prefix (const char *str, const char *prefix)
+{
+   while (*prefix)
+      if (*str++ != *prefix++)
+         return 0;
+   return 1;
+}
+
+static inline unsigned long tc_strtoul (const char **str)
+{
+   unsigned long v = 0;
+
+   while (**str >= '0' && **str <= '9')
+      v = v * 10 + *(*str)++ - '0';
+   return v;
+}
+
+static inline void report (struct touchcore *c, unsigned int type,
+      unsigned int code, int value)
+{
+   c->ops->event (c->ctx, type, code, value);
+}
+
+static inline void report_abs (struct touchcore *c, struct blob_state *blob)
+{
+   report (c, TC_EV_ABS, TC_ABS_X, blob->x);
+   report (c, TC_EV_ABS, TC_ABS_Y, blob->y);
+}
+
+static inline void report_sync (struct touchcore *c)
+{
+   report (c, TC_EV_SYN, TC_SYN_REPORT, 0);
+}
+
+static inline void scroll_lock (struct touchcore *c, unsigned long *flags)
+{
+   if (c->ops->lock)
+      c->ops->lock (c->ctx, flags);
+}
+
+static inline void scroll_unlock (struct touchcore *c, unsigned long flags)
+{
+   if (c->ops->unlock)
+      c->ops->unlock (c->ctx, flags);
+}
+
+
+/**
+ * Compares two screen_state objects and returns a new state_diff
+ * Returns 0 on no change
+ */
+static int compare_state(struct state_diff *diff, struct screen_state *s1,
+      struct screen_state *s2)
+{
+   int i,k,retval = 0;
+   short found_match = 0;
+
+   /* Compare a blob in the first state with everything in the new state.
+    * If a match is found possibly add to moved_blobs.
+    * If not found add to dead_blobs.
+    */
+   for ( i = 0; i < s1->count; i++ ) {
+      // compare to each blob in the second
+      found_match = 0;
+      for ( k = 0; k < s2->count; k++ ) {
+
+         if( s1->alive[i].id == s2->alive[k].id ) {
+            found_match = 1;
+            // check for change
+            if ( tc_abs(s1->alive[i].x - s2->alive[k].x) > JITTER_THRESHOLD ||
+                 tc_abs(s1->alive[i].y - s2->alive[k].y) > JITTER_THRESHOLD ) {
+               // Moved blob difference
+               diff->moved_blobs[diff->move_count++] = &(s2->alive[k]);
+               diff->prev_blobs[diff->move_count-1] = &(s1->alive[i]);
+               retval = 1;
+            }
+            break;
+         }
+
+      }
+      // Dead blob difference
+      if (!found_match) {
+         diff->dead_blobs[diff->dead_count++] = &(s1->alive[i]);
+         retval = 1;
+      }
+   }
+
+   /* Compare a blob from the new state with all the old blobs.
+    * If a match is not found, add to the new_blobs */
+   for ( k = 0; k < s2->count; k++ ) {
+
+      found_match = 0;
+      for ( i = 0; i < s1->count; i++ ) {
+         if ( s2->alive[k].id == s1->alive[i].id ) {
+            found_match = 1;
+            break;
+         }
+      }
+
+      // New blob difference
+      if (!found_match) {
+         diff->new_blobs[diff->new_count++] = &(s2->alive[k]);
+         retval = 1;
+      }
+   }
+   return retval;
+}
+
+static inline int find_id(int count, struct blob_state **blobs, unsigned long id)
+{
+   int i;
+   for ( i = 0; i < count; i++ ) {
+      if ( blobs[i]->id == id ) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+static inline struct blob_state* find_cur_blob(struct touchcore *c,
+      unsigned long target_id)
+{
+   int i;
+   for (i = 0; i < c->cur_state.count; i++) {
+      if ( c->cur_state.alive[i].id == target_id ) {
+         return &(c->cur_state.alive[i]);
+      }
+   }
+   return 0;
+}
+
+/**
+ * Centroid of the two tracked blobs. Returns 0 if either is gone.
+ */
+static int pair_centroid (struct touchcore *c, long *cx, long *cy)
+{
+   struct blob_state *a = find_cur_blob(c, c->mouse_id);
+   struct blob_state *b = find_cur_blob(c, c->mouse2_id);
+
+   if (!a || !b)
+      return 0;
+
+   *cx = (a->x + b->x) / 2;
+   *cy = (a->y + b->y) / 2;
+   return 1;
+}
+
+/**
+ * Feeds the two tracked blobs to the gesture recognizer.
+ * Returns 0 if either is gone.
+ */
+static int pair_update (struct touchcore *c, struct gesture_out *out)
+{
+   struct blob_state *a = find_cur_blob(c, c->mouse_id);
+   struct blob_state *b = find_cur_blob(c, c->mouse2_id);
+
+   if (!a || !b)
+      return 0;
+
+   gesture_update (&c->gesture, a->x, a->y, b->x, b->y, out);
+   return 1;
+}
+
+/**
+ * Reports pending wheel motion. Called with the scroll lock held.
+ */
+static void report_scroll (struct touchcore *c, struct scroll_out *out)
+{
+   if (!out->wheel_hi && !out->hwheel_hi)
+      return;
+
+   if (c->params->hires) {
+      report (c, TC_EV_REL, TC_REL_WHEEL_HI_RES, out->wheel_hi);
+      report (c, TC_EV_REL, TC_REL_HWHEEL_HI_RES, out->hwheel_hi);
+   }
+   report (c, TC_EV_REL, TC_REL_WHEEL, out->wheel);
+   report (c, TC_EV_REL, TC_REL_HWHEEL, out->hwheel);
+   report_sync (c);
+}
+
+static void stop_scroll (struct touchcore *c)
+{
+   unsigned long flags;
+
+   scroll_lock (c, &flags);
+   scroll_stop (&c->scroll);
+   scroll_unlock (c, flags);
+}
+
+int touchcore_tick (struct touchcore *c)
+{
+   struct scroll_out out = { 0, 0, 0, 0 };
+   unsigned long flags;
+   int more;
+
+   /* The last tick still carries the step that ends the momentum */
+   scroll_lock (c, &flags);
+   more = scroll_tick (&c->scroll, &out);
+   report_scroll (c, &out);
+   scroll_unlock (c, flags);
+   return more;
+}
+
+/**
+ * Reports a pinch as Ctrl+wheel, one step per 1/TOUCHCORE_PINCH_DETENTS
+ * screen of spread. Ctrl is held for the whole pinch.
+ */
+static void report_pinch (struct touchcore *c, long scale)
+{
+   long step = c->res / TOUCHCORE_PINCH_DETENTS + 1;
+   long n;
+
+   c->pinch_acc += scale;
+   n = c->pinch_acc / step;
+   if (!n)
+      return;
+   c->pinch_acc -= n * step;
+
+   if (c->params->hires)
+      report (c, TC_EV_REL, TC_REL_WHEEL_HI_RES, n * SCROLL_HIRES_DETENT);
+   report (c, TC_EV_REL, TC_REL_WHEEL, n);
+   report_sync (c);
+}
+
+/**
+ * Reports a rotation on REL_DIAL in degrees, counter clockwise positive
+ */
+static void report_rotate (struct touchcore *c, long rotate)
+{
+   long n;
+
+   c->rotate_acc += rotate;
+   n = c->rotate_acc / TOUCHCORE_ROTATE_STEP;
+   if (!n)
+      return;
+   c->rotate_acc -= n * TOUCHCORE_ROTATE_STEP;
+
+   report (c, TC_EV_REL, TC_REL_DIAL, -n);
+   report_sync (c);
+}
+
+/**
+ * Leaves the current two blob gesture and enters the one recognized
+ */
+static void enter_gesture (struct touchcore *c, int mode,
+      unsigned long long now)
+{
+   unsigned long flags;
+   long cx, cy;
+
+   if (c->mouse_state == 5) {
+      stop_scroll (c);
+   } else if (c->mouse_state == 6) {
+      report (c, TC_EV_KEY, TC_KEY_LEFTCTRL, 0);
+      report_sync (c);
+   }
+   c->pinch_acc = c->rotate_acc = 0;
+
+   switch (mode) {
+      case GESTURE_SCROLL:
+         debug(c, "BEGIN_SCROLL");
+         if (pair_centroid (c, &cx, &cy)) {
+            scroll_lock (c, &flags);
+            scroll_begin (&c->scroll, cx, cy, now);
+            scroll_unlock (c, flags);
+         }
+         c->mouse_state = 5;
+         break;
+      case GESTURE_PINCH:
+         debug(c, "BEGIN_PINCH");
+         report (c, TC_EV_KEY, TC_KEY_LEFTCTRL, 1);
+         report_sync (c);
+         c->mouse_state = 6;
+         break;
+      case GESTURE_ROTATE:
+         debug(c, "BEGIN_ROTATE");
+         c->mouse_state = 7;
+         break;
+   }
+}
+
+/**
+ * One finger mode: a tap clicks, moving the finger drags (BTN_TOUCH)
+ *
+ * 0  :  Initial state: no blobs.
+ * 1  :  New blob. Track ID.
+ * 2  :  Currently tracked id moved.
+ *
+ * Transistions:
+ * 0->1  touch down
+ * 1->0  touch up
+ * 1->2  touch move
+ * 2->0  touch up
+ * 2->2  touch move
+ */
+static void handle_single (struct touchcore *c, struct state_diff *diff)
+{
+   int i;
+
+   switch ( c->mouse_state )
+   {
+      case 0:
+         // no tracked blobs. look for new
+         if ( diff->new_count > 0 ) {
+            c->mouse_id = diff->new_blobs[0]->id;
+
+            // move the cursor
+            report_abs (c, diff->new_blobs[0]);
+            report_sync (c);
+
+            // transition to state 1
+            c->mouse_state = 1;
+         }
+         break;
+      case 1:
+         // click on up
+         i = find_id(diff->dead_count, diff->dead_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Fire CLICK
+            report_abs (c, diff->dead_blobs[i]);
+            report (c, TC_EV_KEY, TC_BTN_TOUCH, 1);
+            report_sync (c);
+            report (c, TC_EV_KEY, TC_BTN_TOUCH, 0);
+            report_sync (c);
+
+            c->mouse_state = 0;
+            break;
+         }
+
+         // start drag on move
+         i = find_id(diff->move_count, diff->moved_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Begin Drag
+            report_abs (c, diff->prev_blobs[i]);
+            report (c, TC_EV_KEY, TC_BTN_TOUCH, 1);
+            report_sync (c);
+            report_abs (c, diff->moved_blobs[i]);
+            report_sync (c);
+
+            c->mouse_state = 2;
+            break;
+         }
+         break;
+      case 2:
+         // End drag on up
+         i = find_id(diff->dead_count, diff->dead_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // End drag
+            report_abs (c, diff->dead_blobs[i]);
+            report (c, TC_EV_KEY, TC_BTN_TOUCH, 0);
+            report_sync (c);
+            c->mouse_state = 0;
+            break;
+         }
+
+         i = find_id(diff->move_count, diff->moved_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Move
+            report_abs (c, diff->moved_blobs[i]);
+            report_sync (c);
+            c->mouse_state = 2;
+            break;
+         }
+         break;
+      default:
+         // ERROR
+         break;
+   }
+}
+
+/**
+ * Compare the previous and current state and fires any necessary events
+ */
+static void handle_state (struct touchcore *c)
+{
+   struct state_diff diff;
+   long i, j, target_id, cx, cy;
+   struct blob_state* blob;
+   struct scroll_out out;
+   struct gesture_out gout;
+   int state_change = 0;
+   unsigned long long now, delay;
+   unsigned long flags;
+
+
+   __builtin_memset(&diff, 0, sizeof(diff));
+
+   state_change = compare_state(&diff, &c->pre_state, &c->cur_state);
+
+   if (c->single) {
+      handle_single (c, &diff);
+      return;
+   }
+
+   /* Set timer experiation */
+   now = c->ops->now_us (c->ctx);
+   if (!c->drag_timer || !c->move_timer) {
+      delay = now - c->timestart;
+
+      if (delay > (unsigned long long) c->params->drag_delay_us)
+         c->drag_timer = 1;
+      if (delay > (unsigned long long) c->params->move_delay_us)
+         c->move_timer = 1;
+   }
+
+   /*
+    * States of the mouse
+    *
+    * 0  :  Initial state: no blobs.
+    * 1  :  New blob. Track ID.
+    * 2  :  Dragging the tracked blob.
+    * 3  :  Hovering, tracked blob moved before the drag delay.
+    * 4  :  Second blob found. Track ID.
+    * 5  :  Scrolling with both blobs.
+    * 6  :  Pinching both blobs (Ctrl+wheel).
+    * 7  :  Rotating both blobs (REL_DIAL).
+    *
+    * Transistions:
+    * 0->1  touch down
+    * 1->0  touch up (left click)
+    * 1->2  drag delay expired
+    * 1->3  touch move
+    * 1->4  second touch down
+    * 2->0  touch up (end drag)
+    * 3->0  touch up
+    * 4->0  either touch up (right click)
+    * 4->5,6,7  gesture recognized, and between 5,6,7 on a gesture switch
+    * 5,6,7->0  either touch up
+    */
+   switch ( c->mouse_state )
+   {
+      case 0:
+         /* No tracked blobs */
+         if (!state_change)
+            break;
+         // Arbitrarily picks a blob if more than one
+         if ( diff.new_count > 0 ) {
+            c->mouse_id = diff.new_blobs[0]->id;
+
+            // a new touch stops any momentum scrolling
+            stop_scroll (c);
+
+            // move the cursor
+            report_abs (c, diff.new_blobs[0]);
+            report_sync (c);
+
+            // Start the timer
+            c->timestart = now;
+            c->drag_timer = 0;
+            c->move_timer = 0;
+
+            // transition to state 1
+            c->mouse_state = 1;
+         }
+         break;
+      case 1:
+         /* One blob found */
+         // click on up
+         i = find_id(diff.dead_count, diff.dead_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Fire CLICK
+            debug(c, "CLICK");
+            report_abs (c, diff.dead_blobs[i]);
+            report (c, TC_EV_KEY, TC_BTN_LEFT, 1);
+            report_sync (c);
+            report (c, TC_EV_KEY, TC_BTN_LEFT, 0);
+            report_sync (c);
+
+            c->mouse_state = 0;
+            break;
+         }
+
+         // Hover the mouse, moved before timer expired
+         i = find_id(diff.move_count, diff.moved_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // moving mouse
+            debug(c, "MOUSE_MOVE");
+            report_abs (c, diff.moved_blobs[i]);
+            report_sync (c);
+
+            // delay transition for better click response
+            if (c->move_timer)
+               c->mouse_state = 3;
+            break;
+         }
+
+         // Look for a new blob to begin right click/scroll
+         // Arbitrarily picks a blob if more than one
+         if ( diff.new_count > 0 ) {
+            c->mouse2_id = diff.new_blobs[0]->id;
+
+            // Start measuring the pair for scroll/pinch/rotate
+            blob = find_cur_blob(c, c->mouse_id);
+            if (blob)
+               gesture_begin (&c->gesture, c->res, blob->x, blob->y,
+                     diff.new_blobs[0]->x, diff.new_blobs[0]->y);
+
+            // transition to state 4
+            c->mouse_state = 4;
+            break;
+         }
+
+         // If the timer expired start a drag
+         if (c->drag_timer) {
+            // look for the current blob
+            if ((blob = find_cur_blob(c, c->mouse_id))) {
+               // Begin Drag
+               debug(c, "BEGIN_DRAG");
+               report_abs (c, blob);
+               report (c, TC_EV_KEY, TC_BTN_LEFT, 1);
+               report_sync (c);
+               c->mouse_state = 2;
+               break;
+            }
+         }
+         break;
+      case 2:
+         /* currently dragging */
+         if (!state_change)
+            break;
+         // End drag on up
+         i = find_id(diff.dead_count, diff.dead_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // End drag
+            debug(c, "END_DRAG");
+            report_abs (c, diff.dead_blobs[i]);
+            report (c, TC_EV_KEY, TC_BTN_LEFT, 0);
+            report_sync (c);
+            c->mouse_state = 0;
+            break;
+         }
+
+         i = find_id(diff.move_count, diff.moved_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Move
+            debug(c, "MOUSE_DRAG");
+            report_abs (c, diff.moved_blobs[i]);
+            report_sync (c);
+            c->mouse_state = 2;
+            break;
+         }
+         break;
+      case 3:
+         /* Mouse hover/move */
+         if (!state_change)
+            break;
+         // Do nothing on death
+         i = find_id(diff.dead_count, diff.dead_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            c->mouse_state = 0;
+            break;
+         }
+
+         i = find_id(diff.move_count, diff.moved_blobs, c->mouse_id);
+         if ( i >= 0 ) {
+            // Move
+            debug(c, "MOUSE_MOVE");
+            report_abs (c, diff.moved_blobs[i]);
+            report_sync (c);
+            c->mouse_state = 3;
+         }
+
+         break;
+      case 4:
+         /* Second blob found */
+         if (!state_change)
+            break;
+         // Right click on touch up
+
+         blob = 0;
+         target_id = -1;
+
+
+         i = find_id(diff.dead_count, diff.dead_blobs, c->mouse_id);
+         j = find_id(diff.dead_count, diff.dead_blobs, c->mouse2_id);
+         if ( j >= 0 ) {
+            // Right click on the other mouse
+            target_id = c->mouse_id;
+         } else if ( i >= 0 ) {
+            target_id = c->mouse2_id;
+         }
+
+         // One of the blobs has died, right click on remaining
+         if ( target_id > 0 ) {
+            // find the blob_state of where to click
+            blob = find_cur_blob(c, target_id);
+
+            // Both lifted in the same frame, click where the first was
+            if (!blob)
+               blob = diff.dead_blobs[i >= 0 ? i : j];
+
+            debug(c, "RIGHT_CLICK");
+            report_abs (c, blob);
+            report (c, TC_EV_KEY, TC_BTN_RIGHT, 1);
+            report_sync (c);
+            report (c, TC_EV_KEY, TC_BTN_RIGHT, 0);
+            report_sync (c);
+
+            c->mouse_state = 0;
+            break;
+         }
+
+         // Moving the pair begins a scroll, pinch or rotate
+         if ( find_id(diff.move_count, diff.moved_blobs, c->mouse_id) < 0 &&
+              find_id(diff.move_count, diff.moved_blobs, c->mouse2_id) < 0 )
+            break;
+
+         if ( pair_update (c, &gout) && gout.mode != GESTURE_NONE )
+            enter_gesture (c, gout.mode, now);
+         break;
+      case 5:
+         /* Scrolling */
+         if (!state_change)
+            break;
+
+         // Lifting either blob ends the scroll, coasting if flung
+         if ( find_id(diff.dead_count, diff.dead_blobs, c->mouse_id) >= 0 ||
+              find_id(diff.dead_count, diff.dead_blobs, c->mouse2_id) >= 0 ) {
+            debug(c, "END_SCROLL");
+            scroll_lock (c, &flags);
+            i = scroll_release (&c->scroll, now, &out);
+            report_scroll (c, &out);
+            scroll_unlock (c, flags);
+
+            if (i)
+               c->ops->timer_start (c->ctx);
+            c->mouse_state = 0;
+            break;
+         }
+
+         if ( !pair_update (c, &gout) )
+            break;
+         if ( gout.changed ) {
+            enter_gesture (c, gout.mode, now);
+            break;
+         }
+
+         if ( pair_centroid (c, &cx, &cy) ) {
+            scroll_lock (c, &flags);
+            if (scroll_update (&c->scroll, cx, cy, now, &out))
+               report_scroll (c, &out);
+            scroll_unlock (c, flags);
+         }
+         break;
+      case 6:
+         /* Pinching */
+         if (!state_change)
+            break;
+
+         if ( find_id(diff.dead_count, diff.dead_blobs, c->mouse_id) >= 0 ||
+              find_id(diff.dead_count, diff.dead_blobs, c->mouse2_id) >= 0 ) {
+            debug(c, "END_PINCH");
+            report (c, TC_EV_KEY, TC_KEY_LEFTCTRL, 0);
+            report_sync (c);
+            c->mouse_state = 0;
+            break;
+         }
+
+         if ( !pair_update (c, &gout) )
+            break;
+         if ( gout.changed )
+            enter_gesture (c, gout.mode, now);
+         else
+            report_pinch (c, gout.scale);
+         break;
+      case 7:
+         /* Rotating */
+         if (!state_change)
+            break;
+
+         if ( find_id(diff.dead_count, diff.dead_blobs, c->mouse_id) >= 0 ||
+              find_id(diff.dead_count, diff.dead_blobs, c->mouse2_id) >= 0 ) {
+            debug(c, "END_ROTATE");
+            c->mouse_state = 0;
+            break;
+         }
+
+         if ( !pair_update (c, &gout) )
+            break;
+         if ( gout.changed )
+            enter_gesture (c, gout.mode, now);
+         else
+            report_rotate (c, gout.rotate);
+         break;
+      default:
+         // ERROR
+         break;
+   }
+}
+
+/**
+ * Maps every blob of the completed frame from tracker to screen
+ * coordinates. Points mapped off screen are clamped to its edge.
+ */
+static void calib_frame (struct touchcore *c)
+{
+   static const int none[CALIB_ENTRIES];
+   struct touchcore_params *p = c->params;
+   struct blob_state *blob = c->cur_state.alive;
+   struct blob_state *end = c->cur_state.alive + c->cur_state.count;
+   int m[CALIB_ENTRIES], count;
+   unsigned long flags;
+   long x, y;
+
+   /* Taken whole under the lock, the matrix may be rewritten meanwhile */
+   scroll_lock (c, &flags);
+   count = p->calib_count;
+   __builtin_memcpy (m, p->calib, sizeof(m));
+   scroll_unlock (c, flags);
+
+   /* A partial matrix is ignored */
+   calib_set (&c->calib, c->res, count == CALIB_ENTRIES ? m : none);
+   if (c->calib.identity)
+      return;
+
+   if (c->calib.affine) {
+      for (; blob < end; blob++) {
+         x = blob->x;
+         y = blob->y;
+         calib_affine (&c->calib, &x, &y);
+         blob->x = clamp_coord (x, c->res);
+         blob->y = clamp_coord (y, c->res);
+      }
+   } else {
+      for (; blob < end; blob++) {
+         x = blob->x;
+         y = blob->y;
+         calib_project (&c->calib, &x, &y);
+         blob->x = clamp_coord (x, c->res);
+         blob->y = clamp_coord (y, c->res);
+      }
+   }
+}
+
+/**
+ * Runs every blob of the completed frame through the jitter filter
+ */
+static void filter_frame (struct touchcore *c, unsigned long long now)
+{
+   struct touchcore_params *p = c->params;
+   struct filter_params params;
+   int i;
+
+   if (!p->filter_enable)
+      return;
+
+   params.min_cutoff = p->filter_mincutoff;
+   params.beta = p->filter_beta;
+   params.d_cutoff = p->filter_dcutoff;
+   params.deadband = coord_div_frac ((unsigned long long) p->filter_deadband
+                                     * c->res * 1000);
+
+   filter_begin (&c->filter);
+   for (i = 0; i < c->cur_state.count; i++)
+      filter_contact (&c->filter, &params, c->cur_state.alive[i].id,
+            &c->cur_state.alive[i].x, &c->cur_state.alive[i].y, now);
+   filter_end (&c->filter);
+}
+
+/**
+ * Replaces every blob of the completed frame with its position predicted
+ * predict_ms ahead. The frame is timestamped on arrival.
+ */
+static void predict_frame (struct touchcore *c, unsigned long long now)
+{
+   struct touchcore_params *p = c->params;
+   struct predict_params params;
+   struct blob_state *blob;
+   int i;
+
+   if (!p->predict_enable)
+      return;
+
+   params.min_speed = coord_div_frac ((unsigned long long) p->predict_minspeed
+                                      * c->res * 16000);
+   params.max_offset = coord_div_frac ((unsigned long long) p->predict_maxoffset
+                                       * c->res * 1000);
+   params.accel = 1;
+
+   predict_begin (&c->predict);
+   for (i = 0; i < c->cur_state.count; i++) {
+      blob = &c->cur_state.alive[i];
+      predict_contact (&c->predict, &params, blob->id, &blob->x, &blob->y,
+            now, now + p->predict_ms * 1000);
+      blob->x = clamp_coord (blob->x, c->res);
+      blob->y = clamp_coord (blob->y, c->res);
+   }
+   predict_end (&c->predict);
+}
+
+/* Copies the blobs in use */
+static void copy_state(struct screen_state *to, const struct screen_state *from)
+{
+   __builtin_memcpy (to->alive, from->alive,
+         from->count * sizeof(from->alive[0]));
+   to->count = from->count;
+}
+
+/**
+ * Receives a new message and modifies the current state
+ * Returns 0 on success; 1 when message bundle compelte (fseq received)
+ * Returns -1 on error
+ */
+static int update_state(struct touchcore *c, struct screen_state *state,
+      const char *message)
+{
+   struct blob_state *blob;
+
+   if ( tc_prefix(message, MESSAGE_ALIVE) ) {
+      // received an alive
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_SOURCE) ) {
+      // TUIO 1.1 source, starts the bundle like an alive would
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_FSEQ) ) {
+      // received a fseq
+      return 1;
+   } else if ( tc_prefix(message, MESSAGE_LOST) ) {
+      // tuiod lost frames before this one (tuiod/fseq.h)
+      const char *args = message + sizeof(MESSAGE_LOST);
+
+      c->lost_frames += tc_strtoul (&args);
+      debug(c, "Frames lost before this one");
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_TIME) ) {
+      // the tracker's time of the bundle (tuiod/message.h)
+      const char *args = message + sizeof(MESSAGE_TIME);
+
+      c->frame_sec = tc_strtoul (&args);
+      c->frame_nsec = 0;
+      if (*args == '.') {
+         args++;
+         c->frame_nsec = tc_strtoul (&args);
+      }
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_DELTA) ) {
+      // starts a bundle of changes to the last one received
+      copy_state(state, &c->raw_state);
+      c->delta = 1;
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_GONE) ) {
+      // a contact of the last bundle lifted (delta bundles only)
+      const char *args = message + sizeof(MESSAGE_GONE);
+
+      blob = find_cur_blob(c, tc_strtoul (&args));
+      if (!blob)
+         return -1;
+      __builtin_memmove (blob, blob + 1,
+            (state->alive + --state->count - blob) * sizeof(*blob));
+      return 0;
+   } else if ( tc_prefix(message, MESSAGE_SET) ) {
+      // received a set
+      const char *args = message + sizeof(MESSAGE_SET);
+      unsigned long id;
+      long new_x, new_y;
+
+      id = tc_strtoul (&args);
+      while (*args == ' ')
+         args++;
+      new_x = parse_coord (&args, c->res);
+      new_y = parse_coord (&args, c->res);
+
+      /* Add to the current state, or move it in a delta */
+      blob = c->delta ? find_cur_blob(c, id) : 0;
+      if (!blob) {
+         if (state->count >= MAX_ALIVE_BLOBS)
+            return -1;
+         blob = &(state->alive[state->count++]);
+      }
+      blob->id = id;
+      blob->x = clamp_coord (new_x, c->res);
+      blob->y = clamp_coord (new_y, c->res);
+
+      return 0;
+   }
+   return -1;
+}
+
+void touchcore_dispatch (struct touchcore *c, const char *message)
+{
+   unsigned long long now;
+
+   /* Verify message profile */
+   if ( !tc_prefix (message, MESSAGE_PROFILE) ) {
+      debug(c, "Unknown profile received");
+      c->msg_status = 1;
+      return;
+   }
+
+   /* Start a new bundle */
+   if (c->msg_status) {
+      c->pre_state = c->cur_state;
+      c->cur_state.count = 0;
+      c->delta = 0;
+   }
+
+   /* Pass the message wtihout the profile */
+   if ( (c->msg_status = update_state(c, &c->cur_state,
+                                      message + MESSAGE_TYPE_OFFSET)) < 0 ) {
+      debug(c, "Bad message received");
+      c->msg_status = 1;
+      return;
+   }
+
+   /* Only handle the state once an fseq is received. */
+   if (c->msg_status) {
+      now = c->ops->now_us (c->ctx);
+      copy_state (&c->raw_state, &c->cur_state);
+      calib_frame (c);
+      filter_frame (c, now);
+      predict_frame (c, now);
+      handle_state (c);
+   }
+}
+
+int touchcore_caps (struct touchcore *c, const struct touchcore_cap **caps)
+{
+   if (c->single) {
+      *caps = caps_single;
+      return sizeof(caps_single) / sizeof(caps_single[0]);
+   }
+
+   *caps = caps_mouse;
+   return c->params->hires ? (int) (sizeof(caps_mouse) / sizeof(caps_mouse[0]))
+                           : CAPS_MOUSE_LORES;
+}
+
+int touchcore_init (struct touchcore *c, const struct touchcore_ops *ops,
+      void *ctx, struct touchcore_params *params, unsigned long res,
+      unsigned long tick_us)
+{
+   if (!res || res > COORD_RES_MAX)
+      return -1;
+
+   __builtin_memset (c, 0, sizeof(*c));
+   c->ops = ops;
+   c->ctx = ctx;
+   c->params = params;
+   c->res = res;
+   c->single = params->single;
+   c->msg_status = -1;
+   c->drag_timer = 1;
+   c->move_timer = 1;
+
+   scroll_init (&c->scroll, res, tick_us);
+   filter_init (&c->filter, res);
+   predict_init (&c->predict);
+   return 0;
+}
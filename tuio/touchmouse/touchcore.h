@@ -0,0 +1,162 @@
+#ifndef __TOUCHCORE_H__
+#define __TOUCHCORE_H__
+
+/*
+ * The TUIO to mouse state machine, shared by the touchmouse module, tuiod
+ * (-u) and the user space tools in Test/.
+ *
+ * The core is fed the text messages tuiod writes to /dev/tuio, one per
+ * touchcore_dispatch call, and turns each completed frame into input
+ * events. It has no kernel or libc dependencies: the clock, the event sink,
+ * the momentum scroll timer and the locking are supplied by the caller
+ * through touchcore_ops. Events use the type and code numbers of the input
+ * layer (TC_* below, the same values as linux/input.h).
+ *
+ * The headers it is built from (coord.h, filter.h, predict.h, gesture.h,
+ * scroll.h, calib.h) are alike: inline code with no kernel headers, so
+ * Test/ runs what the module runs, and no 64 bit divides, which 32 bit
+ * kernels do not link (no __divdi3); 64 bit values are only multiplied
+ * and shifted.
+ */
+
+#include "calib.h"
+#include "coord.h"
+#include "filter.h"
+#include "gesture.h"
+#include "predict.h"
+#include "scroll.h"
+#include "state.h"
+
+/* Event types and codes, as in linux/input.h */
+#define TC_EV_SYN 0x00
+#define TC_EV_KEY 0x01
+#define TC_EV_REL 0x02
+#define TC_EV_ABS 0x03
+#define TC_SYN_REPORT 0
+#define TC_ABS_X 0x00
+#define TC_ABS_Y 0x01
+#define TC_REL_HWHEEL 0x06
+#define TC_REL_DIAL 0x07
+#define TC_REL_WHEEL 0x08
+#define TC_REL_WHEEL_HI_RES 0x0b
+#define TC_REL_HWHEEL_HI_RES 0x0c
+#define TC_KEY_LEFTCTRL 29
+#define TC_BTN_LEFT 0x110
+#define TC_BTN_RIGHT 0x111
+#define TC_BTN_TOUCH 0x14a
+
+#define TOUCHCORE_PINCH_DETENTS 20  /* Zoom steps per screen of spread */
+#define TOUCHCORE_ROTATE_STEP (GESTURE_TURN / 360) /* REL_DIAL unit, 1 deg */
+
+struct touchcore_ops {
+   /* Current time in micro seconds */
+   unsigned long long (*now_us) (void *ctx);
+   /* Reports one input event */
+   void (*event) (void *ctx, unsigned int type, unsigned int code, int value);
+   /* Starts calling touchcore_tick every tick_us until it returns 0 */
+   void (*timer_start) (void *ctx);
+   /* Optional: guard the scroll state against touchcore_tick, and the
+    * calibration of touchcore_params against its writer */
+   void (*lock) (void *ctx, unsigned long *flags);
+   void (*unlock) (void *ctx, unsigned long flags);
+   /* Optional: debug trace, see _DEBUG in touchcore.c */
+   void (*log) (void *ctx, const char *msg);
+};
+
+/*
+ * Tunables, read every frame so the caller may change them at any time;
+ * the calibration, being more than one word, only under ops->lock. Units
+ * are those of the touchmouse module parameters.
+ */
+struct touchcore_params {
+   int single;             /* One finger only: tap clicks, moving drags.
+                              Read by touchcore_init */
+   int hires;              /* Also report REL_WHEEL_HI_RES */
+   int drag_delay_us;      /* Held this long still, a touch presses */
+   int move_delay_us;      /* Motion ignored this long after touch down */
+
+   int calib[CALIB_ENTRIES];  /* Q16 homography, see calib.h */
+   int calib_count;        /* Entries set, anything but 9 means none */
+
+   int filter_enable;
+   int filter_mincutoff;   /* mHz */
+   int filter_beta;        /* mHz per screen/s */
+   int filter_dcutoff;     /* mHz */
+   int filter_deadband;    /* 1/1000000 screen */
+
+   int predict_enable;
+   int predict_ms;
+   int predict_minspeed;   /* 1/1000 screen/s */
+   int predict_maxoffset;  /* 1/1000000 screen */
+};
+
+/* Defaults of the touchmouse module */
+#define TOUCHCORE_PARAMS_DEFAULT { \
+   0, 0, DRAG_DELAY_US, MOVE_DELAY_US, { 0 }, 0, \
+   1, 1000, 20000, 1000, 500, \
+   0, 16, 100, 50000 }
+
+struct touchcore_cap {
+   unsigned int type;
+   unsigned int code;
+};
+
+struct touchcore {
+   const struct touchcore_ops *ops;
+   void *ctx;
+   struct touchcore_params *params;
+   long res;               /* Units per 1.0 of TUIO coordinate */
+   int single;
+
+   struct screen_state pre_state;
+   struct screen_state cur_state;
+   int msg_status;         /* Current state of the message bundle */
+   int delta;              /* The bundle only has changes (tuiod -d) */
+   struct screen_state raw_state; /* The last frame as received */
+   unsigned long lost_frames; /* Announced by tuiod, see tuiod/fseq.h */
+   unsigned long frame_sec;  /* Tracker's time of the last bundle, */
+   unsigned long frame_nsec; /* since 1970, see tuiod/message.h */
+
+   unsigned int mouse_state;
+   unsigned long mouse_id;
+   unsigned long mouse2_id;
+   unsigned long long timestart; /* timer start in micro seconds */
+   char drag_timer;
+   char move_timer;
+
+   struct scroll_state scroll;
+   struct gesture_state gesture;
+   long pinch_acc;         /* Spread not yet reported as a zoom step */
+   long rotate_acc;        /* Rotation not yet reported as a dial step */
+
+   struct calib calib;
+   struct filter_state filter;
+   struct predict_state predict;
+};
+
+/*
+ * Sets up core 'c' reporting ABS_X/ABS_Y in 0..res-1, with momentum scroll
+ * ticks every tick_us. Returns 0, or -1 if res is out of range.
+ */
+int touchcore_init (struct touchcore *c, const struct touchcore_ops *ops,
+      void *ctx, struct touchcore_params *params, unsigned long res,
+      unsigned long tick_us);
+
+/*
+ * Handles one message ("/tuio/2Dcur set 4 0.48 0.41 ..."). Frames are
+ * processed when their fseq arrives.
+ */
+void touchcore_dispatch (struct touchcore *c, const char *message);
+
+/*
+ * Momentum scroll tick, returns 0 once the motion has decayed
+ */
+int touchcore_tick (struct touchcore *c);
+
+/*
+ * Events core 'c' may report, for registering the device.
+ * Returns the number of entries in *caps.
+ */
+int touchcore_caps (struct touchcore *c, const struct touchcore_cap **caps);
+
+#endif
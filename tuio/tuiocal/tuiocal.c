@@ -0,0 +1,353 @@
+/**
+ * Computes touchmouse's calibration matrix from touched reference points.
+ *
+ * Each point pairs where the tracker saw a touch (raw) with where it should
+ * have been on the screen (target), both normalized to 0..1. Three or more
+ * points give a least squares affine fit, four or more with -p a
+ * homography that also corrects keystone. The matrix is printed in the Q16
+ * row major form touchmouse takes:
+ *
+ *    echo 65012,-312,1205,... > /sys/module/touchmouse/parameters/calib
+ *
+ * Points are read from stdin as lines of "raw_x raw_y target_x target_y".
+ * With -s the tool reads a TUIO stream in /dev/tuio text format instead
+ * (the device itself while touchmouse is not loaded, or a capture from
+ * Test/tsdev_poll), asks for a touch on each of nine targets and averages
+ * the position of every touch until it is lifted.
+ *
+ * Usage:
+ *    ./tuiocal [-p] [-w] < points.txt
+ *    ./tuiocal [-p] [-w] -s /dev/tuio
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_POINTS 64
+#define LINE_LEN 256
+#define PROFILE "/tuio/2Dcur "
+#define SYSFS_PARAM "/sys/module/touchmouse/parameters/calib"
+#define MIN_SAMPLES 5      /* Frames a touch must last to count */
+#define Q16 65536.0
+
+struct point {
+   double rx, ry;    /* Raw tracker position */
+   double tx, ty;    /* Target screen position */
+};
+
+static struct point points[MAX_POINTS];
+static int npoints;
+
+/* Targets asked for with -s, 10% in from the edges */
+static const double targets[][2] = {
+   { 0.1, 0.1 }, { 0.5, 0.1 }, { 0.9, 0.1 },
+   { 0.1, 0.5 }, { 0.5, 0.5 }, { 0.9, 0.5 },
+   { 0.1, 0.9 }, { 0.5, 0.9 }, { 0.9, 0.9 },
+};
+#define TARGETS (sizeof(targets) / sizeof(targets[0]))
+
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-p] [-w] [-s tuio_stream]\n", name);
+   exit(1);
+}
+
+/*
+ * Solves the n x n system a x = b in place by Gaussian elimination with
+ * partial pivoting. Returns 0 if the system is singular.
+ */
+static int solve(double *a, double *b, int n)
+{
+   int i, j, k, p;
+   double f, t;
+
+   for (i = 0; i < n; i++) {
+      p = i;
+      for (j = i + 1; j < n; j++)
+         if (fabs(a[j * n + i]) > fabs(a[p * n + i]))
+            p = j;
+      if (fabs(a[p * n + i]) < 1e-12)
+         return 0;
+
+      for (k = 0; k < n; k++) {
+         t = a[i * n + k];
+         a[i * n + k] = a[p * n + k];
+         a[p * n + k] = t;
+      }
+      t = b[i];
+      b[i] = b[p];
+      b[p] = t;
+
+      for (j = i + 1; j < n; j++) {
+         f = a[j * n + i] / a[i * n + i];
+         for (k = i; k < n; k++)
+            a[j * n + k] -= f * a[i * n + k];
+         b[j] -= f * b[i];
+      }
+   }
+
+   for (i = n - 1; i >= 0; i--) {
+      for (k = i + 1; k < n; k++)
+         b[i] -= a[i * n + k] * b[k];
+      b[i] /= a[i * n + i];
+   }
+   return 1;
+}
+
+/*
+ * Adds one equation (row . x = rhs) to the normal equations of an n
+ * parameter least squares problem
+ */
+static void accumulate(double *ata, double *atb, const double *row,
+      double rhs, int n)
+{
+   int i, j;
+
+   for (i = 0; i < n; i++) {
+      for (j = 0; j < n; j++)
+         ata[i * n + j] += row[i] * row[j];
+      atb[i] += row[i] * rhs;
+   }
+}
+
+/*
+ * Least squares affine fit, each output row solved on its own
+ */
+static int fit_affine(double m[9])
+{
+   double ata[9], atb[3], row[3];
+   int r, i;
+
+   for (r = 0; r < 2; r++) {
+      memset(ata, 0, sizeof(ata));
+      memset(atb, 0, sizeof(atb));
+      for (i = 0; i < npoints; i++) {
+         row[0] = points[i].rx;
+         row[1] = points[i].ry;
+         row[2] = 1;
+         accumulate(ata, atb, row, r ? points[i].ty : points[i].tx, 3);
+      }
+      if (!solve(ata, atb, 3))
+         return 0;
+      memcpy(&m[r * 3], atb, sizeof(atb));
+   }
+   m[6] = m[7] = 0;
+   m[8] = 1;
+   return 1;
+}
+
+/*
+ * Least squares homography with m[8] fixed to 1 (the linearized DLT
+ * equations)
+ */
+static int fit_homography(double m[9])
+{
+   double ata[64], atb[8], row[8];
+   struct point *p;
+   int i;
+
+   memset(ata, 0, sizeof(ata));
+   memset(atb, 0, sizeof(atb));
+   for (i = 0; i < npoints; i++) {
+      p = &points[i];
+
+      row[0] = p->rx; row[1] = p->ry; row[2] = 1;
+      row[3] = 0;     row[4] = 0;     row[5] = 0;
+      row[6] = -p->rx * p->tx;
+      row[7] = -p->ry * p->tx;
+      accumulate(ata, atb, row, p->tx, 8);
+
+      row[0] = 0;     row[1] = 0;     row[2] = 0;
+      row[3] = p->rx; row[4] = p->ry; row[5] = 1;
+      row[6] = -p->rx * p->ty;
+      row[7] = -p->ry * p->ty;
+      accumulate(ata, atb, row, p->ty, 8);
+   }
+   if (!solve(ata, atb, 8))
+      return 0;
+   memcpy(m, atb, sizeof(atb));
+   m[8] = 1;
+   return 1;
+}
+
+static void map(const double m[9], double x, double y, double *ox, double *oy)
+{
+   double w = m[6] * x + m[7] * y + m[8];
+
+   *ox = (m[0] * x + m[1] * y + m[2]) / w;
+   *oy = (m[3] * x + m[4] * y + m[5]) / w;
+}
+
+static void read_points(FILE *fp)
+{
+   char line[LINE_LEN];
+   struct point *p;
+
+   while (fgets(line, sizeof(line), fp)) {
+      if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+         continue;
+      if (npoints >= MAX_POINTS) {
+         printf("ERROR: More than %d points\n", MAX_POINTS);
+         exit(1);
+      }
+      p = &points[npoints];
+      if (sscanf(line, "%lf %lf %lf %lf", &p->rx, &p->ry, &p->tx, &p->ty)
+            != 4) {
+         printf("ERROR: Bad point '%s'\n", line);
+         exit(1);
+      }
+      npoints++;
+   }
+}
+
+/*
+ * Waits for one touch on the stream and returns its average position.
+ * Returns 0 at the end of the stream.
+ */
+static int read_touch(FILE *fp, double *x, double *y)
+{
+   char line[LINE_LEN];
+   const char *p;
+   double sx = 0, sy = 0, bx, by;
+   long samples = 0;
+   unsigned long id;
+
+   while (fgets(line, sizeof(line), fp)) {
+      p = line;
+      if (*p == '[')
+         p = strchr(p, ']') ? strchr(p, ']') + 1 : p;
+      if (strncmp(p, PROFILE, strlen(PROFILE)))
+         continue;
+      p += strlen(PROFILE);
+
+      /* An empty alive message lifts the touch */
+      if (!strncmp(p, "alive", 5)) {
+         if (p[strspn(p + 5, " \r\n") + 5] != '\0')
+            continue;
+         if (samples >= MIN_SAMPLES)
+            break;
+         sx = sy = 0;
+         samples = 0;
+         continue;
+      }
+
+      if (sscanf(p, "set %lu %lf %lf", &id, &bx, &by) == 3) {
+         sx += bx;
+         sy += by;
+         samples++;
+      }
+   }
+
+   if (samples < MIN_SAMPLES)
+      return 0;
+   *x = sx / samples;
+   *y = sy / samples;
+   return 1;
+}
+
+static void read_touches(const char *source)
+{
+   FILE *fp;
+   struct point *p;
+   unsigned int i;
+
+   if ((fp = fopen(source, "r")) == NULL) {
+      printf("ERROR: Could not open '%s' for reading!\n", source);
+      exit(1);
+   }
+
+   for (i = 0; i < TARGETS; i++) {
+      p = &points[npoints];
+      p->tx = targets[i][0];
+      p->ty = targets[i][1];
+      fprintf(stderr, "Touch target %u at %.2f %.2f and lift\n", i + 1,
+            p->tx, p->ty);
+      if (!read_touch(fp, &p->rx, &p->ry))
+         break;
+      fprintf(stderr, "  raw %.6f %.6f\n", p->rx, p->ry);
+      npoints++;
+   }
+   fclose(fp);
+}
+
+int main(int argc, char** argv)
+{
+   const char *source = NULL;
+   double m[9], ox, oy, err, max_err = 0;
+   long q[9];
+   int opt, i, ok, projective = 0, write_sysfs = 0;
+   FILE *fp;
+
+   while ((opt = getopt(argc, argv, "pws:")) != -1) {
+      switch (opt) {
+         case 'p':
+            projective = 1;
+            break;
+         case 'w':
+            write_sysfs = 1;
+            break;
+         case 's':
+            source = optarg;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (optind != argc)
+      usage(argv[0]);
+
+   if (source)
+      read_touches(source);
+   else
+      read_points(stdin);
+
+   if (npoints < (projective ? 4 : 3)) {
+      printf("ERROR: Need at least %d points, have %d\n", projective ? 4 : 3,
+            npoints);
+      exit(1);
+   }
+
+   ok = projective ? fit_homography(m) : fit_affine(m);
+   if (!ok) {
+      printf("ERROR: Points are degenerate (collinear?)\n");
+      exit(1);
+   }
+
+   for (i = 0; i < npoints; i++) {
+      map(m, points[i].rx, points[i].ry, &ox, &oy);
+      err = hypot(ox - points[i].tx, oy - points[i].ty);
+      max_err = err > max_err ? err : max_err;
+   }
+   fprintf(stderr, "%d points, max residual %.6f of the screen\n", npoints,
+         max_err);
+
+   for (i = 0; i < 9; i++) {
+      if (fabs(m[i] * Q16) > 0x7FFFFFFF) {
+         printf("ERROR: Matrix entry %d out of range\n", i);
+         exit(1);
+      }
+      q[i] = lround(m[i] * Q16);
+   }
+
+   /* An all zero matrix would switch calibration off */
+   printf("%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", q[0], q[1], q[2], q[3],
+         q[4], q[5], q[6], q[7], q[8]);
+
+   if (write_sysfs) {
+      if ((fp = fopen(SYSFS_PARAM, "w")) == NULL) {
+         printf("ERROR: Could not open '%s' for writing!\n", SYSFS_PARAM);
+         exit(1);
+      }
+      fprintf(fp, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", q[0], q[1], q[2],
+            q[3], q[4], q[5], q[6], q[7], q[8]);
+      if (fclose(fp)) {
+         printf("ERROR: Writing '%s' failed!\n", SYSFS_PARAM);
+         exit(1);
+      }
+   }
+   return 0;
+}
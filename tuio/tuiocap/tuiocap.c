@@ -0,0 +1,249 @@
+/**
+ * Reads the packet captures tuiod records with -r (tuio/tuiod/capture.h).
+ *
+ * Without options a summary is printed: packets, senders, duration and how
+ * much the delta coding saved. -i lists the block index, -v every packet
+ * with its messages, and -t writes the messages as a /dev/tuio text trace
+ * with "# time" lines, as read by Test/touchcore/touchcore_replay and
+ * Test/gesture_replay:
+ *
+ *    ./tuiocap -t table.cap > table.trace
+ *
+ * -s starts that many seconds into the capture, found through the index.
+ *
+ * Usage:
+ *    ./tuiocap [-i] [-v | -t] [-s seconds] capture_file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "capture.h"
+
+#define LINE_LEN 1024
+
+static struct capture_reader reader;
+
+
+static unsigned int get_be32(const unsigned char *p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* Length of the padded OSC string at p, 0 if it runs past end */
+static unsigned int osc_string(const unsigned char *p, const unsigned char *end)
+{
+   const unsigned char *s = p;
+
+   while (s < end && *s)
+      s++;
+   if (s >= end)
+      return 0;
+   return ((s - p) / 4 + 1) * 4;
+}
+
+/*
+ * Writes one OSC message the way tuiod writes it to /dev/tuio:
+ * "/path arg0 arg1 ...". Returns -1 if it is malformed.
+ */
+static int print_message(FILE *out, const unsigned char *p, unsigned int len)
+{
+   const unsigned char *end = p + len, *types;
+   union { unsigned int i; float f; } v;
+   union { unsigned long long i; double d; } v64;
+   char line[LINE_LEN];
+   unsigned int n, pos;
+
+   if ((n = osc_string(p, end)) == 0)
+      return -1;
+   pos = snprintf(line, sizeof(line), "%s", (const char *) p);
+   p += n;
+
+   /* Messages without a type tag string have no arguments */
+   if (p >= end || *p != ',') {
+      fprintf(out, "%s\n", line);
+      return 0;
+   }
+   if ((n = osc_string(p, end)) == 0)
+      return -1;
+   types = p + 1;
+   p += n;
+
+   for (; *types && pos < sizeof(line); types++) {
+      switch (*types) {
+         case 'i':
+         case 'f':
+         case 'c':
+            if (end - p < 4)
+               return -1;
+            v.i = get_be32(p);
+            p += 4;
+            if (*types == 'i')
+               pos += snprintf(line + pos, sizeof(line) - pos, " %d", (int) v.i);
+            else if (*types == 'f')
+               pos += snprintf(line + pos, sizeof(line) - pos, " %f", v.f);
+            else
+               pos += snprintf(line + pos, sizeof(line) - pos, " %c", v.i);
+            break;
+         case 'h':
+         case 'd':
+         case 't':
+            if (end - p < 8)
+               return -1;
+            v64.i = (unsigned long long) get_be32(p) << 32 | get_be32(p + 4);
+            p += 8;
+            if (*types == 'd')
+               pos += snprintf(line + pos, sizeof(line) - pos, " %lf", v64.d);
+            else
+               pos += snprintf(line + pos, sizeof(line) - pos, " %lld",
+                     (long long) v64.i);
+            break;
+         case 's':
+         case 'S':
+            if ((n = osc_string(p, end)) == 0)
+               return -1;
+            pos += snprintf(line + pos, sizeof(line) - pos, " %s",
+                  (const char *) p);
+            p += n;
+            break;
+         case 'b':
+            if (end - p < 4 || get_be32(p) > (unsigned int) (end - p - 4))
+               return -1;
+            p += 4 + (get_be32(p) + 3) / 4 * 4;
+            break;
+         default:
+            /* T F N I carry no data */
+            break;
+      }
+   }
+   fprintf(out, "%s\n", line);
+   return 0;
+}
+
+/* Writes every message of a packet, descending into bundles */
+static int print_packet(FILE *out, const unsigned char *p, unsigned int len)
+{
+   unsigned int size;
+
+   if (len < 16 || memcmp(p, "#bundle", 8))
+      return print_message(out, p, len);
+
+   for (p += 16, len -= 16; len >= 4; p += size, len -= size) {
+      size = get_be32(p);
+      p += 4;
+      len -= 4;
+      if (size > len || print_packet(out, p, size))
+         return -1;
+   }
+   return 0;
+}
+
+static const char *source_name(const struct capture_source *s)
+{
+   static char name[INET6_ADDRSTRLEN + 8];
+   char addr[INET6_ADDRSTRLEN];
+
+   if (s->family != AF_INET && s->family != AF_INET6)
+      return "unknown";
+   inet_ntop(s->family, s->addr, addr, sizeof(addr));
+   snprintf(name, sizeof(name), s->family == AF_INET6 ? "[%s]:%u" : "%s:%u",
+         addr, s->port);
+   return name;
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-i] [-v | -t] [-s seconds] capture_file\n", name);
+   exit(1);
+}
+
+int main(int argc, char** argv)
+{
+   struct capture_reader *r = &reader;
+   struct capture_packet p;
+   unsigned long long first = 0, last = 0, raw = 0, stored = 0, count = 0;
+   unsigned int i, seen[CAPTURE_MAX_SOURCES] = { 0 };
+   double skip = 0;
+   int opt, index = 0, verbose = 0, trace = 0, ret;
+
+   while ((opt = getopt(argc, argv, "ivts:")) != -1) {
+      switch (opt) {
+         case 'i':
+            index = 1;
+            break;
+         case 'v':
+            verbose = 1;
+            break;
+         case 't':
+            trace = 1;
+            break;
+         case 's':
+            skip = atof(optarg);
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (argc - optind != 1 || (verbose && trace))
+      usage(argv[0]);
+
+   if (capture_reader_open(r, argv[optind])) {
+      printf("ERROR: Could not read capture '%s'\n", argv[optind]);
+      exit(1);
+   }
+
+   if (index && !trace) {
+      printf("%u blocks%s\n", r->blocks, r->indexed ? "" :
+            " (no index, rebuilt)");
+      for (i = 0; i < r->blocks; i++)
+         printf("   %5u offset %10llu  %12.6f - %12.6f s  %6u records\n", i,
+               r->block[i].offset,
+               (r->block[i].first_ns - r->start_ns) / 1e9,
+               (r->block[i].last_ns - r->start_ns) / 1e9, r->block[i].records);
+   }
+
+   if (skip > 0 && capture_seek(r, r->start_ns +
+            (unsigned long long) (skip * 1e9)))
+      r->cur = r->blocks;
+
+   while ((ret = capture_next(r, &p)) > 0) {
+      if (!count)
+         first = p.time_ns;
+      last = p.time_ns;
+      count++;
+      raw += p.len;
+      stored += p.stored;
+      seen[p.source] = 1;
+
+      if (trace) {
+         printf("# time %llu\n", (p.time_ns - first) / 1000);
+         print_packet(stdout, p.data, p.len);
+      } else if (verbose) {
+         printf("%12.6f %s %u bytes\n", (p.time_ns - r->start_ns) / 1e9,
+               source_name(p.from), p.len);
+         if (print_packet(stdout, p.data, p.len))
+            printf("   (malformed)\n");
+      }
+   }
+   if (ret < 0)
+      fprintf(stderr, "ERROR: Corrupt record in block %u\n", r->cur - 1);
+   if (trace) {
+      capture_reader_close(r);
+      return ret < 0;
+   }
+
+   printf("%llu packets in %.3f s", count, (last - first) / 1e9);
+   if (r->indexed)
+      printf(", %llu dropped while recording", r->dropped);
+   printf("\n%llu bytes received, %llu stored%s\n", raw, stored,
+         r->flags & CAPTURE_DELTA ? " (delta coded)" : "");
+   for (i = 0; i < CAPTURE_MAX_SOURCES; i++)
+      if (seen[i])
+         printf("source %u: %s\n", i, source_name(&r->source[i]));
+
+   capture_reader_close(r);
+   return ret < 0;
+}
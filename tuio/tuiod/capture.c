@@ -0,0 +1,816 @@
+/*
+ * Binary packet capture for tuiod -r, see capture.h for the file format
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#include "capture.h"
+
+#define MAGIC_FILE "TUIOCAP"
+#define MAGIC_BLOCK 0x31424354     /* "TCB1" */
+#define MAGIC_INDEX 0x31494354     /* "TCI1" */
+#define MAGIC_END 0x31454354       /* "TCE1" */
+
+#define SOURCE_LEN 20              /* Payload of a CAPTURE_SOURCE record */
+#define PAD4(n) (((n) + 3) & ~3U)
+
+/* The one message layout delta coded: "/tuio/2Dcur" ",sifffff" "set" */
+#define CUR_SET_PREFIX "/tuio/2Dcur\0,sifffff\0\0\0\0set"
+#define CUR_SET_PREFIX_LEN 28
+#define CUR_SET_LEN 52             /* Prefix, session id, 5 floats */
+
+struct capture_slot {
+   unsigned long long time_ns;
+   struct capture_source from;
+   unsigned int len;
+   unsigned char data[CAPTURE_MAX_PACKET];
+};
+
+struct capture {
+   int fd;
+   int flags;
+   pthread_t thread;
+   int stop;                       /* Set by capture_close */
+
+   /* The ring: head is written by capture_packet only, tail by the
+    * writer thread only, each published with release/acquire */
+   unsigned long head __attribute__((aligned(64)));
+   unsigned long long dropped;
+   unsigned long tail __attribute__((aligned(64)));
+   struct capture_slot *slot;
+
+   /* Writer thread state */
+   unsigned long long offset;      /* Bytes written */
+   unsigned long long packets;
+   unsigned char *blk;             /* Block header and records */
+   unsigned int blk_len;           /* Record bytes */
+   unsigned int blk_records;
+   unsigned long long blk_first;
+   unsigned long long blk_last;
+   struct capture_block *index;
+   unsigned int blocks;
+   unsigned int index_size;
+   struct capture_source source[CAPTURE_MAX_SOURCES];
+   unsigned int sources;
+   struct capture_delta delta[CAPTURE_MAX_SOURCES];
+   unsigned char enc[2 * CAPTURE_MAX_PACKET];
+};
+
+
+/*
+ * Little endian file fields, big endian OSC fields
+ */
+static void put16(unsigned char *p, unsigned int v)
+{
+   p[0] = v;
+   p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, unsigned int v)
+{
+   p[0] = v;
+   p[1] = v >> 8;
+   p[2] = v >> 16;
+   p[3] = v >> 24;
+}
+
+static void put64(unsigned char *p, unsigned long long v)
+{
+   put32(p, (unsigned int) v);
+   put32(p + 4, (unsigned int) (v >> 32));
+}
+
+static unsigned int get16(const unsigned char *p)
+{
+   return p[0] | p[1] << 8;
+}
+
+static unsigned int get32(const unsigned char *p)
+{
+   return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static unsigned long long get64(const unsigned char *p)
+{
+   return get32(p) | (unsigned long long) get32(p + 4) << 32;
+}
+
+static unsigned int get_be32(const unsigned char *p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+}
+
+static unsigned long long now_ns(int clock)
+{
+   struct timespec ts;
+
+   clock_gettime(clock, &ts);
+   return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*
+ * Delta coding. Both directions walk the packet the same way: bundles are
+ * descended into, 52 byte elements are tagged (coded "/tuio/2Dcur set", or
+ * anything else copied) and all other bytes, including anything malformed,
+ * are copied as they are.
+ */
+static unsigned int *delta_slot(struct capture_delta *d, unsigned int id)
+{
+   unsigned int s = id % CAPTURE_DELTA_SLOTS;
+
+   if (d->id[s] != id) {
+      d->id[s] = id;
+      memset(d->bits[s], 0, sizeof(d->bits[s]));
+   }
+   return d->bits[s];
+}
+
+static int is_bundle(const unsigned char *p, unsigned int len,
+      unsigned int avail)
+{
+   return len >= 16 && avail >= 16 && !memcmp(p, "#bundle", 8);
+}
+
+static unsigned int put_varint(unsigned char *p, unsigned int v)
+{
+   unsigned int n = 0;
+
+   while (v >= 0x80) {
+      p[n++] = (v & 0x7f) | 0x80;
+      v >>= 7;
+   }
+   p[n++] = v;
+   return n;
+}
+
+/* Reads a varint at in[*i], -1 if it runs past avail or 32 bits */
+static int get_varint(const unsigned char *in, unsigned int avail,
+      unsigned int *i, unsigned int *v)
+{
+   unsigned int shift = 0;
+
+   *v = 0;
+   do {
+      if (*i >= avail || shift > 28)
+         return -1;
+      *v |= (unsigned int) (in[*i] & 0x7f) << shift;
+      shift += 7;
+   } while (in[(*i)++] & 0x80);
+   return 0;
+}
+
+static long encode_element(struct capture_delta *d, const unsigned char *in,
+      unsigned int len, unsigned char *out)
+{
+   unsigned int i, o, k, size, bits, diff, *prev;
+
+   if (is_bundle(in, len, len)) {
+      memcpy(out, in, 16);
+      i = o = 16;
+      while (len - i >= 4) {
+         size = get_be32(in + i);
+         if (size > len - i - 4)
+            break;
+         memcpy(out + o, in + i, 4);
+         i += 4;
+         o += 4;
+         o += encode_element(d, in + i, size, out + o);
+         i += size;
+      }
+      memcpy(out + o, in + i, len - i);
+      return o + len - i;
+   }
+
+   if (len != CUR_SET_LEN) {
+      memcpy(out, in, len);
+      return len;
+   }
+   if (memcmp(in, CUR_SET_PREFIX, CUR_SET_PREFIX_LEN)) {
+      out[0] = 0;
+      memcpy(out + 1, in, len);
+      return len + 1;
+   }
+
+   out[0] = 1;
+   o = 1 + put_varint(out + 1, get_be32(in + CUR_SET_PREFIX_LEN));
+   prev = delta_slot(d, get_be32(in + CUR_SET_PREFIX_LEN));
+   for (k = 0; k < 5; k++) {
+      bits = get_be32(in + CUR_SET_PREFIX_LEN + 4 + 4 * k);
+      diff = bits - prev[k];
+      prev[k] = bits;
+      o += put_varint(out + o, (diff << 1) ^ (unsigned int) -(diff >> 31));
+   }
+   return o;
+}
+
+static long decode_element(struct capture_delta *d, const unsigned char *in,
+      unsigned int avail, unsigned int len, unsigned char *out)
+{
+   unsigned int i, o, k, size, id, zz, *prev;
+   long n;
+
+   if (is_bundle(in, len, avail)) {
+      memcpy(out, in, 16);
+      i = o = 16;
+      while (len - o >= 4) {
+         if (avail - i < 4)
+            return -1;
+         size = get_be32(in + i);
+         if (size > len - o - 4)
+            break;
+         memcpy(out + o, in + i, 4);
+         i += 4;
+         o += 4;
+         if ((n = decode_element(d, in + i, avail - i, size, out + o)) < 0)
+            return -1;
+         i += n;
+         o += size;
+      }
+      if (avail - i < len - o)
+         return -1;
+      memcpy(out + o, in + i, len - o);
+      return i + len - o;
+   }
+
+   if (len != CUR_SET_LEN) {
+      if (avail < len)
+         return -1;
+      memcpy(out, in, len);
+      return len;
+   }
+   if (avail < 1 || in[0] > 1)
+      return -1;
+   if (in[0] == 0) {
+      if (avail - 1 < len)
+         return -1;
+      memcpy(out, in + 1, len);
+      return len + 1;
+   }
+
+   i = 1;
+   if (get_varint(in, avail, &i, &id))
+      return -1;
+   memcpy(out, CUR_SET_PREFIX, CUR_SET_PREFIX_LEN);
+   put_be32(out + CUR_SET_PREFIX_LEN, id);
+   prev = delta_slot(d, id);
+   for (k = 0; k < 5; k++) {
+      if (get_varint(in, avail, &i, &zz))
+         return -1;
+      prev[k] += (zz >> 1) ^ -(zz & 1);
+      put_be32(out + CUR_SET_PREFIX_LEN + 4 + 4 * k, prev[k]);
+   }
+   return i;
+}
+
+long capture_delta_encode(struct capture_delta *d, const unsigned char *in,
+      unsigned int len, unsigned char *out)
+{
+   return encode_element(d, in, len, out);
+}
+
+long capture_delta_decode(struct capture_delta *d, const unsigned char *in,
+      unsigned int stored, unsigned int len, unsigned char *out)
+{
+   long n = decode_element(d, in, stored, len, out);
+
+   return n == (long) stored ? (long) len : -1;
+}
+
+
+/*
+ * Writer thread
+ */
+static int write_all(int fd, const unsigned char *p, size_t len)
+{
+   ssize_t n;
+
+   while (len > 0) {
+      if ((n = write(fd, p, len)) < 0) {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      p += n;
+      len -= n;
+   }
+   return 0;
+}
+
+static void add_record(struct capture *c, unsigned int type,
+      unsigned int source, const unsigned char *data, unsigned int stored,
+      unsigned int len, unsigned long long time_ns)
+{
+   unsigned char *p = c->blk + CAPTURE_BLOCK_HEADER + c->blk_len;
+
+   p[0] = type;
+   p[1] = 0;
+   put16(p + 2, source);
+   put32(p + 4, stored);
+   put32(p + 8, len);
+   put64(p + 12, time_ns);
+   memcpy(p + CAPTURE_RECORD_HEADER, data, stored);
+   memset(p + CAPTURE_RECORD_HEADER + stored, 0, PAD4(stored) - stored);
+
+   c->blk_len += CAPTURE_RECORD_HEADER + PAD4(stored);
+   c->blk_records++;
+   c->blk_last = time_ns;
+}
+
+static void add_source(struct capture *c, unsigned int id,
+      unsigned long long time_ns)
+{
+   unsigned char rec[SOURCE_LEN];
+
+   put16(rec, c->source[id].family);
+   put16(rec + 2, c->source[id].port);
+   memcpy(rec + 4, c->source[id].addr, 16);
+   add_record(c, CAPTURE_SOURCE, id, rec, SOURCE_LEN, SOURCE_LEN, time_ns);
+}
+
+/* Opens a block: every source is declared again and the delta state reset */
+static void block_begin(struct capture *c, unsigned long long time_ns)
+{
+   unsigned int i;
+
+   c->blk_first = time_ns;
+   for (i = 0; i < c->sources; i++)
+      add_source(c, i, time_ns);
+   memset(c->delta, 0, sizeof(c->delta));
+}
+
+/* Writes the open block. A block that cannot be written is lost, and
+ * left out of the index */
+static void block_seal(struct capture *c)
+{
+   struct capture_block *b;
+   unsigned int len = CAPTURE_BLOCK_HEADER + c->blk_len;
+
+   if (!c->blk_records)
+      return;
+
+   put32(c->blk, MAGIC_BLOCK);
+   put32(c->blk + 4, c->blk_len);
+   put32(c->blk + 8, c->blk_records);
+   put32(c->blk + 12, 0);
+   put64(c->blk + 16, c->blk_first);
+   put64(c->blk + 24, c->blk_last);
+   c->blk_len = 0;
+   c->blk_records = 0;
+
+   if (c->blocks == c->index_size) {
+      b = realloc(c->index, 2 * (c->index_size + 32) * sizeof(*b));
+      if (b == NULL)
+         return;
+      c->index = b;
+      c->index_size = 2 * (c->index_size + 32);
+   }
+   if (write_all(c->fd, c->blk, len))
+      return;
+
+   b = &c->index[c->blocks++];
+   b->offset = c->offset;
+   b->first_ns = get64(c->blk + 16);
+   b->last_ns = get64(c->blk + 24);
+   b->records = get32(c->blk + 8);
+   c->offset += len;
+}
+
+static unsigned int find_source(struct capture *c,
+      const struct capture_source *from, int *added)
+{
+   unsigned int i;
+
+   *added = 0;
+   for (i = 0; i < c->sources; i++)
+      if (!memcmp(&c->source[i], from, sizeof(*from)))
+         return i;
+   if (c->sources == CAPTURE_MAX_SOURCES)
+      return 0;
+   c->source[c->sources] = *from;
+   *added = 1;
+   return c->sources++;
+}
+
+static void write_packet(struct capture *c, const struct capture_slot *s)
+{
+   unsigned int source, worst;
+   int added;
+   long n;
+
+   source = find_source(c, &s->from, &added);
+
+   /* Room for the sources of a new block and a packet coded at its worst */
+   worst = CAPTURE_RECORD_HEADER + PAD4(2 * s->len) +
+      (CAPTURE_RECORD_HEADER + SOURCE_LEN) * c->sources;
+   if (c->blk_records && c->blk_len + worst > CAPTURE_BLOCK_SIZE)
+      block_seal(c);
+
+   if (!c->blk_records)
+      block_begin(c, s->time_ns);
+   else if (added)
+      add_source(c, source, s->time_ns);
+
+   if (c->flags & CAPTURE_DELTA) {
+      n = capture_delta_encode(&c->delta[source], s->data, s->len, c->enc);
+      add_record(c, CAPTURE_PACKET_DELTA, source, c->enc, n, s->len,
+            s->time_ns);
+   } else {
+      add_record(c, CAPTURE_PACKET, source, s->data, s->len, s->len,
+            s->time_ns);
+   }
+   c->packets++;
+}
+
+static void write_index(struct capture *c)
+{
+   unsigned char *buf, *p;
+   unsigned int i, len;
+
+   len = CAPTURE_INDEX_HEADER + CAPTURE_INDEX_ENTRY * c->blocks +
+      CAPTURE_TRAILER;
+   if ((buf = calloc(1, len)) == NULL)
+      return;
+
+   put32(buf, MAGIC_INDEX);
+   put32(buf + 4, c->blocks);
+   put64(buf + 8, c->packets);
+   put64(buf + 16, __atomic_load_n(&c->dropped, __ATOMIC_RELAXED));
+   for (i = 0; i < c->blocks; i++) {
+      p = buf + CAPTURE_INDEX_HEADER + CAPTURE_INDEX_ENTRY * i;
+      put64(p, c->index[i].offset);
+      put64(p + 8, c->index[i].first_ns);
+      put64(p + 16, c->index[i].last_ns);
+      put32(p + 24, c->index[i].records);
+   }
+   p = buf + len - CAPTURE_TRAILER;
+   put64(p, c->offset);
+   put32(p + 8, MAGIC_END);
+
+   write_all(c->fd, buf, len);
+   free(buf);
+}
+
+static void *writer(void *arg)
+{
+   struct capture *c = arg;
+   struct timespec idle = { 0, 1000000 };
+   unsigned long head;
+
+   while (1) {
+      head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+      if (c->tail != head) {
+         write_packet(c, &c->slot[c->tail % CAPTURE_RING]);
+         __atomic_store_n(&c->tail, c->tail + 1, __ATOMIC_RELEASE);
+         continue;
+      }
+
+      /* Drained: only now may it stop */
+      if (__atomic_load_n(&c->stop, __ATOMIC_ACQUIRE))
+         break;
+      if (c->blk_records &&
+            now_ns(CLOCK_MONOTONIC) - c->blk_first >= CAPTURE_BLOCK_NS)
+         block_seal(c);
+      nanosleep(&idle, NULL);
+   }
+
+   block_seal(c);
+   write_index(c);
+   return NULL;
+}
+
+
+/*
+ * Writer API
+ */
+struct capture *capture_open(const char *path, int flags)
+{
+   struct capture *c;
+   unsigned char header[CAPTURE_FILE_HEADER];
+
+   if ((c = calloc(1, sizeof(*c))) == NULL)
+      return NULL;
+   c->flags = flags;
+   c->slot = malloc(CAPTURE_RING * sizeof(*c->slot));
+   c->blk = malloc(CAPTURE_BLOCK_HEADER + CAPTURE_BLOCK_SIZE);
+   if (!c->slot || !c->blk)
+      goto fail;
+
+   if ((c->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+      goto fail;
+
+   memset(header, 0, sizeof(header));
+   memcpy(header, MAGIC_FILE, 8);
+   put16(header + 8, CAPTURE_VERSION);
+   put16(header + 10, flags);
+   put32(header + 12, CAPTURE_BLOCK_SIZE);
+   put64(header + 16, now_ns(CLOCK_REALTIME));
+   put64(header + 24, now_ns(CLOCK_MONOTONIC));
+   if (write_all(c->fd, header, sizeof(header)))
+      goto fail_fd;
+   c->offset = sizeof(header);
+
+   if ((errno = pthread_create(&c->thread, NULL, writer, c)) != 0)
+      goto fail_fd;
+   return c;
+
+fail_fd:
+   close(c->fd);
+fail:
+   free(c->slot);
+   free(c->blk);
+   free(c);
+   return NULL;
+}
+
+int capture_packet(struct capture *c, const struct sockaddr *from,
+      const void *data, int len)
+{
+   struct capture_slot *s;
+   unsigned long head = c->head;
+
+   if (len < 0 || len > CAPTURE_MAX_PACKET ||
+         head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE) >= CAPTURE_RING) {
+      __atomic_store_n(&c->dropped, c->dropped + 1, __ATOMIC_RELAXED);
+      return -1;
+   }
+
+   s = &c->slot[head % CAPTURE_RING];
+   s->time_ns = now_ns(CLOCK_MONOTONIC);
+   memset(&s->from, 0, sizeof(s->from));
+   if (from && from->sa_family == AF_INET) {
+      s->from.family = AF_INET;
+      s->from.port = ntohs(((const struct sockaddr_in *) from)->sin_port);
+      memcpy(s->from.addr, &((const struct sockaddr_in *) from)->sin_addr, 4);
+   } else if (from && from->sa_family == AF_INET6) {
+      s->from.family = AF_INET6;
+      s->from.port = ntohs(((const struct sockaddr_in6 *) from)->sin6_port);
+      memcpy(s->from.addr, &((const struct sockaddr_in6 *) from)->sin6_addr,
+            16);
+   }
+   s->len = len;
+   memcpy(s->data, data, len);
+
+   __atomic_store_n(&c->head, head + 1, __ATOMIC_RELEASE);
+   return 0;
+}
+
+void capture_close(struct capture *c, unsigned long long *packets,
+      unsigned long long *dropped)
+{
+   __atomic_store_n(&c->stop, 1, __ATOMIC_RELEASE);
+   pthread_join(c->thread, NULL);
+   close(c->fd);
+
+   if (packets)
+      *packets = c->packets;
+   if (dropped)
+      *dropped = c->dropped;
+   free(c->index);
+   free(c->slot);
+   free(c->blk);
+   free(c);
+}
+
+
+/*
+ * Reader
+ */
+static int read_at(FILE *fp, unsigned long long offset, void *buf,
+      size_t len)
+{
+   if (fseeko(fp, offset, SEEK_SET) || fread(buf, 1, len, fp) != len)
+      return -1;
+   return 0;
+}
+
+static int read_index(struct capture_reader *r, unsigned long long size)
+{
+   unsigned char buf[CAPTURE_INDEX_ENTRY];
+   unsigned long long offset;
+   unsigned int i;
+
+   if (size < CAPTURE_FILE_HEADER + CAPTURE_INDEX_HEADER + CAPTURE_TRAILER ||
+         read_at(r->fp, size - CAPTURE_TRAILER, buf, CAPTURE_TRAILER) ||
+         get32(buf + 8) != MAGIC_END)
+      return -1;
+
+   offset = get64(buf);
+   if (offset + CAPTURE_INDEX_HEADER > size ||
+         read_at(r->fp, offset, buf, CAPTURE_INDEX_HEADER) ||
+         get32(buf) != MAGIC_INDEX)
+      return -1;
+
+   r->blocks = get32(buf + 4);
+   r->packets = get64(buf + 8);
+   r->dropped = get64(buf + 16);
+   if (offset + CAPTURE_INDEX_HEADER + (unsigned long long) r->blocks *
+         CAPTURE_INDEX_ENTRY + CAPTURE_TRAILER != size)
+      return -1;
+   if ((r->block = calloc(r->blocks + 1, sizeof(*r->block))) == NULL)
+      return -1;
+
+   for (i = 0; i < r->blocks; i++) {
+      if (fread(buf, 1, CAPTURE_INDEX_ENTRY, r->fp) != CAPTURE_INDEX_ENTRY)
+         return -1;
+      r->block[i].offset = get64(buf);
+      r->block[i].first_ns = get64(buf + 8);
+      r->block[i].last_ns = get64(buf + 16);
+      r->block[i].records = get32(buf + 24);
+   }
+   r->indexed = 1;
+   return 0;
+}
+
+/* Walks the blocks of a file that was not closed, up to the first torn one */
+static int rebuild_index(struct capture_reader *r, unsigned long long size)
+{
+   unsigned char buf[CAPTURE_BLOCK_HEADER];
+   unsigned long long offset = CAPTURE_FILE_HEADER;
+   struct capture_block *b;
+   unsigned int size_alloc = 0;
+
+   free(r->block);
+   r->block = NULL;
+   r->blocks = 0;
+   r->packets = r->dropped = 0;
+
+   while (offset + CAPTURE_BLOCK_HEADER <= size &&
+         !read_at(r->fp, offset, buf, CAPTURE_BLOCK_HEADER) &&
+         get32(buf) == MAGIC_BLOCK && get32(buf + 4) <= r->block_size &&
+         offset + CAPTURE_BLOCK_HEADER + get32(buf + 4) <= size) {
+      if (r->blocks == size_alloc) {
+         size_alloc = size_alloc ? 2 * size_alloc : 64;
+         if ((b = realloc(r->block, size_alloc * sizeof(*b))) == NULL)
+            return -1;
+         r->block = b;
+      }
+      b = &r->block[r->blocks++];
+      b->offset = offset;
+      b->records = get32(buf + 8);
+      b->first_ns = get64(buf + 16);
+      b->last_ns = get64(buf + 24);
+      offset += CAPTURE_BLOCK_HEADER + get32(buf + 4);
+   }
+   return 0;
+}
+
+int capture_reader_open(struct capture_reader *r, const char *path)
+{
+   unsigned char header[CAPTURE_FILE_HEADER];
+   unsigned long long size;
+
+   memset(r, 0, sizeof(*r));
+   if ((r->fp = fopen(path, "rb")) == NULL)
+      return -1;
+
+   if (fread(header, 1, sizeof(header), r->fp) != sizeof(header) ||
+         memcmp(header, MAGIC_FILE, 8) ||
+         get16(header + 8) != CAPTURE_VERSION) {
+      errno = EINVAL;
+      goto fail;
+   }
+   r->flags = get16(header + 10);
+   r->block_size = get32(header + 12);
+   r->start_realtime_ns = get64(header + 16);
+   r->start_ns = get64(header + 24);
+
+   if ((r->data = malloc(r->block_size)) == NULL ||
+         fseeko(r->fp, 0, SEEK_END))
+      goto fail;
+   size = ftello(r->fp);
+
+   if (read_index(r, size) && rebuild_index(r, size))
+      goto fail;
+   return 0;
+
+fail:
+   capture_reader_close(r);
+   return -1;
+}
+
+void capture_reader_close(struct capture_reader *r)
+{
+   if (r->fp)
+      fclose(r->fp);
+   free(r->block);
+   free(r->data);
+   memset(r, 0, sizeof(*r));
+}
+
+int capture_seek(struct capture_reader *r, unsigned long long time_ns)
+{
+   unsigned int lo = 0, hi = r->blocks, mid;
+
+   /* First block that ends at or after time_ns */
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (r->block[mid].last_ns < time_ns)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   r->cur = lo;
+   r->data_len = r->pos = 0;
+   return lo < r->blocks ? 0 : -1;
+}
+
+static int load_block(struct capture_reader *r)
+{
+   unsigned char header[CAPTURE_BLOCK_HEADER];
+   unsigned int len;
+
+   if (r->cur >= r->blocks)
+      return 0;
+   if (read_at(r->fp, r->block[r->cur].offset, header, sizeof(header)) ||
+         get32(header) != MAGIC_BLOCK ||
+         (len = get32(header + 4)) > r->block_size ||
+         fread(r->data, 1, len, r->fp) != len)
+      return -1;
+
+   r->cur++;
+   r->data_len = len;
+   r->pos = 0;
+   memset(r->delta, 0, sizeof(r->delta));
+   return 1;
+}
+
+int capture_next(struct capture_reader *r, struct capture_packet *p)
+{
+   const unsigned char *rec;
+   unsigned int type, source, stored, len;
+   int ret;
+
+   while (1) {
+      if (r->pos >= r->data_len) {
+         if ((ret = load_block(r)) <= 0)
+            return ret;
+         continue;
+      }
+
+      if (r->data_len - r->pos < CAPTURE_RECORD_HEADER)
+         return -1;
+      rec = r->data + r->pos;
+      type = rec[0];
+      source = get16(rec + 2);
+      stored = get32(rec + 4);
+      len = get32(rec + 8);
+      if (stored > r->data_len - r->pos - CAPTURE_RECORD_HEADER ||
+            PAD4(stored) > r->data_len - r->pos - CAPTURE_RECORD_HEADER)
+         return -1;
+      r->pos += CAPTURE_RECORD_HEADER + PAD4(stored);
+
+      if (source >= CAPTURE_MAX_SOURCES)
+         return -1;
+
+      switch (type) {
+         case CAPTURE_SOURCE:
+            if (stored < SOURCE_LEN)
+               return -1;
+            r->source[source].family = get16(rec + CAPTURE_RECORD_HEADER);
+            r->source[source].port = get16(rec + CAPTURE_RECORD_HEADER + 2);
+            memcpy(r->source[source].addr, rec + CAPTURE_RECORD_HEADER + 4,
+                  16);
+            continue;
+
+         case CAPTURE_PACKET:
+            if (len != stored)
+               return -1;
+            p->data = rec + CAPTURE_RECORD_HEADER;
+            break;
+
+         case CAPTURE_PACKET_DELTA:
+            if (len > CAPTURE_MAX_PACKET ||
+                  capture_delta_decode(&r->delta[source],
+                     rec + CAPTURE_RECORD_HEADER, stored, len, r->packet) < 0)
+               return -1;
+            p->data = r->packet;
+            break;
+
+         default:
+            /* Record types of later versions */
+            continue;
+      }
+
+      p->time_ns = get64(rec + 12);
+      p->source = source;
+      p->from = &r->source[source];
+      p->len = len;
+      p->stored = CAPTURE_RECORD_HEADER + PAD4(stored);
+      return 1;
+   }
+}
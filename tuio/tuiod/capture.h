@@ -0,0 +1,161 @@
+/*
+ * Binary capture of the OSC packets tuiod receives (tuiod -r), for replay
+ * and benchmarking. Read back with capture_reader_*, see tuio/tuiocap.
+ *
+ * The file is append only. All numbers are little endian:
+ *
+ *    file header    "TUIOCAP\0", u16 version, u16 flags, u32 block size,
+ *                   u64 start (CLOCK_REALTIME ns), u64 start (MONOTONIC ns)
+ *    block ...      u32 "TCB1", u32 bytes of records, u32 records,
+ *                   u32 reserved, u64 first and u64 last record time
+ *       record ...  u8 type, u8 reserved, u16 source, u32 stored bytes,
+ *                   u32 packet bytes, u64 time (MONOTONIC ns), then the
+ *                   stored bytes padded to 4
+ *    index          u32 "TCI1", u32 blocks, u64 packets, u64 dropped, then
+ *                   per block u64 offset, u64 first, u64 last, u32 records,
+ *                   u32 reserved
+ *    trailer        u64 index offset, u32 "TCE1", u32 reserved
+ *
+ * The index and trailer are written on close; a file without them (tuiod
+ * was killed) is read by walking the blocks. Blocks are written when full
+ * or a second old and stand alone: each starts by declaring every source
+ * seen so far (CAPTURE_SOURCE records: u16 family, u16 port, 16 byte
+ * address) and resets the delta state, so a reader can start at any block.
+ *
+ * CAPTURE_PACKET records hold the datagram as received. With CAPTURE_DELTA
+ * (CAPTURE_PACKET_DELTA records) every 52 byte "/tuio/2Dcur set" message
+ * is stored as a tag byte 1, its session id as a LEB128
+ * varint, and its five floats as varints of the zigzagged difference of
+ * their bits from the same session's previous message. Positions of a
+ * contact change little from frame to frame, so the message mostly shrinks
+ * to 15 bytes. Other 52 byte elements get a tag byte 0 and are copied, the
+ * rest of the packet is copied as is. Decoding restores the packet byte
+ * for byte.
+ *
+ * The writer never blocks the receive path: capture_packet copies the
+ * packet into a single producer, single consumer ring and a writer thread
+ * encodes and writes it. When the ring is full packets are dropped, and
+ * counted in the index.
+ */
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdio.h>
+#include <sys/socket.h>
+
+#define CAPTURE_VERSION 1
+#define CAPTURE_DELTA 0x0001       /* File flag: delta coded coordinates */
+
+#define CAPTURE_BLOCK_SIZE 65536   /* Record bytes per block, at most */
+#define CAPTURE_BLOCK_NS 1000000000ULL /* Oldest unwritten record */
+#define CAPTURE_MAX_PACKET 4096    /* Larger packets are dropped */
+#define CAPTURE_RING 1024          /* Packets buffered for the writer */
+#define CAPTURE_MAX_SOURCES 64     /* Senders told apart; more share id 0 */
+#define CAPTURE_DELTA_SLOTS 64     /* Sessions remembered per source */
+
+#define CAPTURE_FILE_HEADER 32
+#define CAPTURE_BLOCK_HEADER 32
+#define CAPTURE_RECORD_HEADER 20
+#define CAPTURE_INDEX_HEADER 24
+#define CAPTURE_INDEX_ENTRY 32
+#define CAPTURE_TRAILER 16
+
+/* Record types */
+#define CAPTURE_PACKET 1
+#define CAPTURE_PACKET_DELTA 2
+#define CAPTURE_SOURCE 3
+
+struct capture_source {
+   unsigned short family;          /* AF_INET, AF_INET6 */
+   unsigned short port;            /* Host order */
+   unsigned char addr[16];         /* Network order, IPv4 in the first 4 */
+};
+
+struct capture_block {
+   unsigned long long offset;      /* Of the block header */
+   unsigned long long first_ns;
+   unsigned long long last_ns;
+   unsigned int records;
+};
+
+/* Per source delta state, see CAPTURE_DELTA */
+struct capture_delta {
+   unsigned int id[CAPTURE_DELTA_SLOTS];
+   unsigned int bits[CAPTURE_DELTA_SLOTS][5];
+};
+
+/*
+ * Writer
+ */
+struct capture;
+
+/* Creates the file and starts the writer thread. NULL on error (errno) */
+struct capture *capture_open(const char *path, int flags);
+
+/*
+ * Queues a received packet, timestamped now. Never blocks; returns -1 if
+ * the packet was dropped (ring full or larger than CAPTURE_MAX_PACKET).
+ */
+int capture_packet(struct capture *c, const struct sockaddr *from,
+      const void *data, int len);
+
+/* Writes what is queued, the index and the trailer, and frees c */
+void capture_close(struct capture *c, unsigned long long *packets,
+      unsigned long long *dropped);
+
+/*
+ * Reader
+ */
+struct capture_reader {
+   FILE *fp;
+   int flags;
+   unsigned int block_size;
+   unsigned long long start_realtime_ns;
+   unsigned long long start_ns;
+
+   struct capture_block *block;    /* Index, from the file or rebuilt */
+   unsigned int blocks;
+   unsigned long long packets;     /* As recorded in the index, else 0 */
+   unsigned long long dropped;
+   int indexed;                    /* The file had an index */
+
+   unsigned int cur;               /* Next block to load */
+   unsigned char *data;            /* Records of the loaded block */
+   unsigned int data_len;
+   unsigned int pos;
+
+   struct capture_source source[CAPTURE_MAX_SOURCES];
+   struct capture_delta delta[CAPTURE_MAX_SOURCES];
+   unsigned char packet[CAPTURE_MAX_PACKET];
+};
+
+struct capture_packet {
+   unsigned long long time_ns;     /* CLOCK_MONOTONIC when received */
+   unsigned int source;
+   const struct capture_source *from;
+   const unsigned char *data;      /* Valid until the next capture_next */
+   unsigned int len;
+   unsigned int stored;            /* Bytes it took in the file */
+};
+
+/* Opens a capture and loads or rebuilds its index. 0, or -1 on error */
+int capture_reader_open(struct capture_reader *r, const char *path);
+void capture_reader_close(struct capture_reader *r);
+
+/* Continues from the block holding time_ns (or the next one after it) */
+int capture_seek(struct capture_reader *r, unsigned long long time_ns);
+
+/* Reads the next packet: 1, 0 at the end, -1 on a corrupt record */
+int capture_next(struct capture_reader *r, struct capture_packet *p);
+
+/*
+ * Delta coding of one packet (see CAPTURE_DELTA). Encoding takes any
+ * input and returns the bytes written to out, which must have room for
+ * 2 * len. Decoding returns len, or -1 if the stored bytes are corrupt.
+ */
+long capture_delta_encode(struct capture_delta *d, const unsigned char *in,
+      unsigned int len, unsigned char *out);
+long capture_delta_decode(struct capture_delta *d, const unsigned char *in,
+      unsigned int stored, unsigned int len, unsigned char *out);
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Delta output of the /tuio/2Dcur frames, see delta.h
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "delta.h"
+#include "tlog.h"
+
+struct contact {
+   unsigned long id;
+   float x, y;                     /* As last passed on */
+};
+
+/* The one sender delta coded, see delta.h */
+struct sender {
+   int source;                     /* Its fseq_frame source */
+   int off;                        /* Another sender came, all go whole */
+   int started;
+   int key;                        /* The frame goes out whole */
+   int overran;                    /* More contacts than the table holds */
+   unsigned int frame;
+   int count;
+   struct contact contact[DELTA_MAX_CONTACTS];
+};
+
+static void (*output)(const char *line);
+static struct sender sender;
+
+
+void delta_init(void (*out)(const char *line))
+{
+   output = out;
+}
+
+static struct contact *find(struct sender *d, unsigned long id)
+{
+   int i;
+
+   for (i = 0; i < d->count; i++)
+      if (d->contact[i].id == id)
+         return &d->contact[i];
+   return NULL;
+}
+
+static int is_alive(unsigned long id, const char *types, lo_arg **argv,
+      int argc)
+{
+   int i;
+
+   for (i = 1; i < argc; i++)
+      if (types[i] == 'i' && (unsigned long) argv[i]->i == id)
+         return 1;
+   return 0;
+}
+
+/* Starts a frame: whole, or a delta after the contacts lifted */
+static int alive(struct sender *d, const char *types, lo_arg **argv,
+      int argc)
+{
+   char line[64];
+   int i;
+
+   d->key = !d->started || d->overran || !(d->frame % DELTA_KEYFRAME);
+   d->started = 1;
+   if (d->key) {
+      d->count = 0;
+      d->overran = 0;
+      return DELTA_PASS;
+   }
+
+   output(DELTA_PROFILE " delta\n");
+   for (i = 0; i < d->count; i++) {
+      if (is_alive(d->contact[i].id, types, argv, argc))
+         continue;
+      snprintf(line, sizeof(line), DELTA_PROFILE " gone %lu\n",
+            d->contact[i].id);
+      output(line);
+      d->contact[i--] = d->contact[--d->count];
+   }
+   return DELTA_SKIP;
+}
+
+static int set(struct sender *d, lo_arg **argv)
+{
+   struct contact *c = find(d, argv[1]->i);
+   float x = argv[2]->f, y = argv[3]->f;
+
+   if (c && !d->key && x - c->x < DELTA_THRESHOLD &&
+         c->x - x < DELTA_THRESHOLD && y - c->y < DELTA_THRESHOLD &&
+         c->y - y < DELTA_THRESHOLD)
+      return DELTA_SKIP;
+
+   if (!c) {
+      if (d->count == DELTA_MAX_CONTACTS) {
+         d->overran = 1;
+         return DELTA_PASS;
+      }
+      c = &d->contact[d->count++];
+      c->id = argv[1]->i;
+   }
+   c->x = x;
+   c->y = y;
+   return DELTA_PASS;
+}
+
+int delta_message(int source, const char *path, const char *types,
+      lo_arg **argv, int argc)
+{
+   struct sender *d = &sender;
+   const char *cmd;
+
+   if (!output || d->off || argc < 1 || types[0] != 's' ||
+         strcmp(path, DELTA_PROFILE))
+      return DELTA_PASS;
+   cmd = &argv[0]->s;
+
+   /* One sender only: a delta is of the last frame of any */
+   if (!strcmp(cmd, "alive") && (source < 0 ||
+            (d->started && source != d->source))) {
+      tlog(TLOG_WARN, "Delta: frames of another sender (source %ld), "
+            "passing all on whole from now", source, 0);
+      d->off = 1;
+      return DELTA_PASS;
+   }
+   if (!strcmp(cmd, "alive")) {
+      d->source = source;
+      return alive(d, types, argv, argc);
+   }
+   if (!d->started || source != d->source)
+      return DELTA_PASS;
+   if (!strcmp(cmd, "set") && argc >= 4 && !strncmp(types, "siff", 4))
+      return set(d, argv);
+   if (!strcmp(cmd, "fseq"))
+      d->frame++;
+   return DELTA_PASS;
+}
+
+long delta_save(void *state, size_t max)
+{
+   if (sizeof(sender) > max)
+      return -1;
+   memcpy(state, &sender, sizeof(sender));
+   return sizeof(sender);
+}
+
+int delta_restore(const void *state, size_t len)
+{
+   if (len != sizeof(sender))
+      return -1;
+   memcpy(&sender, state, len);
+   return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Delta output of the /tuio/2Dcur frames (tuiod -d).
+ *
+ * Trackers send every contact in every frame, so with a few fingers
+ * resting on the table most of what tuiod passes on are repeats. In delta
+ * mode tuiod keeps the last frame it passed on and sends only what
+ * changed:
+ *
+ *    /tuio/2Dcur delta          instead of the alive message: the frame
+ *                               starts as a copy of the last one
+ *    /tuio/2Dcur gone 4         contact 4 lifted
+ *    /tuio/2Dcur set 7 ...      contact 7 new, or moved DELTA_THRESHOLD
+ *                               or more since it was last sent
+ *    /tuio/2Dcur fseq 1234      as ever, ends the frame
+ *
+ * Every DELTA_KEYFRAME frames, and after the contact table overran, the
+ * frame goes out whole, so a consumer that missed lines (the /dev/tuio
+ * ring overwrites the oldest when full) catches up. touchcore takes both.
+ *
+ * touchcore keeps a single last frame, whoever sent it, so only one
+ * sender's frames can be delta coded. Once a second sender's /tuio/2Dcur
+ * frames come (or of a sender fseq.h could not tell apart), every frame
+ * goes out whole until tuiod restarts, and that is logged.
+ */
+#ifndef __DELTA_H__
+#define __DELTA_H__
+
+#include <stddef.h>
+#include <lo/lo.h>
+
+#define DELTA_PROFILE "/tuio/2Dcur"
+#define DELTA_MAX_CONTACTS 64      /* Contacts remembered a sender */
+#define DELTA_THRESHOLD 0.0005f    /* Movement sent, of the surface */
+#define DELTA_KEYFRAME 60          /* Frames between whole frames */
+
+/* delta_message results */
+#define DELTA_PASS 0               /* Pass the message on */
+#define DELTA_SKIP 1               /* Leave it out */
+
+/*
+ * Turns delta output on; output writes the lines delta_message adds
+ * (with a trailing newline)
+ */
+void delta_init(void (*output)(const char *line));
+
+/*
+ * Checks a message of sender source (-1 if unknown), passing on the lines
+ * that replace it through output. Returns DELTA_PASS or DELTA_SKIP.
+ */
+int delta_message(int source, const char *path, const char *types,
+      lo_arg **argv, int argc);
+
+/*
+ * The last frame passed on, for tuiod's successor (handover.h):
+ * delta_save copies it to state, returning its length, -1 if over max;
+ * delta_restore takes it back, returning -1 if it does not fit.
+ */
+long delta_save(void *state, size_t max);
+int delta_restore(const void *state, size_t len);
+
+#endif
@@ -0,0 +1,468 @@
+/*
+ * Frames for local clients over a SOCK_SEQPACKET socket, see fanout.h
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "fanout.h"
+#include "tlog.h"
+
+#define RECORD_MAX (sizeof(struct fanout_record) + \
+      FANOUT_MAX_CONTACTS * sizeof(struct fanout_contact))
+
+/* Where a profile's set message has the contact, -1 for none */
+struct layout {
+   const char *profile;
+   int class_id, x, y, angle, vx, vy, accel;
+};
+
+static const struct layout layouts[] = {
+   /* set s x y X Y m */
+   { "/tuio/2Dcur", -1, 2, 3, -1, 4, 5, 6 },
+   /* set s i x y a X Y A m r */
+   { "/tuio/2Dobj", 2, 3, 4, 5, 6, 7, 9 },
+   /* set s x y a w h f X Y A m r */
+   { "/tuio/2Dblb", -1, 2, 3, 4, 8, 9, 11 },
+   /* Anything else, its first two floats */
+   { NULL, -1, 2, 3, -1, -1, -1, -1 },
+};
+
+/* The contacts alive of a sender's profile */
+struct table {
+   int used;
+   int source;
+   char profile[FANOUT_PROFILE_LEN];
+   const struct layout *layout;
+   long lost;                      /* For the next frame, fanout_begin */
+   long long time_ns;
+   unsigned long long seen_ns;     /* Last message */
+   int count;
+   struct fanout_contact contact[FANOUT_MAX_CONTACTS];
+};
+
+struct queued {
+   size_t len;
+   union {
+      struct fanout_record record;
+      unsigned char data[RECORD_MAX];
+   } u;
+};
+
+struct client {
+   int fd;                         /* -1 when free */
+   struct fanout_subscribe sub;
+   int head, count;                /* The queue */
+   unsigned long long since;       /* Queue stuck since, 0 if moving */
+   struct queued queue[FANOUT_QUEUE];
+};
+
+static struct table tables[FANOUT_TABLES];
+static struct client clients[FANOUT_MAX_CLIENTS];
+static int listen_fd = -1;
+static char *sock_path;
+static ino_t sock_ino;
+static struct queued scratch;
+static int refused;                /* A sender's frames were left out */
+
+
+int fanout_open(const char *path)
+{
+   struct sockaddr_un addr;
+   struct stat st;
+   int i, err;
+
+   if (strlen(path) >= sizeof(addr.sun_path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   for (i = 0; i < FANOUT_MAX_CLIENTS; i++)
+      clients[i].fd = -1;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+   if ((listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK |
+               SOCK_CLOEXEC, 0)) < 0)
+      return -1;
+   unlink(path);
+   if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+         listen(listen_fd, FANOUT_MAX_CLIENTS) < 0 ||
+         stat(path, &st) < 0 || (sock_path = strdup(path)) == NULL) {
+      err = errno;
+      close(listen_fd);
+      listen_fd = -1;
+      errno = err;
+      return -1;
+   }
+   sock_ino = st.st_ino;
+   return listen_fd;
+}
+
+static void drop_client(struct client *c, const char *why)
+{
+   tlog_s(TLOG_WARN, "Fanout: dropped a client, %s (slot %ld)", why,
+         c - clients);
+   close(c->fd);
+   c->fd = -1;
+}
+
+void fanout_close(void)
+{
+   struct stat st;
+   int i;
+
+   if (listen_fd < 0)
+      return;
+   for (i = 0; i < FANOUT_MAX_CLIENTS; i++) {
+      if (clients[i].fd >= 0)
+         close(clients[i].fd);
+      clients[i].fd = -1;
+   }
+   close(listen_fd);
+   listen_fd = -1;
+   /* Unless a tuiod taken over from this one serves there now */
+   if (stat(sock_path, &st) == 0 && st.st_ino == sock_ino)
+      unlink(sock_path);
+   free(sock_path);
+   sock_path = NULL;
+}
+
+int fanout_pollfds(struct pollfd *pfd)
+{
+   int i, n = 0;
+
+   if (listen_fd < 0)
+      return 0;
+   pfd[n].fd = listen_fd;
+   pfd[n++].events = POLLIN;
+   for (i = 0; i < FANOUT_MAX_CLIENTS; i++) {
+      if (clients[i].fd < 0)
+         continue;
+      pfd[n].fd = clients[i].fd;
+      pfd[n++].events = POLLIN | (clients[i].count ? POLLOUT : 0);
+   }
+   return n;
+}
+
+/* Sends what is queued for c, in one go; 0, or -1 if c was dropped */
+static int flush(struct client *c, unsigned long long now)
+{
+   struct mmsghdr msgs[FANOUT_QUEUE];
+   struct iovec iov[FANOUT_QUEUE];
+   struct queued *q;
+   int i, sent;
+
+   memset(msgs, 0, c->count * sizeof(msgs[0]));
+   for (i = 0; i < c->count; i++) {
+      q = &c->queue[(c->head + i) % FANOUT_QUEUE];
+      iov[i].iov_base = q->u.data;
+      iov[i].iov_len = q->len;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+
+   sent = c->count ? sendmmsg(c->fd, msgs, c->count, MSG_DONTWAIT |
+         MSG_NOSIGNAL) : 0;
+   if (sent < 0 && errno != EAGAIN) {
+      drop_client(c, "gone");
+      return -1;
+   }
+   if (sent > 0) {
+      c->head = (c->head + sent) % FANOUT_QUEUE;
+      c->count -= sent;
+   }
+
+   /* Waiting with nothing taken for too long */
+   if (!c->count || sent > 0)
+      c->since = c->count ? now : 0;
+   else if (!c->since)
+      c->since = now;
+   else if (now - c->since > FANOUT_STALL_NS) {
+      drop_client(c, "too slow");
+      return -1;
+   }
+   return 0;
+}
+
+static void accept_clients(void)
+{
+   struct client *c;
+   int fd, i, sndbuf = FANOUT_SNDBUF;
+
+   while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK |
+               SOCK_CLOEXEC)) >= 0) {
+      for (i = 0; i < FANOUT_MAX_CLIENTS && clients[i].fd >= 0; i++)
+         ;
+      if (i == FANOUT_MAX_CLIENTS) {
+         tlog(TLOG_WARN, "Fanout: %ld clients already, refused one",
+               FANOUT_MAX_CLIENTS, 0);
+         close(fd);
+         continue;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+      c = &clients[i];
+      memset(c, 0, sizeof(*c) - sizeof(c->queue));
+      c->fd = fd;
+      tlog(TLOG_INFO, "Fanout: client %ld connected", i, 0);
+   }
+}
+
+/* A subscription from c, or its hang up */
+static void subscribe(struct client *c)
+{
+   struct fanout_subscribe sub;
+   ssize_t n;
+
+   while ((n = recv(c->fd, &sub, sizeof(sub), MSG_DONTWAIT)) != 0) {
+      if (n < 0) {
+         if (errno != EAGAIN)
+            drop_client(c, "gone");
+         return;
+      }
+      if (n != sizeof(sub)) {
+         tlog(TLOG_WARN, "Fanout: client %ld sent %ld bytes, not a "
+               "subscription", c - clients, n);
+         continue;
+      }
+      sub.profile[FANOUT_PROFILE_LEN - 1] = '\0';
+      c->sub = sub;
+   }
+   drop_client(c, "hung up");
+}
+
+void fanout_poll(const struct pollfd *pfd, int n, unsigned long long now)
+{
+   struct client *c;
+   int i, k;
+
+   for (i = 0; i < n; i++) {
+      if (!pfd[i].revents)
+         continue;
+      if (pfd[i].fd == listen_fd) {
+         accept_clients();
+         continue;
+      }
+      for (k = 0, c = NULL; k < FANOUT_MAX_CLIENTS && !c; k++)
+         if (clients[k].fd == pfd[i].fd)
+            c = &clients[k];
+      if (!c)
+         continue;
+      if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))
+         subscribe(c);
+      if (c->fd >= 0 && (pfd[i].revents & POLLOUT))
+         flush(c, now);
+   }
+}
+
+/*
+ * The table of a sender's profile, new in a free one or the one idle
+ * longest past FANOUT_IDLE_NS; NULL if all are in use
+ */
+static struct table *find_table(int source, const char *profile,
+      unsigned long long now)
+{
+   struct table *free_table = NULL;
+   const struct layout *l;
+   int i;
+
+   for (i = 0; i < FANOUT_TABLES; i++) {
+      if (!tables[i].used) {
+         if (!free_table || free_table->used)
+            free_table = &tables[i];
+      } else if (tables[i].source == source &&
+            !strcmp(tables[i].profile, profile)) {
+         tables[i].seen_ns = now;
+         return &tables[i];
+      } else if (now - tables[i].seen_ns >= FANOUT_IDLE_NS &&
+            (!free_table || (free_table->used &&
+               tables[i].seen_ns < free_table->seen_ns))) {
+         free_table = &tables[i];
+      }
+   }
+   if (strlen(profile) >= FANOUT_PROFILE_LEN)
+      return NULL;
+   if (!free_table) {
+      if (!refused)
+         tlog_s(TLOG_WARN, "Fanout: %s frames of sender %ld left out, all "
+               "tables in use", profile, source);
+      refused = 1;
+      return NULL;
+   }
+
+   for (l = layouts; l->profile && strcmp(l->profile, profile); l++)
+      ;
+   memset(free_table, 0, sizeof(*free_table));
+   free_table->used = 1;
+   free_table->source = source;
+   strcpy(free_table->profile, profile);
+   free_table->layout = l;
+   free_table->seen_ns = now;
+   refused = 0;
+   return free_table;
+}
+
+void fanout_begin(int source, const char *profile, long lost,
+      long long time_ns, unsigned long long now)
+{
+   struct table *t;
+
+   if (listen_fd < 0 || (t = find_table(source, profile, now)) == NULL)
+      return;
+   t->lost += lost;
+   t->time_ns = time_ns;
+}
+
+static float arg_float(const char *types, lo_arg **argv, int argc, int i)
+{
+   return i >= 0 && i < argc && types[i] == 'f' ? argv[i]->f : 0;
+}
+
+/* The contacts not in an alive message are gone */
+static void alive(struct table *t, const char *types, lo_arg **argv,
+      int argc)
+{
+   int i, k;
+
+   for (i = 0; i < t->count; i++) {
+      for (k = 1; k < argc; k++)
+         if (types[k] == 'i' && (uint32_t) argv[k]->i == t->contact[i].id)
+            break;
+      if (k == argc)
+         t->contact[i--] = t->contact[--t->count];
+   }
+}
+
+static void set(struct table *t, const char *types, lo_arg **argv,
+      int argc)
+{
+   const struct layout *l = t->layout;
+   struct fanout_contact *c;
+   uint32_t id;
+   int i;
+
+   if (argc < 2 || types[1] != 'i')
+      return;
+   id = argv[1]->i;
+   for (i = 0; i < t->count && t->contact[i].id != id; i++)
+      ;
+   if (i == t->count) {
+      if (t->count == FANOUT_MAX_CONTACTS)
+         return;
+      t->count++;
+   }
+
+   c = &t->contact[i];
+   c->id = id;
+   c->class_id = l->class_id >= 0 && l->class_id < argc &&
+      types[l->class_id] == 'i' ? argv[l->class_id]->i : 0;
+   c->x = arg_float(types, argv, argc, l->x);
+   c->y = arg_float(types, argv, argc, l->y);
+   c->angle = arg_float(types, argv, argc, l->angle);
+   c->vx = arg_float(types, argv, argc, l->vx);
+   c->vy = arg_float(types, argv, argc, l->vy);
+   c->accel = arg_float(types, argv, argc, l->accel);
+}
+
+static int in_region(const struct fanout_subscribe *sub,
+      const struct fanout_contact *c)
+{
+   if (!sub->x0 && !sub->y0 && !sub->x1 && !sub->y1)
+      return 1;
+   return c->x >= sub->x0 && c->x <= sub->x1 &&
+      c->y >= sub->y0 && c->y <= sub->y1;
+}
+
+/* The record of t as client c subscribed, into scratch */
+static void build(const struct table *t, const struct client *c, long fseq)
+{
+   struct fanout_record *r = &scratch.u.record;
+   struct fanout_contact *out = (struct fanout_contact *) (r + 1);
+   int i;
+
+   memset(r, 0, sizeof(*r));
+   r->magic = FANOUT_MAGIC;
+   r->source = t->source;
+   strcpy(r->profile, t->profile);
+   r->fseq = fseq;
+   r->lost = t->lost;
+   r->time_ns = t->time_ns;
+   for (i = 0; i < t->count; i++)
+      if (in_region(&c->sub, &t->contact[i]))
+         out[r->count++] = t->contact[i];
+   scratch.len = sizeof(*r) + r->count * sizeof(*out);
+}
+
+/*
+ * Queues scratch for c; when full it replaces the newest record of the
+ * same sender and profile, or else the oldest
+ */
+static void enqueue(struct client *c)
+{
+   struct fanout_record *r = &scratch.u.record, *old;
+   struct queued *q = NULL;
+   int i;
+
+   if (c->count < FANOUT_QUEUE) {
+      q = &c->queue[(c->head + c->count++) % FANOUT_QUEUE];
+   } else {
+      for (i = c->count - 1; i >= 0 && !q; i--) {
+         old = &c->queue[(c->head + i) % FANOUT_QUEUE].u.record;
+         if (old->source == r->source && !strcmp(old->profile, r->profile))
+            q = &c->queue[(c->head + i) % FANOUT_QUEUE];
+      }
+      if (q) {
+         r->coalesced += q->u.record.coalesced + 1;
+         r->lost += q->u.record.lost;
+      } else {
+         /* None to replace: the oldest goes */
+         c->head = (c->head + 1) % FANOUT_QUEUE;
+         q = &c->queue[(c->head + FANOUT_QUEUE - 1) % FANOUT_QUEUE];
+      }
+   }
+   q->len = scratch.len;
+   memcpy(q->u.data, scratch.u.data, scratch.len);
+}
+
+/* Sends the frame of t to the clients subscribed to it */
+static void frame(struct table *t, long fseq, unsigned long long now)
+{
+   struct client *c;
+   int i;
+
+   for (i = 0; i < FANOUT_MAX_CLIENTS; i++) {
+      c = &clients[i];
+      if (c->fd < 0 || (c->sub.profile[0] &&
+               strcmp(c->sub.profile, t->profile)))
+         continue;
+      build(t, c, fseq);
+      enqueue(c);
+      flush(c, now);
+   }
+   t->lost = 0;
+   t->time_ns = 0;
+}
+
+void fanout_message(int source, const char *path, const char *types,
+      lo_arg **argv, int argc, unsigned long long now)
+{
+   struct table *t;
+   const char *cmd;
+
+   if (listen_fd < 0 || argc < 1 || types[0] != 's' ||
+         (t = find_table(source, path, now)) == NULL)
+      return;
+   cmd = &argv[0]->s;
+
+   if (!strcmp(cmd, "alive"))
+      alive(t, types, argv, argc);
+   else if (!strcmp(cmd, "set"))
+      set(t, types, argv, argc);
+   else if (!strcmp(cmd, "fseq") && argc >= 2 && types[1] == 'i')
+      frame(t, argv[1]->i, now);
+}
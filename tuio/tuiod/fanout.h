@@ -0,0 +1,105 @@
+/*
+ * Frames for any number of local clients (tuiod -s path).
+ *
+ * /dev/tuio has a single reader, the touchmouse module. With -s tuiod
+ * also serves a SOCK_SEQPACKET Unix socket at path, and every client
+ * connected gets each frame as one binary record: a fanout_record and
+ * its contacts, all in host order:
+ *
+ *    struct fanout_record      sender, profile, fseq, frames lost, ...
+ *    struct fanout_contact     count of them, the contacts alive
+ *
+ * A client takes every frame of the profiles tuiod passes on (-p) until
+ * it sends a fanout_subscribe, narrowing them to one profile and the
+ * contacts within a region; it may send another any time.
+ *
+ * Frames are whole (the contacts a tracker did not "set" again keep their
+ * last values), so a client that falls behind can skip some. Its socket
+ * buffers FANOUT_SNDBUF bytes, and behind that a queue takes FANOUT_QUEUE
+ * records more; when it is full the newest record queued of the same
+ * sender and profile is replaced by the new one, with its coalesced count
+ * up (or else the oldest record goes). A client whose queue has not
+ * moved for FANOUT_STALL_NS is dropped. The records due to a client go
+ * out in one sendmmsg per frame; nothing blocks the receive thread.
+ *
+ * The contacts of FANOUT_TABLES senders by profile are tracked; one whose
+ * messages stop for FANOUT_IDLE_NS gives its table up to a new one. The
+ * frames of a sender finding none free are left out, which is logged.
+ *
+ * Clients are not handed over (handover.h), they connect again.
+ */
+#ifndef __FANOUT_H__
+#define __FANOUT_H__
+
+#include <poll.h>
+#include <stdint.h>
+#include <lo/lo.h>
+
+#define FANOUT_PROFILE_LEN 32
+#define FANOUT_MAX_CONTACTS 64     /* A record */
+#define FANOUT_MAX_CLIENTS 16
+#define FANOUT_QUEUE 8             /* Records waiting a client */
+#define FANOUT_SNDBUF 16384        /* Its socket's, to keep them few */
+#define FANOUT_TABLES 16           /* Senders by profile tracked */
+#define FANOUT_IDLE_NS 10000000000ULL /* Silence that frees a table */
+#define FANOUT_STALL_NS 2000000000ULL
+#define FANOUT_MAGIC 0x31495554    /* "TUI1" */
+
+struct fanout_record {
+   uint32_t magic;
+   uint32_t source;                /* Sender number, as fseq.h */
+   char profile[FANOUT_PROFILE_LEN];
+   int32_t fseq;
+   uint32_t lost;                  /* Frames the tracker sent, lost */
+   uint32_t coalesced;             /* Frames left out, the client slow */
+   uint32_t count;                 /* Contacts following */
+   uint64_t time_ns;               /* Tracker's time since 1970, 0 if none */
+};
+
+struct fanout_contact {
+   uint32_t id;                    /* Session id */
+   uint32_t class_id;              /* Fiducial of /tuio/2Dobj, else 0 */
+   float x, y;                     /* 0 to 1 */
+   float angle;                    /* /tuio/2Dobj and 2Dblb, else 0 */
+   float vx, vy;                   /* Velocity */
+   float accel;
+};
+
+struct fanout_subscribe {
+   char profile[FANOUT_PROFILE_LEN]; /* "" for all */
+   float x0, y0, x1, y1;           /* All 0 for the whole surface */
+};
+
+/*
+ * Starts serving at path, replacing any file there. Returns the listening
+ * descriptor, or -1 on error (errno).
+ */
+int fanout_open(const char *path);
+
+/* Drops the clients and removes the socket */
+void fanout_close(void);
+
+/*
+ * The descriptors to poll, listening socket and clients, into pfd (room
+ * for 1 + FANOUT_MAX_CLIENTS); returns their number
+ */
+int fanout_pollfds(struct pollfd *pfd);
+
+/* Handles what poll returned for them: new clients, subscriptions */
+void fanout_poll(const struct pollfd *pfd, int n, unsigned long long now);
+
+/*
+ * The frames lost before the next one of sender source and profile, and
+ * its time (0 if none), see fseq.h and message.h
+ */
+void fanout_begin(int source, const char *profile, long lost,
+      long long time_ns, unsigned long long now);
+
+/*
+ * Takes a message of sender source; an fseq ends the frame of its
+ * profile, which goes out to the clients subscribed
+ */
+void fanout_message(int source, const char *path, const char *types,
+      lo_arg **argv, int argc, unsigned long long now);
+
+#endif
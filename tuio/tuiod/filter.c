@@ -0,0 +1,139 @@
+/*
+ * TUIO profile subscriptions of tuiod, see filter.h
+ */
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "filter.h"
+
+#define UDP_HEADER 8               /* Where a UDP socket filter sees data */
+#define BUNDLE_FIRST 20            /* "#bundle", timetag, element size */
+
+#define ACCEPT 0xffffffff          /* Snap length: the whole datagram */
+
+static char profiles[FILTER_MAX_PROFILES][FILTER_PROFILE_LEN + 1] =
+   { FILTER_DEFAULT };
+static int profile_len[FILTER_MAX_PROFILES] = { sizeof(FILTER_DEFAULT) - 1 };
+static int profile_count = 1;       /* 0 for all */
+
+int filter_set(const char *list)
+{
+   const char *p, *end;
+   int len;
+
+   profile_count = 0;
+   if (!strcmp(list, "*"))
+      return 0;
+
+   for (p = list; *p; p = *end ? end + 1 : end) {
+      end = strchr(p, ',');
+      if (!end)
+         end = p + strlen(p);
+      len = end - p;
+      if (!len)
+         continue;
+      if (len > FILTER_PROFILE_LEN || profile_count == FILTER_MAX_PROFILES)
+         return -1;
+      memcpy(profiles[profile_count], p, len);
+      profiles[profile_count][len] = '\0';
+      profile_len[profile_count++] = len;
+   }
+   return 0;
+}
+
+int filter_count(void)
+{
+   return profile_count;
+}
+
+const char *filter_profile(int i)
+{
+   return profiles[i];
+}
+
+static unsigned int get32(const unsigned char *p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* Whether the OSC message of len bytes has a path subscribed */
+static int subscribed(const unsigned char *msg, size_t len)
+{
+   int i;
+
+   for (i = 0; i < profile_count; i++)
+      if (len > (size_t) profile_len[i] &&
+            !memcmp(msg, profiles[i], profile_len[i] + 1))
+         return 1;
+   return 0;
+}
+
+int filter_packet(const unsigned char *data, size_t len)
+{
+   size_t off, size;
+
+   if (!profile_count)
+      return 1;
+   if (len < 16 || memcmp(data, "#bundle", 8))
+      return subscribed(data, len);
+
+   for (off = 16; off + 4 <= len; off += 4 + size) {
+      size = get32(data + off);
+      if (size > len - off - 4)
+         break;
+      if (subscribed(data + off + 4, size))
+         return 1;
+   }
+   return 0;
+}
+
+int filter_program(struct sock_filter *insn)
+{
+   unsigned char word[FILTER_PROFILE_LEN + 4];
+   int n = 0, i, k, words, fail;
+
+   if (!profile_count)
+      return -1;
+
+   /* Datagrams that are not bundles are left to filter_packet */
+   insn[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+         UDP_HEADER);
+   insn[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+         get32((const unsigned char *) "#bun"), 0, 0);
+   fail = n - 1;                   /* Patched to jump to accept below */
+
+   /* The first message's path, padded with NULs like OSC does */
+   for (i = 0; i < profile_count; i++) {
+      memset(word, 0, sizeof(word));
+      memcpy(word, profiles[i], profile_len[i]);
+      words = profile_len[i] / 4 + 1;
+      for (k = 0; k < words; k++) {
+         insn[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+               UDP_HEADER + BUNDLE_FIRST + 4 * k);
+         /* On a mismatch skip the rest of this profile and its accept */
+         insn[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+               get32(word + 4 * k), 0, 2 * (words - k - 1) + 1);
+      }
+      insn[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, ACCEPT);
+   }
+   insn[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+   insn[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, ACCEPT);
+   insn[fail].jf = n - 1 - fail - 1;
+   return n;
+}
+
+int filter_attach(int fd)
+{
+   struct sock_filter insn[FILTER_MAX_INSNS];
+   struct sock_fprog prog;
+   int n;
+
+   if ((n = filter_program(insn)) < 0) {
+      errno = EINVAL;
+      return -1;
+   }
+   prog.len = n;
+   prog.filter = insn;
+   return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
@@ -0,0 +1,50 @@
+/*
+ * The TUIO profiles tuiod passes on (tuiod -p), by default only
+ * /tuio/2Dcur, the one touchmouse understands.
+ *
+ * A TUIO bundle holds the messages of one profile, so datagrams are
+ * filtered whole, before liblo decodes them: a bundle is kept if any of
+ * its messages is of a profile subscribed, a lone message if it is. The
+ * messages that get through are routed to tuiod's handler by a liblo
+ * method per profile.
+ *
+ * filter_attach moves the check into the kernel, as a classic BPF socket
+ * filter on the first message of a bundle, so bundles of other profiles
+ * are not even queued to the socket. Datagrams that are not bundles pass
+ * it, for filter_packet to decide.
+ */
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <stddef.h>
+#include <linux/filter.h>
+
+#define FILTER_MAX_PROFILES 8
+#define FILTER_PROFILE_LEN 28      /* Longest profile path */
+#define FILTER_DEFAULT "/tuio/2Dcur"
+#define FILTER_MAX_INSNS \
+   (4 + FILTER_MAX_PROFILES * (2 * (FILTER_PROFILE_LEN / 4) + 3))
+
+/*
+ * Subscribes the comma separated profiles, "*" for all of them. Returns
+ * 0, or -1 if a profile is too long or there are too many.
+ */
+int filter_set(const char *profiles);
+
+/* Profiles subscribed, 0 when all are */
+int filter_count(void);
+const char *filter_profile(int i);
+
+/* Whether a datagram is to be decoded */
+int filter_packet(const unsigned char *data, size_t len);
+
+/*
+ * The kernel filter's classic BPF program, into insn (room for
+ * FILTER_MAX_INSNS); returns its length, -1 when all profiles pass
+ */
+int filter_program(struct sock_filter *insn);
+
+/* Attaches the kernel filter to a UDP socket. Returns 0, or -1 (errno) */
+int filter_attach(int fd);
+
+#endif
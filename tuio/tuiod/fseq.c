@@ -0,0 +1,452 @@
+/*
+ * Frame ordering of the TUIO bundles tuiod receives, see fseq.h
+ */
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fseq.h"
+#include "tlog.h"
+
+struct held {
+   unsigned long long time_ns;     /* Arrival */
+   long fseq;
+   size_t len;
+   unsigned char data[FSEQ_MAX_PACKET];
+};
+
+struct profile {
+   char path[FSEQ_PROFILE_LEN];
+   long last;                      /* fseq of the last frame passed on */
+   unsigned long long last_ns;
+   int count;                      /* Frames held, by fseq */
+   int flush;                      /* Window overran, pass them all */
+   struct held *held;              /* From the pool, on first use */
+};
+
+struct fseq_source {
+   struct sockaddr_storage from;
+   socklen_t from_len;
+   unsigned long long seen_ns;     /* Last datagram */
+   int profiles;
+   struct profile profile[FSEQ_PROFILES];
+};
+
+static struct fseq_source sources[FSEQ_MAX_SOURCES];
+static int source_count;
+static struct fseq_source *last_source;
+static unsigned long long budget_ns;
+static int held_total;
+static struct fseq_stats stats;
+static struct held out;            /* The frame fseq_next returned */
+static struct held *pool;          /* FSEQ_WINDOWS windows */
+static int pool_used;
+static struct held *spare[FSEQ_WINDOWS]; /* Windows of senders gone */
+static int spare_count;
+static int refused;                /* A sender was passed on as is */
+
+
+static unsigned int get32(const unsigned char *p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* Matches an OSC "<path> fseq <n>" message of len bytes */
+static int match_fseq(const unsigned char *msg, size_t len, long *fseq)
+{
+   const unsigned char *end;
+   size_t pad;
+
+   if (len < 8 || msg[0] != '/')
+      return 0;
+   end = memchr(msg, '\0', len);
+   if (!end || end - msg >= FSEQ_PROFILE_LEN)
+      return 0;
+   pad = (end - msg + 4) & ~3;
+   if (len != pad + 16 || memcmp(msg + pad, ",si\0fseq\0\0\0\0", 12))
+      return 0;
+   *fseq = (int) get32(msg + pad + 12);
+   return 1;
+}
+
+/* Finds the fseq message of a datagram, a bundle or a lone message */
+static const char *find_fseq(const unsigned char *data, size_t len,
+      long *fseq)
+{
+   size_t off, size;
+
+   if (len < 16 || memcmp(data, "#bundle", 8))
+      return match_fseq(data, len, fseq) ? (const char *) data : NULL;
+
+   /* The fseq closes the bundle, but look at every element */
+   for (off = 16; off + 4 <= len; off += 4 + size) {
+      size = get32(data + off);
+      if (size > len - off - 4)
+         break;
+      if (match_fseq(data + off + 4, size, fseq))
+         return (const char *) data + off + 4;
+   }
+   return NULL;
+}
+
+static int same_sender(const struct fseq_source *s,
+      const struct sockaddr *from, socklen_t from_len)
+{
+   const struct sockaddr_in *a, *b;
+   const struct sockaddr_in6 *a6, *b6;
+
+   if (s->from.ss_family != from->sa_family)
+      return 0;
+   if (from->sa_family == AF_INET) {
+      a = (const struct sockaddr_in *) &s->from;
+      b = (const struct sockaddr_in *) from;
+      return a->sin_port == b->sin_port &&
+         a->sin_addr.s_addr == b->sin_addr.s_addr;
+   }
+   if (from->sa_family == AF_INET6) {
+      a6 = (const struct sockaddr_in6 *) &s->from;
+      b6 = (const struct sockaddr_in6 *) from;
+      return a6->sin6_port == b6->sin6_port &&
+         !memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(b6->sin6_addr));
+   }
+   return s->from_len == from_len && !memcmp(&s->from, from, from_len);
+}
+
+int fseq_init(unsigned long long budget)
+{
+   budget_ns = budget;
+   if (!budget || pool)
+      return 0;
+   pool = calloc(FSEQ_WINDOWS * (FSEQ_WINDOW + 1), sizeof(*pool));
+   return pool ? 0 : -1;
+}
+
+/* The place of the sender silent longest, if it is silent long enough */
+static struct fseq_source *expired(unsigned long long now)
+{
+   struct fseq_source *s = NULL;
+   int i, k;
+
+   for (i = 0; i < source_count; i++)
+      if (now - sources[i].seen_ns >= FSEQ_EXPIRE_NS &&
+            (!s || sources[i].seen_ns < s->seen_ns))
+         s = &sources[i];
+   if (!s)
+      return NULL;
+
+   /* Its windows go to the next senders to hold frames */
+   for (k = 0; k < s->profiles; k++) {
+      held_total -= s->profile[k].count;
+      if (s->profile[k].held)
+         spare[spare_count++] = s->profile[k].held;
+   }
+   memset(s, 0, sizeof(*s));
+   return s;
+}
+
+struct fseq_source *fseq_source(const struct sockaddr *from,
+      socklen_t from_len, unsigned long long now)
+{
+   struct fseq_source *s = last_source;
+   int i;
+
+   if (!s || !same_sender(s, from, from_len)) {
+      for (i = 0, s = NULL; i < source_count && !s; i++)
+         if (same_sender(&sources[i], from, from_len))
+            s = &sources[i];
+   }
+   if (s) {
+      s->seen_ns = now;
+      return last_source = s;
+   }
+
+   if (from_len > sizeof(struct sockaddr_storage))
+      return NULL;
+   if (source_count < FSEQ_MAX_SOURCES)
+      s = &sources[source_count++];
+   else if ((s = expired(now)) == NULL) {
+      if (!refused)
+         tlog(TLOG_WARN, "Fseq: %ld senders heard from in the last %ld s, "
+               "passing new ones on unordered", FSEQ_MAX_SOURCES,
+               (long) (FSEQ_EXPIRE_NS / 1000000000));
+      refused = 1;
+      return NULL;
+   }
+   refused = 0;
+   memcpy(&s->from, from, from_len);
+   s->from_len = from_len;
+   s->seen_ns = now;
+   return last_source = s;
+}
+
+static struct profile *find_profile(struct fseq_source *s, const char *path)
+{
+   int i;
+
+   for (i = 0; i < s->profiles; i++)
+      if (!strcmp(s->profile[i].path, path))
+         return &s->profile[i];
+   if (s->profiles == FSEQ_PROFILES)
+      return NULL;
+
+   strcpy(s->profile[s->profiles].path, path);
+   s->profile[s->profiles].last_ns = 0;
+   return &s->profile[s->profiles++];
+}
+
+/* The frames held that one passed on since has left behind */
+static void drop_stale(struct profile *p)
+{
+   while (p->count && p->held[0].fseq <= p->last) {
+      stats.stale++;
+      p->count--;
+      held_total--;
+      memmove(&p->held[0], &p->held[1], p->count * sizeof(*p->held));
+   }
+}
+
+/*
+ * Holds a frame ahead of the next one expected. A full window makes room
+ * by passing on its oldest frame at once, the one held first or this one:
+ * then FSEQ_PASS, with *fseq and frame set to the frame to pass on.
+ */
+static int hold(struct profile *p, const unsigned char *data, size_t len,
+      long *fseq, unsigned long long now, struct fseq_frame *frame)
+{
+   int i, result = FSEQ_HOLD;
+
+   if (!p->held) {
+      if (spare_count)
+         p->held = spare[--spare_count];
+      else if (pool_used == FSEQ_WINDOWS)
+         return FSEQ_PASS;
+      else
+         p->held = &pool[pool_used++ * (FSEQ_WINDOW + 1)];
+   }
+
+   drop_stale(p);
+   for (i = 0; i < p->count; i++) {
+      if (p->held[i].fseq == *fseq) {
+         stats.duplicates++;
+         return FSEQ_DROP;
+      }
+      if (p->held[i].fseq > *fseq)
+         break;
+   }
+
+   if (p->count == FSEQ_WINDOW + 1) {
+      if (i == 0)
+         return FSEQ_PASS;
+      /* Valid until the next fseq_ call, as fseq_next's */
+      out = p->held[0];
+      p->count--;
+      held_total--;
+      memmove(&p->held[0], &p->held[1], p->count * sizeof(*p->held));
+      i--;
+      frame->data = out.data;
+      frame->len = out.len;
+      result = FSEQ_PASS;
+   }
+
+   memmove(&p->held[i + 1], &p->held[i], (p->count - i) * sizeof(*p->held));
+   p->held[i].time_ns = now;
+   p->held[i].fseq = *fseq;
+   p->held[i].len = len;
+   memcpy(p->held[i].data, data, len);
+   p->count++;
+   held_total++;
+   stats.held++;
+
+   /* Full: stop waiting for the missing frames */
+   if (p->count > FSEQ_WINDOW)
+      p->flush = 1;
+   if (result == FSEQ_PASS)
+      *fseq = out.fseq;
+   return result;
+}
+
+static void drop_held(struct profile *p)
+{
+   held_total -= p->count;
+   p->count = 0;
+   p->flush = 0;
+}
+
+int fseq_packet(struct fseq_source *s, const unsigned char *data,
+      size_t len, unsigned long long now, struct fseq_frame *frame)
+{
+   struct profile *p = NULL;
+   const char *path;
+   long fseq;
+   int result;
+
+   frame->data = data;
+   frame->len = len;
+   frame->from = s ? (const struct sockaddr *) &s->from : NULL;
+   frame->source = s ? s - sources : -1;
+   frame->profile = NULL;
+   frame->lost = 0;
+
+   if (!s || (path = find_fseq(data, len, &fseq)) == NULL)
+      return FSEQ_PASS;
+   if (fseq < 0 || (p = find_profile(s, path)) == NULL)
+      return FSEQ_PASS;
+   frame->profile = p->path;
+
+   /* First frame, or the sender started over */
+   if (!p->last_ns || now - p->last_ns > FSEQ_IDLE_NS ||
+         fseq < p->last - FSEQ_RESET) {
+      drop_held(p);
+      p->last = fseq;
+      p->last_ns = now;
+      return FSEQ_PASS;
+   }
+
+   if (fseq <= p->last) {
+      if (fseq == p->last)
+         stats.duplicates++;
+      else
+         stats.stale++;
+      return FSEQ_DROP;
+   }
+
+   /* Held, unless there is no window for it, or it is full */
+   if (fseq > p->last + 1 && budget_ns && len <= FSEQ_MAX_PACKET &&
+         (result = hold(p, data, len, &fseq, now, frame)) != FSEQ_PASS)
+      return result;
+
+   frame->lost = fseq - p->last - 1;
+   stats.lost += frame->lost;
+   p->last = fseq;
+   p->last_ns = now;
+   return FSEQ_PASS;
+}
+
+/* Whether the first frame held is to go out at now */
+static int due(const struct profile *p, unsigned long long now)
+{
+   unsigned long long first = p->held[0].time_ns;
+   int i;
+
+   if (p->flush || p->held[0].fseq == p->last + 1)
+      return 1;
+   for (i = 1; i < p->count; i++)
+      if (p->held[i].time_ns < first)
+         first = p->held[i].time_ns;
+   return now - first >= budget_ns;
+}
+
+int fseq_next(unsigned long long now, struct fseq_frame *frame)
+{
+   struct fseq_source *s;
+   struct profile *p;
+   int i, k;
+
+   for (i = 0; held_total && i < source_count; i++) {
+      s = &sources[i];
+      for (k = 0; k < s->profiles; k++) {
+         p = &s->profile[k];
+
+         /* Passed by a frame too large to hold */
+         drop_stale(p);
+         if (!p->count || !due(p, now))
+            continue;
+
+         out = p->held[0];
+         p->count--;
+         held_total--;
+         memmove(&p->held[0], &p->held[1], p->count * sizeof(*p->held));
+         if (!p->count)
+            p->flush = 0;
+
+         frame->data = out.data;
+         frame->len = out.len;
+         frame->from = (const struct sockaddr *) &s->from;
+         frame->source = i;
+         frame->profile = p->path;
+         frame->lost = out.fseq - p->last - 1;
+         stats.lost += frame->lost;
+         p->last = out.fseq;
+         p->last_ns = now;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+int fseq_timeout(unsigned long long now, int max_ms)
+{
+   unsigned long long wait, first;
+   struct profile *p;
+   int i, k, n;
+
+   for (i = 0; held_total && i < source_count; i++) {
+      for (k = 0; k < sources[i].profiles; k++) {
+         p = &sources[i].profile[k];
+         if (!p->count)
+            continue;
+         if (due(p, now))
+            return 0;
+         first = p->held[0].time_ns;
+         for (n = 1; n < p->count; n++)
+            if (p->held[n].time_ns < first)
+               first = p->held[n].time_ns;
+         wait = (first + budget_ns - now + 999999) / 1000000;
+         if (wait < (unsigned long long) max_ms)
+            max_ms = wait;
+      }
+   }
+   return max_ms;
+}
+
+void fseq_get_stats(struct fseq_stats *s)
+{
+   *s = stats;
+}
+
+void fseq_flush(void)
+{
+   int i, k;
+
+   for (i = 0; held_total && i < source_count; i++)
+      for (k = 0; k < sources[i].profiles; k++)
+         if (sources[i].profile[k].count)
+            sources[i].profile[k].flush = 1;
+}
+
+long fseq_save(void *state, size_t max)
+{
+   struct fseq_source *s = state;
+   size_t len = source_count * sizeof(*sources);
+   int i, k;
+
+   if (len > max)
+      return -1;
+   memcpy(s, sources, len);
+   for (i = 0; i < source_count; i++) {
+      for (k = 0; k < s[i].profiles; k++) {
+         s[i].profile[k].count = 0;
+         s[i].profile[k].flush = 0;
+         s[i].profile[k].held = NULL;
+      }
+   }
+   return len;
+}
+
+int fseq_restore(const void *state, size_t len)
+{
+   int i, k;
+
+   if (len % sizeof(*sources) || len > sizeof(sources))
+      return -1;
+   memcpy(sources, state, len);
+   source_count = len / sizeof(*sources);
+   for (i = 0; i < source_count; i++)
+      for (k = 0; k < sources[i].profiles; k++)
+         sources[i].profile[k].held = NULL;
+   last_source = NULL;
+   held_total = 0;
+   pool_used = 0;
+   spare_count = 0;
+   return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Frame ordering of the TUIO bundles tuiod receives over UDP.
+ *
+ * UDP may drop, duplicate or reorder datagrams, and a TUIO frame is one
+ * bundle ending in "<profile> fseq <n>". Before a datagram is dispatched
+ * its fseq is looked up, and the frame is checked against the last one
+ * passed on for the same sender and profile:
+ *
+ *    fseq above the last     passed on; the frames skipped are lost
+ *    fseq at or below it     a duplicate or a stale frame, dropped
+ *
+ * A sender that restarts its count (fseq far below the last, or after
+ * FSEQ_IDLE_NS of silence) starts over. Datagrams without an fseq, or
+ * with fseq -1 (TUIO's redundant repeats), are passed on as they are.
+ *
+ * With a reordering window (fseq_init with a budget) a frame arriving
+ * ahead of a missing one is held instead, up to FSEQ_WINDOW frames a
+ * profile (and FSEQ_WINDOWS profiles), until the missing frame arrives or
+ * the oldest held frame has waited out the budget; then the held frames
+ * go out in order and the ones still missing count as lost. A burst that
+ * overfills a window, before fseq_next is called, pushes its oldest frame
+ * out through fseq_packet.
+ *
+ * The frames lost before a frame are reported with it, tuiod passes them
+ * on as "<profile> lost <n>" so the consumer can tell a lost frame from a
+ * contact lifted.
+ *
+ * Senders are told apart by address and port, and a tracker that restarts
+ * mostly comes back on another port. Once FSEQ_MAX_SOURCES are known, a
+ * new sender takes the place of the one silent longest, if that has sent
+ * nothing for FSEQ_EXPIRE_NS; if none has, it is passed on as is (not
+ * ordered, source -1) and that is logged.
+ */
+#ifndef __FSEQ_H__
+#define __FSEQ_H__
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define FSEQ_MAX_SOURCES 16        /* Senders ordered; more pass as is */
+#define FSEQ_EXPIRE_NS 10000000000ULL /* Silence that frees a sender's place */
+#define FSEQ_PROFILES 4            /* Profiles ordered a sender */
+#define FSEQ_PROFILE_LEN 32
+#define FSEQ_WINDOW 8              /* Frames held a profile */
+#define FSEQ_WINDOWS 8             /* Profiles holding frames at once */
+#define FSEQ_MAX_PACKET 4096       /* Larger datagrams are never held */
+#define FSEQ_RESET 64              /* Frames back that mean a restart */
+#define FSEQ_IDLE_NS 1000000000ULL /* Silence that means a restart */
+
+/* fseq_packet results */
+#define FSEQ_PASS 0                /* Dispatch the datagram now */
+#define FSEQ_DROP 1                /* Duplicate or stale frame */
+#define FSEQ_HOLD 2                /* Copied to the window, see fseq_next */
+
+struct fseq_source;
+
+/* A datagram to dispatch */
+struct fseq_frame {
+   const unsigned char *data;
+   size_t len;
+   const struct sockaddr *from;
+   int source;                     /* Sender number, -1 if not ordered */
+   const char *profile;            /* Of its fseq, NULL without one */
+   long lost;                      /* Frames of the profile lost before */
+};
+
+struct fseq_stats {
+   unsigned long duplicates;       /* Frames dropped, same fseq as passed */
+   unsigned long stale;            /* Frames dropped, older than passed */
+   unsigned long lost;             /* Frames never received */
+   unsigned long held;             /* Frames put in the window */
+};
+
+/*
+ * Sets the reordering budget, 0 (the default) for no window. The windows
+ * are allocated here. Returns 0, or -1 if they could not be.
+ */
+int fseq_init(unsigned long long budget_ns);
+
+/*
+ * The ordering state of a sender, added on first sight at now (monotonic
+ * ns); NULL if every place is taken by a sender heard from recently
+ */
+struct fseq_source *fseq_source(const struct sockaddr *from,
+      socklen_t from_len, unsigned long long now);
+
+/*
+ * Checks a datagram of source s received at now (monotonic ns). On
+ * FSEQ_PASS *frame describes it, or the oldest frame of a full window,
+ * valid until the next fseq_ call (the datagram is held then).
+ */
+int fseq_packet(struct fseq_source *s, const unsigned char *data,
+      size_t len, unsigned long long now, struct fseq_frame *frame);
+
+/*
+ * Takes the next held frame that is due at now, returns 0 if there is
+ * none. The frame's data stays valid until the next fseq_ call.
+ */
+int fseq_next(unsigned long long now, struct fseq_frame *frame);
+
+/* Milliseconds until a held frame is due, at most max_ms */
+int fseq_timeout(unsigned long long now, int max_ms);
+
+void fseq_get_stats(struct fseq_stats *stats);
+
+/* Makes every frame held due, for fseq_next to pass them all on */
+void fseq_flush(void);
+
+/*
+ * The order of every sender, for tuiod's successor (handover.h): fseq_save
+ * copies it to state, with nothing held (fseq_flush first), returning its
+ * length, -1 if over max; fseq_restore takes it back, returning -1 if it
+ * does not fit.
+ */
+long fseq_save(void *state, size_t max);
+int fseq_restore(const void *state, size_t len);
+
+#endif
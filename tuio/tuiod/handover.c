@@ -0,0 +1,421 @@
+/*
+ * Handover of tuiod's sockets and state to its successor, see handover.h
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <link.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "delta.h"
+#include "fseq.h"
+#include "handover.h"
+#include "tlog.h"
+#include "uinput.h"
+
+#define MAGIC "tuiohnd"
+
+/* State sections */
+#define SECTION_FSEQ 1
+#define SECTION_DELTA 2
+#define SECTION_UINPUT 3
+
+#define ALIGN(n) (((n) + 7) & ~7UL)
+
+#define BUILD_ID 32                /* Bytes of the build ID compared */
+
+struct header {
+   char magic[8];
+   unsigned int version;
+   unsigned int uinput;            /* Output mode of the sender */
+   unsigned int len;               /* State bytes following */
+   long drops;                     /* Socket drop count seen */
+   unsigned char build[BUILD_ID];  /* Of the sender's executable */
+};
+
+struct section {
+   unsigned int id;
+   unsigned int len;               /* Data following, padded to 8 */
+};
+
+static unsigned char state[HANDOVER_MAX] __attribute__((aligned(8)));
+static size_t state_len;
+static int other_build;            /* The state taken over was left out */
+static int conn_fd = -1;           /* To the tuiod taken over from */
+static long long conn_deadline;
+static int listen_fd = -1;
+static char *sock_path;
+static ino_t sock_ino;
+
+
+static long long now_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Waits for events on fd until the deadline; 0 on time out */
+static int wait_for(int fd, short events, long long deadline)
+{
+   struct pollfd pfd = { fd, events, 0 };
+   long long left;
+
+   do {
+      if ((left = deadline - now_ms()) < 0)
+         return 0;
+   } while (poll(&pfd, 1, left) < 0 && errno == EINTR);
+   return pfd.revents != 0;
+}
+
+static int read_all(int fd, void *data, size_t len, long long deadline)
+{
+   unsigned char *p = data;
+   ssize_t n;
+
+   while (len) {
+      if (!wait_for(fd, POLLIN, deadline) || (n = read(fd, p, len)) <= 0)
+         return -1;
+      p += n;
+      len -= n;
+   }
+   return 0;
+}
+
+static int write_all(int fd, const void *data, size_t len,
+      long long deadline)
+{
+   const unsigned char *p = data;
+   ssize_t n;
+
+   while (len) {
+      if (!wait_for(fd, POLLOUT, deadline) ||
+            (n = send(fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT)) <= 0)
+         return -1;
+      p += n;
+      len -= n;
+   }
+   return 0;
+}
+
+/* Copies the executable's GNU build ID note to data, if it has one */
+static int find_build_id(struct dl_phdr_info *info, size_t size, void *data)
+{
+   const ElfW(Phdr) *ph;
+   const ElfW(Nhdr) *note;
+   const char *p, *end;
+   size_t align;
+   int i;
+
+   for (i = 0; i < info->dlpi_phnum; i++) {
+      ph = &info->dlpi_phdr[i];
+      if (ph->p_type != PT_NOTE)
+         continue;
+      align = ph->p_align == 8 ? 8 : 4;
+      p = (const char *) (info->dlpi_addr + ph->p_vaddr);
+      end = p + ph->p_memsz;
+      while (p + sizeof(*note) <= end) {
+         note = (const ElfW(Nhdr) *) p;
+         p += sizeof(*note) + ((note->n_namesz + align - 1) & ~(align - 1));
+         if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+               !memcmp(note + 1, "GNU", 4) && p + note->n_descsz <= end) {
+            memcpy(data, p, note->n_descsz < BUILD_ID ? note->n_descsz :
+                  BUILD_ID);
+            return 1;
+         }
+         p += (note->n_descsz + align - 1) & ~(align - 1);
+      }
+   }
+   return 1;                       /* The executable comes first */
+}
+
+/*
+ * The build ID of tuiod, to tell whether the state saved by another
+ * tuiod, memory images of its structs, is laid out as this one's. All
+ * zero if the linker left it out (gcc -Wl,--build-id=none).
+ */
+static const unsigned char *build_id(void)
+{
+   static unsigned char id[BUILD_ID];
+   static int found;
+
+   if (!found) {
+      dl_iterate_phdr(find_build_id, id);
+      found = 1;
+   }
+   return id;
+}
+
+static int unix_addr(struct sockaddr_un *addr, const char *path)
+{
+   if (strlen(path) >= sizeof(addr->sun_path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   memset(addr, 0, sizeof(*addr));
+   addr->sun_family = AF_UNIX;
+   strcpy(addr->sun_path, path);
+   return 0;
+}
+
+int handover_take(const char *path, int use_uinput, int *sock_fd,
+      int *dev_fd, long *drops)
+{
+   struct sockaddr_un addr;
+   struct header hdr;
+   struct iovec iov = { &hdr, sizeof(hdr) };
+   struct msghdr msg;
+   struct cmsghdr *c;
+   char control[CMSG_SPACE(2 * sizeof(int))];
+   static const unsigned char zero_id[BUILD_ID];
+   int fds[2] = { -1, -1 };
+   long long deadline = now_ms() + HANDOVER_START_MS;
+   ssize_t n;
+   int fd;
+
+   if (unix_addr(&addr, path) < 0 ||
+         (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      goto fail;
+   if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+      close(fd);
+      if (errno == ENOENT || errno == ECONNREFUSED)
+         return 0;
+      goto fail;
+   }
+
+   /* The descriptors come with the first bytes */
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control;
+   msg.msg_controllen = sizeof(control);
+   if (!wait_for(fd, POLLIN, deadline) ||
+         (n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) <= 0) {
+      tlog_s(TLOG_ERROR, "ERROR: The tuiod at '%s' did not hand over",
+            path, 0);
+      close(fd);
+      return -1;
+   }
+   for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS &&
+            c->cmsg_len == CMSG_LEN(sizeof(fds)))
+         memcpy(fds, CMSG_DATA(c), sizeof(fds));
+
+   if (fds[0] < 0 || read_all(fd, (char *) &hdr + n, sizeof(hdr) - n,
+            deadline) < 0 ||
+         memcmp(hdr.magic, MAGIC, sizeof(hdr.magic)) ||
+         hdr.len > HANDOVER_MAX) {
+      tlog_s(TLOG_ERROR, "ERROR: Handover from '%s' failed", path, 0);
+      goto refuse;
+   }
+   if (hdr.uinput != (unsigned int) use_uinput) {
+      tlog_ss(TLOG_ERROR, "ERROR: The tuiod at '%s' runs %s, so must this "
+            "one", path, hdr.uinput ? "-u" : "a device", 0);
+      goto refuse;
+   }
+   if (read_all(fd, state, hdr.len, deadline) < 0) {
+      tlog_s(TLOG_ERROR, "ERROR: Handover from '%s' cut short", path, 0);
+      goto refuse;
+   }
+
+   /* Another build: take the sockets, not the state */
+   other_build = hdr.version != HANDOVER_VERSION ||
+         memcmp(hdr.build, build_id(), BUILD_ID) ||
+         !memcmp(hdr.build, zero_id, BUILD_ID);
+   state_len = other_build ? 0 : hdr.len;
+   *sock_fd = fds[0];
+   *dev_fd = fds[1];
+   *drops = hdr.drops;
+   conn_fd = fd;
+   conn_deadline = deadline;
+   tlog_s(TLOG_INFO, "Took over from the tuiod at '%s'", path, 0);
+   return 1;
+
+refuse:
+   /* Closing without an answer, the tuiod there carries on */
+   if (fds[0] >= 0) {
+      close(fds[0]);
+      close(fds[1]);
+   }
+   close(fd);
+   return -1;
+
+fail:
+   tlog_ss(TLOG_ERROR, "ERROR: Could not reach the tuiod at '%s': %s",
+         path, strerror(errno), 0);
+   return -1;
+}
+
+int handover_restore(void)
+{
+   const struct section *sec;
+   size_t pos = 0;
+   int failed = state_len ? 0 : -1, gone = 1;
+   char ack = 1;
+
+   while (pos + sizeof(*sec) <= state_len) {
+      sec = (const struct section *) &state[pos];
+      pos += sizeof(*sec);
+      if (sec->len > state_len - pos) {
+         failed = -1;
+         break;
+      }
+      if ((sec->id == SECTION_FSEQ &&
+               fseq_restore(&state[pos], sec->len) < 0) ||
+            (sec->id == SECTION_DELTA &&
+               delta_restore(&state[pos], sec->len) < 0) ||
+            (sec->id == SECTION_UINPUT &&
+               uinput_restore(&state[pos], sec->len) < 0))
+         failed = -1;
+      pos += ALIGN(sec->len);
+   }
+   if (other_build)
+      tlog(TLOG_WARN, "Handover: the tuiod before is another build, its "
+            "state was left out, starting afresh", 0, 0);
+   else if (failed)
+      tlog(TLOG_WARN, "Handover: the state of the tuiod before was left "
+            "out, starting afresh", 0, 0);
+
+   /* Let it go; it says so, unless it gave up waiting and carries on */
+   if (conn_fd >= 0) {
+      if (write_all(conn_fd, &ack, 1, conn_deadline) < 0 ||
+            read_all(conn_fd, &ack, 1, conn_deadline) < 0) {
+         tlog(TLOG_ERROR, "ERROR: Handover: the tuiod before carried on",
+               0, 0);
+         failed = -1;
+         gone = 0;
+      }
+      close(conn_fd);
+      conn_fd = -1;
+   }
+   return gone ? (failed ? 1 : 0) : -1;
+}
+
+int handover_listen(const char *path)
+{
+   struct sockaddr_un addr;
+   struct stat st;
+   int err;
+
+   if (unix_addr(&addr, path) < 0 || (listen_fd = socket(AF_UNIX,
+               SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0)
+      return -1;
+   unlink(path);
+   if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+         listen(listen_fd, 1) < 0 || stat(path, &st) < 0 ||
+         (sock_path = strdup(path)) == NULL) {
+      err = errno;
+      close(listen_fd);
+      listen_fd = -1;
+      errno = err;
+      return -1;
+   }
+   sock_ino = st.st_ino;
+   return listen_fd;
+}
+
+/* Appends a section of up to max bytes saved by save */
+static void add_section(unsigned int id,
+      long (*save)(void *state, size_t max))
+{
+   struct section *sec = (struct section *) &state[state_len];
+   size_t room = HANDOVER_MAX - state_len - sizeof(*sec);
+   long len;
+
+   if (state_len + sizeof(*sec) > HANDOVER_MAX ||
+         (len = save(sec + 1, room)) < 0) {
+      tlog(TLOG_WARN, "Handover: state section %ld does not fit", id, 0);
+      return;
+   }
+   sec->id = id;
+   sec->len = len;
+   state_len = ALIGN(state_len + sizeof(*sec) + len);
+   if (state_len > HANDOVER_MAX)
+      state_len = HANDOVER_MAX;
+}
+
+int handover_give(int sock_fd, int dev_fd, int use_uinput, long drops)
+{
+   struct header hdr;
+   struct iovec iov[2];
+   struct msghdr msg;
+   struct cmsghdr *c;
+   char control[CMSG_SPACE(2 * sizeof(int))];
+   int fds[2] = { sock_fd, dev_fd };
+   long long deadline = now_ms() + HANDOVER_TIMEOUT_MS;
+   ssize_t n, total;
+   char ack = 0;
+   int fd;
+
+   if ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) < 0)
+      return 0;
+
+   state_len = 0;
+   add_section(SECTION_FSEQ, fseq_save);
+   add_section(SECTION_DELTA, delta_save);
+   if (use_uinput)
+      add_section(SECTION_UINPUT, uinput_save);
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, MAGIC, sizeof(hdr.magic));
+   hdr.version = HANDOVER_VERSION;
+   memcpy(hdr.build, build_id(), BUILD_ID);
+   hdr.uinput = use_uinput;
+   hdr.len = state_len;
+   hdr.drops = drops;
+
+   iov[0].iov_base = &hdr;
+   iov[0].iov_len = sizeof(hdr);
+   iov[1].iov_base = state;
+   iov[1].iov_len = state_len;
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = iov;
+   msg.msg_iovlen = 2;
+   msg.msg_control = control;
+   msg.msg_controllen = sizeof(control);
+   c = CMSG_FIRSTHDR(&msg);
+   c->cmsg_level = SOL_SOCKET;
+   c->cmsg_type = SCM_RIGHTS;
+   c->cmsg_len = CMSG_LEN(sizeof(fds));
+   memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+   total = sizeof(hdr) + state_len;
+   if (!wait_for(fd, POLLOUT, deadline) ||
+         (n = sendmsg(fd, &msg, MSG_NOSIGNAL)) < (ssize_t) sizeof(hdr) ||
+         write_all(fd, state + (n - sizeof(hdr)), total - n, deadline) < 0 ||
+         read_all(fd, &ack, 1, deadline) < 0 ||
+         write_all(fd, &ack, 1, deadline) < 0) {
+      tlog(TLOG_WARN, "Handover: the new tuiod did not take over, carrying "
+            "on", 0, 0);
+      close(fd);
+      return 0;
+   }
+
+   /* The new tuiod listens once this one is gone from the path */
+   tlog(TLOG_INFO, "Handover: handed over %ld bytes of state", state_len, 0);
+   handover_close();
+   close(fd);
+   return 1;
+}
+
+void handover_close(void)
+{
+   struct stat st;
+
+   if (listen_fd < 0)
+      return;
+   close(listen_fd);
+   listen_fd = -1;
+   if (stat(sock_path, &st) == 0 && st.st_ino == sock_ino)
+      unlink(sock_path);
+   free(sock_path);
+   sock_path = NULL;
+}
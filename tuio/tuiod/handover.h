@@ -0,0 +1,76 @@
+/*
+ * Restarting tuiod without losing a frame (tuiod -H path).
+ *
+ * A tuiod started with -H listens on the Unix socket at path. The next
+ * tuiod started with the same -H, to upgrade or reconfigure it, connects
+ * there before binding the port or opening the device, and the one
+ * running hands over:
+ *
+ *    its UDP socket         bound, with the datagrams queued in it
+ *    its device             /dev/tuio (held by one writer at a time), or
+ *                           the uinput mouse with -u
+ *    its state              the fseq order (fseq.h) and last frames
+ *                           (delta.h) of every sender, and with -u the
+ *                           touchmouse: drags and scrolls under way
+ *
+ * The descriptors go over the socket with SCM_RIGHTS. The old tuiod passes
+ * on the frames it was holding, hands over and stops reading; when the
+ * new one acknowledges it answers and exits, leaving the socket and
+ * device open, and the new one listens on path in turn. Datagrams
+ * arriving meanwhile wait in the socket.
+ *
+ * Touch input waits as long as the exchange, so the old tuiod gives the
+ * new one HANDOVER_TIMEOUT_MS from connecting to acknowledging, all steps
+ * together, and otherwise carries on. The new tuiod then gets no answer
+ * and exits, leaving both to the old one.
+ *
+ * Both must run the same output mode (-u or a device). The state goes as
+ * memory images of the modules' structs, so it is only taken from a tuiod
+ * of the same build, the executables' GNU build IDs equal: after an
+ * upgrade the sockets are still taken over, and the state starts afresh,
+ * as after a plain restart. HANDOVER_VERSION is that of the exchange.
+ */
+#ifndef __HANDOVER_H__
+#define __HANDOVER_H__
+
+#define HANDOVER_VERSION 2
+#define HANDOVER_MAX 65536         /* State bytes */
+#define HANDOVER_TIMEOUT_MS 50     /* The old tuiod's wait for the new one */
+#define HANDOVER_START_MS 2000     /* The new tuiod's wait for the old one */
+
+/*
+ * Takes over from the tuiod listening at path, if any: *sock_fd and
+ * *dev_fd are set to its UDP socket and device (uinput with use_uinput),
+ * *drops to the socket's drop count it had seen. Returns 1 if taken over,
+ * 0 if no tuiod is listening there, -1 on error (logged; the tuiod there
+ * carries on).
+ */
+int handover_take(const char *path, int use_uinput, int *sock_fd,
+      int *dev_fd, long *drops);
+
+/*
+ * Restores the state taken over, once the modules are set up, and lets
+ * the old tuiod go. Returns 0, 1 if the state was left out (logged), or
+ * -1 if the old tuiod carried on: then this one is to exit without
+ * reading the socket or destroying the device.
+ */
+int handover_restore(void);
+
+/*
+ * Listens at path for the next tuiod. Returns the descriptor to poll, or
+ * -1 on error (errno).
+ */
+int handover_listen(const char *path);
+
+/*
+ * Hands sock_fd, dev_fd and the state over to the tuiod connecting; the
+ * frames held are to be passed on before (fseq_flush). Returns 1 if it
+ * took them, then this tuiod is to stop reading and exit without
+ * destroying the device; 0 if not.
+ */
+int handover_give(int sock_fd, int dev_fd, int use_uinput, long drops);
+
+/* Stops listening, removing the socket if it still is ours */
+void handover_close(void);
+
+#endif
@@ -0,0 +1,346 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <lo/lo.h>
+
+#include "message.h"
+#include "tlog.h"
+
+/* Seconds from the OSC (NTP) epoch, 1900, to the Unix one */
+#define NTP_UNIX 2208988800UL
+
+/* Scale of "%f", its six decimals */
+#define FIXED_SCALE 1000000
+
+unsigned long write_msg_unknown = 0;
+
+/*
+ * The rest of the output buffer: text goes at p, end is the last byte it
+ * may take (the null's). Every put checks the room first and writes
+ * nothing when there is not enough, returning -1.
+ */
+struct span {
+   char *p;
+   char *end;
+};
+
+static inline int put(struct span *o, const char *s, size_t len)
+{
+   if(len > (size_t) (o->end - o->p))
+      return -1;
+   memcpy(o->p, s, len);
+   o->p += len;
+   return 0;
+}
+
+static inline int put_char(struct span *o, char c)
+{
+   if(o->p == o->end)
+      return -1;
+   *o->p++ = c;
+   return 0;
+}
+
+/* The digits of v, at least min of them (zero padded) */
+static int put_uint(struct span *o, uint64_t v, int min)
+{
+   char digits[20];
+   int n = 0;
+
+   do {
+      digits[sizeof(digits) - ++n] = '0' + v % 10;
+      v /= 10;
+   } while(v || n < min);
+   return put(o, digits + sizeof(digits) - n, n);
+}
+
+static int put_int(struct span *o, int64_t v)
+{
+   if(v < 0 && put_char(o, '-') < 0)
+      return -1;
+   /* Negated unsigned, INT64_MIN included */
+   return put_uint(o, v < 0 ? -(uint64_t) v : (uint64_t) v, 1);
+}
+
+/* Through snprintf, for what the writers here do not take */
+static int put_printf(struct span *o, double v)
+{
+   int len = snprintf(o->p, o->end - o->p + 1, "%f", v);
+
+   if(len > o->end - o->p)
+      return -1;
+   o->p += len;
+   return 0;
+}
+
+/*
+ * A float as "%f" writes it, to the digit. A float has 24 significant
+ * bits and FIXED_SCALE 14 beyond its powers of two, so the scaled value
+ * is exact in a double and rounding it half to even, as printf does, is
+ * exact as well. Not a number, infinities and values too large to scale
+ * go through snprintf.
+ */
+static int put_fixed(struct span *o, float f)
+{
+   double v = f, scaled;
+   uint64_t units;
+
+   if(!(v > -9e12 && v < 9e12))
+      return put_printf(o, v);
+
+   /* The sign of "-0.000000" too */
+   if(__builtin_signbit(v) && put_char(o, '-') < 0)
+      return -1;
+   scaled = (v < 0 ? -v : v) * FIXED_SCALE;
+   units = (uint64_t) scaled;
+   if(scaled - units > 0.5 || (scaled - units == 0.5 && (units & 1)))
+      units++;
+
+   if(put_uint(o, units / FIXED_SCALE, 1) < 0 || put_char(o, '.') < 0)
+      return -1;
+   return put_uint(o, units % FIXED_SCALE, 6);
+}
+
+static int put_hex(struct span *o, const unsigned char *data, size_t len)
+{
+   static const char hex[] = "0123456789abcdef";
+   size_t i;
+
+   if(put(o, "0x", 2) < 0 || 2 * len > (size_t) (o->end - o->p))
+      return -1;
+   for(i = 0; i < len; i++) {
+      *o->p++ = hex[data[i] >> 4];
+      *o->p++ = hex[data[i] & 15];
+   }
+   return 0;
+}
+
+/* The bytes put_word escapes */
+static const unsigned char escaped[256] = {
+   [0 ... ' '] = 1, ['"'] = 1, ['\\'] = 1, [0x7f] = 1,
+};
+
+/*
+ * Text from the sender as one word: its spaces, control characters, '"'
+ * and '\' as "\x20" and so on, so that it can neither split into two
+ * arguments nor start a line of its own; "" when empty.
+ */
+static int put_word(struct span *o, const char *s, size_t len)
+{
+   static const char hex[] = "0123456789abcdef";
+   const unsigned char *p = (const unsigned char *) s, *end = p + len;
+   const unsigned char *plain;
+
+   if(!len)
+      return put(o, "\"\"", 2);
+   while(p < end) {
+      for(plain = p; p < end && !escaped[*p]; p++)
+         ;
+      if(put(o, (const char *) plain, p - plain) < 0)
+         return -1;
+      if(p == end)
+         break;
+      if(o->end - o->p < 4)
+         return -1;
+      *o->p++ = '\\';
+      *o->p++ = 'x';
+      *o->p++ = hex[*p >> 4];
+      *o->p++ = hex[*p++ & 15];
+   }
+   return 0;
+}
+
+static int put_timetag(struct span *o, lo_timetag tt)
+{
+   long long ns;
+
+   if(tt.sec == 0 && tt.frac == 1)
+      return put(o, "immediate", 9);
+   ns = timetag_ns(tt);
+   if(ns < 0 && put_char(o, '-') < 0)
+      return -1;
+   ns = ns < 0 ? -ns : ns;
+   if(put_uint(o, ns / 1000000000, 1) < 0 || put_char(o, '.') < 0)
+      return -1;
+   return put_uint(o, ns % 1000000000, 9);
+}
+
+/*
+ * Formatters of the OSC argument types, each writing the value (write_msg
+ * writes the space before it). They return 0, or -1 if it did not fit.
+ */
+typedef int (*format_fn)(struct span *o, lo_arg *arg);
+
+/** 32 bit signed integer. */
+static int format_int32(struct span *o, lo_arg *arg)
+{
+   return put_int(o, arg->i);
+}
+
+/** 64 bit signed integer. */
+static int format_int64(struct span *o, lo_arg *arg)
+{
+   return put_int(o, arg->h);
+}
+
+/** 32 bit IEEE-754 float. */
+static int format_float(struct span *o, lo_arg *arg)
+{
+   return put_fixed(o, arg->f);
+}
+
+/** 64 bit IEEE-754 double, too wide for put_fixed to be exact. */
+static int format_double(struct span *o, lo_arg *arg)
+{
+   return put_printf(o, arg->d);
+}
+
+/** Standard C, NULL terminated string, and symbol ('S'), escaped. */
+static int format_string(struct span *o, lo_arg *arg)
+{
+   return put_word(o, &arg->s, strlen(&arg->s));
+}
+
+/** Standard C, 8 bit, char, escaped as a string. */
+static int format_char(struct span *o, lo_arg *arg)
+{
+   return put_word(o, (const char *) &arg->c, 1);
+}
+
+/** A 4 byte MIDI packet: port, status, data 1 and 2, in hex. */
+static int format_midi(struct span *o, lo_arg *arg)
+{
+   return put_hex(o, arg->m, 4);
+}
+
+/*
+ * OSC TimeTag value. liblo 0.26 turns it to host order as one 64 bit
+ * number, seconds in the high half, which on a little endian host leaves
+ * arg->t with its halves swapped; taken as that number it is right on
+ * any host.
+ */
+static int format_timetag(struct span *o, lo_arg *arg)
+{
+   lo_timetag tt;
+   uint64_t v;
+
+   memcpy(&v, arg, sizeof(v));
+   tt.sec = v >> 32;
+   tt.frac = (uint32_t) v;
+   return put_timetag(o, tt);
+}
+
+/*
+ * OSC binary blob, its bytes in hex ("0x" alone when empty). Read as
+ * lo_blob_datasize and lo_blob_dataptr do, the size in host order then
+ * the bytes, so that nothing here needs liblo linked (Test/microbench).
+ */
+static int format_blob(struct span *o, lo_arg *arg)
+{
+   uint32_t size;
+
+   memcpy(&size, arg, sizeof(size));
+   return put_hex(o, (const unsigned char *) arg + sizeof(size), size);
+}
+
+/** The types without data: True, False, Nil and Infinitum. */
+static int format_true(struct span *o, lo_arg *arg)
+{
+   return put(o, "true", 4);
+}
+
+static int format_false(struct span *o, lo_arg *arg)
+{
+   return put(o, "false", 5);
+}
+
+static int format_nil(struct span *o, lo_arg *arg)
+{
+   return put(o, "nil", 3);
+}
+
+static int format_infinitum(struct span *o, lo_arg *arg)
+{
+   return put(o, "inf", 3);
+}
+
+static const format_fn formats[128] = {
+   ['i'] = format_int32,
+   ['h'] = format_int64,
+   ['f'] = format_float,
+   ['d'] = format_double,
+   ['s'] = format_string,
+   ['S'] = format_string,
+   ['c'] = format_char,
+   ['m'] = format_midi,
+   ['t'] = format_timetag,
+   ['b'] = format_blob,
+   ['T'] = format_true,
+   ['F'] = format_false,
+   ['N'] = format_nil,
+   ['I'] = format_infinitum,
+};
+
+/*
+ * Composes the osc datatypes into a human readable string of the form:
+ * "/path/here arg0 arg1 arg2 arg3"
+ */
+int write_msg( char* lbuf, int buf_len, const char *path, const char *types,
+               lo_arg **argv, int argc)
+{
+   struct span o = { lbuf, lbuf + buf_len };
+   unsigned char t;
+   char type[2] = "";
+   int i;
+
+   /* Any path with -p '*', as the sender wrote it */
+   if(buf_len < 0 || put_word(&o, path, strlen(path)) < 0)
+      return -1;
+
+   for(i = 0; i < argc; i++) {
+      if(put_char(&o, ' ') < 0)
+         return -1;
+      t = types[i];
+      if(t < 128 && formats[t]) {
+         if(formats[t](&o, argv[i]) < 0)
+            return -1;
+      } else {
+         /* A placeholder keeps the arguments after it in place */
+         write_msg_unknown++;
+         type[0] = t;
+         tlog_s(TLOG_WARN, "Unknown type [%s]", type, 0);
+         if(put_char(&o, '?') < 0)
+            return -1;
+      }
+   }
+
+   *o.p = '\0';
+   return o.p - lbuf;
+}
+
+int write_timetag(char *buf, size_t room, lo_timetag tt)
+{
+   struct span o = { buf, buf + room - 1 };
+
+   if(!room || put_char(&o, ' ') < 0 || put_timetag(&o, tt) < 0)
+      return -1;
+   *o.p = '\0';
+   return o.p - buf;
+}
+
+long long timetag_ns(lo_timetag tt)
+{
+   return ((long long) tt.sec - (long long) NTP_UNIX) * 1000000000 +
+      (long long) (((uint64_t) tt.frac * 1000000000) >> 32);
+}
+
+int bundle_timetag(const unsigned char *data, size_t len, lo_timetag *tt)
+{
+   if(len < 16 || memcmp(data, "#bundle", 8))
+      return 0;
+   tt->sec = (uint32_t) data[8] << 24 | data[9] << 16 | data[10] << 8 |
+      data[11];
+   tt->frac = (uint32_t) data[12] << 24 | data[13] << 16 | data[14] << 8 |
+      data[15];
+   return !(tt->sec == 0 && tt->frac <= 1);
+}
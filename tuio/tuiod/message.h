@@ -0,0 +1,55 @@
+/*
+ * Formats the OSC messages tuiod receives as the text lines it writes to
+ * /dev/tuio, see write_msg. Every OSC type is written as one word, so the
+ * arguments keep their places:
+ *
+ *    i h              as they are (64 bit 'h' too)
+ *    s S c            as they are, but for spaces, control characters,
+ *                     '"' and '\' written "\x20", "\x0a" and so on; an
+ *                     empty string is ""
+ *    f d              "%f"
+ *    t                seconds since 1970 with nanoseconds,
+ *                     "1760000000.250000000", or "immediate"
+ *    b                the bytes in hex, "0x0a1b2c"
+ *    m                the 4 MIDI bytes in hex, "0x00903c40"
+ *    T F N I          "true" "false" "nil" "inf"
+ *
+ * The path is escaped as the strings are: whatever a sender puts in a
+ * message, it stays one line with a word per argument. An argument of a
+ * type unknown is written as "?" and logged (tlog.h).
+ * Apart from tuiod this is linked into Test/microbench.
+ */
+#ifndef __MESSAGE_H__
+#define __MESSAGE_H__
+
+#include <lo/lo.h>
+
+/*
+ * Composes the osc datatypes into a human readable string of the form:
+ * "/path/here arg0 arg1 arg2 arg3", at most buf_len characters and the
+ * null. Returns its length, -1 if it would not fit; nothing is written
+ * past buf[buf_len] either way. Floats are written as "%f" would, without
+ * going through printf.
+ */
+int write_msg( char* buf, int buf_len, const char *path, const char *types,
+               lo_arg **argv, int argc);
+
+/* Arguments of unknown type written as "?" by write_msg so far */
+extern unsigned long write_msg_unknown;
+
+/*
+ * Writes " <time tag>" to buf as write_msg does, at most room bytes with
+ * the null. Returns its length, -1 if it would not fit.
+ */
+int write_timetag(char *buf, size_t room, lo_timetag tt);
+
+/*
+ * The time tag of a bundle datagram in *tt. Returns 0 if data is no
+ * bundle, or its tag is "immediately" (the sender set no time).
+ */
+int bundle_timetag(const unsigned char *data, size_t len, lo_timetag *tt);
+
+/* A time tag in nanoseconds since 1970 */
+long long timetag_ns(lo_timetag tt);
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ * Runtime metrics of tuiod, see metrics.h
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+#define POLL_MS 100                /* Longest wait before checking stop */
+#define REQUEST_LEN 1024
+
+/* The last one counts the senders beyond METRICS_MAX_SOURCES */
+static struct metrics_source sources[METRICS_MAX_SOURCES + 1];
+static int source_count;           /* Published with release */
+static struct metrics_source *last_source;
+
+unsigned long metrics_socket_drops = 0;
+
+static char *sock_path;
+static ino_t sock_ino;             /* Of the socket file, while ours */
+static int listen_fd = -1;
+static int stop;
+static pthread_t thread;
+
+
+unsigned long long metrics_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void metrics_hist_add(struct metrics_hist *h, unsigned long long ns)
+{
+   unsigned long long us;
+   int i = 0;
+
+   /* Bucket i holds up to 2^i us */
+   if (ns > 1000) {
+      us = (ns - 1) / 1000;
+      i = 64 - __builtin_clzll(us);
+      if (i > METRICS_BUCKETS)
+         i = METRICS_BUCKETS;
+   }
+   METRICS_ADD(h->bucket[i], 1);
+   METRICS_ADD(h->count, 1);
+   METRICS_ADD(h->sum_ns, ns);
+}
+
+void metrics_frame(struct metrics_source *s, long fseq,
+      unsigned long long now)
+{
+   /* Each profile sends the frame's fseq, count it once */
+   if (s->last_frame_ns && fseq <= s->last_fseq)
+      return;
+   if (s->last_frame_ns) {
+      if (fseq > s->last_fseq + 1)
+         METRICS_ADD(s->fseq_gaps, fseq - s->last_fseq - 1);
+      metrics_hist_add(&s->frame_interval, now - s->last_frame_ns);
+   }
+   s->last_fseq = fseq;
+   s->last_frame_ns = now;
+}
+
+static void source_key(const struct sockaddr *from, unsigned short *family,
+      unsigned short *port, unsigned char *addr)
+{
+   memset(addr, 0, 16);
+   *family = from->sa_family;
+   if (from->sa_family == AF_INET) {
+      const struct sockaddr_in *in = (const struct sockaddr_in *) from;
+      *port = ntohs(in->sin_port);
+      memcpy(addr, &in->sin_addr, 4);
+   } else if (from->sa_family == AF_INET6) {
+      const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *) from;
+      *port = ntohs(in6->sin6_port);
+      memcpy(addr, &in6->sin6_addr, 16);
+   } else {
+      *port = 0;
+   }
+}
+
+struct metrics_source *metrics_source(const struct sockaddr *from)
+{
+   struct metrics_source *s = last_source;
+   unsigned short family, port;
+   unsigned char addr[16];
+   char host[INET6_ADDRSTRLEN];
+   int i;
+
+   source_key(from, &family, &port, addr);
+   if (s && s->family == family && s->port == port &&
+         !memcmp(s->addr, addr, 16))
+      return s;
+
+   for (i = 0; i < source_count; i++) {
+      s = &sources[i];
+      if (s->family == family && s->port == port &&
+            !memcmp(s->addr, addr, 16))
+         return last_source = s;
+   }
+
+   if (source_count == METRICS_MAX_SOURCES)
+      return last_source = &sources[METRICS_MAX_SOURCES];
+
+   /* Fill in before the server can see it */
+   s = &sources[source_count];
+   s->family = family;
+   s->port = port;
+   memcpy(s->addr, addr, 16);
+   if (family == AF_INET || family == AF_INET6) {
+      inet_ntop(family, addr, host, sizeof(host));
+      snprintf(s->name, sizeof(s->name), family == AF_INET6 ?
+            "[%s]:%u" : "%s:%u", host, port);
+   } else {
+      strcpy(s->name, "local");
+   }
+   __atomic_store_n(&source_count, source_count + 1, __ATOMIC_RELEASE);
+   return last_source = s;
+}
+
+
+/*
+ * Scrapes
+ */
+#define LOAD(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+struct counter {
+   const char *name;
+   const char *help;
+   size_t offset;
+};
+
+static const struct counter counters[] = {
+   { "tuiod_datagrams_total", "Datagrams received",
+      offsetof(struct metrics_source, datagrams) },
+   { "tuiod_bundles_total", "OSC bundles received",
+      offsetof(struct metrics_source, bundles) },
+   { "tuiod_messages_total", "OSC messages handled",
+      offsetof(struct metrics_source, messages) },
+   { "tuiod_bytes_total", "Datagram bytes received",
+      offsetof(struct metrics_source, bytes) },
+   { "tuiod_parse_errors_total", "Packets liblo could not parse",
+      offsetof(struct metrics_source, parse_errors) },
+   { "tuiod_unknown_types_total", "Message arguments of unknown type",
+      offsetof(struct metrics_source, unknown_types) },
+   { "tuiod_overflows_total", "Messages too long for the line buffer",
+      offsetof(struct metrics_source, overflows) },
+   { "tuiod_fseq_gaps_total", "Frames missing from the fseq sequence",
+      offsetof(struct metrics_source, fseq_gaps) },
+   { "tuiod_fseq_dropped_total", "Duplicate and stale frames dropped",
+      offsetof(struct metrics_source, fseq_dropped) },
+   { "tuiod_filtered_total", "Datagrams of profiles not subscribed",
+      offsetof(struct metrics_source, filtered) },
+};
+
+struct histogram {
+   const char *name;
+   const char *help;
+   size_t offset;
+};
+
+static const struct histogram histograms[] = {
+   { "tuiod_frame_interval_seconds", "Time between frames of a sender",
+      offsetof(struct metrics_source, frame_interval) },
+   { "tuiod_write_latency_seconds", "Time to hand a message on",
+      offsetof(struct metrics_source, write_latency) },
+   { "tuiod_source_latency_seconds", "Time from the bundle time tag to "
+      "arrival", offsetof(struct metrics_source, source_latency) },
+};
+
+static void print_histogram(FILE *fp, const char *name, const char *source,
+      const struct metrics_hist *h)
+{
+   unsigned long sum = 0;
+   int i;
+
+   for (i = 0; i < METRICS_BUCKETS; i++) {
+      sum += LOAD(h->bucket[i]);
+      fprintf(fp, "%s_bucket{source=\"%s\",le=\"%g\"} %lu\n", name, source,
+            (1 << i) / 1e6, sum);
+   }
+   sum += LOAD(h->bucket[METRICS_BUCKETS]);
+   fprintf(fp, "%s_bucket{source=\"%s\",le=\"+Inf\"} %lu\n", name, source,
+         sum);
+   fprintf(fp, "%s_sum{source=\"%s\"} %.9f\n", name, source,
+         LOAD(h->sum_ns) / 1e9);
+   fprintf(fp, "%s_count{source=\"%s\"} %lu\n", name, source, sum);
+}
+
+static void print_metrics(FILE *fp)
+{
+   int count = __atomic_load_n(&source_count, __ATOMIC_ACQUIRE);
+   struct metrics_source *s;
+   unsigned int c;
+   int i;
+
+   fprintf(fp, "# HELP tuiod_socket_drops_total Datagrams dropped with the "
+         "receive buffer full\n# TYPE tuiod_socket_drops_total counter\n"
+         "tuiod_socket_drops_total %lu\n", LOAD(metrics_socket_drops));
+
+   for (c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+      fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n", counters[c].name,
+            counters[c].help, counters[c].name);
+      for (i = 0; i <= METRICS_MAX_SOURCES; i++) {
+         if (i >= count && i < METRICS_MAX_SOURCES)
+            continue;
+         s = &sources[i];
+         if (i == METRICS_MAX_SOURCES && !LOAD(s->datagrams))
+            continue;
+         fprintf(fp, "%s{source=\"%s\"} %lu\n", counters[c].name, s->name,
+               LOAD(*(unsigned long *) ((char *) s + counters[c].offset)));
+      }
+   }
+
+   for (c = 0; c < sizeof(histograms) / sizeof(histograms[0]); c++) {
+      fprintf(fp, "# HELP %s %s\n# TYPE %s histogram\n",
+            histograms[c].name, histograms[c].help, histograms[c].name);
+      for (i = 0; i <= METRICS_MAX_SOURCES; i++) {
+         if (i >= count && i < METRICS_MAX_SOURCES)
+            continue;
+         s = &sources[i];
+         if (i == METRICS_MAX_SOURCES && !LOAD(s->datagrams))
+            continue;
+         print_histogram(fp, histograms[c].name, s->name,
+               (struct metrics_hist *) ((char *) s + histograms[c].offset));
+      }
+   }
+}
+
+/* Answers one scrape: HTTP if asked with a GET, else the bare text */
+static void serve(int fd)
+{
+   struct pollfd pfd = { fd, POLLIN, 0 };
+   char request[REQUEST_LEN];
+   char *text = NULL;
+   size_t len = 0, done;
+   ssize_t n = 0;
+   FILE *fp;
+   int http;
+
+   if (poll(&pfd, 1, POLL_MS) > 0)
+      n = read(fd, request, sizeof(request));
+   http = n >= 4 && !memcmp(request, "GET ", 4);
+
+   if ((fp = open_memstream(&text, &len)) == NULL)
+      return;
+   print_metrics(fp);
+   fclose(fp);
+
+   if (http)
+      dprintf(fd, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+            "version=0.0.4\r\nContent-Length: %zu\r\n\r\n", len);
+   for (done = 0; done < len; done += n)
+      if ((n = send(fd, text + done, len - done, MSG_NOSIGNAL)) <= 0)
+         break;
+   free(text);
+}
+
+static void *server(void *arg)
+{
+   struct pollfd pfd = { listen_fd, POLLIN, 0 };
+   int fd;
+
+   while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+      if (poll(&pfd, 1, POLL_MS) <= 0)
+         continue;
+      if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+         continue;
+      serve(fd);
+      close(fd);
+   }
+   return NULL;
+}
+
+int metrics_open(const char *path)
+{
+   struct sockaddr_un addr;
+   struct stat st;
+   int err;
+
+   if (strlen(path) >= sizeof(addr.sun_path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   strcpy(sources[METRICS_MAX_SOURCES].name, "other");
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+
+   if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      return -1;
+   unlink(path);
+   if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+         listen(listen_fd, 4) < 0 || stat(path, &st) < 0)
+      goto fail;
+   sock_ino = st.st_ino;
+   if ((sock_path = strdup(path)) == NULL)
+      goto fail;
+
+   if ((errno = pthread_create(&thread, NULL, server, NULL)) != 0) {
+      free(sock_path);
+      sock_path = NULL;
+      goto fail;
+   }
+   return 0;
+
+fail:
+   err = errno;
+   close(listen_fd);
+   listen_fd = -1;
+   errno = err;
+   return -1;
+}
+
+void metrics_close(void)
+{
+   struct stat st;
+
+   if (listen_fd < 0)
+      return;
+   __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+   pthread_join(thread, NULL);
+   close(listen_fd);
+   listen_fd = -1;
+   /* Unless a tuiod taken over from this one serves there now */
+   if (stat(sock_path, &st) == 0 && st.st_ino == sock_ino)
+      unlink(sock_path);
+   free(sock_path);
+   sock_path = NULL;
+}
@@ -0,0 +1,90 @@
+/*
+ * Runtime metrics of tuiod (tuiod -m), served on a Unix domain socket in
+ * the Prometheus text format:
+ *
+ *    curl --unix-socket /run/tuiod.sock http://localhost/metrics
+ *    socat - UNIX-CONNECT:/run/tuiod.sock
+ *
+ * Counted per sender: datagrams, bundles, messages and bytes received,
+ * packets liblo could not parse, arguments of unknown type, messages
+ * longer than the line buffer (dropped), frames missing from the fseq
+ * sequence, duplicate and stale frames dropped (fseq.h), and datagrams
+ * of profiles not subscribed (filter.h). In all, the datagrams the socket
+ * dropped with its receive buffer full (sock.h). Histograms per sender:
+ * the time between frames (fseq messages), the time taken to hand a
+ * message on, to /dev/tuio or the built in touchmouse, and the time from
+ * the bundle time tag to its arrival (for trackers that set one, with the
+ * clocks in sync).
+ *
+ * The counters are written by tuiod's receive thread only, with plain
+ * (relaxed) stores into the sender's own cache line aligned block, and
+ * read by the server thread when a scrape comes in. Nothing is formatted
+ * or locked on the receive path, scraped or not.
+ */
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <sys/socket.h>
+
+#define METRICS_MAX_SOURCES 16     /* Senders told apart; more share one */
+#define METRICS_BUCKETS 24         /* Histogram buckets, up to 2^i us */
+
+struct metrics_hist {
+   unsigned long bucket[METRICS_BUCKETS + 1]; /* The last one above all */
+   unsigned long count;
+   unsigned long long sum_ns;
+};
+
+struct metrics_source {
+   unsigned long datagrams;
+   unsigned long bundles;
+   unsigned long messages;
+   unsigned long bytes;
+   unsigned long parse_errors;
+   unsigned long unknown_types;
+   unsigned long overflows;
+   unsigned long fseq_gaps;        /* Frames missing */
+   unsigned long fseq_dropped;     /* Duplicate and stale frames */
+   unsigned long filtered;         /* Datagrams of profiles not wanted */
+   struct metrics_hist frame_interval;
+   struct metrics_hist write_latency;
+   struct metrics_hist source_latency;
+
+   /* Receive thread only */
+   long last_fseq;
+   unsigned long long last_frame_ns;
+   unsigned short family;
+   unsigned short port;
+   unsigned char addr[16];
+   char name[56];                  /* "address:port", the metric label */
+} __attribute__((aligned(64)));
+
+/* Datagrams the socket dropped, of all senders (sock.h) */
+extern unsigned long metrics_socket_drops;
+
+/*
+ * Starts serving the metrics on a Unix socket at path, replacing any file
+ * there. Returns 0, or -1 on error (errno).
+ */
+int metrics_open(const char *path);
+
+/* Stops the server and removes the socket */
+void metrics_close(void);
+
+/* The counters of a sender, added on first sight */
+struct metrics_source *metrics_source(const struct sockaddr *from);
+
+/* Monotonic clock, for the histograms */
+unsigned long long metrics_now(void);
+
+void metrics_hist_add(struct metrics_hist *h, unsigned long long ns);
+
+/* Counts a frame of the sender: its interval, and the frames missed */
+void metrics_frame(struct metrics_source *s, long fseq,
+      unsigned long long now);
+
+/* Counter updates, from the receive thread */
+#define METRICS_ADD(counter, n) \
+   __atomic_store_n(&(counter), (counter) + (n), __ATOMIC_RELAXED)
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Real-time mode of tuiod's receive thread, see rt.h
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+#include "tlog.h"
+
+unsigned long rt_allocations = 0;
+
+static cpu_set_t cpus;
+static int cpus_set;
+static __thread int armed;         /* Counting on this thread */
+
+
+int rt_cpus(const char *list)
+{
+   char *end;
+   long first, last;
+
+   CPU_ZERO(&cpus);
+   while (*list) {
+      first = last = strtol(list, &end, 10);
+      if (end == list || first < 0)
+         return -1;
+      if (*end == '-') {
+         list = end + 1;
+         last = strtol(list, &end, 10);
+         if (end == list || last < first)
+            return -1;
+      }
+      if (last >= CPU_SETSIZE)
+         return -1;
+      for (; first <= last; first++)
+         CPU_SET(first, &cpus);
+      if (*end == ',')
+         end++;
+      else if (*end)
+         return -1;
+      list = end;
+   }
+   cpus_set = CPU_COUNT(&cpus) > 0;
+   return cpus_set ? 0 : -1;
+}
+
+/* Faults in the stack the receive thread may use */
+static void touch_stack(void)
+{
+   volatile char stack[RT_STACK];
+
+   memset((char *) stack, 0, sizeof(stack));
+}
+
+int rt_setup(int prio)
+{
+   struct sched_param param;
+   int failed = 0, err;
+
+   if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+      tlog_s(TLOG_ERROR, "RT: mlockall failed: %s (needs CAP_IPC_LOCK or "
+            "a higher memlock limit)", strerror(errno), 0);
+      failed++;
+   }
+   mallopt(M_TRIM_THRESHOLD, -1);
+   mallopt(M_MMAP_MAX, 0);
+   touch_stack();
+
+   if (cpus_set && (err = pthread_setaffinity_np(pthread_self(),
+               sizeof(cpus), &cpus)) != 0) {
+      tlog_s(TLOG_ERROR, "RT: pinning to the CPUs given failed: %s",
+            strerror(err), 0);
+      failed++;
+   }
+
+   memset(&param, 0, sizeof(param));
+   param.sched_priority = prio;
+   if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO,
+               &param)) != 0) {
+      tlog_s(TLOG_ERROR, "RT: SCHED_FIFO failed: %s (priority %ld, needs "
+            "CAP_SYS_NICE or an rtprio limit)", strerror(err), prio);
+      failed++;
+   }
+
+   if (!failed)
+      tlog(TLOG_INFO, "RT: SCHED_FIFO priority %ld, memory locked", prio, 0);
+   rt_count();
+   return failed;
+}
+
+void rt_count(void)
+{
+   armed = 1;
+}
+
+
+/*
+ * Heap allocations, counted by taking glibc's allocator entry points over
+ * (RT_COUNT_ALLOCATIONS builds only, see rt.h). Whatever allocates inside
+ * libc, strdup, stdio, getaddrinfo, calls these too.
+ */
+#if defined(RT_COUNT_ALLOCATIONS) && defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+static void count(void)
+{
+   if (!armed)
+      return;
+   if (!rt_allocations++)
+      tlog(TLOG_WARN, "RT: heap allocation on the receive thread after "
+            "setup", 0, 0);
+}
+
+void *malloc(size_t size)
+{
+   count();
+   return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+   count();
+   return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+   count();
+   return __libc_realloc(p, size);
+}
+
+void *reallocarray(void *p, size_t n, size_t size)
+{
+   if (size && n > (size_t) -1 / size) {
+      errno = ENOMEM;
+      return NULL;
+   }
+   return realloc(p, n * size);
+}
+
+void *memalign(size_t align, size_t size)
+{
+   count();
+   return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+   return memalign(align, size);
+}
+
+int posix_memalign(void **p, size_t align, size_t size)
+{
+   void *mem;
+
+   if (!align || align % sizeof(void *) || (align & (align - 1)))
+      return EINVAL;
+   if ((mem = memalign(align, size)) == NULL)
+      return ENOMEM;
+   *p = mem;
+   return 0;
+}
+
+void *valloc(size_t size)
+{
+   count();
+   return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size)
+{
+   count();
+   return __libc_pvalloc(size);
+}
+#endif
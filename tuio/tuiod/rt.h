@@ -0,0 +1,55 @@
+/*
+ * Real-time mode of tuiod's receive thread (tuiod -R), so touch frames are
+ * not left waiting in the socket buffer while other programs load the CPU.
+ *
+ * rt_setup, called once everything is allocated and the helper threads
+ * (logger, capture writer, metrics server) are running:
+ *
+ *    - locks all memory, current and future (mlockall), which also
+ *      faults in every buffer and ring, and touches RT_STACK bytes of
+ *      stack so the receive thread does not fault on it later
+ *    - keeps freed heap memory mapped (mallopt), so later allocations do
+ *      not fault either
+ *    - pins the receive thread to the CPUs of -c, if given
+ *    - runs it SCHED_FIFO at the given priority
+ *
+ * The helper threads keep their normal scheduling. Each step that fails is
+ * logged with what it needs (root, CAP_SYS_NICE, CAP_IPC_LOCK or the
+ * rtprio and memlock limits), and tuiod carries on without it.
+ *
+ * Built with RT_COUNT_ALLOCATIONS (make RT_COUNT=1), heap allocations on
+ * the receive thread after rt_setup are counted (rt_allocations), and the
+ * first one is logged. liblo allocates while decoding a message, those
+ * stay; with the heap locked they are cheap. The count takes malloc,
+ * calloc, realloc, reallocarray, memalign, aligned_alloc, posix_memalign,
+ * valloc and pvalloc over for the whole process, whatever the mode, which
+ * is why it is left out of normal builds; libc's own allocations (strdup,
+ * stdio) go through them, but memory mapped with mmap is not counted.
+ */
+#ifndef __RT_H__
+#define __RT_H__
+
+#define RT_STACK (256 * 1024)      /* Stack faulted in */
+
+/* Heap allocations on the receive thread since rt_setup (see above) */
+extern unsigned long rt_allocations;
+
+/*
+ * Parses a CPU list like "2" or "0,2-3" for rt_setup. Returns 0, or -1 if
+ * it is malformed.
+ */
+int rt_cpus(const char *list);
+
+/*
+ * Puts the calling thread in real-time mode at SCHED_FIFO priority prio.
+ * Returns the number of steps that failed (logged).
+ */
+int rt_setup(int prio);
+
+/*
+ * Counts the heap allocations of the calling thread from now on, as
+ * rt_setup does, without the rest of it (Test/microbench)
+ */
+void rt_count(void);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Tuning of tuiod's UDP socket, see sock.h
+ */
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "sock.h"
+#include "tlog.h"
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+int sock_setup(int fd, int rcvbuf, int busy_poll_us)
+{
+   socklen_t len = sizeof(int);
+   int on = 1, got = 0, failed = 0;
+
+   if (rcvbuf) {
+      if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+               sizeof(rcvbuf)) < 0 &&
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+               sizeof(rcvbuf)) < 0) {
+         tlog_s(TLOG_ERROR, "Socket: SO_RCVBUF failed: %s", strerror(errno),
+               0);
+         failed++;
+      }
+      /* The kernel doubles the size asked for its bookkeeping */
+      getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &got, &len);
+      if (got / 2 < rcvbuf) {
+         tlog(TLOG_WARN, "Socket: receive buffer %ld bytes, not %ld (raise "
+               "net.core.rmem_max, or run with CAP_NET_ADMIN)", got / 2,
+               rcvbuf);
+         failed++;
+      } else {
+         tlog(TLOG_INFO, "Socket: receive buffer %ld bytes", got / 2, 0);
+      }
+   }
+
+   if (busy_poll_us && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+            &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+      tlog_s(TLOG_ERROR, "Socket: SO_BUSY_POLL failed: %s (raising it needs "
+            "CAP_NET_ADMIN)", strerror(errno), 0);
+      failed++;
+   }
+
+   if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+      tlog_s(TLOG_WARN, "Socket: SO_RXQ_OVFL failed, drops are not counted: "
+            "%s", strerror(errno), 0);
+      failed++;
+   }
+   return failed;
+}
+
+long sock_drops(struct msghdr *msg)
+{
+   struct cmsghdr *c;
+   unsigned int drops;
+
+   for (c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+         memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+         return drops;
+      }
+   }
+   return -1;
+}
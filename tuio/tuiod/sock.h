@@ -0,0 +1,39 @@
+/*
+ * Tuning of tuiod's UDP socket, which liblo creates with the defaults.
+ *
+ * A tracker sending a burst faster than tuiod reads overflows the socket
+ * receive buffer, and the kernel drops the datagrams without a word. So:
+ *
+ *    -b bytes   receive buffer size; SO_RCVBUFFORCE when allowed
+ *               (CAP_NET_ADMIN), else SO_RCVBUF, which net.core.rmem_max
+ *               caps. The size the kernel granted is logged.
+ *    -B us      SO_BUSY_POLL: reads spin on the device queue for up to us
+ *               microseconds rather than sleep (raising it needs
+ *               CAP_NET_ADMIN; poll() only busy polls with the
+ *               net.core.busy_poll sysctl set).
+ *
+ * SO_RXQ_OVFL is always enabled: every datagram comes with the number of
+ * datagrams the socket dropped so far, which tuiod logs and exports in
+ * the metrics as they grow.
+ */
+#ifndef __SOCK_H__
+#define __SOCK_H__
+
+#include <sys/socket.h>
+
+#define SOCK_CONTROL 64            /* Ancillary data space a datagram */
+
+/*
+ * Sets the receive buffer (0 to leave it) and busy poll time (0 to leave
+ * it) of socket fd and enables SO_RXQ_OVFL. Failures are logged. Returns
+ * the number of settings that failed.
+ */
+int sock_setup(int fd, int rcvbuf, int busy_poll_us);
+
+/*
+ * The socket's drop count carried by a datagram received with recvmsg,
+ * -1 if it has none
+ */
+long sock_drops(struct msghdr *msg);
+
+#endif
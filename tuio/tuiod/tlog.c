@@ -0,0 +1,221 @@
+/*
+ * Asynchronous logging for tuiod, see tlog.h
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tlog.h"
+
+struct tlog_record {
+   unsigned long long time_ns;
+   const char *fmt;
+   long arg[2];
+   unsigned int suppressed;        /* Repeats not logged before this one */
+   unsigned char strings;          /* String arguments in str */
+   char str[TLOG_STR];             /* Each NUL terminated */
+};
+
+struct tlog {
+   FILE *fp;
+   pthread_t thread;
+   int stop;                       /* Set by tlog_close */
+   unsigned long long start_ns;
+
+   /* The ring: head is written by tlog_write only, tail by the writer
+    * thread only, each published with release/acquire */
+   unsigned long head __attribute__((aligned(64)));
+   unsigned long dropped;
+   unsigned long tail __attribute__((aligned(64)));
+   struct tlog_record *rec;
+};
+
+int tlog_level = TLOG_INFO;
+
+static struct tlog *log_ring;
+static FILE *start_fp;             /* tlog_start's, until tlog_open */
+static unsigned long long start_ns;
+
+
+static unsigned long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Copies s after the strings already in r, cut short to fit */
+static unsigned int add_string(struct tlog_record *r, unsigned int pos,
+      const char *s)
+{
+   unsigned int len;
+
+   if (!s)
+      s = "(null)";
+   len = strnlen(s, TLOG_STR - 1 - pos);
+   memcpy(r->str + pos, s, len);
+   r->str[pos + len] = '\0';
+   return pos + len + 1 < TLOG_STR ? pos + len + 1 : TLOG_STR - 1;
+}
+
+static void print_record(FILE *fp, unsigned long long start,
+      const struct tlog_record *r)
+{
+   const char *s1;
+
+   fprintf(fp, "[%10.6f] ", (r->time_ns - start) / 1e9);
+   switch (r->strings) {
+      case 0:
+         fprintf(fp, r->fmt, r->arg[0], r->arg[1]);
+         break;
+      case 1:
+         fprintf(fp, r->fmt, r->str, r->arg[0], r->arg[1]);
+         break;
+      default:
+         s1 = r->str + strlen(r->str) + 1;
+         fprintf(fp, r->fmt, r->str, s1, r->arg[0], r->arg[1]);
+         break;
+   }
+   if (r->suppressed)
+      fprintf(fp, " (%u more suppressed)", r->suppressed);
+   fputc('\n', fp);
+}
+
+void tlog_write(struct tlog_site *site, int level, const char *fmt,
+      int strings, const char *s0, const char *s1, long a0, long a1)
+{
+   struct tlog *l = log_ring;
+   struct tlog_record *r, one;
+   unsigned long long now;
+   unsigned long head;
+   unsigned int pos;
+
+   if (!l && !start_fp)
+      return;
+   now = now_ns();
+
+   if (level <= TLOG_WARN) {
+      if (now - site->start_ns >= TLOG_BURST_NS) {
+         site->start_ns = now;
+         site->count = 0;
+      }
+      if (site->count >= TLOG_BURST) {
+         site->suppressed++;
+         return;
+      }
+      site->count++;
+   }
+
+   if (l) {
+      head = l->head;
+      if (head - __atomic_load_n(&l->tail, __ATOMIC_ACQUIRE) >= TLOG_RING) {
+         __atomic_store_n(&l->dropped, l->dropped + 1, __ATOMIC_RELAXED);
+         return;
+      }
+      r = &l->rec[head % TLOG_RING];
+   } else {
+      r = &one;
+   }
+   r->time_ns = now;
+   r->fmt = fmt;
+   r->arg[0] = a0;
+   r->arg[1] = a1;
+   r->suppressed = site->suppressed;
+   site->suppressed = 0;
+   r->strings = strings;
+   if (strings > 0) {
+      pos = add_string(r, 0, s0);
+      if (strings > 1)
+         add_string(r, pos, s1);
+   }
+
+   if (!l) {
+      /* Flushed, for a fork not to write it twice */
+      print_record(start_fp, start_ns, r);
+      fflush(start_fp);
+      return;
+   }
+   __atomic_store_n(&l->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void *writer(void *arg)
+{
+   struct tlog *l = arg;
+   struct timespec idle = { 0, TLOG_IDLE_NS };
+   unsigned long head, dropped, reported = 0;
+   int stop;
+
+   while (1) {
+      /* Read stop first: whatever was queued before it is written */
+      stop = __atomic_load_n(&l->stop, __ATOMIC_ACQUIRE);
+      head = __atomic_load_n(&l->head, __ATOMIC_ACQUIRE);
+      if (l->tail != head) {
+         for (; l->tail != head; l->tail++)
+            print_record(l->fp, l->start_ns, &l->rec[l->tail % TLOG_RING]);
+         __atomic_store_n(&l->tail, head, __ATOMIC_RELEASE);
+      }
+
+      dropped = __atomic_load_n(&l->dropped, __ATOMIC_RELAXED);
+      if (dropped != reported) {
+         fprintf(l->fp, "[%10.6f] %lu log records dropped, the ring was "
+               "full\n", (now_ns() - l->start_ns) / 1e9, dropped - reported);
+         reported = dropped;
+      }
+      fflush(l->fp);
+
+      if (stop)
+         break;
+      nanosleep(&idle, NULL);
+   }
+   return NULL;
+}
+
+void tlog_start(FILE *fp)
+{
+   start_fp = fp;
+   start_ns = now_ns();
+}
+
+int tlog_open(FILE *fp)
+{
+   struct tlog *l;
+
+   if (!fp) {
+      errno = EINVAL;
+      return -1;
+   }
+   if ((l = calloc(1, sizeof(*l))) == NULL)
+      return -1;
+   if ((l->rec = malloc(TLOG_RING * sizeof(*l->rec))) == NULL) {
+      free(l);
+      return -1;
+   }
+   l->fp = fp;
+   /* The times go on from tlog_start's */
+   l->start_ns = start_fp ? start_ns : now_ns();
+
+   if ((errno = pthread_create(&l->thread, NULL, writer, l)) != 0) {
+      free(l->rec);
+      free(l);
+      return -1;
+   }
+   log_ring = l;
+   start_fp = NULL;
+   return 0;
+}
+
+void tlog_close(void)
+{
+   struct tlog *l = log_ring;
+
+   if (!l)
+      return;
+   log_ring = NULL;
+   __atomic_store_n(&l->stop, 1, __ATOMIC_RELEASE);
+   pthread_join(l->thread, NULL);
+   free(l->rec);
+   free(l);
+}
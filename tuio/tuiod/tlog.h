@@ -0,0 +1,87 @@
+/*
+ * Asynchronous logging for tuiod, off the receive path.
+ *
+ * A log call does not format or write anything: it stores the format
+ * string (which must be a literal), its integer arguments and a copy of
+ * its string arguments in a record of a single producer, single consumer
+ * ring, and a writer thread formats the records and writes them to the
+ * log file. Only tuiod's receive thread may log. When the ring is full
+ * records are dropped, and counted in the log.
+ *
+ * Formats take the string arguments first, then the integers as long:
+ *
+ *    tlog_ss (TLOG_ERROR, "liblo error in %s: %s (%ld)", path, msg, num);
+ *
+ * No newline at the end, the writer adds it, and the time since
+ * tlog_open in front.
+ *
+ * Before the writer thread can run (tuiod starts it once it has forked
+ * and taken over, see handover.h), tlog_start has the records written as
+ * they are logged, on the caller's thread.
+ *
+ * Errors and warnings are rate limited per call site: after TLOG_BURST
+ * records in TLOG_BURST_NS the site's records are counted instead, and
+ * the count is logged with its next record. Levels above tlog_level are
+ * skipped at run time, those above TLOG_LEVEL_MAX are compiled out.
+ */
+#ifndef __TLOG_H__
+#define __TLOG_H__
+
+#include <stdio.h>
+
+#define TLOG_ERROR 0
+#define TLOG_WARN 1
+#define TLOG_INFO 2
+#define TLOG_VERBOSE 3             /* Every message received (tuiod -v) */
+
+#ifndef TLOG_LEVEL_MAX
+#define TLOG_LEVEL_MAX TLOG_VERBOSE
+#endif
+
+#define TLOG_RING 1024             /* Records queued for the writer */
+#define TLOG_STR 240               /* Bytes of string arguments a record */
+#define TLOG_BURST 10              /* Errors and warnings a call site ... */
+#define TLOG_BURST_NS 1000000000ULL /* ... logs in this time */
+#define TLOG_IDLE_NS 10000000      /* Writer poll interval when idle */
+
+/* Rate limit state of a call site */
+struct tlog_site {
+   unsigned long long start_ns;    /* Of the current burst */
+   unsigned int count;             /* Records logged in it */
+   unsigned int suppressed;        /* Since the last record logged */
+};
+
+/* Highest level logged, TLOG_INFO unless changed */
+extern int tlog_level;
+
+/*
+ * Writes the records to fp as they are logged, until tlog_open. For
+ * starting up, not for the receive path.
+ */
+void tlog_start(FILE *fp);
+
+/*
+ * Starts the writer thread on fp, which stays open after tlog_close.
+ * Returns 0, or -1 on error (errno). Until then log calls are dropped,
+ * or written at once after tlog_start.
+ */
+int tlog_open(FILE *fp);
+
+/* Writes the records still queued and stops the writer */
+void tlog_close(void);
+
+/* Use the macros below, they keep the rate limit state per call site */
+void tlog_write(struct tlog_site *site, int level, const char *fmt,
+      int strings, const char *s0, const char *s1, long a0, long a1);
+
+#define TLOG(level, fmt, strings, s0, s1, a0, a1) do { \
+   static struct tlog_site tlog_site_; \
+   if ((level) <= TLOG_LEVEL_MAX && (level) <= tlog_level) \
+      tlog_write(&tlog_site_, level, fmt, strings, s0, s1, a0, a1); \
+} while (0)
+
+#define tlog(level, fmt, a0, a1) TLOG(level, fmt, 0, NULL, NULL, a0, a1)
+#define tlog_s(level, fmt, s0, a0) TLOG(level, fmt, 1, s0, NULL, a0, 0)
+#define tlog_ss(level, fmt, s0, s1, a0) TLOG(level, fmt, 2, s0, s1, a0, 0)
+
+#endif
@@ -10,12 +10,61 @@
  *    messages on the specified port. When a message is recieved a human
  *    readable string will be written to the specified device.
  *
+ *    With -u no device is needed: the touchmouse state machine
+ *    (../touchmouse/touchcore.h) is built into tuiod and the messages go
+ *    straight to it, with the mouse events injected through /dev/uinput.
+ *    The touchmouse module must not be loaded as well.
+ *
+ *    With -r every packet received is also recorded, timestamped and with
+ *    its sender, to a binary capture file (see capture.h, tuio/tuiocap);
+ *    -z delta codes the contact coordinates in it.
+ *
+ *    Only the TUIO profiles subscribed with -p (by default /tuio/2Dcur, "*"
+ *    for all) are decoded and passed on, the datagrams of others are
+ *    dropped as they arrive, with -k already in the kernel (see filter.h).
+ *
+ *    With -d only the /tuio/2Dcur contacts that changed are passed on, with
+ *    a whole frame now and then (see delta.h).
+ *
+ *    -b sets the socket receive buffer size, -B its busy poll time, and the
+ *    datagrams the socket drops are logged and counted (see sock.h).
+ *
+ *    With -H a tuiod started later with the same -H socket takes over the
+ *    UDP socket, the device and the state of this one, which exits, so a
+ *    restart loses no frames (see handover.h).
+ *
+ *    -R runs the receive thread SCHED_FIFO at the given priority, with the
+ *    memory locked, and -c pins it to a list of CPUs (see rt.h).
+ *
+ *    Frames (bundles) are passed on in fseq order, per sender and profile:
+ *    duplicates and frames older than the last one are dropped, and frames
+ *    lost are announced as "/tuio/2Dcur lost 2". -w holds frames arriving
+ *    early for up to the given milliseconds, for the missing ones to catch
+ *    up (see fseq.h).
+ *
+ *    With -s every frame also goes, as a binary record of its contacts, to
+ *    each local client connected to a SOCK_SEQPACKET socket, which may
+ *    subscribe to a profile and a region of the surface (see fanout.h).
+ *
+ *    With -m counters and histograms of what is received are served on a
+ *    Unix socket, in the Prometheus text format (see metrics.h).
+ *
  *    TUIO/OSC messages are delived in the following format:
  *       "/osc/path/info arg0 arg1 arg2 arg3"
  *   ex: "/tuio/2Dcur set 4 0.482812 0.412500 0.000000 0.000000 -7.122507"
+ *    every argument as one word (see message.h). A frame whose bundle has
+ *    a time tag starts with it, in seconds since 1970:
+ *   ex: "/tuio/2Dcur time 1760000000.250000000"
  *
  * Usage:
- *    ./tuiod 3333 /dev/tuio
+ *    ./tuiod [-f] [-v] [-d] [-r file [-z]] [-m socket] [-w ms]
+ *            [-p profiles [-k]] [-R prio [-c cpus]] [-b bytes] [-B us]
+ *            [-H socket] [-s socket] 3333 /dev/tuio
+ *    ./tuiod [-f] [-v] [-d] [-r file [-z]] [-m socket] [-w ms]
+ *            [-p profiles [-k]] [-R prio [-c cpus]] [-b bytes] [-B us]
+ *            [-H socket] [-s socket] -u 3333
+ *
+ *    -f stays in the foreground, -v logs every message received.
  *
  *
  * Daemon setup from Devin Watson:
@@ -31,11 +80,28 @@
 #include <syslog.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include <lo/lo.h>
 
-//#define __VERBOSE 
+#include "capture.h"
+#include "delta.h"
+#include "fanout.h"
+#include "filter.h"
+#include "fseq.h"
+#include "handover.h"
+#include "message.h"
+#include "rt.h"
+#include "sock.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "uinput.h"
+
 #define __DAEMON
 
+#define POLL_MS 100  /* Longest wait before checking for a signal */
+
 #define LOG_FILE "/var/log/tuiod.log"
 
 // FIXME: Need to handle this somehow!?
@@ -43,14 +109,30 @@
 
 FILE *log_fp = 0;
 FILE *dev_fp = 0;
-int done = 0;
+int use_uinput = 0;
+volatile sig_atomic_t done = 0;  /* The signal that stops tuiod */
 char* buf = 0;
-
+struct capture *cap = 0;
+int use_metrics = 0;
+int kernel_filter = 0;
+int use_delta = 0;
+int frame_source = -1;            /* Sender number, see fseq_frame */
+int rt_prio = 0;
+int rcvbuf = 0;
+int busy_poll = 0;
+long socket_drops = 0;            /* The socket's count, as last seen */
+char *handover_path = 0;
+int handover_sock = -1;           /* UDP socket taken over, see handover.h */
+int handed_over = 0;
+struct metrics_source *src = 0;   /* Sender of the packet being handled */
+unsigned char packet[65536];
+
+void usage(const char *name);
 void collect_tuio(char* sk_port);
+void dispatch_frame(lo_server st, const struct fseq_frame *frame);
+void output(const char *line);
 void error(int num, const char *m, const char *path);
 void sighandler(int sig);
-int write_msg( char* buf, int buf_len, const char *path, const char *types,
-               lo_arg **argv, int argc);
 
 int generic_handler(const char *path, const char *types, lo_arg **argv,
                      int argc, void *data, void *user_data);
@@ -60,13 +142,82 @@ int main(int argc, char* argv[])
 #ifdef __DAEMON
    pid_t pid, sid;
 #endif
-   char* dev_file;
-
-   if(argc != 3) {
-      printf("usage: %s port_num dest_device\n", argv[0]);
-      exit(EXIT_FAILURE);
+   char* dev_file = 0;
+   char* cap_file = 0;
+   char* metrics_file = 0;
+   char* fanout_file = 0;
+   int daemonize = 1;
+   int cap_flags = 0;
+   unsigned long long packets, dropped;
+   int opt, taken = 0, dev_fd = -1;
+
+   while((opt = getopt(argc, argv, "fvur:zm:w:p:kdR:c:b:B:H:s:")) != -1) {
+      switch(opt) {
+         case 'f':
+            daemonize = 0;
+            break;
+         case 'v':
+            tlog_level = TLOG_VERBOSE;
+            break;
+         case 'u':
+            use_uinput = 1;
+            break;
+         case 'r':
+            cap_file = optarg;
+            break;
+         case 'z':
+            cap_flags |= CAPTURE_DELTA;
+            break;
+         case 'm':
+            metrics_file = optarg;
+            break;
+         case 'w':
+            if(fseq_init(strtoul(optarg, NULL, 10) * 1000000ULL) < 0) {
+               printf("ERROR: Could not allocate the reordering window\n");
+               exit(EXIT_FAILURE);
+            }
+            break;
+         case 'p':
+            if(filter_set(optarg) < 0)
+               usage(argv[0]);
+            break;
+         case 'k':
+            kernel_filter = 1;
+            break;
+         case 'd':
+            use_delta = 1;
+            delta_init(output);
+            break;
+         case 'R':
+            rt_prio = atoi(optarg);
+            if(rt_prio < 1 || rt_prio > 99)
+               usage(argv[0]);
+            break;
+         case 'c':
+            if(rt_cpus(optarg) < 0)
+               usage(argv[0]);
+            break;
+         case 'b':
+            rcvbuf = atoi(optarg);
+            break;
+         case 'B':
+            busy_poll = atoi(optarg);
+            break;
+         case 'H':
+            handover_path = optarg;
+            break;
+         case 's':
+            fanout_file = optarg;
+            break;
+         default:
+            usage(argv[0]);
+      }
    }
-   dev_file = argv[2];
+
+   if(argc - optind != (use_uinput ? 1 : 2) || (cap_flags && !cap_file))
+      usage(argv[0]);
+   if(!use_uinput)
+      dev_file = argv[optind + 1];
    /* // liblo accepts port as string. Not needed now
    // Parse the port number
    sk_port = atoi(argv[1]);
@@ -78,85 +229,210 @@ int main(int argc, char* argv[])
 
 #ifdef __DAEMON
 
-   /* Fork from the parent process */
-   pid = fork();
-   if (pid < 0)
-      exit(EXIT_FAILURE);
+   if (daemonize) {
+      /* Fork from the parent process */
+      pid = fork();
+      if (pid < 0)
+         exit(EXIT_FAILURE);
 
-   /* Exit parent */
-   if (pid > 0) 
-      exit(EXIT_SUCCESS);
+      /* Exit parent */
+      if (pid > 0) 
+         exit(EXIT_SUCCESS);
 
 
-   /* Change the file mode mask */
-   umask(0);
+      /* Change the file mode mask */
+      umask(0);
+   }
 #endif
 
-   /* Open any logs here */
-   if((log_fp = fopen(LOG_FILE, "w")) == NULL) {
+   /* Open any logs here, after those of the tuiod taken over from */
+   if((log_fp = fopen(LOG_FILE, handover_path ? "a" : "w")) == NULL) {
       printf("Warning: Could not open log file [%s] for writing\n", LOG_FILE);
       //exit(EXIT_FAILURE);
    }
+   /* Written at once until the logger's thread starts, below */
+   if(log_fp)
+      tlog_start(log_fp);
+
+   /* Take the socket and device of a tuiod running, if there is one */
+   if(handover_path && (taken = handover_take(handover_path, use_uinput,
+               &handover_sock, &dev_fd, &socket_drops)) < 0) {
+      printf("ERROR: Could not take over from the tuiod at '%s', see %s\n",
+            handover_path, LOG_FILE);
+      exit(EXIT_FAILURE);
+   }
 
-   /* Open the device for reading */
-   if((dev_fp = fopen(dev_file, "w")) == NULL) {
-      printf("ERROR: Could not open device '%s' for writing!\n", dev_file);
+   if(taken && use_uinput) {
+      uinput_adopt(dev_fd);
+   } else if(taken) {
+      if((dev_fp = fdopen(dev_fd, "w")) == NULL) {
+         printf("ERROR: Could not write to the device taken over\n");
+         exit(EXIT_FAILURE);
+      }
+   } else if(use_uinput) {
+      /* Create the mouse */
+      if(uinput_init() < 0) {
+         printf("ERROR: Could not create the uinput mouse, see %s\n", LOG_FILE);
+         exit(EXIT_FAILURE);
+      }
+      if(log_fp) fprintf(log_fp, "Created uinput mouse\n");
+   } else {
+      /* Open the device for reading */
+      if((dev_fp = fopen(dev_file, "w")) == NULL) {
+         printf("ERROR: Could not open device '%s' for writing!\n", dev_file);
 
-      if(log_fp)
-         fprintf(log_fp, "ERROR: Could not open device '%s' for writing!\n", dev_file);
+         if(log_fp)
+            fprintf(log_fp, "ERROR: Could not open device '%s' for writing!\n", dev_file);
 
-      exit(EXIT_FAILURE);
+         exit(EXIT_FAILURE);
+      }
+      if(log_fp) fprintf(log_fp, "Opened device '%s' for writing\n", dev_file);
    }
-   if(log_fp) fprintf(log_fp, "Opened device '%s' for writing\n", dev_file);
 
-#ifdef __DAEMON
-   /* Creates a new SID for the child process */
-   if ((sid = setsid()) < 0) {
-      if(log_fp) fprintf(log_fp, "ERROR: setsid() failed\n");
-      exit(EXIT_FAILURE);
+   if(cap_file) {
+      /* Relative to the cwd at start, before the daemon leaves it */
+      if((cap = capture_open(cap_file, cap_flags)) == NULL) {
+         printf("ERROR: Could not open capture '%s': %s\n", cap_file,
+               strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+      if(log_fp) fprintf(log_fp, "Recording to '%s'\n", cap_file);
    }
 
-   /* Change the cwd */
-   if ((chdir("/")) < 0) {
-      if(log_fp) fprintf(log_fp, "ERROR: chdir(\"/\") failed\n");
-      exit(EXIT_FAILURE);
+   if(metrics_file) {
+      if(metrics_open(metrics_file) < 0) {
+         printf("ERROR: Could not serve metrics on '%s': %s\n", metrics_file,
+               strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+      use_metrics = 1;
+      if(log_fp) fprintf(log_fp, "Serving metrics on '%s'\n", metrics_file);
    }
+
+   if(fanout_file) {
+      if(fanout_open(fanout_file) < 0) {
+         printf("ERROR: Could not serve frames on '%s': %s\n", fanout_file,
+               strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+      if(log_fp) fprintf(log_fp, "Serving frames on '%s'\n", fanout_file);
+   }
+
+#ifdef __DAEMON
+   if (daemonize) {
+      /* Creates a new SID for the child process */
+      if ((sid = setsid()) < 0) {
+         if(log_fp) fprintf(log_fp, "ERROR: setsid() failed\n");
+         exit(EXIT_FAILURE);
+      }
+
+      /* Change the cwd */
+      if ((chdir("/")) < 0) {
+         if(log_fp) fprintf(log_fp, "ERROR: chdir(\"/\") failed\n");
+         exit(EXIT_FAILURE);
+      }
    
-   /* Close out the standard file descriptors */
-   close(STDIN_FILENO);
-   close(STDOUT_FILENO);
-   close(STDERR_FILENO);
+      /* Close out the standard file descriptors */
+      close(STDIN_FILENO);
+      close(STDOUT_FILENO);
+      close(STDERR_FILENO);
+   }
 #endif
 
    /* Allocate memory for buffer */
    buf = malloc(BUF_LEN);
 
-
-   collect_tuio(argv[1]);
-
-   fclose(log_fp);
+   /* From here on the log is written by its own thread, see tlog.h */
+   if(log_fp && tlog_open(log_fp) < 0)
+      fprintf(log_fp, "ERROR: Could not start the logger: %s\n",
+            strerror(errno));
+
+   collect_tuio(argv[optind]);
+   if(done)
+      tlog(TLOG_INFO, "Signal %ld, shutting down", done, 0);
+
+   /* The successor has the mouse now */
+   if(use_uinput && !handed_over)
+      uinput_exit();
+   handover_close();
+   fanout_close();
+   metrics_close();
+#ifdef RT_COUNT_ALLOCATIONS
+   if(rt_prio)
+      tlog(TLOG_INFO, "RT: %ld heap allocations on the receive thread",
+            rt_allocations, 0);
+#endif
+   tlog_close();
+   if(cap) {
+      capture_close(cap, &packets, &dropped);
+      if(log_fp) fprintf(log_fp, "Recorded %llu packets, dropped %llu\n",
+            packets, dropped);
+   }
+   if(log_fp) fclose(log_fp);
    free(buf);
    return 0;
 }
 
 
+void usage(const char *name)
+{
+   printf("usage: %s [-f] [-v] [-d] [-r file [-z]] [-m socket] [-w ms] "
+         "[-p profiles [-k]]\n          [-R prio [-c cpus]] [-b bytes] "
+         "[-B us] [-H socket] [-s socket] port_num dest_device\n", name);
+   printf("       %s [-f] [-v] [-d] [-r file [-z]] [-m socket] [-w ms] "
+         "[-p profiles [-k]]\n          [-R prio [-c cpus]] [-b bytes] "
+         "[-B us] [-H socket] [-s socket] -u port_num\n", name);
+   exit(EXIT_FAILURE);
+}
+
+static unsigned long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /*
  * Accepts a port number as a null terminated string and begins polling the
- * specified socket for any osc data packets
+ * specified socket for any osc data packets. Messages are handled on this
+ * thread, between them the touchmouse timers are run (-u) and the frames
+ * held for reordering sent on.
  */
 void collect_tuio(char* sk_port)
 {
+   struct pollfd pfd[2 + 1 + FANOUT_MAX_CLIENTS];
+   struct sockaddr_storage from;
+   socklen_t from_len;
+   ssize_t len;
+   struct iovec iov = { packet, sizeof(packet) };
+   struct msghdr msg;
+   char control[SOCK_CONTROL];
+   long drops;
+   struct metrics_source *msrc = 0;
+   struct fseq_frame frame;
+   unsigned long long now;
+   int timeout, ready, nfds, i;
+
    /* Register signal handlers */
    signal(SIGABRT, &sighandler);
    signal(SIGTERM, &sighandler);
    signal(SIGINT, &sighandler);
 
 
-   /* Create a new server */
-   lo_server_thread st = lo_server_thread_new(sk_port, error);
+   /* Create a new server; on any port when the socket was taken over,
+    * it is not read from */
+   lo_server st = lo_server_new(handover_sock < 0 ? sk_port : NULL, error);
+   if(!st) {
+      tlog_s(TLOG_ERROR, "ERROR: Could not listen on port %s", sk_port, 0);
+      return;
+   }
 
-   /* Add method that will match any path and args */
-   lo_server_thread_add_method(st, NULL, NULL, generic_handler, NULL);
+   /* Add a method per profile subscribed, or one for any path and args */
+   for(i = 0; i < filter_count(); i++)
+      lo_server_add_method(st, filter_profile(i), NULL, generic_handler, NULL);
+   if(!filter_count())
+      lo_server_add_method(st, NULL, NULL, generic_handler, NULL);
 
    
    /* add method that will handle the 2d objects */
@@ -169,14 +445,168 @@ void collect_tuio(char* sk_port)
    /* add method that will handle the set msg from 2dcur profile */
    //lo_server_thread_add_method(st, "/tuio/2Dcur", "sifffff", cur_set_handler, NULL);
 
-   /* Start the server */
-   lo_server_thread_start(st);
+   pfd[0].fd = lo_server_get_socket_fd(st);
+   pfd[0].events = POLLIN;
+   if(handover_sock >= 0) {
+      dup2(handover_sock, pfd[0].fd);
+      close(handover_sock);
+      if(handover_restore() < 0) {
+         /* The socket and device are still the old tuiod's */
+         handed_over = 1;
+         lo_server_free(st);
+         return;
+      }
+   }
+
+   sock_setup(pfd[0].fd, rcvbuf, busy_poll);
+   if(kernel_filter && filter_attach(pfd[0].fd) < 0)
+      tlog_s(TLOG_ERROR, "ERROR: Could not attach the profile filter: %s",
+            strerror(errno), 0);
+
+   /* For the next tuiod to take over */
+   pfd[1].fd = -1;
+   pfd[1].events = POLLIN;
+   if(handover_path && (pfd[1].fd = handover_listen(handover_path)) < 0)
+      tlog_s(TLOG_ERROR, "ERROR: Could not listen for a handover: %s",
+            strerror(errno), 0);
+
+   /* Everything is allocated now */
+   if(rt_prio)
+      rt_setup(rt_prio);
 
    while(!done) {
-      usleep(1000);
+      /* Sleep until a packet arrives or the next timer is due */
+      timeout = use_uinput ? uinput_timeout(POLL_MS) : POLL_MS;
+      timeout = fseq_timeout(now_ns(), timeout);
+      nfds = 2 + fanout_pollfds(pfd + 2);
+      ready = poll(pfd, nfds, timeout);
+
+      /* Clients of -s connecting, subscribing or taking what is queued */
+      if(ready > 0 && nfds > 2)
+         fanout_poll(pfd + 2, nfds - 2, now_ns());
+
+      if(ready > 0 && (pfd[0].revents & POLLIN)) {
+         /* Take the datagrams ourselves to see the raw bytes, sender and
+          * the socket's drop count */
+         memset(&msg, 0, sizeof(msg));
+         msg.msg_name = &from;
+         msg.msg_iov = &iov;
+         msg.msg_iovlen = 1;
+         msg.msg_control = control;
+         for(;;) {
+            msg.msg_namelen = sizeof(from);
+            msg.msg_controllen = sizeof(control);
+            if((len = recvmsg(pfd[0].fd, &msg, MSG_DONTWAIT)) <= 0)
+               break;
+            from_len = msg.msg_namelen;
+            if((drops = sock_drops(&msg)) > socket_drops) {
+               tlog(TLOG_WARN, "Socket: %ld datagrams dropped, the receive "
+                     "buffer was full (%ld so far)", drops - socket_drops,
+                     drops);
+               if(use_metrics)
+                  METRICS_ADD(metrics_socket_drops, drops - socket_drops);
+               socket_drops = drops;
+            }
+            if(cap)
+               capture_packet(cap, (struct sockaddr *) &from, packet, len);
+            if(use_metrics) {
+               msrc = metrics_source((struct sockaddr *) &from);
+               METRICS_ADD(msrc->datagrams, 1);
+               METRICS_ADD(msrc->bytes, len);
+               if(len >= 8 && !memcmp(packet, "#bundle", 8))
+                  METRICS_ADD(msrc->bundles, 1);
+            }
+
+            if(!filter_packet(packet, len)) {
+               if(msrc)
+                  METRICS_ADD(msrc->filtered, 1);
+               continue;
+            }
+            now = now_ns();
+            switch(fseq_packet(fseq_source((struct sockaddr *) &from,
+                        from_len, now), packet, len, now, &frame)) {
+               case FSEQ_PASS:
+                  dispatch_frame(st, &frame);
+                  break;
+               case FSEQ_DROP:
+                  if(msrc)
+                     METRICS_ADD(msrc->fseq_dropped, 1);
+                  break;
+            }
+         }
+      }
+
+      /* The frames held that are in order now, or waited long enough */
+      while(fseq_next(now_ns(), &frame))
+         dispatch_frame(st, &frame);
+
+      /* A new tuiod taking over: pass on all held, and stop once it has */
+      if(ready > 0 && (pfd[1].revents & POLLIN)) {
+         fseq_flush();
+         while(fseq_next(now_ns(), &frame))
+            dispatch_frame(st, &frame);
+         if(handover_give(pfd[0].fd, use_uinput ? uinput_get_fd() :
+                  fileno(dev_fp), use_uinput, socket_drops)) {
+            handed_over = 1;
+            break;
+         }
+         pfd[1].revents = 0;
+      }
+
+      if(use_uinput)
+         uinput_run_timers();
    }
 
-   lo_server_thread_free(st);
+   lo_server_free(st);
+}
+
+/* Hands a datagram to liblo, after the frames lost before it if any */
+void dispatch_frame(lo_server st, const struct fseq_frame *frame)
+{
+   struct timespec ts;
+   lo_timetag tt;
+   long long ns, tag_ns = 0;
+   int len;
+
+   src = use_metrics && frame->from ? metrics_source(frame->from) : 0;
+   frame_source = frame->source;
+
+   if(frame->lost && frame->profile) {
+      snprintf(buf, BUF_LEN, "%s lost %ld\n", frame->profile, frame->lost);
+      output(buf);
+   }
+
+   /* The tracker's time of the frame, when it sets one */
+   if(frame->profile && bundle_timetag(frame->data, frame->len, &tt)) {
+      len = snprintf(buf, BUF_LEN, "%s time", frame->profile);
+      if((len = write_timetag(buf + len, BUF_LEN - len - 1, tt)) > 0) {
+         strcat(buf, "\n");
+         output(buf);
+      }
+
+      tag_ns = timetag_ns(tt);
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ns = (long long) ts.tv_sec * 1000000000 + ts.tv_nsec - tag_ns;
+      if(src && ns >= 0)
+         metrics_hist_add(&src->source_latency, ns);
+   }
+   if(frame->profile)
+      fanout_begin(frame->source, frame->profile, frame->lost, tag_ns,
+            now_ns());
+   lo_server_dispatch_data(st, (void *) frame->data, frame->len);
+}
+
+/* Writes a line to the device, or hands it to the built in touchmouse */
+void output(const char *line)
+{
+   if(use_uinput) {
+      uinput_dispatch(line);
+      return;
+   }
+
+   if(fputs(line, dev_fp) == EOF)
+      tlog(TLOG_ERROR, "ERROR: Could not write to device!", 0, 0);
+   fflush(dev_fp);
 }
 
 /* Generic handler for all osc messages in any format */
@@ -184,6 +614,8 @@ int generic_handler(const char *path, const char *types, lo_arg **argv,
                      int argc, void *data, void *user_data)
 {
    int len;
+   unsigned long unknown = write_msg_unknown;
+   unsigned long long start = 0;
    /*
 #ifdef __VERBOSE
    int i;
@@ -199,103 +631,62 @@ int generic_handler(const char *path, const char *types, lo_arg **argv,
 */
 
 
+   if(src) {
+      METRICS_ADD(src->messages, 1);
+      start = metrics_now();
+      if(argc >= 2 && types[0] == 's' && types[1] == 'i' &&
+            !strcmp(&argv[0]->s, "fseq"))
+         metrics_frame(src, argv[1]->i, start);
+   }
+
+   /* To the clients of -s, whole frames whatever -d leaves out */
+   fanout_message(frame_source, path, types, argv, argc, now_ns());
+
+   /* Only what changed since the last frame (-d) */
+   if(use_delta &&
+         delta_message(frame_source, path, types, argv, argc) == DELTA_SKIP)
+      return 1;
+
    /* Compose the message into a one line character string */
    len = write_msg(buf, BUF_LEN-2, path, types, argv, argc);
 
+   if(src) {
+      if(write_msg_unknown != unknown)
+         METRICS_ADD(src->unknown_types, write_msg_unknown - unknown);
+      if(len < 0)
+         METRICS_ADD(src->overflows, 1);
+   }
+
    if( len < 0 ) {
-      if(log_fp) fprintf(log_fp, "ERROR: Buffer overflow! Data not written\n");
+      tlog(TLOG_ERROR, "ERROR: Buffer overflow! Data not written", 0, 0);
    } else {
+      tlog_s(TLOG_VERBOSE, "%s", buf, 0);
+
       // Add a null terminator
       buf[len] = '\n';
       buf[len+1] = '\0';
 
-      // Write the data to the device
-      if(!fputs(buf, dev_fp))
-         if(log_fp) fprintf(log_fp, "ERROR: Could not write to device!\n");
-      fflush(dev_fp);
+      output(buf);
 
-#ifdef __VERBOSE
-      if(log_fp) fprintf(log_fp, "%s\n", buf);
-#endif
+      if(src)
+         metrics_hist_add(&src->write_latency, metrics_now() - start);
    }
     
    return 1;
 }
 
-/*
- * Composes the osc datatypes into a human readable string of the form:
- * "/path/here arg0 arg1 arg2 arg3\n"
- */
-int write_msg( char* lbuf, int buf_len, const char *path, const char *types,
-               lo_arg **argv, int argc)
-{
-   int i;
-   char* buf_start = lbuf;
-
-   lbuf += sprintf(lbuf, "%s", path);
-   
-   if(lbuf - buf_start > buf_len)
-      return -1;
-
-   for(i = 0; i < argc; i++) {
-
-      /* check for overflow */
-      if(lbuf - buf_start > buf_len)
-         return -1;
-
-      switch(types[i]) {
-         /** 32 bit signed integer. */
-         case 'i':
-            lbuf += sprintf(lbuf, " %d", argv[i]->i);
-            break;
-         /** 64 bit signed integer. */
-         case 'h':
-            lbuf += sprintf(lbuf, " %ld", argv[i]->h);
-            break;
-         /** 32 bit IEEE-754 float. */
-         case 'f':
-            lbuf += sprintf(lbuf, " %f", argv[i]->f);
-            break;
-         /** 64 bit IEEE-754 double. */
-         case 'd':
-            lbuf += sprintf(lbuf, " %lf", argv[i]->d);
-            break;
-         /** Standard C, NULL terminated string. */
-         case 's':
-            lbuf += sprintf(lbuf, " %s", &(argv[i]->s));
-            break;
-         /** Standard C, NULL terminated, string. Used in systems which
-           * distinguish strings and symbols. */
-         case 'S':
-            lbuf += sprintf(lbuf, " %s", &(argv[i]->S));
-            break;
-         /** Standard C, 8 bit, char. */
-         case 'c':
-            lbuf += sprintf(lbuf, " %c", argv[i]->c);
-            break;
-         /** OSC TimeTag value. */
-         // TODO
-         case 't':
-            if(log_fp) fprintf(log_fp, "TODO: TimeTag\n");
-            break;
-         default:
-            if(log_fp) fprintf(log_fp, "Unknown type [%c]\n", types[i]);
-            break;
-      }
-   }
-
-   return lbuf - buf_start;
-}
-
 /* Called when liblo recieves an error */
 void error(int num, const char *m, const char *path)
 {
-   if(log_fp) fprintf(log_fp, "liblo server error %d in path %s: %s\n", num, path, m);
+   tlog_ss(TLOG_ERROR, "liblo server error in path %s: %s (%ld)", path, m, num);
+   if(src)
+      METRICS_ADD(src->parse_errors, 1);
 }
 
+/* Only stops the loop: log_fp is the log writer's (tlog.h), and stdio is
+ * not safe in a signal handler */
 void sighandler(int sig)
 {
-   if(log_fp) fprintf(log_fp, "SIG\n");
-   done = 1;
+   done = sig;
 }
 
@@ -0,0 +1,202 @@
+/*
+ * /dev/uinput backend of tuiod's built in touchmouse, see uinput.h
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#include "tlog.h"
+#include "touchcore.h"
+#include "uinput.h"
+
+static struct touchcore core;
+static struct touchcore_params params = TOUCHCORE_PARAMS_DEFAULT;
+static int uinput_fd = -1;
+static long long tick_us;
+static long long next_tick_us;   /* 0 when the scroll timer is idle */
+
+
+static unsigned long long uinput_now_us(void *ctx)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void uinput_event(void *ctx, unsigned int type, unsigned int code,
+      int value)
+{
+   struct input_event ev;
+
+   /* The kernel timestamps the event */
+   memset(&ev, 0, sizeof(ev));
+   ev.type = type;
+   ev.code = code;
+   ev.value = value;
+
+   if (write(uinput_fd, &ev, sizeof(ev)) != sizeof(ev))
+      tlog_s(TLOG_ERROR, "ERROR: uinput write failed: %s", strerror(errno), 0);
+}
+
+static void uinput_timer_start(void *ctx)
+{
+   next_tick_us = uinput_now_us(NULL) + tick_us;
+}
+
+static const struct touchcore_ops uinput_ops = {
+   .now_us = uinput_now_us,
+   .event = uinput_event,
+   .timer_start = uinput_timer_start,
+};
+
+int uinput_timeout(int max_ms)
+{
+   long long left;
+
+   if (!next_tick_us)
+      return max_ms;
+
+   left = next_tick_us - (long long) uinput_now_us(NULL);
+   left = left > 0 ? (left + 999) / 1000 : 0;
+   return left < max_ms ? (int) left : max_ms;
+}
+
+void uinput_run_timers(void)
+{
+   long long now = uinput_now_us(NULL);
+
+   if (!next_tick_us || now < next_tick_us)
+      return;
+
+   if (!touchcore_tick(&core)) {
+      next_tick_us = 0;
+      return;
+   }
+
+   /* Skip any missed ticks */
+   while (next_tick_us <= now)
+      next_tick_us += tick_us;
+}
+
+void uinput_dispatch(const char *message)
+{
+   touchcore_dispatch(&core, message);
+}
+
+static void core_init(void)
+{
+#ifdef REL_WHEEL_HI_RES
+   params.hires = 1;
+#endif
+   tick_us = 1000000 / UINPUT_SCROLL_HZ;
+   touchcore_init(&core, &uinput_ops, NULL, &params, UINPUT_COORD_RES,
+         tick_us);
+}
+
+int uinput_init(void)
+{
+   struct uinput_user_dev setup;
+   const struct touchcore_cap *caps;
+   int i, count, request;
+
+   core_init();
+   if ((uinput_fd = open(UINPUT_DEVICE, O_WRONLY | O_NONBLOCK)) < 0) {
+      tlog_ss(TLOG_ERROR, "ERROR: Could not open '%s': %s", UINPUT_DEVICE,
+            strerror(errno), 0);
+      return -1;
+   }
+
+   memset(&setup, 0, sizeof(setup));
+   strncpy(setup.name, "touchmouse", UINPUT_MAX_NAME_SIZE - 1);
+   setup.id.bustype = BUS_VIRTUAL;
+   setup.id.vendor  = 0x0001;
+   setup.id.product = 0x0001;
+   setup.id.version = 0x0100;
+   setup.absmin[ABS_X] = 0;
+   setup.absmax[ABS_X] = UINPUT_COORD_RES - 1;
+   setup.absmin[ABS_Y] = 0;
+   setup.absmax[ABS_Y] = UINPUT_COORD_RES - 1;
+
+   /* Everything the core may report */
+   count = touchcore_caps(&core, &caps);
+   for (i = 0; i < count; i++) {
+      request = caps[i].type == EV_KEY ? UI_SET_KEYBIT
+              : caps[i].type == EV_REL ? UI_SET_RELBIT : UI_SET_ABSBIT;
+      if (ioctl(uinput_fd, UI_SET_EVBIT, caps[i].type) < 0
+            || ioctl(uinput_fd, request, caps[i].code) < 0)
+         goto error;
+   }
+
+   if (write(uinput_fd, &setup, sizeof(setup)) != sizeof(setup)
+         || ioctl(uinput_fd, UI_DEV_CREATE) < 0)
+      goto error;
+   return 0;
+
+error:
+   tlog_s(TLOG_ERROR, "ERROR: Could not create uinput device: %s",
+         strerror(errno), 0);
+   close(uinput_fd);
+   uinput_fd = -1;
+   return -1;
+}
+
+void uinput_exit(void)
+{
+   if (uinput_fd < 0)
+      return;
+
+   ioctl(uinput_fd, UI_DEV_DESTROY);
+   close(uinput_fd);
+   uinput_fd = -1;
+}
+
+void uinput_adopt(int fd)
+{
+   core_init();
+   uinput_fd = fd;
+}
+
+int uinput_get_fd(void)
+{
+   return uinput_fd;
+}
+
+/* What goes to the successor */
+struct saved {
+   struct touchcore core;
+   long long next_tick_us;
+};
+
+long uinput_save(void *state, size_t max)
+{
+   struct saved *saved = state;
+
+   if (sizeof(*saved) > max)
+      return -1;
+   saved->core = core;
+   saved->next_tick_us = next_tick_us;
+   return sizeof(*saved);
+}
+
+int uinput_restore(const void *state, size_t len)
+{
+   const struct saved *saved = state;
+   struct touchcore c;
+
+   if (len != sizeof(*saved))
+      return -1;
+
+   /* The state, not the pointers of the process that saved it */
+   c = saved->core;
+   c.ops = core.ops;
+   c.ctx = core.ctx;
+   c.params = core.params;
+   core = c;
+   next_tick_us = saved->next_tick_us;
+   return 0;
+}
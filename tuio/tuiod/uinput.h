@@ -0,0 +1,44 @@
+/*
+ * Built in touchmouse for tuiod -u: the shared state machine
+ * (../touchmouse/touchcore.h) reporting through /dev/uinput.
+ *
+ * Everything runs on tuiod's receive thread; the momentum scroll timer is
+ * run from tuiod's poll loop (see uinput_timeout and uinput_run_timers).
+ */
+#ifndef __UINPUT_H__
+#define __UINPUT_H__
+
+#include <stddef.h>
+
+#define UINPUT_DEVICE "/dev/uinput"
+#define UINPUT_COORD_RES 1000000   /* Units per 1.0 of TUIO coordinate */
+#define UINPUT_SCROLL_HZ 60        /* Momentum scroll events per second */
+
+/* Creates the mouse. Returns 0 on success, -1 on error (logged) */
+int uinput_init(void);
+void uinput_exit(void);
+
+/*
+ * Takes over the mouse fd of the tuiod before (handover.h) instead of
+ * creating one; its state follows with uinput_restore
+ */
+void uinput_adopt(int fd);
+int uinput_get_fd(void);
+
+/*
+ * The touchmouse state, drags and scrolls under way included: uinput_save
+ * copies it to state, returning its length, -1 if over max; uinput_restore
+ * takes it back, returning -1 if it does not fit.
+ */
+long uinput_save(void *state, size_t max);
+int uinput_restore(const void *state, size_t len);
+
+/* Handles one "/tuio/2Dcur ..." message */
+void uinput_dispatch(const char *message);
+
+/* Milliseconds until the next timer is due, at most max_ms */
+int uinput_timeout(int max_ms);
+/* Runs the timers that are due */
+void uinput_run_timers(void);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __RING_H__
+#define __RING_H__
+
+/*
+ * The message ring of the tuio device: BUF_COUNT entries of up to BUF_LEN
+ * bytes, linked in a loop. A write never waits for the reader: when the
+ * ring is full the oldest message is overwritten and the reader moved past
+ * it, so messages stay in order.
+ *
+ * No kernel dependencies (the includer provides size_t), so the ring also
+ * runs in user space, see Test/microbench. The device copies the message
+ * from or to the user between the _slot and _done calls.
+ */
+
+#define BUF_COUNT 20    /* Number of buffers in the ring */
+#define BUF_LEN 256     /* Maximum message length */
+
+/* Ring buffer entry struct */
+struct buf_ring_ent {
+   char buf[BUF_LEN];   /* Actual data in the buffer */
+   size_t len;          /* Length of data in the buffer, 0 once read */
+   struct buf_ring_ent *next; /* Pointer to next entry in ring */
+};
+
+struct tuio_ring {
+   struct buf_ring_ent *read;    /* The current read buffer */
+   struct buf_ring_ent *write;   /* The current write buffer */
+};
+
+/*
+ * Links the count entries of 'ent' into an empty ring
+ */
+static inline void ring_init(struct tuio_ring *r, struct buf_ring_ent *ent,
+      int count)
+{
+   int i;
+
+   for (i = 0; i < count; i++) {
+      ent[i].len = 0;
+      ent[i].next = &ent[(i + 1) % count];
+   }
+   r->read = r->write = ent;
+}
+
+/*
+ * Entry to write the next message to
+ */
+static inline struct buf_ring_ent *ring_write_slot(struct tuio_ring *r)
+{
+   /* If we are overwritting data,
+    * move the read pointer to preserve message order */
+   if (r->write->len)
+      r->read = r->read->next;
+   return r->write;
+}
+
+/*
+ * Publishes the len bytes written to the slot
+ */
+static inline void ring_write_done(struct tuio_ring *r, size_t len)
+{
+   r->write->len = len;
+   r->write = r->write->next;
+}
+
+/*
+ * Entry of the oldest unread message, 0 if there is none
+ */
+static inline struct buf_ring_ent *ring_read_slot(struct tuio_ring *r)
+{
+   return r->read->len ? r->read : 0;
+}
+
+/*
+ * Clears the entry read and moves on
+ */
+static inline void ring_read_done(struct tuio_ring *r)
+{
+   r->read->len = 0;
+   r->read = r->read->next;
+}
+
+#endif
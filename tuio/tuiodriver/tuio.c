@@ -44,23 +44,16 @@
 
 #include <asm/uaccess.h>
 
-#define BUF_COUNT 20    /* Number of buffers in the ring */
-#define BUF_LEN 256     /* Maximum message length */
+#include "ring.h"
+
 #define DEV_NAME "tuio" /* Device filename: /dev/DEV_NAME */
 
 
 /* Wait queue for reading */
 static DECLARE_WAIT_QUEUE_HEAD(tuio_read_wait);
 
-/* Ring buffer entry struct */
-struct buf_ring_ent {
-   char buf[BUF_LEN];   /* Actual data in the buffer */
-   size_t len;          /* Length of data in the buffer */
-   struct buf_ring_ent *next; /* Pointer to next entry in ring */
-};
-
-static struct buf_ring_ent *read_buf;  /* Pointer to the current read buffer */
-static struct buf_ring_ent *write_buf; /* Pointer to the current write buffer */
+static struct buf_ring_ent *ring_buf;  /* The BUF_COUNT ring entries */
+static struct tuio_ring ring;          /* See ring.h */
 
 static int read_busy = 0;  /* Used to prevent multiple readers */
 static int write_busy = 0; /* Used to prevent multiple writers */
@@ -78,16 +71,17 @@ static int write_busy = 0; /* Used to prevent multiple writers */
 static ssize_t tuio_read(struct file * file, char * buf, 
 			  size_t count, loff_t *ppos)
 {
+   struct buf_ring_ent *read_buf;
    ssize_t retval;
 
    /* Sleep until new data has arrived */
-   while (!read_buf->len) {
+   while (!(read_buf = ring_read_slot(&ring))) {
 
       if (file->f_flags & O_NONBLOCK)
          return -EAGAIN;
 
       /* Wait until there is data in the current read buffer */
-      wait_event_interruptible(tuio_read_wait, read_buf->len != 0);
+      wait_event_interruptible(tuio_read_wait, ring.read->len != 0);
 
       if (signal_pending(current))
          return -ERESTARTSYS;
@@ -107,8 +101,7 @@ static ssize_t tuio_read(struct file * file, char * buf,
 
    /* Clear the current buffer and move on */
    retval = read_buf->len;
-   read_buf->len = 0;
-   read_buf = read_buf->next;
+   ring_read_done(&ring);
 
 	/* All data has been passed. */
 	return retval;
@@ -121,25 +114,21 @@ static ssize_t tuio_read(struct file * file, char * buf,
 static ssize_t tuio_write(struct file * file, const char * buf, 
 			size_t count, loff_t * offp)
 {
+   struct buf_ring_ent *write_buf;
+
    /* verify the length of the data */
    if (count > BUF_LEN)
       return -EINVAL;
 
-   /* If we are overwritting data,
-    * move the read pointer to preserve message order */
-   if (write_buf->len) {
-      read_buf = read_buf->next;
-   }
+   /* Overwrites the oldest message when full */
+   write_buf = ring_write_slot(&ring);
 
 	/* Get the data and store it. */
 	if (copy_from_user(write_buf->buf,buf,count))
 		return -EINVAL;
 
-   /* Save the data length */
-   write_buf->len = count;
-
-   /* Move the current ring pointer */
-   write_buf = write_buf->next;
+   /* Save the data length and move the current ring pointer */
+   ring_write_done(&ring, count);
 
    /* Wakeup the blocking threads */
    wake_up_interruptible(&tuio_read_wait);
@@ -225,8 +214,6 @@ static struct miscdevice tsdev = {
 static int __init tuio_init(void)
 {
 	int ret;
-   int i;
-   struct buf_ring_ent *cur;
 
 	/*
 	 * Create the "tsdev" device in the /sys/class/misc directory.
@@ -239,15 +226,13 @@ static int __init tuio_init(void)
 		       "Unable to register %s misc device\n", DEV_NAME);
 
    /* Setup the ring buffer */
-   read_buf = write_buf = cur = kmalloc(sizeof(struct buf_ring_ent), GFP_USER);
-   cur->len = 0;
-   for (i = 1; i < BUF_COUNT; i++) {
-      cur->next = kmalloc(sizeof(struct buf_ring_ent), GFP_USER);
-      cur = cur->next;
-      cur->len = 0;
+   ring_buf = kmalloc(BUF_COUNT * sizeof(struct buf_ring_ent), GFP_USER);
+   if (!ring_buf) {
+      if (!ret)
+         misc_deregister(&tsdev);
+      return -ENOMEM;
    }
-   /* close the loop */
-   cur->next = read_buf;
+   ring_init(&ring, ring_buf, BUF_COUNT);
 
 	return ret;
 }
@@ -258,17 +243,10 @@ static int __init tuio_init(void)
  */
 static void __exit tuio_exit(void)
 {
-   struct buf_ring_ent *cur, *next = 0;
-
 	misc_deregister(&tsdev);
 
    /* Free the ring buffer */
-   cur = read_buf;
-   while (next != read_buf) {
-      next = cur->next;
-      kfree(cur);
-      cur = next;
-   }
+   kfree(ring_buf);
 }
 
 
@@ -0,0 +1,415 @@
+/**
+ * Replays a tuiod packet capture (tuio/tuiod/capture.h) to a UDP port, to
+ * load tuiod and the touchmouse device with recorded traffic.
+ *
+ * Packets go out at their recorded times, -x times faster, or with -m as
+ * fast as they can be sent. Each send waits for its absolute deadline on
+ * CLOCK_MONOTONIC (clock_nanosleep TIMER_ABSTIME), so lateness does not
+ * add up over a long replay.
+ *
+ * A recording can be scaled up to heavier loads:
+ *    -c n  clones every contact n times. The clones get their own session
+ *          ids and are spread across the surface. "alive" lists and "set"
+ *          messages of the 2Dcur profile are rewritten, the rest is copied.
+ *    -S n  sends every packet from n sockets, like n trackers. The copies
+ *          of each sender get session ids of their own.
+ * For example, ten fingers on eight trackers at 500 Hz from a one finger
+ * recording at 60 Hz:
+ *
+ *    ./tuioplay -c 10 -S 8 -x 8.33 table.cap 3333
+ *
+ * At the end the achieved packet rate is printed, and the send lateness
+ * against the deadlines (min, mean, 50/99/99.9th percentile, max).
+ *
+ * Usage:
+ *    ./tuioplay [-h host] [-x speed | -m] [-l loops] [-c contacts]
+ *               [-S sources] capture_file port
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "capture.h"
+
+#define MAX_OUT 65507              /* Largest UDP payload */
+#define MAX_SOCKETS 1024
+#define CLONE_ID_STEP 10000        /* Session ids of the contact clones */
+#define SOURCE_ID_STEP 1000000     /* And of the sender copies */
+#define LATE_BUCKETS 100000        /* 1 us lateness histogram, to 100 ms */
+
+/* "/tuio/2Dcur" ",sifffff" "set", as the capture codes it */
+#define CUR_PATH "/tuio/2Dcur\0"
+#define CUR_PATH_LEN 12
+#define CUR_SET_PREFIX "/tuio/2Dcur\0,sifffff\0\0\0\0set"
+#define CUR_SET_PREFIX_LEN 28
+#define CUR_SET_LEN 52
+
+struct packet {
+   unsigned long long time_ns;     /* From the start of the capture */
+   unsigned int source;
+   unsigned int len;
+   unsigned char *data;
+};
+
+static struct packet *packets;
+static unsigned long count;
+static unsigned int sources = 1;   /* Senders in the capture */
+static struct capture_reader reader;
+
+static int contacts = 1;
+static int copies = 1;
+static unsigned char out[MAX_OUT];
+
+static unsigned long late_hist[LATE_BUCKETS + 1];
+
+
+static unsigned int get_be32(const unsigned char *p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void put_be32(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+}
+
+static long long now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Loads the whole capture, so the replay does no file I/O
+ */
+static void load(const char *file)
+{
+   struct capture_packet p;
+   unsigned long size = 0;
+   unsigned long long first = 0;
+   int ret;
+
+   if (capture_reader_open(&reader, file)) {
+      printf("ERROR: Could not read capture '%s'\n", file);
+      exit(1);
+   }
+
+   while ((ret = capture_next(&reader, &p)) > 0) {
+      if (count == size) {
+         size = size ? 2 * size : 4096;
+         if ((packets = realloc(packets, size * sizeof(*packets))) == NULL)
+            goto oom;
+      }
+      if (!count)
+         first = p.time_ns;
+      packets[count].time_ns = p.time_ns - first;
+      packets[count].source = p.source;
+      packets[count].len = p.len;
+      if ((packets[count].data = malloc(p.len)) == NULL)
+         goto oom;
+      memcpy(packets[count].data, p.data, p.len);
+      if (p.source >= sources)
+         sources = p.source + 1;
+      count++;
+   }
+   if (ret < 0)
+      printf("Warning: Capture is corrupt after packet %lu\n", count);
+   capture_reader_close(&reader);
+   return;
+
+oom:
+   printf("ERROR: Out of memory loading '%s'\n", file);
+   exit(1);
+}
+
+/* Position of clone k, spread over the surface and wrapped into 0..1 */
+static unsigned int offset_coord(unsigned int bits, int k, float step)
+{
+   union { unsigned int i; float f; } v;
+
+   v.i = bits;
+   v.f += k * step;
+   v.f -= floorf(v.f);
+   return v.i;
+}
+
+static int is_set(const unsigned char *in, unsigned int len)
+{
+   return len == CUR_SET_LEN && !memcmp(in, CUR_SET_PREFIX, CUR_SET_PREFIX_LEN);
+}
+
+/* Writes clone k of a "set" message for sender copy s */
+static void clone_set(unsigned char *o, const unsigned char *in, int k, int s)
+{
+   memcpy(o, in, CUR_SET_LEN);
+   put_be32(o + CUR_SET_PREFIX_LEN, get_be32(in + CUR_SET_PREFIX_LEN) +
+         s * SOURCE_ID_STEP + k * CLONE_ID_STEP);
+   put_be32(o + 32, offset_coord(get_be32(in + 32), k, 0.131f));
+   put_be32(o + 36, offset_coord(get_be32(in + 36), k, 0.293f));
+}
+
+/*
+ * Rewrites a packet, or a bundle element, for sender copy s: session ids
+ * are moved and 2Dcur contacts cloned. Returns the bytes written, or -1 if
+ * it is malformed or out would overflow.
+ */
+static long expand(const unsigned char *in, unsigned int len,
+      unsigned char *o, unsigned int room, int s)
+{
+   const unsigned char *types;
+   unsigned int i, n, size, ids, id_base = s * SOURCE_ID_STEP;
+   unsigned long pos;
+   long w;
+   int k;
+
+   /* Bundle: each element in turn, the clones as elements of their own */
+   if (len >= 16 && !memcmp(in, "#bundle", 8)) {
+      if (room < 16)
+         return -1;
+      memcpy(o, in, 16);
+      for (pos = 16, i = 16; i < len; i += size) {
+         if (len - i < 4 || (size = get_be32(in + i)) > len - i - 4)
+            return -1;
+         i += 4;
+         if (is_set(in + i, size)) {
+            if (room - pos < (unsigned long) contacts * (CUR_SET_LEN + 4))
+               return -1;
+            for (k = 0; k < contacts; k++, pos += CUR_SET_LEN + 4) {
+               put_be32(o + pos, CUR_SET_LEN);
+               clone_set(o + pos + 4, in + i, k, s);
+            }
+            continue;
+         }
+         if (room - pos < 4 ||
+               (w = expand(in + i, size, o + pos + 4, room - pos - 4, s)) < 0)
+            return -1;
+         put_be32(o + pos, w);
+         pos += 4 + w;
+      }
+      return pos;
+   }
+
+   /* A "set" on its own cannot be cloned, only moved */
+   if (is_set(in, len)) {
+      if (room < CUR_SET_LEN)
+         return -1;
+      clone_set(o, in, 0, s);
+      return CUR_SET_LEN;
+   }
+
+   /* "alive": every id for every clone */
+   if (len >= CUR_PATH_LEN + 12 && !memcmp(in, CUR_PATH, CUR_PATH_LEN) &&
+         !memcmp(in + CUR_PATH_LEN, ",s", 2)) {
+      types = in + CUR_PATH_LEN + 1;
+      for (ids = 0; CUR_PATH_LEN + 2 + ids < len && types[1 + ids] == 'i';
+            ids++)
+         ;
+      n = CUR_PATH_LEN + (ids + 2) / 4 * 4 + 4;   /* Path and type tags */
+      if (CUR_PATH_LEN + 2 + ids < len && types[1 + ids] == '\0' &&
+            len == n + 8 + 4 * ids && !memcmp(in + n, "alive\0\0\0", 8)) {
+         size = (ids * contacts + 2) / 4 * 4 + 4;
+         if (room < CUR_PATH_LEN + size + 8 + 4 * ids * contacts)
+            return -1;
+         memcpy(o, in, CUR_PATH_LEN);
+         pos = CUR_PATH_LEN;
+         memset(o + pos, 0, size);
+         o[pos] = ',';
+         o[pos + 1] = 's';
+         memset(o + pos + 2, 'i', ids * contacts);
+         pos += size;
+         memcpy(o + pos, "alive\0\0\0", 8);
+         pos += 8;
+         for (k = 0; k < contacts; k++)
+            for (i = 0; i < ids; i++, pos += 4)
+               put_be32(o + pos, get_be32(in + n + 8 + 4 * i) + id_base +
+                     k * CLONE_ID_STEP);
+         return pos;
+      }
+   }
+
+   if (room < len)
+      return -1;
+   memcpy(o, in, len);
+   return len;
+}
+
+static int open_sockets(int *fd, int n, const char *host, const char *port)
+{
+   struct addrinfo hints, *ai;
+   int i;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_DGRAM;
+   if (getaddrinfo(host, port, &hints, &ai)) {
+      printf("ERROR: Unknown host '%s'\n", host);
+      return -1;
+   }
+
+   /* One socket, and so one source port, per sender */
+   for (i = 0; i < n; i++) {
+      if ((fd[i] = socket(ai->ai_family, SOCK_DGRAM, 0)) < 0 ||
+            connect(fd[i], ai->ai_addr, ai->ai_addrlen)) {
+         printf("ERROR: Could not open socket %d: %s\n", i, strerror(errno));
+         freeaddrinfo(ai);
+         return -1;
+      }
+   }
+   freeaddrinfo(ai);
+   return 0;
+}
+
+/* Lateness at the given fraction of the sends, in us */
+static double percentile(unsigned long sends, double fraction)
+{
+   unsigned long seen = 0, want = (unsigned long) ceil(sends * fraction);
+   unsigned int i;
+
+   for (i = 0; i <= LATE_BUCKETS; i++)
+      if ((seen += late_hist[i]) >= want && want)
+         return i;
+   return LATE_BUCKETS;
+}
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-h host] [-x speed | -m] [-l loops] [-c contacts] "
+         "[-S sources] capture_file port\n", name);
+   exit(1);
+}
+
+int main(int argc, char** argv)
+{
+   const char *host = "127.0.0.1";
+   static int fd[MAX_SOCKETS];
+   double speed = 1;
+   int flat_out = 0, loops = 1, opt, loop, s;
+   unsigned long i, sends = 0, errors = 0, bytes = 0;
+   unsigned long long span;
+   long long start, deadline = 0, sent_at, late, late_min = -1, late_max = 0;
+   double late_sum = 0, elapsed;
+   struct timespec ts;
+   struct packet *pk;
+   long len;
+
+   while ((opt = getopt(argc, argv, "h:x:ml:c:S:")) != -1) {
+      switch (opt) {
+         case 'h':
+            host = optarg;
+            break;
+         case 'x':
+            speed = atof(optarg);
+            break;
+         case 'm':
+            flat_out = 1;
+            break;
+         case 'l':
+            loops = atoi(optarg);
+            break;
+         case 'c':
+            contacts = atoi(optarg);
+            break;
+         case 'S':
+            copies = atoi(optarg);
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (argc - optind != 2 || speed <= 0 || loops < 1 || contacts < 1 ||
+         copies < 1 || contacts > 100)
+      usage(argv[0]);
+
+   load(argv[optind]);
+   if (!count) {
+      printf("ERROR: No packets in '%s'\n", argv[optind]);
+      exit(1);
+   }
+   if (sources * copies > MAX_SOCKETS) {
+      printf("ERROR: %u senders times %d is more than %d sockets\n", sources,
+            copies, MAX_SOCKETS);
+      exit(1);
+   }
+   if (open_sockets(fd, sources * copies, host, argv[optind + 1]))
+      exit(1);
+
+   /* Loops follow each other one mean packet interval apart */
+   span = packets[count - 1].time_ns + (count > 1 ?
+         packets[count - 1].time_ns / (count - 1) : 0);
+
+   start = now_ns();
+   for (loop = 0; loop < loops; loop++) {
+      for (i = 0; i < count; i++) {
+         pk = &packets[i];
+         if (!flat_out) {
+            deadline = start + (long long)
+               ((loop * span + pk->time_ns) / speed);
+            ts.tv_sec = deadline / 1000000000;
+            ts.tv_nsec = deadline % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+                  == EINTR)
+               ;
+         }
+
+         for (s = 0; s < copies; s++) {
+            if (contacts == 1 && s == 0) {
+               len = pk->len;
+               memcpy(out, pk->data, len);
+            } else if ((len = expand(pk->data, pk->len, out, sizeof(out),
+                        s)) < 0) {
+               /* Too big to scale up, send it as it was */
+               len = pk->len;
+               memcpy(out, pk->data, len);
+            }
+
+            if (send(fd[pk->source * copies + s], out, len, 0) < 0)
+               errors++;
+            bytes += len;
+            sends++;
+
+            if (!flat_out) {
+               sent_at = now_ns();
+               late = sent_at > deadline ? sent_at - deadline : 0;
+               late_sum += late;
+               if (late_min < 0 || late < late_min)
+                  late_min = late;
+               if (late > late_max)
+                  late_max = late;
+               late /= 1000;
+               late_hist[late < LATE_BUCKETS ? late : LATE_BUCKETS]++;
+            }
+         }
+      }
+   }
+   elapsed = (now_ns() - start) / 1e9;
+
+   printf("%lu packets (%lu bytes) in %.3f s: %.0f packets/s", sends, bytes,
+         elapsed, sends / elapsed);
+   if (!flat_out && span)
+      printf(", target %.0f", count * copies / (span / 1e9 / speed));
+   printf("\n");
+   if (errors)
+      printf("%lu send errors\n", errors);
+   if (!flat_out)
+      printf("late min %.1f mean %.1f p50 %.0f p99 %.0f p99.9 %.0f max %.1f us"
+            "\n", late_min / 1e3, late_sum / sends / 1e3,
+            percentile(sends, 0.5), percentile(sends, 0.99),
+            percentile(sends, 0.999), late_max / 1e3);
+
+   for (i = 0; i < count; i++)
+      free(packets[i].data);
+   free(packets);
+   return 0;
+}
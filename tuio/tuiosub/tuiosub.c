@@ -0,0 +1,144 @@
+/**
+ * Prints the frames tuiod serves with -s (tuio/tuiod/fanout.h).
+ *
+ * Every record is a line with its sender, profile, fseq, the frames lost
+ * and coalesced before it, then a line per contact. -p subscribes to one
+ * profile, -r to the contacts within a region of the surface. -q prints a
+ * count of records and contacts a second instead, and -w waits that many
+ * milliseconds after each record, as a slow client would:
+ *
+ *    ./tuiosub -p /tuio/2Dcur -r 0,0,0.5,1 /tmp/tuio.sock
+ *
+ * Usage:
+ *    ./tuiosub [-p profile] [-r x0,y0,x1,y1] [-q] [-w ms] socket
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fanout.h"
+
+static union {
+   struct fanout_record record;
+   unsigned char data[sizeof(struct fanout_record) +
+      FANOUT_MAX_CONTACTS * sizeof(struct fanout_contact)];
+} rec;
+
+
+static void usage(const char *name)
+{
+   printf("usage: %s [-p profile] [-r x0,y0,x1,y1] [-q] [-w ms] socket\n",
+         name);
+   exit(1);
+}
+
+static void print_record(const struct fanout_record *r)
+{
+   const struct fanout_contact *c = (const struct fanout_contact *) (r + 1);
+   unsigned int i;
+
+   printf("%u %s fseq %d lost %u coalesced %u contacts %u", r->source,
+         r->profile, r->fseq, r->lost, r->coalesced, r->count);
+   if (r->time_ns)
+      printf(" time %llu.%09llu", (unsigned long long) r->time_ns / 1000000000,
+            (unsigned long long) r->time_ns % 1000000000);
+   printf("\n");
+   for (i = 0; i < r->count; i++)
+      printf("   %u class %u %f %f angle %f v %f %f a %f\n", c[i].id,
+            c[i].class_id, c[i].x, c[i].y, c[i].angle, c[i].vx, c[i].vy,
+            c[i].accel);
+}
+
+int main(int argc, char** argv)
+{
+   struct fanout_subscribe sub;
+   struct sockaddr_un addr;
+   struct timespec wait = { 0, 0 }, now;
+   const struct fanout_record *r = &rec.record;
+   unsigned long records = 0, contacts = 0, coalesced = 0;
+   time_t second = 0;
+   int opt, fd, subscribe = 0, quiet = 0;
+   ssize_t n;
+
+   memset(&sub, 0, sizeof(sub));
+   while ((opt = getopt(argc, argv, "p:r:qw:")) != -1) {
+      switch (opt) {
+         case 'p':
+            if (strlen(optarg) >= FANOUT_PROFILE_LEN)
+               usage(argv[0]);
+            strcpy(sub.profile, optarg);
+            subscribe = 1;
+            break;
+         case 'r':
+            if (sscanf(optarg, "%f,%f,%f,%f", &sub.x0, &sub.y0, &sub.x1,
+                     &sub.y1) != 4)
+               usage(argv[0]);
+            subscribe = 1;
+            break;
+         case 'q':
+            quiet = 1;
+            break;
+         case 'w':
+            wait.tv_sec = atoi(optarg) / 1000;
+            wait.tv_nsec = atoi(optarg) % 1000 * 1000000L;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (argc - optind != 1 || strlen(argv[optind]) >= sizeof(addr.sun_path))
+      usage(argv[0]);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, argv[optind]);
+   if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0 ||
+         connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+      perror(argv[optind]);
+      exit(1);
+   }
+   if (subscribe && send(fd, &sub, sizeof(sub), 0) != sizeof(sub)) {
+      perror("subscribe");
+      exit(1);
+   }
+
+   while ((n = recv(fd, rec.data, sizeof(rec.data), 0)) > 0) {
+      if (n < (ssize_t) sizeof(*r) || r->magic != FANOUT_MAGIC ||
+            n != (ssize_t) (sizeof(*r) + r->count *
+               sizeof(struct fanout_contact))) {
+         printf("ERROR: Not a record, %zd bytes\n", n);
+         exit(1);
+      }
+
+      if (!quiet) {
+         print_record(r);
+      } else {
+         records++;
+         contacts += r->count;
+         coalesced += r->coalesced;
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         if (now.tv_sec != second) {
+            if (second)
+               printf("%lu records, %lu contacts, %lu coalesced\n", records,
+                     contacts, coalesced);
+            second = now.tv_sec;
+            records = contacts = coalesced = 0;
+         }
+      }
+      fflush(stdout);
+
+      if (wait.tv_sec || wait.tv_nsec)
+         nanosleep(&wait, NULL);
+   }
+   if (n < 0)
+      perror("recv");
+   else
+      printf("tuiod closed the connection\n");
+   close(fd);
+   return 0;
+}